@@ -26,18 +26,27 @@
 
 MTS_NAMESPACE_BEGIN
 
+/**
+ * \brief Memory pool for path vertices and edges
+ *
+ * By default, entries are recycled individually through a free list.
+ * Renderers which build and discard all of their paths for every sample
+ * (e.g. BDPT) can instead switch to an arena mode, where vertices and edges
+ * are handed out contiguously and returned all at once by \ref reset().
+ */
 class MemoryPool {
 public:
 	/// Create a new memory pool with aninitial set of 128 entries
 	MemoryPool(size_t nEntries = 128)
-		: m_vertexPool(nEntries), m_edgePool(nEntries) { }
+		: m_vertexPool(nEntries), m_edgePool(nEntries),
+		  m_vertexArena(nEntries), m_edgeArena(nEntries), m_arena(false) { }
 
 	/// Destruct the memory pool and release all entries
 	~MemoryPool() { }
 
 	/// Acquire an edge
 	inline PathEdge *allocEdge() {
-		PathEdge *edge = m_edgePool.alloc();
+		PathEdge *edge = m_arena ? m_edgeArena.alloc() : m_edgePool.alloc();
 		#if defined(MTS_BD_DEBUG_HEAVY)
 		memset(edge, 0xFF, sizeof(PathEdge));
 		#endif
@@ -46,7 +55,7 @@ public:
 
 	/// Acquire an vertex
 	inline PathVertex *allocVertex() {
-		PathVertex *vertex = m_vertexPool.alloc();
+		PathVertex *vertex = m_arena ? m_vertexArena.alloc() : m_vertexPool.alloc();
 		#if defined(MTS_BD_DEBUG_HEAVY)
 		memset(vertex, 0xFF, sizeof(PathVertex));
 		#endif
@@ -55,27 +64,58 @@ public:
 
 	/// Release an edge
 	inline void release(PathEdge *edge) {
-		m_edgePool.release(edge);
+		if (m_arena)
+			m_edgeArena.release(edge);
+		else
+			m_edgePool.release(edge);
 	}
 
 	/// Release an entry
 	inline void release(PathVertex *vertex) {
-		m_vertexPool.release(vertex);
+		if (m_arena)
+			m_vertexArena.release(vertex);
+		else
+			m_vertexPool.release(vertex);
+	}
+
+	/**
+	 * \brief Switch between the free list and arena allocation
+	 *
+	 * In arena mode, \ref release() only reclaims the most recently
+	 * allocated entry, and all other entries stay in use until the next
+	 * call to \ref reset(). The pool must be unused when switching.
+	 */
+	void setArenaMode(bool arena) {
+		if (!unused())
+			SLog(EError, "MemoryPool::setArenaMode(): the pool is still in use!");
+		m_arena = arena;
+	}
+
+	/// Are vertices and edges allocated from an arena?
+	inline bool isArenaMode() const {
+		return m_arena;
+	}
+
+	/// Release all vertices and edges allocated in arena mode at once
+	inline void reset() {
+		m_vertexArena.reset();
+		m_edgeArena.reset();
 	}
 
 	/// Check if every entry has been released
 	bool unused() const {
-		return m_vertexPool.unused() && m_edgePool.unused();
+		return m_vertexPool.unused() && m_edgePool.unused()
+			&& m_vertexArena.unused() && m_edgeArena.unused();
 	}
 
 	/// Return the currently allocated amount of storage for edges
 	inline size_t edgeSize() {
-		return m_edgePool.size();
+		return m_edgePool.size() + m_edgeArena.size();
 	}
 
 	/// Return the currently allocated amount of storage for vertices
 	inline size_t vertexSize() {
-		return m_vertexPool.size();
+		return m_vertexPool.size() + m_vertexArena.size();
 	}
 
 	/// Return a human-readable description
@@ -83,7 +123,10 @@ public:
 		std::ostringstream oss;
 		oss << "MemoryPool[" << endl
 			<< "  vertexPool = " << m_vertexPool.toString() << "," << endl
-			<< "  edgePool = " << m_edgePool.toString() << endl
+			<< "  edgePool = " << m_edgePool.toString() << "," << endl
+			<< "  vertexArena = " << m_vertexArena.toString() << "," << endl
+			<< "  edgeArena = " << m_edgeArena.toString() << "," << endl
+			<< "  arenaMode = " << m_arena << endl
 			<< "]";
 		return oss.str();
 	}
@@ -91,6 +134,9 @@ public:
 private:
 	BasicMemoryPool<PathVertex> m_vertexPool;
 	BasicMemoryPool<PathEdge> m_edgePool;
+	BasicMemoryArena<PathVertex> m_vertexArena;
+	BasicMemoryArena<PathEdge> m_edgeArena;
+	bool m_arena;
 };
 
 MTS_NAMESPACE_END
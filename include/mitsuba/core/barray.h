@@ -21,6 +21,7 @@
 #define __MITSUBA_CORE_BARRAY_H_
 
 #include <mitsuba/mitsuba.h>
+#include <mitsuba/core/half.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -403,6 +404,324 @@ private:
 	bool m_owner;
 };
 
+/**
+ * \brief Block-compressed 2D array of color values
+ *
+ * This class stores the same 4x4 blocks as \ref BlockedArray, but uses a
+ * lossy fixed-rate encoding in the spirit of the BC1 and BC6H texture
+ * formats: each block holds two endpoint values in half precision and a
+ * 4-bit index per entry, which selects one of 16 evenly spaced points on the
+ * line segment between the endpoints. Entries are decoded on access.
+ *
+ * An RGB block thus occupies 20 bytes instead of the 96 bytes required by a
+ * \ref BlockedArray of half precision values, and a luminance block occupies
+ * 12 instead of 32 bytes.
+ *
+ * Assumes that \c Value is some kind of \c TSpectrum instance with
+ * nonnegative entries.
+ */
+template <typename Value> class CompressedBlockedArray {
+public:
+	typedef typename Value::Scalar Scalar;
+	static const size_t blockSize = 4;
+
+	/// Compressed representation of a block of 4x4 entries
+	struct Block {
+		/// Endpoints of the line segment
+		half endpoints[2][Value::dim];
+		/// 4-bit position of each entry along the segment
+		uint32_t indices[2];
+
+		/// Decode the entry with the given index (in row-major order)
+		inline Value eval(size_t i) const {
+			Scalar t = (Scalar) ((indices[i >> 3] >> (4 * (i & 7))) & 0xF)
+				* (Scalar) (1.0f / 15.0f);
+			Value result;
+			for (int c=0; c<Value::dim; ++c) {
+				Scalar a = (Scalar) endpoints[0][c],
+				       b = (Scalar) endpoints[1][c];
+				result[c] = a + (b - a) * t;
+			}
+			return result;
+		}
+	};
+
+	/// Create an unitialized compressed array
+	CompressedBlockedArray() : m_data(NULL), m_size(-1), m_owner(false) { }
+
+	/**
+	 * \brief Allocate memory for a compressed array of
+	 * the specified width and height
+	 */
+	void alloc(const Vector2i &size) {
+		if (m_data && m_owner)
+			freeAligned(m_data);
+
+		m_xBlocks = (size.x + blockSize - 1) / blockSize;
+		m_yBlocks = (size.y + blockSize - 1) / blockSize;
+		m_data = (Block *) allocAligned(m_xBlocks * m_yBlocks * sizeof(Block));
+		m_owner = true; /* We own this pointer */
+		m_size = size;
+	}
+
+	/**
+	 * \brief Initialize the compressed array with a given pointer
+	 * and array size.
+	 *
+	 * This is useful in case memory has already been allocated.
+	 */
+	void map(void *ptr, const Vector2i &size) {
+		if (m_data && m_owner)
+			freeAligned(m_data);
+
+		m_xBlocks = (size.x + blockSize - 1) / blockSize;
+		m_yBlocks = (size.y + blockSize - 1) / blockSize;
+		m_data = (Block *) ptr;
+		m_owner = false; /* We do not own this pointer */
+		m_size = size;
+	}
+
+	/**
+	 * \brief Compress values from a non-blocked source in row-major order
+	 *
+	 * Blocks that extend past the right or bottom edge of the array
+	 * are padded by replicating the outermost entries.
+	 */
+	template <typename AltValue> void init(const AltValue *data) {
+		Value values[blockSize * blockSize];
+
+		for (size_t yb=0; yb<m_yBlocks; ++yb) {
+			for (size_t xb=0; xb<m_xBlocks; ++xb) {
+				for (size_t i=0; i<blockSize * blockSize; ++i) {
+					int x = std::min((int) (xb * blockSize + i % blockSize), m_size.x - 1),
+					    y = std::min((int) (yb * blockSize + i / blockSize), m_size.y - 1);
+					values[i] = Value(data[x + (size_t) m_size.x * y]);
+				}
+				encode(values, m_data[xb + yb * m_xBlocks]);
+			}
+		}
+	}
+
+	/**
+	 * \brief Compress values from a non-blocked source in row-major order
+	 * and collect component-wise minimum, maximum, and average information.
+	 *
+	 * Assumes that \c AltValue is some kind of \c TVector or \c TSpectrum instance.
+	 */
+	template <typename AltValue> void init(const AltValue *data,
+			AltValue &min_, AltValue &max_, AltValue &avg_) {
+		typedef typename AltValue::Scalar AltScalar;
+
+		AltValue
+			min(+std::numeric_limits<AltScalar>::infinity()),
+			max(-std::numeric_limits<AltScalar>::infinity()),
+			avg((AltScalar) 0);
+
+		const AltValue *ptr = data;
+		for (int y=0; y<m_size.y; ++y) {
+			for (int x=0; x<m_size.x; ++x) {
+				const AltValue &value = *ptr++;
+				for (int i=0; i<AltValue::dim; ++i) {
+					min[i]  = std::min(min[i], value[i]);
+					max[i]  = std::max(max[i], value[i]);
+					avg[i] += value[i];
+				}
+			}
+		}
+		min_ = min;
+		max_ = max;
+		avg_ = avg / (AltScalar) (m_size.x * m_size.y);
+
+		init(data);
+	}
+
+	/**
+	 * \brief Decompress the contents of the array to a non-blocked
+	 * destination buffer in row-major order.
+	 *
+	 * \remark This function performs type casts when <tt>Value != AltValue</tt>
+	 */
+	template <typename AltValue> void copyTo(AltValue *data) const {
+		for (int y=0; y<m_size.y; ++y)
+			for (int x=0; x<m_size.x; ++x)
+					*data++ = AltValue((*this)(x, y));
+	}
+
+	/**
+	 * \brief Zero out unused memory portions
+	 *
+	 * Since blocks are always fully initialized, this function does nothing
+	 */
+	void cleanup() {
+	}
+
+	/// Return the size of the array
+	inline const Vector2i &getSize() const { return m_size; }
+
+	/// Return the hypothetical heap memory requirements of a compressed array for the given size
+	inline static size_t bufferSize(const Vector2i &size) {
+		size_t xBlocks = (size.x + blockSize - 1) / blockSize,
+		       yBlocks = (size.y + blockSize - 1) / blockSize;
+		return xBlocks * yBlocks * sizeof(Block);
+	}
+
+	/// Return the size of the allocated buffer
+	inline size_t getBufferSize() const {
+		return m_xBlocks * m_yBlocks * sizeof(Block);
+	}
+
+	/// Return the width of the array
+	inline int getWidth() const { return m_size.x; }
+
+	/// Return the height of the array
+	inline int getHeight() const { return m_size.y; }
+
+	/// Release all memory
+	~CompressedBlockedArray() {
+		if (m_data && m_owner)
+			freeAligned(m_data);
+	}
+
+	/// Decode the specified entry
+	inline Value operator()(int x, int y) const {
+		size_t xb = (size_t) (x >> 2), yb = (size_t) (y >> 2),
+		       xo = (size_t) (x & 3),  yo = (size_t) (y & 3);
+
+		return m_data[xb + yb * m_xBlocks].eval(blockSize * yo + xo);
+	}
+
+	/// Return a pointer to the internal representation
+	inline Block *getData() { return m_data; }
+
+	/// Return a pointer to the internal representation (const version)
+	inline const Block *getData() const { return m_data; }
+
+	/**
+	 * \brief Compress a block of 4x4 values (in row-major order)
+	 *
+	 * The endpoints are initially placed at the extremes of the values
+	 * along their principal axis and then refined using a least-squares
+	 * fit given the resulting indices.
+	 */
+	static void encode(const Value *values, Block &block) {
+		const int n = (int) (blockSize * blockSize), dim = Value::dim;
+
+		Value mean((Scalar) 0);
+		for (int i=0; i<n; ++i)
+			mean += values[i];
+		mean /= (Scalar) n;
+
+		/* Determine the principal axis using power iteration */
+		Value axis((Scalar) 1);
+		if (dim > 1) {
+			Scalar cov[Value::dim][Value::dim];
+			for (int a=0; a<dim; ++a)
+				for (int b=0; b<dim; ++b)
+					cov[a][b] = 0;
+			for (int i=0; i<n; ++i) {
+				Value d = values[i] - mean;
+				for (int a=0; a<dim; ++a)
+					for (int b=0; b<dim; ++b)
+						cov[a][b] += d[a] * d[b];
+			}
+
+			for (int it=0; it<8; ++it) {
+				Value next((Scalar) 0);
+				Scalar maxComp = 0;
+				for (int a=0; a<dim; ++a) {
+					for (int b=0; b<dim; ++b)
+						next[a] += cov[a][b] * axis[b];
+					maxComp = std::max(maxComp, std::abs(next[a]));
+				}
+				if (maxComp == 0)
+					break;
+				axis = next / maxComp;
+			}
+		}
+
+		Scalar axisLength2 = 0;
+		for (int c=0; c<dim; ++c)
+			axisLength2 += axis[c] * axis[c];
+
+		Scalar tMin = 0, tMax = 0;
+		for (int i=0; i<n; ++i) {
+			Scalar t = 0;
+			for (int c=0; c<dim; ++c)
+				t += (values[i][c] - mean[c]) * axis[c];
+			t /= axisLength2;
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		Scalar error = setEndpoints(values, mean + axis * tMin,
+			mean + axis * tMax, block);
+
+		/* Least-squares refinement of the endpoints for the chosen weights */
+		Scalar aa = 0, ab = 0, bb = 0;
+		Value ax((Scalar) 0), bx((Scalar) 0);
+		for (int i=0; i<n; ++i) {
+			Scalar t = (Scalar) ((block.indices[i >> 3] >> (4 * (i & 7))) & 0xF)
+				* (Scalar) (1.0f / 15.0f), s = 1 - t;
+			aa += s * s; ab += s * t; bb += t * t;
+			ax += values[i] * s; bx += values[i] * t;
+		}
+
+		Scalar det = aa * bb - ab * ab;
+		if (det > (Scalar) 1e-6f) {
+			Block refined;
+			Scalar refinedError = setEndpoints(values,
+				(ax * bb - bx * ab) / det, (bx * aa - ax * ab) / det, refined);
+			if (refinedError < error)
+				block = refined;
+		}
+	}
+
+protected:
+	/**
+	 * \brief Quantize the given endpoints, choose the best index for
+	 * every value, and return the resulting squared error
+	 */
+	static Scalar setEndpoints(const Value *values, const Value &e0,
+			const Value &e1, Block &block) {
+		const int n = (int) (blockSize * blockSize), dim = Value::dim;
+
+		Value a, d;
+		for (int c=0; c<dim; ++c) {
+			block.endpoints[0][c] = half((float) std::min(std::max(e0[c], (Scalar) 0), (Scalar) HALF_MAX));
+			block.endpoints[1][c] = half((float) std::min(std::max(e1[c], (Scalar) 0), (Scalar) HALF_MAX));
+			a[c] = (Scalar) block.endpoints[0][c];
+			d[c] = (Scalar) block.endpoints[1][c] - a[c];
+		}
+
+		Scalar length2 = 0;
+		for (int c=0; c<dim; ++c)
+			length2 += d[c] * d[c];
+		Scalar scale = length2 > 0 ? (Scalar) 15 / length2 : (Scalar) 0;
+
+		block.indices[0] = block.indices[1] = 0;
+		Scalar error = 0;
+		for (int i=0; i<n; ++i) {
+			Scalar t = 0;
+			for (int c=0; c<dim; ++c)
+				t += (values[i][c] - a[c]) * d[c];
+			uint32_t index = (uint32_t) std::min(std::max(
+				t * scale + (Scalar) 0.5f, (Scalar) 0), (Scalar) 15);
+			block.indices[i >> 3] |= index << (4 * (i & 7));
+
+			Value diff = block.eval((size_t) i) - values[i];
+			for (int c=0; c<dim; ++c)
+				error += diff[c] * diff[c];
+		}
+		return error;
+	}
+
+private:
+	Block *m_data;
+	Vector2i m_size;
+	size_t m_xBlocks, m_yBlocks;
+	bool m_owner;
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_BARRAY_H_ */
@@ -22,6 +22,9 @@
 
 #include <mitsuba/core/aabb.h>
 #include <mitsuba/core/timer.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/sse.h>
+#endif
 
 MTS_NAMESPACE_BEGIN
 
@@ -1041,6 +1044,473 @@ protected:
 	size_t m_depth;
 };
 
+/**
+ * \brief Compact kd-tree over point data with leaf buckets
+ *
+ * In contrast to \ref PointKDTree, the points are not stored inside the
+ * tree nodes. The tree is built using the sliding midpoint rule until at
+ * most \ref KLeafSize points remain, after which the points and their
+ * data records are reordered so that every leaf references a contiguous
+ * range. Coordinates are kept in structure-of-arrays form, which allows
+ * testing the points of a leaf four at a time (using SSE in single
+ * precision builds).
+ *
+ * Inner nodes only take 8 bytes: the split position is stored in single
+ * precision (points are partitioned against the rounded value), the left
+ * child directly follows its parent, and the index of the right child
+ * shares a word with the split axis.
+ *
+ * Points can only be added before \ref build() is called. Indices passed
+ * to query callbacks and stored in search results refer to the order
+ * established by \ref build().
+ *
+ * \tparam _PointType Underlying point data type with up to three dimensions
+ * \tparam _DataRecord Custom storage that should be associated with each point
+ *
+ * \ingroup libcore
+ * \see PointKDTree
+ */
+template <typename _PointType, typename _DataRecord> class CompactPointKDTree {
+public:
+	typedef _PointType                       PointType;
+	typedef _DataRecord                      DataRecord;
+	typedef uint32_t                         IndexType;
+	typedef typename PointType::Scalar       Scalar;
+	typedef TAABB<PointType>                 AABBType;
+
+	/// Maximum number of points in a leaf bucket
+	static const IndexType KLeafSize = 8;
+
+	/// Compact kd-tree node (8 bytes)
+	struct Node {
+		enum {
+			ELeafAxis  = 3,
+			EAxisMask  = 3,
+			EIndexShift = 2
+		};
+
+		union {
+			/// Split position of an inner node
+			float split;
+			/// Index of the first point of a leaf
+			IndexType start;
+		};
+		/// Split axis (or \ref ELeafAxis) and right child index (or point count)
+		IndexType flags;
+
+		/// Check whether this is a leaf node
+		inline bool isLeaf() const { return (flags & EAxisMask) == ELeafAxis; }
+		/// Return the split axis of an inner node
+		inline int getAxis() const { return (int) (flags & EAxisMask); }
+		/// Return the index of the right child of an inner node
+		inline IndexType getRightIndex() const { return flags >> EIndexShift; }
+		/// Return the number of points in a leaf
+		inline IndexType getCount() const { return flags >> EIndexShift; }
+	};
+
+	/// Result data type for k-nn queries
+	struct SearchResult {
+		Float distSquared;
+		IndexType index;
+
+		inline SearchResult() {}
+
+		inline SearchResult(Float distSquared, IndexType index)
+			: distSquared(distSquared), index(index) { }
+
+		inline bool operator==(const SearchResult &r) const {
+			return distSquared == r.distSquared &&
+				index == r.index;
+		}
+	};
+
+	/// Comparison functor for nearest-neighbor search queries
+	struct SearchResultComparator {
+	public:
+		inline bool operator()(const SearchResult &a, const SearchResult &b) const {
+			return a.distSquared < b.distSquared;
+		}
+	};
+
+public:
+	/// Create an empty kd-tree
+	inline CompactPointKDTree() : m_depth(0) {
+		BOOST_STATIC_ASSERT(PointType::dim <= 3);
+	}
+
+	// =============================================================
+	//! @{ \name \c stl::vector-like interface
+	// =============================================================
+	/// Remove all points
+	inline void clear() {
+		for (int i=0; i<PointType::dim; ++i)
+			m_coords[i].clear();
+		m_data.clear();
+		m_nodes.clear();
+		m_aabb.reset();
+		m_depth = 0;
+	}
+	/// Reserve memory for a certain number of points
+	inline void reserve(size_t size) {
+		for (int i=0; i<PointType::dim; ++i)
+			m_coords[i].reserve(size);
+		m_data.reserve(size);
+	}
+	/// Return the number of points
+	inline size_t size() const { return m_data.size(); }
+	/// Return the number of points that fit into the reserved memory
+	inline size_t capacity() const { return m_data.capacity(); }
+	/// Append a point and its data record
+	inline void push_back(const PointType &p, const DataRecord &data) {
+		for (int i=0; i<PointType::dim; ++i)
+			m_coords[i].push_back(p[i]);
+		m_data.push_back(data);
+		m_aabb.expandBy(p);
+	}
+	/// Return the position of a point
+	inline PointType getPosition(size_t idx) const {
+		PointType p;
+		for (int i=0; i<PointType::dim; ++i)
+			p[i] = m_coords[i][idx];
+		return p;
+	}
+	/// Return the data record of a point
+	inline DataRecord &getData(size_t idx) { return m_data[idx]; }
+	/// Return the data record of a point (const version)
+	inline const DataRecord &getData(size_t idx) const { return m_data[idx]; }
+	//! @}
+	// =============================================================
+
+	/// Set the AABB of the underlying point data
+	inline void setAABB(const AABBType &aabb) { m_aabb = aabb; }
+	/// Return the AABB of the underlying point data
+	inline const AABBType &getAABB() const { return m_aabb; }
+	/// Return the depth of the constructed kd-tree
+	inline size_t getDepth() const { return m_depth; }
+	/// Return the number of nodes of the constructed kd-tree
+	inline size_t getNodeCount() const { return m_nodes.size(); }
+	/// Return a node of the constructed kd-tree (the root has index zero)
+	inline const Node &getNode(IndexType index) const { return m_nodes[index]; }
+
+	/// Return the memory used by nodes, coordinates and data records in bytes
+	inline size_t getMemoryUsage() const {
+		return m_nodes.size() * sizeof(Node)
+			+ m_data.size() * (PointType::dim * sizeof(Scalar) + sizeof(DataRecord));
+	}
+
+	/// Construct the kd-tree hierarchy and reorder the points
+	void build(bool recomputeAABB = false) {
+		ref<Timer> timer = new Timer();
+		IndexType count = (IndexType) m_data.size();
+		m_nodes.clear();
+		m_depth = 0;
+
+		if (count == 0) {
+			SLog(EWarn, "build(): kd-tree is empty!");
+			return;
+		}
+
+		if (recomputeAABB) {
+			m_aabb.reset();
+			for (IndexType i=0; i<count; ++i)
+				m_aabb.expandBy(getPosition(i));
+		}
+
+		std::vector<IndexType> indirection(count);
+		for (IndexType i=0; i<count; ++i)
+			indirection[i] = i;
+
+		m_nodes.reserve(4 * (count / KLeafSize) + 1);
+		buildNode(&indirection[0], 0, count, m_aabb, 1);
+		std::vector<Node>(m_nodes).swap(m_nodes);
+		int constructionTime = timer->getMilliseconds();
+		timer->reset();
+
+		/* Move the points into leaf order */
+		std::vector<Scalar> coords(count);
+		for (int i=0; i<PointType::dim; ++i) {
+			for (IndexType j=0; j<count; ++j)
+				coords[j] = m_coords[i][indirection[j]];
+			m_coords[i].swap(coords);
+			std::vector<Scalar>(m_coords[i]).swap(m_coords[i]);
+		}
+		{
+			std::vector<DataRecord> data(count);
+			for (IndexType j=0; j<count; ++j)
+				data[j] = m_data[indirection[j]];
+			m_data.swap(data);
+		}
+
+		SLog(EDebug, "Built a compact %i-dimensional kd-tree over %u points (%s, "
+			"depth " SIZE_T_FMT ") in %i ms (+ %i ms to reorder)", PointType::dim, count,
+			memString(getMemoryUsage()).c_str(), m_depth, constructionTime,
+			timer->getMilliseconds());
+	}
+
+	/**
+	 * \brief Run a k-nearest-neighbor search query
+	 *
+	 * Has the same semantics as \ref PointKDTree::nnSearch().
+	 *
+	 * \param p Search position
+	 * \param sqrSearchRadius
+	 *      Specifies the squared maximum search radius. After the query
+	 *      finishes, the parameter value will correspond to the (potentially lower)
+	 *      maximum query radius that was necessary to ensure that the number of
+	 *      results did not exceed \c k.
+	 * \param k Maximum number of search results
+	 * \param results Target array for search results. Must
+	 *      contain storage for at least \c k+1 entries!
+	 * \return The number of search results (equal to \c k or less)
+	 */
+	size_t nnSearch(const PointType &p, Float &sqrSearchRadius,
+			size_t k, SearchResult *results) const {
+		NNCollector collector(k, results, sqrSearchRadius);
+		traverse(p, collector.sqrSearchRadius, collector);
+		sqrSearchRadius = collector.sqrSearchRadius;
+		return collector.resultCount;
+	}
+
+	/// Run a k-nearest-neighbor search query without any search radius threshold
+	inline size_t nnSearch(const PointType &p, size_t k,
+			SearchResult *results) const {
+		Float searchRadiusSqr = std::numeric_limits<Float>::infinity();
+		return nnSearch(p, searchRadiusSqr, k, results);
+	}
+
+	/**
+	 * \brief Execute a search query and run the specified functor on the results
+	 *
+	 * The functor is invoked with the index of every point whose distance to
+	 * \c p is smaller than \c searchRadius.
+	 *
+	 * \return The number of functor invocations
+	 */
+	template <typename Functor> size_t executeQuery(const PointType &p,
+			Float searchRadius, Functor &functor) const {
+		QueryCollector<Functor> collector(functor);
+		Float sqrSearchRadius = searchRadius * searchRadius;
+		traverse(p, sqrSearchRadius, collector);
+		return collector.found;
+	}
+
+protected:
+	struct NNCollector {
+		size_t k, resultCount;
+		SearchResult *results;
+		Float sqrSearchRadius;
+		bool isHeap;
+
+		inline NNCollector(size_t k, SearchResult *results, Float sqrSearchRadius)
+			: k(k), resultCount(0), results(results),
+			  sqrSearchRadius(sqrSearchRadius), isHeap(false) { }
+
+		inline void operator()(IndexType index, Float distSquared) {
+			if (resultCount < k) {
+				results[resultCount++] = SearchResult(distSquared, index);
+				return;
+			}
+			if (!isHeap) {
+				std::make_heap(results, results + resultCount, SearchResultComparator());
+				isHeap = true;
+			}
+
+			/* Add the new point, remove the one that is farthest away */
+			results[resultCount] = SearchResult(distSquared, index);
+			std::push_heap(results, results + resultCount + 1, SearchResultComparator());
+			std::pop_heap(results, results + resultCount + 1, SearchResultComparator());
+			sqrSearchRadius = results[0].distSquared;
+		}
+	};
+
+	template <typename Functor> struct QueryCollector {
+		Functor &functor;
+		size_t found;
+
+		inline QueryCollector(Functor &functor) : functor(functor), found(0) { }
+
+		inline void operator()(IndexType index, Float distSquared) {
+			functor(index);
+			++found;
+		}
+	};
+
+	/**
+	 * \brief Visit all leaves that may contain points closer than
+	 * the (possibly shrinking) search radius, nearest side first
+	 */
+	template <typename Collector> inline void traverse(const PointType &p,
+			const Float &sqrSearchRadius, Collector &collector) const {
+		if (m_nodes.empty())
+			return;
+
+		struct StackEntry {
+			IndexType index;
+			Float distSquared;
+		};
+		StackEntry *stack = (StackEntry *) alloca((m_depth+1) * sizeof(StackEntry));
+		IndexType index = 0, stackPos = 0;
+
+		while (true) {
+			const Node &node = m_nodes[index];
+
+			if (!node.isLeaf()) {
+				Float distToPlane = (Float) (p[node.getAxis()] - (Scalar) node.split);
+				IndexType left = index + 1, right = node.getRightIndex();
+				if (distToPlane*distToPlane <= sqrSearchRadius) {
+					stack[stackPos].index = distToPlane > 0 ? left : right;
+					stack[stackPos].distSquared = distToPlane*distToPlane;
+					++stackPos;
+				}
+				index = distToPlane > 0 ? right : left;
+				continue;
+			}
+
+			scanLeaf(node, p, sqrSearchRadius, collector);
+
+			/* Skip subtrees that moved out of range of a shrinking search */
+			do {
+				if (stackPos == 0)
+					return;
+				--stackPos;
+			} while (stack[stackPos].distSquared > sqrSearchRadius);
+			index = stack[stackPos].index;
+		}
+	}
+
+	/// Compute the distances to the points of a leaf and report the ones within range
+	template <typename Collector> inline void scanLeaf(const Node &node, const PointType &p,
+			const Float &sqrSearchRadius, Collector &collector) const {
+		IndexType i = node.start, end = node.start + node.getCount();
+		const Scalar *coords[3];
+		for (int j=0; j<PointType::dim; ++j)
+			coords[j] = &m_coords[j][0];
+
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+		if (PointType::dim == 3 && sizeof(Scalar) == sizeof(float)) {
+			const float *x = (const float *) coords[0],
+			            *y = (const float *) coords[1],
+			            *z = (const float *) coords[2];
+			const __m128
+				px = _mm_set1_ps((float) p[0]),
+				py = _mm_set1_ps((float) p[1]),
+				pz = _mm_set1_ps((float) p[PointType::dim - 1]);
+
+			for (; i + 4 <= end; i += 4) {
+				__m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), px),
+				       dy = _mm_sub_ps(_mm_loadu_ps(y + i), py),
+				       dz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+				__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+					_mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int mask = _mm_movemask_ps(_mm_cmplt_ps(dist,
+					_mm_set1_ps((float) sqrSearchRadius)));
+				if (!mask)
+					continue;
+
+				float distances[4];
+				_mm_storeu_ps(distances, dist);
+				for (int j=0; j<4; ++j) {
+					/* The radius may shrink while the results are collected */
+					if ((mask & (1 << j)) && distances[j] < sqrSearchRadius)
+						collector(i + j, distances[j]);
+				}
+			}
+		}
+#endif
+
+		for (; i < end; ++i) {
+			Float distSquared = 0;
+			for (int j=0; j<PointType::dim; ++j) {
+				Float diff = (Float) (coords[j][i] - p[j]);
+				distSquared += diff * diff;
+			}
+			if (distSquared < sqrSearchRadius)
+				collector(i, distSquared);
+		}
+	}
+
+	/// Recursively build the subtree over a range of the indirection table
+	void buildNode(IndexType *indices, IndexType begin, IndexType end,
+			const AABBType &aabb, size_t depth) {
+		m_depth = std::max(depth, m_depth);
+		IndexType nodeIndex = (IndexType) m_nodes.size(),
+		          count = end - begin;
+		m_nodes.push_back(Node());
+
+		IndexType mid = begin;
+		AABBType bounds(aabb);
+		int axis = 0;
+		float split = 0;
+
+		for (int attempt = 0; count > KLeafSize && attempt < PointType::dim; ++attempt) {
+			axis = bounds.getLargestAxis();
+			if (!(bounds.max[axis] > bounds.min[axis]))
+				break;
+			const std::vector<Scalar> &coords = m_coords[axis];
+
+			/* Sliding midpoint rule, using the median if one side stays empty */
+			split = (float) ((bounds.min[axis] + bounds.max[axis]) * (Scalar) 0.5f);
+			mid = partition(indices, begin, end, coords, (Scalar) split, false);
+
+			if (mid == begin || mid == end) {
+				IndexType *median = indices + begin + count / 2;
+				std::nth_element(indices + begin, median, indices + end,
+					[&](IndexType a, IndexType b) { return coords[a] < coords[b]; });
+				split = (float) coords[*median];
+				mid = partition(indices, begin, end, coords, (Scalar) split, false);
+				if (mid == begin)
+					mid = partition(indices, begin, end, coords, (Scalar) split, true);
+			}
+
+			if (mid != begin && mid != end)
+				break;
+
+			/* All points share the coordinate (e.g. they lie on a plane):
+			   collapse this extent and retry along the remaining axes */
+			bounds.min[axis] = bounds.max[axis] = coords[indices[begin]];
+		}
+
+		if (mid == begin || mid == end) {
+			/* Too few points or no usable split plane */
+			Node &node = m_nodes[nodeIndex];
+			node.start = begin;
+			node.flags = (count << Node::EIndexShift) | Node::ELeafAxis;
+			return;
+		}
+
+		AABBType leftAABB(bounds), rightAABB(bounds);
+		leftAABB.max[axis] = rightAABB.min[axis] = (Scalar) split;
+
+		buildNode(indices, begin, mid, leftAABB, depth + 1);
+		IndexType rightIndex = (IndexType) m_nodes.size();
+		buildNode(indices, mid, end, rightAABB, depth + 1);
+
+		Node &node = m_nodes[nodeIndex];
+		node.split = split;
+		node.flags = (rightIndex << Node::EIndexShift) | (IndexType) axis;
+	}
+
+	/// Move points below (or not above) the split value to the front of the range
+	static inline IndexType partition(IndexType *indices, IndexType begin, IndexType end,
+			const std::vector<Scalar> &coords, Scalar split, bool inclusive) {
+		IndexType *mid;
+		if (inclusive)
+			mid = std::partition(indices + begin, indices + end,
+				[&](IndexType i) { return coords[i] <= split; });
+		else
+			mid = std::partition(indices + begin, indices + end,
+				[&](IndexType i) { return coords[i] < split; });
+		return (IndexType) (mid - indices);
+	}
+
+protected:
+	std::vector<Node> m_nodes;
+	std::vector<Scalar> m_coords[PointType::dim];
+	std::vector<DataRecord> m_data;
+	AABBType m_aabb;
+	size_t m_depth;
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_KDTREE_H_ */
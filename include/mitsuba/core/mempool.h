@@ -108,6 +108,90 @@ private:
 	size_t m_size;
 };
 
+/**
+ * \brief Bump allocator for objects of the same type, which are
+ * released all at once
+ *
+ * Entries are handed out contiguously from a list of blocks in the order
+ * of the requests. Only the most recently allocated entry can be released
+ * individually (releasing any other entry has no effect), and \ref reset()
+ * returns all entries in constant time while keeping the blocks around
+ * for later reuse. Like \ref BasicMemoryPool, this class does not invoke
+ * constructors or destructors.
+ *
+ * \ingroup libcore
+ */
+template <typename T> class BasicMemoryArena {
+public:
+	/// Create a new arena, which allocates blocks of the given number of entries
+	BasicMemoryArena(size_t blockSize = MTS_MEMPOOL_GRANULARITY)
+		: m_blockSize(blockSize), m_block(0), m_next(NULL), m_end(NULL) { }
+
+	/// Destruct the arena and release all blocks
+	~BasicMemoryArena() {
+		for (size_t i=0; i<m_blocks.size(); ++i)
+			freeAligned(m_blocks[i]);
+	}
+
+	/// Acquire an entry
+	inline T *alloc() {
+		if (EXPECT_NOT_TAKEN(m_next == m_end))
+			nextBlock();
+		return m_next++;
+	}
+
+	/// Release an entry (only has an effect for the most recent one)
+	inline void release(T *ptr) {
+		if (ptr + 1 != m_next || m_next == m_blocks[m_block])
+			return;
+		/* Continue at the end of the previous block once this one is empty */
+		if (--m_next == m_blocks[m_block] && m_block > 0) {
+			--m_block;
+			m_next = m_end = m_blocks[m_block] + m_blockSize;
+		}
+	}
+
+	/// Release all entries at once
+	inline void reset() {
+		if (m_blocks.empty())
+			return;
+		m_block = 0;
+		m_next = m_blocks[0];
+		m_end = m_next + m_blockSize;
+	}
+
+	/// Return the total size of the arena
+	inline size_t size() const {
+		return m_blocks.size() * m_blockSize;
+	}
+
+	/// Check if every entry has been released
+	bool unused() const {
+		return m_blocks.empty() || (m_block == 0 && m_next == m_blocks[0]);
+	}
+
+	/// Return a human-readable description
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "BasicMemoryArena[size=" << size() << ", blocks=" << m_blocks.size() << "]";
+		return oss.str();
+	}
+private:
+	void nextBlock() {
+		if (m_next != NULL)
+			++m_block;
+		if (m_block == m_blocks.size())
+			m_blocks.push_back(static_cast<T *>(allocAligned(sizeof(T) * m_blockSize)));
+		m_next = m_blocks[m_block];
+		m_end = m_next + m_blockSize;
+	}
+private:
+	std::vector<T *> m_blocks;
+	size_t m_blockSize;
+	size_t m_block;
+	T *m_next, *m_end;
+};
+
 MTS_NAMESPACE_END
 
 #endif /* __MITSUBA_CORE_MEMPOOL_H_ */
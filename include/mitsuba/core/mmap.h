@@ -59,6 +59,9 @@ public:
 	/// Return whether the mapped memory region is read-only
 	bool isReadOnly() const;
 
+	/// Return whether writes to the mapping are private to this process
+	bool isCopyOnWrite() const;
+
 	/// Return a string representation
 	std::string toString() const;
 
@@ -70,6 +73,16 @@ public:
 	 */
 	static ref<MemoryMappedFile> createTemporary(size_t size);
 
+	/**
+	 * \brief Map an existing file using copy-on-write semantics
+	 *
+	 * Pages are shared with the page cache (and hence with other
+	 * processes mapping the same file) until they are modified,
+	 * at which point the affected page receives a private copy.
+	 * The file on disk is never changed.
+	 */
+	static ref<MemoryMappedFile> createCopyOnWrite(const fs::pathstr &filename);
+
 	MTS_DECLARE_CLASS()
 protected:
 	/// Internal constructor
@@ -22,7 +22,9 @@
 
 #include <mitsuba/core/serialization.h>
 #include <mitsuba/core/lock.h>
+#include <atomic>
 #include <deque>
+#include <memory>
 
 /**
  * Uncomment this to enable scheduling debug messages
@@ -335,6 +337,7 @@ protected:
 };
 
 class Worker;
+class LocalWorker;
 
 /**
  * \brief Centralized task scheduler implementation.
@@ -345,11 +348,19 @@ class Worker;
  * units from the scheduler, which are then executed on the current machine
  * or sent to remote nodes over a network connection.
  *
+ * Work units are always generated while holding the scheduler lock (the
+ * \ref ParallelProcess interface is not thread-safe). To keep contention
+ * low when work units are small, local workers generate them in batches,
+ * whose size adapts to the observed processing time. The batches are kept
+ * in per-worker lock-free task queues, from which idle local workers steal
+ * work. Completed work units are reported back to the scheduler in bulk.
+ *
  * \ingroup libcore
  * \ingroup libpython
  */
 class MTS_EXPORT_CORE Scheduler : public Object {
 	friend class Worker;
+	friend class LocalWorker;
 public:
 	/**
 	 * \brief Schedule a parallelizable process for execution.
@@ -497,8 +508,9 @@ public:
 		int inflight;
 		/* Is the parallel process still generating work */
 		bool morework;
-		/* Was the process cancelled using \c cancel()?*/
-		bool cancelled;
+		/* Was the process cancelled using \c cancel()? (also read
+		   by local workers without holding the scheduler lock) */
+		std::atomic<bool> cancelled;
 		/* Is the process currently in the queue? */
 		bool active;
 		/* Signaled every time a work unit arrives */
@@ -542,6 +554,20 @@ public:
 		std::string toString() const;
 	};
 
+	/**
+	 * Work unit that has been generated ahead of time for a local
+	 * worker. It waits in the task queue of that worker, from where
+	 * idle local workers may steal it.
+	 */
+	struct Task {
+		int id;
+		ParallelProcess *proc;
+		ProcessRecord *rec;
+		ref<WorkUnit> workUnit;
+
+		inline Task() : id(-1), proc(NULL), rec(NULL) { }
+	};
+
 	struct ResourceRecord {
 		std::vector<SerializableObject *> resources;
 		ref<MemoryStream> stream;
@@ -562,7 +588,8 @@ public:
 	enum EStatus {
 		/// Sucessfully acquired a work unit
 		EOK,
-		/// There is currently no work (and onlyTry was set to true)
+		/// There is currently no work (and onlyTry was set to true, or
+		/// other local workers have queued tasks that can be stolen)
 		ENone,
 		/// The scheduler is shutting down
 		EStop
@@ -593,6 +620,24 @@ protected:
 	 */
 	EStatus acquireWork(Item &item, bool local, bool onlyTry, bool keepLock);
 
+	/**
+	 * Acquire work for a local worker -- generates a batch of up to
+	 * \c batchSize work units from one process and pushes them onto the
+	 * worker's task queue. Also reports the work units that the worker
+	 * has completed since the last call.
+	 */
+	EStatus acquireLocalWork(LocalWorker *worker, int batchSize);
+
+	/// Try to steal a queued work unit from another local worker
+	Task *stealWork(LocalWorker *thief);
+
+	/**
+	 * Report work units that a local worker has completed. Cheaper than
+	 * \ref releaseWork(), since it only needs to take the lock once
+	 * for a whole batch.
+	 */
+	void retireWork(LocalWorker *worker);
+
 	/// Release the main scheduler lock -- internally used by the remote worker
 	inline void releaseLock() { m_mutex->unlock(); }
 
@@ -667,6 +712,10 @@ private:
 	std::map<int, ResourceRecord *> m_resources;
 	/// List of all active workers
 	std::vector<Worker *> m_workers;
+	/// Local workers that take part in work stealing (fixed while running)
+	std::vector<LocalWorker *> m_localWorkers;
+	/// Number of work units in the task queues of the local workers
+	std::atomic<int> m_queuedTasks;
 	int m_resourceCounter, m_processCounter;
 	bool m_running;
 	int m_nextWorkerOffset;
@@ -789,9 +838,23 @@ protected:
 	virtual ~LocalWorker();
 	/* Worker implementation */
 	virtual void run();
+	virtual void clear();
 	virtual void signalResourceExpiration(int id);
 	virtual void signalProcessCancellation(int id);
 	virtual void signalProcessTermination(int id);
+
+	/// Process a work unit from a task queue
+	void execute(Scheduler::Task *task);
+
+	/**
+	 * Drop all queued work units of the specified process (which
+	 * is about to be cancelled by this worker)
+	 */
+	void discardTasks(int id);
+private:
+	friend class Scheduler;
+	struct LocalWorkerPrivate;
+	std::unique_ptr<LocalWorkerPrivate> m_local;
 };
 
 /**
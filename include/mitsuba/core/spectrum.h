@@ -21,6 +21,13 @@
 #define __MITSUBA_CORE_SPECTRUM_H_
 
 #include <mitsuba/mitsuba.h>
+#include <type_traits>
+#if defined(MTS_SSE)
+#include <emmintrin.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#endif
 
 #if !defined(SPECTRUM_SAMPLES)
 #error The desired number of spectral samples must be \
@@ -282,6 +289,324 @@ protected:
 	std::vector<Float> m_wavelengths, m_values;
 };
 
+/**
+ * \brief Component-wise kernels behind the arithmetic of \ref TSpectrum
+ *
+ * This generic version processes one sample at a time. When SSE is enabled,
+ * single precision spectra with a multiple of four samples (e.g. spectral
+ * builds with 8 or 16 samples) are handled by the vectorized specialization
+ * below.
+ *
+ * \ingroup libcore
+ */
+template <typename T, int N, bool Packed> struct TSpectrumKernels {
+	static inline void fill(T *r, T v) {
+		for (int i=0; i<N; i++)
+			r[i] = v;
+	}
+
+	static inline void add(T *r, const T *a, const T *b) {
+		for (int i=0; i<N; i++)
+			r[i] = a[i] + b[i];
+	}
+
+	static inline void sub(T *r, const T *a, const T *b) {
+		for (int i=0; i<N; i++)
+			r[i] = a[i] - b[i];
+	}
+
+	static inline void mul(T *r, const T *a, const T *b) {
+		for (int i=0; i<N; i++)
+			r[i] = a[i] * b[i];
+	}
+
+	static inline void div(T *r, const T *a, const T *b) {
+		for (int i=0; i<N; i++)
+			r[i] = a[i] / b[i];
+	}
+
+	static inline void scale(T *r, const T *a, T f) {
+		for (int i=0; i<N; i++)
+			r[i] = a[i] * f;
+	}
+
+	static inline void addWeighted(T *r, T weight, const T *a) {
+		for (int i=0; i<N; i++)
+			r[i] += weight * a[i];
+	}
+
+	static inline void negate(T *r, const T *a) {
+		for (int i=0; i<N; i++)
+			r[i] = -a[i];
+	}
+
+	static inline void abs(T *r, const T *a) {
+		for (int i=0; i<N; i++)
+			r[i] = std::abs(a[i]);
+	}
+
+	static inline void sqrt(T *r, const T *a) {
+		for (int i=0; i<N; i++)
+			r[i] = std::sqrt(a[i]);
+	}
+
+	static inline void safe_sqrt(T *r, const T *a) {
+		for (int i=0; i<N; i++)
+			r[i] = math::safe_sqrt(a[i]);
+	}
+
+	static inline void clampNegative(T *r) {
+		for (int i=0; i<N; i++)
+			r[i] = std::max((T) 0.0f, r[i]);
+	}
+
+	static inline T sum(const T *a) {
+		T result = 0.0f;
+		for (int i=0; i<N; i++)
+			result += a[i];
+		return result;
+	}
+
+	static inline T max(const T *a) {
+		T result = a[0];
+		for (int i=1; i<N; i++)
+			result = std::max(result, a[i]);
+		return result;
+	}
+
+	static inline T min(const T *a) {
+		T result = a[0];
+		for (int i=1; i<N; i++)
+			result = std::min(result, a[i]);
+		return result;
+	}
+
+	static inline bool equal(const T *a, const T *b) {
+		for (int i=0; i<N; i++) {
+			if (a[i] != b[i])
+				return false;
+		}
+		return true;
+	}
+
+	static inline bool isZero(const T *a) {
+		for (int i=0; i<N; i++) {
+			if (a[i] != 0.0f)
+				return false;
+		}
+		return true;
+	}
+};
+
+/// Should a TSpectrum instantiation use the vectorized kernels?
+template <typename T, int N> struct TSpectrumPacked {
+#if defined(MTS_SSE)
+	enum { value = std::is_same<T, float>::value && N % 4 == 0 };
+#else
+	enum { value = false };
+#endif
+};
+
+#if defined(MTS_SSE)
+/**
+ * \brief SSE kernels for single precision spectra with a multiple of four
+ * samples
+ *
+ * Component-wise operations use 256-bit AVX instructions when the compiler
+ * targets AVX. All loads and stores are unaligned, and the storage keeps the
+ * natural alignment of \c float: spectra are regularly reinterpreted from
+ * plain float buffers (e.g. bitmap or image block data) that carry no stronger
+ * alignment guarantee, and unaligned accesses to memory that happens to be
+ * aligned cost nothing on current processors.
+ */
+template <typename T, int N> struct TSpectrumKernels<T, N, true> {
+	static FINLINE float hsum(__m128 v) {
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+		return _mm_cvtss_f32(v);
+	}
+
+	static FINLINE float hmax(__m128 v) {
+		v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_max_ss(v, _mm_shuffle_ps(v, v, 1));
+		return _mm_cvtss_f32(v);
+	}
+
+	static FINLINE float hmin(__m128 v) {
+		v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+		v = _mm_min_ss(v, _mm_shuffle_ps(v, v, 1));
+		return _mm_cvtss_f32(v);
+	}
+
+	/// Apply a binary operation (given as SSE and AVX functors) to all samples
+	template <typename Op> static FINLINE void map(float *r, const float *a,
+			const float *b, const Op &op) {
+		int i = 0;
+#if defined(__AVX__)
+		for (; i + 8 <= N; i += 8)
+			_mm256_storeu_ps(r + i, op(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+#endif
+		for (; i < N; i += 4)
+			_mm_storeu_ps(r + i, op(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+
+	struct Add {
+		FINLINE __m128 operator()(__m128 a, __m128 b) const { return _mm_add_ps(a, b); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256 b) const { return _mm256_add_ps(a, b); }
+#endif
+	};
+
+	struct Sub {
+		FINLINE __m128 operator()(__m128 a, __m128 b) const { return _mm_sub_ps(a, b); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256 b) const { return _mm256_sub_ps(a, b); }
+#endif
+	};
+
+	struct Mul {
+		FINLINE __m128 operator()(__m128 a, __m128 b) const { return _mm_mul_ps(a, b); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256 b) const { return _mm256_mul_ps(a, b); }
+#endif
+	};
+
+	struct Div {
+		FINLINE __m128 operator()(__m128 a, __m128 b) const { return _mm_div_ps(a, b); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256 b) const { return _mm256_div_ps(a, b); }
+#endif
+	};
+
+	struct Scale {
+		float f;
+		Scale(float f) : f(f) { }
+		FINLINE __m128 operator()(__m128 a) const { return _mm_mul_ps(a, _mm_set1_ps(f)); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_mul_ps(a, _mm256_set1_ps(f)); }
+#endif
+	};
+
+	/// Computes <tt>a * w + b</tt> for a fixed weight \c w
+	struct MulAdd {
+		float w;
+		MulAdd(float w) : w(w) { }
+		FINLINE __m128 operator()(__m128 a, __m128 b) const {
+			return _mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(w)), b);
+		}
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256 b) const {
+			return _mm256_add_ps(_mm256_mul_ps(a, _mm256_set1_ps(w)), b);
+		}
+#endif
+	};
+
+	/// Ignores the second argument and applies a unary operation to the first one
+	template <typename Unary> struct First {
+		Unary op;
+		First(const Unary &op) : op(op) { }
+		FINLINE __m128 operator()(__m128 a, __m128) const { return op(a); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a, __m256) const { return op(a); }
+#endif
+	};
+
+	struct Negate {
+		FINLINE __m128 operator()(__m128 a) const { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_xor_ps(a, _mm256_set1_ps(-0.0f)); }
+#endif
+	};
+
+	struct Abs {
+		FINLINE __m128 operator()(__m128 a) const { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+#endif
+	};
+
+	struct Sqrt {
+		FINLINE __m128 operator()(__m128 a) const { return _mm_sqrt_ps(a); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_sqrt_ps(a); }
+#endif
+	};
+
+	/// Matches <tt>std::max(0, a)</tt>, i.e. NaNs are also mapped to zero
+	struct ClampNegative {
+		FINLINE __m128 operator()(__m128 a) const { return _mm_max_ps(a, _mm_setzero_ps()); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_max_ps(a, _mm256_setzero_ps()); }
+#endif
+	};
+
+	struct SafeSqrt {
+		FINLINE __m128 operator()(__m128 a) const { return _mm_sqrt_ps(ClampNegative()(a)); }
+#if defined(__AVX__)
+		FINLINE __m256 operator()(__m256 a) const { return _mm256_sqrt_ps(ClampNegative()(a)); }
+#endif
+	};
+
+	template <typename Unary> static FINLINE void map(float *r, const float *a, const Unary &op) {
+		map(r, a, a, First<Unary>(op));
+	}
+
+	static FINLINE void fill(float *r, float v) {
+		__m128 value = _mm_set1_ps(v);
+		for (int i=0; i<N; i += 4)
+			_mm_storeu_ps(r + i, value);
+	}
+
+	static FINLINE void add(float *r, const float *a, const float *b) { map(r, a, b, Add()); }
+	static FINLINE void sub(float *r, const float *a, const float *b) { map(r, a, b, Sub()); }
+	static FINLINE void mul(float *r, const float *a, const float *b) { map(r, a, b, Mul()); }
+	static FINLINE void div(float *r, const float *a, const float *b) { map(r, a, b, Div()); }
+	static FINLINE void scale(float *r, const float *a, float f) { map(r, a, Scale(f)); }
+	static FINLINE void addWeighted(float *r, float weight, const float *a) { map(r, a, r, MulAdd(weight)); }
+	static FINLINE void negate(float *r, const float *a) { map(r, a, Negate()); }
+	static FINLINE void abs(float *r, const float *a) { map(r, a, Abs()); }
+	static FINLINE void sqrt(float *r, const float *a) { map(r, a, Sqrt()); }
+	static FINLINE void safe_sqrt(float *r, const float *a) { map(r, a, SafeSqrt()); }
+	static FINLINE void clampNegative(float *r) { map(r, r, ClampNegative()); }
+
+	static FINLINE float sum(const float *a) {
+		__m128 result = _mm_loadu_ps(a);
+		for (int i=4; i<N; i += 4)
+			result = _mm_add_ps(result, _mm_loadu_ps(a + i));
+		return hsum(result);
+	}
+
+	static FINLINE float max(const float *a) {
+		__m128 result = _mm_loadu_ps(a);
+		for (int i=4; i<N; i += 4)
+			result = _mm_max_ps(result, _mm_loadu_ps(a + i));
+		return hmax(result);
+	}
+
+	static FINLINE float min(const float *a) {
+		__m128 result = _mm_loadu_ps(a);
+		for (int i=4; i<N; i += 4)
+			result = _mm_min_ps(result, _mm_loadu_ps(a + i));
+		return hmin(result);
+	}
+
+	static FINLINE bool equal(const float *a, const float *b) {
+		__m128 neq = _mm_cmpneq_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+		for (int i=4; i<N; i += 4)
+			neq = _mm_or_ps(neq, _mm_cmpneq_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		return _mm_movemask_ps(neq) == 0;
+	}
+
+	static FINLINE bool isZero(const float *a) {
+		const __m128 zero = _mm_setzero_ps();
+		__m128 neq = _mm_cmpneq_ps(_mm_loadu_ps(a), zero);
+		for (int i=4; i<N; i += 4)
+			neq = _mm_or_ps(neq, _mm_cmpneq_ps(_mm_loadu_ps(a + i), zero));
+		return _mm_movemask_ps(neq) == 0;
+	}
+};
+#endif
+
 /**
  * \brief Abstract spectral power distribution data type
  *
@@ -296,6 +621,9 @@ template <typename T, int N> struct TSpectrum {
 public:
 	typedef T          Scalar;
 
+	/// Component-wise kernels used for this instantiation
+	typedef TSpectrumKernels<T, N, TSpectrumPacked<T, N>::value> Kernels;
+
 	/// Number of dimensions
 	const static int dim = N;
 
@@ -311,8 +639,7 @@ public:
 
 	/// Create a new spectral power distribution with all samples set to the given value
 	explicit inline TSpectrum(Scalar v) {
-		for (int i=0; i<N; i++)
-			s[i] = v;
+		Kernels::fill(s, v);
 	}
 
 	/// Copy a spectral power distribution
@@ -333,39 +660,34 @@ public:
 
 	/// Add two spectral power distributions
 	inline TSpectrum operator+(const TSpectrum &spec) const {
-		TSpectrum value = *this;
-		for (int i=0; i<N; i++)
-			value.s[i] += spec.s[i];
+		TSpectrum value;
+		Kernels::add(value.s, s, spec.s);
 		return value;
 	}
 
 	/// Add a spectral power distribution to this instance
 	inline TSpectrum& operator+=(const TSpectrum &spec) {
-		for (int i=0; i<N; i++)
-			s[i] += spec.s[i];
+		Kernels::add(s, s, spec.s);
 		return *this;
 	}
 
 	/// Subtract a spectral power distribution
 	inline TSpectrum operator-(const TSpectrum &spec) const {
-		TSpectrum value = *this;
-		for (int i=0; i<N; i++)
-			value.s[i] -= spec.s[i];
+		TSpectrum value;
+		Kernels::sub(value.s, s, spec.s);
 		return value;
 	}
 
 	/// Subtract a spectral power distribution from this instance
 	inline TSpectrum& operator-=(const TSpectrum &spec) {
-		for (int i=0; i<N; i++)
-			s[i] -= spec.s[i];
+		Kernels::sub(s, s, spec.s);
 		return *this;
 	}
 
 	/// Multiply by a scalar
 	inline TSpectrum operator*(Scalar f) const {
-		TSpectrum value = *this;
-		for (int i=0; i<N; i++)
-			value.s[i] *= f;
+		TSpectrum value;
+		Kernels::scale(value.s, s, f);
 		return value;
 	}
 
@@ -376,61 +698,50 @@ public:
 
 	/// Multiply by a scalar
 	inline TSpectrum& operator*=(Scalar f) {
-		for (int i=0; i<N; i++)
-			s[i] *= f;
+		Kernels::scale(s, s, f);
 		return *this;
 	}
 
 	/// Perform a component-wise multiplication by another spectrum
 	inline TSpectrum operator*(const TSpectrum &spec) const {
-		TSpectrum value = *this;
-		for (int i=0; i<N; i++)
-			value.s[i] *= spec.s[i];
+		TSpectrum value;
+		Kernels::mul(value.s, s, spec.s);
 		return value;
 	}
 
 	/// Perform a component-wise multiplication by another spectrum
 	inline TSpectrum& operator*=(const TSpectrum &spec) {
-		for (int i=0; i<N; i++)
-			s[i] *= spec.s[i];
+		Kernels::mul(s, s, spec.s);
 		return *this;
 	}
 
 	/// Perform a component-wise division by another spectrum
 	inline TSpectrum& operator/=(const TSpectrum &spec) {
-		for (int i=0; i<N; i++)
-			s[i] /= spec.s[i];
+		Kernels::div(s, s, spec.s);
 		return *this;
 	}
 
 	/// Perform a component-wise division by another spectrum
 	inline TSpectrum operator/(const TSpectrum &spec) const {
-		TSpectrum value = *this;
-		for (int i=0; i<N; i++)
-			value.s[i] /= spec.s[i];
+		TSpectrum value;
+		Kernels::div(value.s, s, spec.s);
 		return value;
 	}
 
 	/// Divide by a scalar
 	inline TSpectrum operator/(Scalar f) const {
-		TSpectrum value = *this;
+		TSpectrum value;
 #ifdef MTS_DEBUG
 		if (f == 0)
 			SLog(EWarn, "TSpectrum: Division by zero!");
 #endif
-		Scalar recip = 1.0f / f;
-		for (int i=0; i<N; i++)
-			value.s[i] *= recip;
+		Kernels::scale(value.s, s, 1.0f / f);
 		return value;
 	}
 
 	/// Equality test
 	inline bool operator==(const TSpectrum &spec) const {
-		for (int i=0; i<N; i++) {
-			if (s[i] != spec.s[i])
-				return false;
-		}
-		return true;
+		return Kernels::equal(s, spec.s);
 	}
 
 	/// Inequality test
@@ -449,9 +760,7 @@ public:
 		if (f == 0)
 			SLog(EWarn, "TTSpectrum: Division by zero!");
 #endif
-		Scalar recip = 1.0f / f;
-		for (int i=0; i<N; i++)
-			s[i] *= recip;
+		Kernels::scale(s, s, 1.0f / f);
 		return *this;
 	}
 
@@ -473,39 +782,32 @@ public:
 
 	/// Multiply-accumulate operation, adds \a weight * \a spec
 	inline void addWeighted(Scalar weight, const TSpectrum &spec) {
-		for (int i=0; i<N; i++)
-			s[i] += weight * spec.s[i];
+		Kernels::addWeighted(s, weight, spec.s);
 	}
 
 	/// Return the average over all wavelengths
 	inline Scalar average() const {
-		Scalar result = 0.0f;
-		for (int i=0; i<N; i++)
-			result += s[i];
-		return result * (1.0f / N);
+		return Kernels::sum(s) * (1.0f / N);
 	}
 
 	/// Component-wise absolute value
 	inline TSpectrum abs() const {
 		TSpectrum value;
-		for (int i=0; i<N; i++)
-			value.s[i] = std::abs(s[i]);
+		Kernels::abs(value.s, s);
 		return value;
 	}
 
 	/// Component-wise square root
 	inline TSpectrum sqrt() const {
 		TSpectrum value;
-		for (int i=0; i<N; i++)
-			value.s[i] = std::sqrt(s[i]);
+		Kernels::sqrt(value.s, s);
 		return value;
 	}
 
 	/// Component-wise square root
 	inline TSpectrum safe_sqrt() const {
 		TSpectrum value;
-		for (int i=0; i<N; i++)
-			value.s[i] = math::safe_sqrt(s[i]);
+		Kernels::safe_sqrt(value.s, s);
 		return value;
 	}
 
@@ -535,31 +837,23 @@ public:
 
 	/// Clamp negative values
 	inline void clampNegative() {
-		for (int i=0; i<N; i++)
-			s[i] = std::max((Scalar) 0.0f, s[i]);
+		Kernels::clampNegative(s);
 	}
 
 	/// Return the highest-valued spectral sample
 	inline Scalar max() const {
-		Scalar result = s[0];
-		for (int i=1; i<N; i++)
-			result = std::max(result, s[i]);
-		return result;
+		return Kernels::max(s);
 	}
 
 	/// Return the lowest-valued spectral sample
 	inline Scalar min() const {
-		Scalar result = s[0];
-		for (int i=1; i<N; i++)
-			result = std::min(result, s[i]);
-		return result;
+		return Kernels::min(s);
 	}
 
 	/// Negate
 	inline TSpectrum operator-() const {
 		TSpectrum value;
-		for (int i=0; i<N; i++)
-			value.s[i] = -s[i];
+		Kernels::negate(value.s, s);
 		return value;
 	}
 
@@ -575,11 +869,7 @@ public:
 
 	/// Check if this spectrum is zero at all wavelengths
 	inline bool isZero() const {
-		for (int i=0; i<N; i++) {
-			if (s[i] != 0.0f)
-				return false;
-		}
-		return true;
+		return Kernels::isZero(s);
 	}
 
 	/// Serialize this spectrum to a stream
@@ -698,10 +988,7 @@ public:
 	}
 
 	/// Create a new spectral power distribution with all samples set to the given value
-	explicit inline Spectrum(Float v) {
-		for (int i=0; i<SPECTRUM_SAMPLES; i++)
-			s[i] = v;
-	}
+	explicit inline Spectrum(Float v) : Parent(v) { }
 
 	/// Copy a spectral power distribution
 	explicit inline Spectrum(Float value[SPECTRUM_SAMPLES]) {
@@ -854,11 +1141,7 @@ public:
 
 	/// Equality test
 	inline bool operator==(const Spectrum &val) const {
-		for (int i=0; i<SPECTRUM_SAMPLES; i++) {
-			if (s[i] != val.s[i])
-				return false;
-		}
-		return true;
+		return Kernels::equal(s, val.s);
 	}
 
 	/// Inequality test
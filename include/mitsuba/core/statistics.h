@@ -39,12 +39,14 @@ MTS_NAMESPACE_BEGIN
 #define PROGRESS_MSG_SIZE 56
 
 /**
- * Specifies the number of internal counters associated with each
+ * Specifies the number of internal counters (shards) associated with each
  * \ref StatsCounter instance.
  *
- * This is needed for SMP/ccNUMA systems where different processors might
- * be contending for a cache line containing a counter. The solution used
- * here tries to ensure that every processor has  its own local counter.
+ * Every thread that updates statistics is assigned a shard of its own
+ * (shards of terminated threads are reused), which it can update using plain
+ * non-atomic instructions. Counter values are only aggregated when they are
+ * read. Threads beyond this limit share the first shard, which is updated
+ * atomically.
  */
 #define NUM_COUNTERS       128   // Must be a power of 2
 
@@ -82,12 +84,24 @@ struct CacheLineCounter {
 	char unused[120];
 };
 
+#if !defined(__WINDOWS__)
+namespace detail {
+	/// Counter shard owned by the calling thread (-1 if none has been assigned yet)
+	extern MTS_EXPORT_CORE __thread int t_statsShard;
+}
+#endif
+
 /** \brief General-purpose statistics counter
  *
  * This class implements a simple counter, which can be used to track various
  * quantities within Mitsuba. At various points during the execution, it is
  * possible to then call \ref Statistics::printStats() to get a human-readable
- * report of their values.
+ * report of their values, or \ref Statistics::getSnapshot() to obtain them
+ * in a machine-readable form.
+ *
+ * Updates only touch a counter shard that is private to the calling thread
+ * (see \ref NUM_COUNTERS), hence they are cheap enough for the innermost
+ * loops of the renderer.
  *
  * \ingroup libcore
  */
@@ -113,18 +127,11 @@ public:
 #if defined(MTS_NO_STATISTICS)
 		// do nothing
 		return 0;
-#elif defined(_MSC_VER) && defined(_WIN64)
-		const int offset = Thread::getID() & NUM_COUNTERS_MASK;
-		_InterlockedExchangeAdd64(reinterpret_cast<__int64 volatile *>(&m_value[offset].value), 1);
-		return m_value[offset].value;
-#elif defined(_MSC_VER) && defined(_WIN32)
-		const int offset = Thread::getID() & NUM_COUNTERS_MASK;
-		_InterlockedExchangeAdd(reinterpret_cast<long volatile *>(&m_value[offset].value), 1);
-		return m_value[offset].value;
-#elif defined(__POWERPC__) && !defined(_LP64)
-		return (uint64_t) __sync_fetch_and_add(&m_value[Thread::getID() & NUM_COUNTERS_MASK].value, 1);
 #else
-		return __sync_fetch_and_add(&m_value[Thread::getID() & NUM_COUNTERS_MASK].value, 1);
+		int shard = getShard();
+		if (EXPECT_TAKEN(shard != 0))
+			return m_value[shard].value++;
+		return atomicAdd(&m_value[0], 1);
 #endif
 	}
 
@@ -132,12 +139,12 @@ public:
 	inline void operator+=(size_t amount) {
 #ifdef MTS_NO_STATISTICS
 		/// do nothing
-#elif defined(_MSC_VER) && defined(_WIN64)
-		_InterlockedExchangeAdd64(reinterpret_cast<__int64 volatile *>(&m_value[Thread::getID() & NUM_COUNTERS_MASK].value), amount);
-#elif defined(_MSC_VER) && defined(_WIN32)
-		_InterlockedExchangeAdd(reinterpret_cast<long volatile *>(&m_value[Thread::getID() & NUM_COUNTERS_MASK].value), amount);
 #else
-		__sync_fetch_and_add(&m_value[Thread::getID() & NUM_COUNTERS_MASK].value, amount);
+		int shard = getShard();
+		if (EXPECT_TAKEN(shard != 0))
+			m_value[shard].value += amount;
+		else
+			atomicAdd(&m_value[0], amount);
 #endif
 	}
 
@@ -145,12 +152,12 @@ public:
 	inline void incrementBase(size_t amount = 1) {
 #ifdef MTS_NO_STATISTICS
 		/// do nothing
-#elif defined(_MSC_VER) && defined(_WIN64)
-		_InterlockedExchangeAdd64(reinterpret_cast<__int64 volatile *>(&m_base[Thread::getID() & NUM_COUNTERS_MASK].value), amount);
-#elif defined(_WIN32)
-		_InterlockedExchangeAdd(reinterpret_cast<long volatile *>(&m_base[Thread::getID() & NUM_COUNTERS_MASK].value), amount);
 #else
-		__sync_fetch_and_add(&m_base[Thread::getID() & NUM_COUNTERS_MASK].value, amount);
+		int shard = getShard();
+		if (EXPECT_TAKEN(shard != 0))
+			m_base[shard].value += amount;
+		else
+			atomicAdd(&m_base[0], amount);
 #endif
 	}
 
@@ -159,19 +166,25 @@ public:
 	 * an observation of the quantity whose minimum is to be determined
 	 */
 	inline void recordMinimum(size_t value) {
-		int id = Thread::getID() & NUM_COUNTERS_MASK;
+		int shard = getShard();
 		#if MTS_32BIT_COUNTERS == 1
 			volatile int32_t *ptr =
-				(volatile int32_t *) &m_value[id].value;
+				(volatile int32_t *) &m_value[shard].value;
 			int32_t curMinimum;
 			int32_t newMinimum = (int32_t) value;
 		#else
 			volatile int64_t *ptr =
-				(volatile int64_t *) &m_value[id].value;
+				(volatile int64_t *) &m_value[shard].value;
 			int64_t curMinimum;
 			int64_t newMinimum = (int64_t) value;
 		#endif
 
+		if (EXPECT_TAKEN(shard != 0)) {
+			if (newMinimum < *ptr)
+				*ptr = newMinimum;
+			return;
+		}
+
 		do {
 			curMinimum = *ptr;
 			if (newMinimum >= curMinimum)
@@ -187,19 +200,25 @@ public:
 	 * an observation of the quantity whose maximum is to be determined
 	 */
 	inline void recordMaximum(size_t value) {
-		int id = Thread::getID() & NUM_COUNTERS_MASK;
+		int shard = getShard();
 		#if MTS_32BIT_COUNTERS == 1
 			volatile int32_t *ptr =
-				(volatile int32_t *) &m_value[id].value;
+				(volatile int32_t *) &m_value[shard].value;
 			int32_t curMaximum;
 			int32_t newMaximum = (int32_t) value;
 		#else
 			volatile int64_t *ptr =
-				(volatile int64_t *) &m_value[id].value;
+				(volatile int64_t *) &m_value[shard].value;
 			int64_t curMaximum;
 			int64_t newMaximum = (int64_t) value;
 		#endif
 
+		if (EXPECT_TAKEN(shard != 0)) {
+			if (newMaximum > *ptr)
+				*ptr = newMaximum;
+			return;
+		}
+
 		do {
 			curMaximum = *ptr;
 			if (newMaximum <= curMaximum)
@@ -268,6 +287,35 @@ public:
 
 	/// Sorting by name (for the statistics)
 	bool operator<(const StatsCounter &v) const;
+
+	/**
+	 * \brief Return the counter shard owned by the calling thread
+	 *
+	 * A value of zero denotes the shared shard, which must be
+	 * updated atomically.
+	 */
+#if defined(__WINDOWS__)
+	static int getShard();
+#else
+	inline static int getShard() {
+		int shard = detail::t_statsShard;
+		return EXPECT_TAKEN(shard >= 0) ? shard : acquireShard();
+	}
+#endif
+private:
+	/// Assign a shard to the calling thread
+	static int acquireShard();
+
+	/// Atomically increment a counter of the shared shard
+	inline static uint64_t atomicAdd(CacheLineCounter *counter, size_t amount) {
+#if defined(_MSC_VER) && defined(_WIN64)
+		return (uint64_t) _InterlockedExchangeAdd64(reinterpret_cast<__int64 volatile *>(&counter->value), amount);
+#elif defined(_MSC_VER) && defined(_WIN32)
+		return (uint64_t) _InterlockedExchangeAdd(reinterpret_cast<long volatile *>(&counter->value), (long) amount);
+#else
+		return (uint64_t) __sync_fetch_and_add(&counter->value, amount);
+#endif
+	}
 private:
 	std::string m_category;
 	std::string m_name;
@@ -353,9 +401,37 @@ public:
 	/// Return a string containing gathered statistics
 	std::string getStats();
 
-	/// Reset all statistics counters
+	/**
+	 * \brief Reset all statistics counters
+	 *
+	 * Since counter shards are updated without synchronization, this
+	 * should only be called while no rendering is in progress.
+	 */
 	void resetAll();
 
+	/// Machine-readable formats supported by \ref getSnapshot()
+	enum ESnapshotFormat {
+		/// JSON object with a \c counters array
+		EJSON = 0,
+		/// CSV table with a header line
+		ECSV
+	};
+
+	/**
+	 * \brief Return the current values of all counters in a
+	 * machine-readable format
+	 *
+	 * Counters are aggregated without interrupting the threads that update
+	 * them, hence this function can be polled every frame while rendering.
+	 * Every counter is reported with its category, name, type, value and
+	 * base value (the latter is only meaningful for percentages and averages).
+	 *
+	 * \param format  Output format
+	 * \param category When not empty, only report counters of this category
+	 */
+	std::string getSnapshot(ESnapshotFormat format = EJSON,
+		const std::string &category = "");
+
 	/// Initialize the global statistics collector
 	static void staticInitialization();
 
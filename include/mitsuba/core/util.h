@@ -124,6 +124,23 @@ extern std::string MTS_EXPORT_CORE lastErrorText();
 /// Determine the number of available CPU cores
 extern MTS_EXPORT_CORE int getCoreCount();
 
+/**
+ * \brief Determine the number of NUMA nodes spanned by the
+ * available CPU cores
+ *
+ * Returns 1 if the topology cannot be determined (and on
+ * platforms other than Linux).
+ */
+extern MTS_EXPORT_CORE int getNUMANodeCount();
+
+/**
+ * \brief Return the NUMA node of an available CPU core
+ *
+ * Cores are indexed in the same way as by \ref Thread::setCoreAffinity(),
+ * nodes are numbered consecutively starting at zero.
+ */
+extern MTS_EXPORT_CORE int getCoreNUMANode(int core);
+
 /// Return the host name of this machine
 extern MTS_EXPORT_CORE std::string getHostName();
 
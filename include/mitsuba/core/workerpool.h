@@ -0,0 +1,105 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_CORE_WORKERPOOL_H_)
+#define __MITSUBA_CORE_WORKERPOOL_H_
+
+#include <mitsuba/mitsuba.h>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Pool of persistent worker threads for frame-wise parallel work
+ *
+ * The workers are started on demand and parked between calls to \ref run(),
+ * which wakes them through a generation counter. This keeps the cost of
+ * restarting the interactive renderers after a scene change low, since
+ * neither threads nor their thread-local state have to be recreated.
+ *
+ * The workers are regular Mitsuba threads, hence thread-local storage
+ * and the logging infrastructure work as usual.
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE WorkerPool {
+public:
+	/**
+	 * \brief Create an empty pool
+	 *
+	 * \param pinCores
+	 *     Pin every worker to a core (see \ref setCores())
+	 */
+	WorkerPool(bool pinCores = false);
+
+	/// Stop and join all workers
+	~WorkerPool();
+
+	/**
+	 * \brief Set the cores that pinned workers are placed on
+	 *
+	 * Worker \c i is pinned to <tt>cores[i]</tt>. Workers beyond the
+	 * end of the list are pinned to the core matching their index.
+	 * Only affects workers started after this call.
+	 */
+	void setCores(const std::vector<int> &cores);
+
+	/**
+	 * \brief Run a task on the given number of workers and return
+	 * once all of them have finished
+	 *
+	 * The task receives the index of the worker. Missing workers are
+	 * started first, surplus workers stay parked.
+	 */
+	void run(int numThreads, const std::function<void(int)> &task);
+
+	/**
+	 * \brief Return the time in milliseconds from waking the pool to
+	 * the first worker running the task of the last call to \ref run()
+	 */
+	inline float getRestartLatency() const { return m_restartLatency; }
+
+	/// Return the number of started workers
+	inline size_t getWorkerCount() const { return m_workers.size(); }
+
+protected:
+	class Worker;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_wake, m_done;
+	ref_vector<Thread> m_workers;
+	std::function<void(int)> m_task;
+	unsigned int m_generation;
+	int m_numThreads, m_running;
+	bool m_quit, m_pinCores;
+	std::vector<int> m_cores;
+
+	std::chrono::steady_clock::time_point m_wakeTime;
+	std::atomic<bool> m_started;
+	float volatile m_restartLatency;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_CORE_WORKERPOOL_H_ */
@@ -0,0 +1,228 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_BVH4_H_)
+#define __MITSUBA_RENDER_BVH4_H_
+
+#include <mitsuba/core/aabb.h>
+#if defined(MTS_SSE)
+#include <mitsuba/core/sse.h>
+#endif
+
+/// Maximum depth of the 4-wide hierarchy (bounds the traversal stack)
+#define MTS_BVH_MAXDEPTH 64
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief 4-wide bounding volume hierarchy over an indexed set of primitives
+ *
+ * The hierarchy is built top-down using the surface area heuristic on
+ * binned primitive centroids, collapsing up to four children into every
+ * node. Large subtrees are constructed in parallel. Compared to the SAH
+ * kd-tree, primitives are never split or clipped, hence construction is
+ * much faster and uses exactly one index per primitive. The four child
+ * boxes of a node are tested at once (using SSE in single precision
+ * builds).
+ *
+ * The class only stores the hierarchy -- intersecting the actual
+ * primitives is delegated to the owner (see \ref ShapeKDTree), which
+ * must provide the same \c intersect() methods used by the kd-tree.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER BVH4 {
+public:
+	typedef uint32_t IndexType;
+
+	/// Marks an unused child slot
+	static const IndexType KEmptySlot = 0xFFFFFFFF;
+
+	/// Four child boxes stored in SoA layout (128 bytes)
+	struct Node {
+		/// Child bounds, indexed by [min/max][axis][child]
+		float bounds[2][3][4];
+		/// Inner node index, first primitive index of a leaf, or \ref KEmptySlot
+		IndexType child[4];
+		/// Number of primitives of a leaf (zero for inner nodes and empty slots)
+		IndexType count[4];
+	};
+
+	/// Create an empty hierarchy
+	BVH4();
+
+	/**
+	 * \brief Build the hierarchy over the supplied primitive bounds
+	 *
+	 * \param primBounds
+	 *    Bounding box of every primitive; the index into this
+	 *    vector is handed to the intersection routines
+	 * \param parallel
+	 *    Construct large subtrees in parallel?
+	 */
+	void build(const std::vector<AABB> &primBounds, bool parallel = true);
+
+	/// Release all memory
+	void clear();
+
+	/// Has the hierarchy been built?
+	inline bool isBuilt() const { return !m_nodes.empty(); }
+
+	/// Return the number of nodes
+	inline size_t getNodeCount() const { return m_nodes.size(); }
+
+	/// Return the size of the nodes and primitive indices in bytes
+	inline size_t getMemoryUsage() const {
+		return m_nodes.size() * sizeof(Node) + m_indices.size() * sizeof(IndexType);
+	}
+
+	/**
+	 * \brief Traverse the hierarchy
+	 *
+	 * \c Intersector must provide <tt>intersect(ray, idx, mint, maxt, t, temp)</tt>
+	 * and (for shadow rays) <tt>intersect(ray, idx, mint, maxt)</tt>.
+	 * Nearer children are visited first, and the search interval is
+	 * narrowed with every hit, so \c temp holds the closest hit on return.
+	 */
+	template <bool shadowRay, typename Intersector> FINLINE bool rayIntersect(
+			const Intersector *isect, const Ray &ray, Float mint, Float maxt,
+			Float &t, void *temp) const {
+		struct StackEntry {
+			IndexType node;
+			Float tnear;
+		};
+		StackEntry stack[3 * MTS_BVH_MAXDEPTH + 1];
+		int stackIndex = 0;
+		bool foundIntersection = false;
+
+		const int nx = ray.dRcp.x < 0 ? 1 : 0,
+		          ny = ray.dRcp.y < 0 ? 1 : 0,
+		          nz = ray.dRcp.z < 0 ? 1 : 0;
+
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+		const __m128
+			ox = _mm_set1_ps(ray.o.x), oy = _mm_set1_ps(ray.o.y), oz = _mm_set1_ps(ray.o.z),
+			rx = _mm_set1_ps(ray.dRcp.x), ry = _mm_set1_ps(ray.dRcp.y), rz = _mm_set1_ps(ray.dRcp.z),
+			mint4 = _mm_set1_ps(mint);
+#endif
+
+		stack[stackIndex].node = 0;
+		stack[stackIndex].tnear = mint;
+		++stackIndex;
+
+		while (stackIndex > 0) {
+			--stackIndex;
+			if (stack[stackIndex].tnear > maxt)
+				continue;
+			const Node &node = m_nodes[stack[stackIndex].node];
+
+			Float tnear[4];
+			int hitMask = 0;
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+			{
+				const __m128 maxt4 = _mm_set1_ps(maxt);
+				__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[nx][0]), ox), rx);
+				__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1-nx][0]), ox), rx);
+				__m128 tmin = _mm_max_ps(t0, mint4), tmax = _mm_min_ps(t1, maxt4);
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[ny][1]), oy), ry);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1-ny][1]), oy), ry);
+				tmin = _mm_max_ps(t0, tmin); tmax = _mm_min_ps(t1, tmax);
+				t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[nz][2]), oz), rz);
+				t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.bounds[1-nz][2]), oz), rz);
+				tmin = _mm_max_ps(t0, tmin); tmax = _mm_min_ps(t1, tmax);
+				hitMask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+				_mm_storeu_ps(tnear, tmin);
+			}
+#else
+			for (int i=0; i<4; ++i) {
+				/* NaNs (zero direction components) end up in the first
+				   operand of each comparison and are ignored */
+				Float tmin = mint, tmax = maxt, t0, t1;
+				t0 = (node.bounds[nx][0][i] - ray.o.x) * ray.dRcp.x;
+				t1 = (node.bounds[1-nx][0][i] - ray.o.x) * ray.dRcp.x;
+				tmin = t0 > tmin ? t0 : tmin; tmax = t1 < tmax ? t1 : tmax;
+				t0 = (node.bounds[ny][1][i] - ray.o.y) * ray.dRcp.y;
+				t1 = (node.bounds[1-ny][1][i] - ray.o.y) * ray.dRcp.y;
+				tmin = t0 > tmin ? t0 : tmin; tmax = t1 < tmax ? t1 : tmax;
+				t0 = (node.bounds[nz][2][i] - ray.o.z) * ray.dRcp.z;
+				t1 = (node.bounds[1-nz][2][i] - ray.o.z) * ray.dRcp.z;
+				tmin = t0 > tmin ? t0 : tmin; tmax = t1 < tmax ? t1 : tmax;
+				tnear[i] = tmin;
+				if (tmin <= tmax)
+					hitMask |= 1 << i;
+			}
+#endif
+			if (!hitMask)
+				continue;
+
+			/* Intersect leaves right away, collect inner nodes */
+			int inner[4], innerCount = 0;
+			for (int i=0; i<4; ++i) {
+				if (!(hitMask & (1 << i)))
+					continue;
+				if (node.count[i] == 0) {
+					inner[innerCount++] = i;
+					continue;
+				}
+				const IndexType *prim = &m_indices[node.child[i]],
+				                *end = prim + node.count[i];
+				for (; prim != end; ++prim) {
+					if (shadowRay) {
+						if (isect->intersect(ray, *prim, mint, maxt))
+							return true;
+					} else {
+						Float tempT;
+						if (isect->intersect(ray, *prim, mint, maxt, tempT, temp)) {
+							t = maxt = tempT;
+							foundIntersection = true;
+						}
+					}
+				}
+			}
+
+			/* Push inner nodes so that the nearest one is popped first */
+			for (int i=1; i<innerCount; ++i) {
+				int value = inner[i], j = i;
+				for (; j > 0 && tnear[inner[j-1]] < tnear[value]; --j)
+					inner[j] = inner[j-1];
+				inner[j] = value;
+			}
+			for (int i=0; i<innerCount; ++i) {
+				stack[stackIndex].node = node.child[inner[i]];
+				stack[stackIndex].tnear = tnear[inner[i]];
+				++stackIndex;
+			}
+		}
+
+		return foundIntersection;
+	}
+
+protected:
+	struct BuildContext;
+	IndexType buildSubtree(BuildContext &ctx, std::vector<Node> &nodes,
+		IndexType begin, IndexType end, int depth) const;
+
+protected:
+	std::vector<Node> m_nodes;
+	std::vector<IndexType> m_indices;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_BVH4_H_ */
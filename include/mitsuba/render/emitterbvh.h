@@ -0,0 +1,152 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_EMITTERBVH_H_)
+#define __MITSUBA_RENDER_EMITTERBVH_H_
+
+#include <mitsuba/core/aabb.h>
+#include <mitsuba/core/pmf.h>
+#include <mitsuba/render/emitter.h>
+#include <unordered_map>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Bounding volume hierarchy over the emitters of a scene, which
+ * chooses emitters for direct illumination sampling proportionally to
+ * their estimated contribution at a reference point.
+ *
+ * Every node stores the bounding box, the total (luminance) power and a
+ * cone bounding the emission directions of the emitters below it. The
+ * importance of a node at a reference point is a conservative estimate of
+ * the received irradiance, which accounts for the distance, the emission
+ * profile and the cosine at the receiver (following "Importance Sampling
+ * of Many Lights with Adaptive Tree Splitting" by Conty Estevez and
+ * Kulla). Sampling descends from the root and randomly picks one child
+ * per level proportionally to these estimates, and \ref pdf() recomputes
+ * the same probabilities along the path from a leaf to the root.
+ *
+ * Only emitters with a finite extent (area lights and point-like emitters)
+ * are inserted into the hierarchy. Environment and directional emitters
+ * are chosen according to their sampling weight, and the whole hierarchy
+ * competes with them as if it were a single emitter of unit weight.
+ *
+ * The bounds, power estimates and normal cones are computed once on
+ * construction, hence the hierarchy assumes static emitters. The scene
+ * rebuilds it from \ref Scene::initialize() and \ref Scene::refitKDTree();
+ * emitters that are moved or edited by other means leave it stale.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER EmitterBVH : public Object {
+public:
+	typedef uint32_t IndexType;
+
+	/// Hierarchy node (inner nodes have their first child right after them)
+	struct Node {
+		/// Bounds of all emitters below this node
+		AABB aabb;
+		/// Axis of the cone bounding the surface normals
+		Vector axis;
+		/// Cosine of the opening angle of the normal cone
+		Float cosThetaO;
+		/// Cosine of the maximal emission angle relative to a normal
+		Float cosThetaE;
+		/// Total power (luminance) of the emitters below this node
+		Float power;
+		/// Index of the parent node
+		IndexType parent;
+		/// Index of the second child, or the emitter index of a leaf
+		IndexType index;
+		/// Is this a leaf node?
+		bool leaf;
+	};
+
+	/**
+	 * \brief Build the hierarchy over the supplied list of emitters
+	 *
+	 * The emitters must already be configured and attached to their
+	 * shapes. They are not referenced by the hierarchy, hence they must
+	 * outlive it (the scene takes care of this).
+	 */
+	EmitterBVH(const ref_vector<Emitter> &emitters);
+
+	/**
+	 * \brief Choose an emitter for direct illumination sampling
+	 *
+	 * \param ref
+	 *    Reference point, for which the emitter should be chosen
+	 * \param refN
+	 *    Surface normal at the reference point, or zero in a medium
+	 *    and on transmissive surfaces
+	 * \param sample
+	 *    A uniformly distributed sample on [0, 1], which is adjusted
+	 *    so that it can be reused
+	 * \param pdf
+	 *    Returns the discrete probability of the chosen emitter
+	 * \return
+	 *    The chosen emitter, or \c NULL when no emitter can possibly
+	 *    illuminate the reference point
+	 */
+	const Emitter *sample(const Point &ref, const Normal &refN,
+		Float &sample, Float &pdf) const;
+
+	/**
+	 * \brief Return the discrete probability of choosing a certain
+	 * emitter in \ref sample() for the given reference point
+	 */
+	Float pdf(const Emitter *emitter, const Point &ref, const Normal &refN) const;
+
+	/// Return the number of emitters stored in the hierarchy
+	inline size_t getBoundedEmitterCount() const { return m_bounded.size(); }
+
+	/// Return the number of emitters which are chosen by their sampling weight
+	inline size_t getUnboundedEmitterCount() const { return m_unbounded.size(); }
+
+	/// Return the number of nodes
+	inline size_t getNodeCount() const { return m_nodes.size(); }
+
+	/// Return a string representation
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~EmitterBVH() { }
+
+	/// Estimate the contribution of a node at the given reference point
+	Float importance(const Node &node, const Point &ref, const Normal &refN) const;
+
+	/// Recursively build the subtree over <tt>[start, end)</tt> of the emitter list
+	IndexType build(std::vector<Node> &emitterBounds, size_t start, size_t end,
+		IndexType parent);
+
+private:
+	std::vector<Node> m_nodes;
+	std::vector<const Emitter *> m_bounded;
+	std::vector<const Emitter *> m_unbounded;
+	/// Leaf node index of bounded emitters, or the index of unbounded ones
+	std::unordered_map<const Emitter *, IndexType> m_lookup;
+	/// Unbounded emitters followed by an entry for the whole hierarchy
+	DiscreteDistribution m_topPDF;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_EMITTERBVH_H_ */
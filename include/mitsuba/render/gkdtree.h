@@ -755,6 +755,45 @@ public:
 			freeAligned(m_nodes-1); // undo alignment shift
 	}
 
+	/**
+	 * \brief Replace the contents of this (unbuilt) kd-tree by
+	 * a copy of another fully built one
+	 *
+	 * The node and index buffers are allocated and written by the
+	 * calling thread, hence the operating system will generally place
+	 * them in the memory of the NUMA node this thread is running on.
+	 */
+	void copyTree(const GenericKDTree &other) {
+		KDAssert(!isBuilt() && other.isBuilt());
+		m_traversalCost = other.m_traversalCost;
+		m_queryCost = other.m_queryCost;
+		m_emptySpaceBonus = other.m_emptySpaceBonus;
+		m_clip = other.m_clip;
+		m_retract = other.m_retract;
+		m_parallelBuild = other.m_parallelBuild;
+		m_maxDepth = other.m_maxDepth;
+		m_stopPrims = other.m_stopPrims;
+		m_maxBadRefines = other.m_maxBadRefines;
+		m_exactPrimThreshold = other.m_exactPrimThreshold;
+		m_minMaxBins = other.m_minMaxBins;
+		m_logLevel = other.m_logLevel;
+		m_aabb = other.m_aabb;
+		m_tightAABB = other.m_tightAABB;
+
+		/* Trees without geometry consist of a single leaf and no index buffer */
+		m_nodeCount = other.m_indices ? other.m_nodeCount : 1;
+		m_indexCount = other.m_indices ? other.m_indexCount : 0;
+
+		// +1 shift is for alignment purposes (see KDNode::getSibling)
+		m_nodes = static_cast<KDNode *> (allocAligned(
+				sizeof(KDNode) * (m_nodeCount+1)))+1;
+		memcpy(m_nodes, other.m_nodes, sizeof(KDNode) * m_nodeCount);
+		if (other.m_indices) {
+			m_indices = new IndexType[m_indexCount];
+			memcpy(m_indices, other.m_indices, sizeof(IndexType) * m_indexCount);
+		}
+	}
+
 	/**
 	 * \brief Set the traversal cost used by the tree construction heuristic
 	 */
@@ -61,6 +61,24 @@ public:
 	ImageBlock(Bitmap::EPixelFormat fmt, const Vector2i &size,
 			const ReconstructionFilter *filter = NULL, int channels = -1, bool warn = true);
 
+	/**
+	 * \brief Create a thread-private splatting view of a shared image block
+	 *
+	 * The view shares the bitmap of \c target, but \ref putAtomic() accumulates
+	 * samples into a small direct-mapped cache of private tiles without any
+	 * atomic operations. Tiles are merged into the shared bitmap in one batch
+	 * when they are evicted from the cache and when \ref flushTiles() is called.
+	 * Only one thread may splat through a given view at a time.
+	 *
+	 * \param target
+	 *    Shared image block whose bitmap receives the merged tiles
+	 * \param tileSize
+	 *    Edge length of the private tiles in pixels
+	 * \param tileCount
+	 *    Number of tiles kept in the cache (rounded down to a square grid)
+	 */
+	ImageBlock(ImageBlock *target, int tileSize, int tileCount = 64);
+
 	/// Set the current block offset
 	inline void setOffset(const Point2i &offset) { m_offset = offset; }
 
@@ -104,7 +122,20 @@ public:
 	inline const ReconstructionFilter *getFilter() const { return m_filter; }
 
 	/// Clear everything to zero
-	inline void clear() { m_bitmap->clear(); }
+	inline void clear() {
+		m_bitmap->clear();
+		if (m_tileSize)
+			discardTiles();
+	}
+
+	/// Does \ref putAtomic() accumulate into thread-private tiles?
+	inline bool hasTiles() const { return m_tileSize > 0; }
+
+	/// Merge all pending tile-local contributions into the shared bitmap
+	void flushTiles();
+
+	/// Drop all pending tile-local contributions
+	void discardTiles();
 
 	/// Accumulate another image block into this one
 	inline void put(const ImageBlock *block) {
@@ -229,6 +260,11 @@ public:
 				goto bad_sample;
 		}
 
+		if (m_tileSize) {
+			putTiled(_pos, aligned_value);
+			return true;
+		}
+
 		{
 			const Float filterRadius = m_filter->getRadius();
 			const Vector2i &size = m_bitmap->getSize();
@@ -348,6 +384,15 @@ public:
 protected:
 	/// Virtual destructor
 	virtual ~ImageBlock();
+
+	/// Splat a (valid) sample into the thread-private tile cache
+	void putTiled(const Point2 &pos, const Float *value);
+
+	/// Return the cached tile for the given tile coordinates, evicting as necessary
+	Float *acquireTile(int tx, int ty);
+
+	/// Merge the given cache slot into the shared bitmap
+	void mergeTile(int slot);
 protected:
 	ref<Bitmap> m_bitmap;
 	Point2i m_offset;
@@ -356,6 +401,11 @@ protected:
 	const ReconstructionFilter *m_filter;
 	Float *m_weightsX, *m_weightsY;
 	bool m_warn;
+
+	/* Thread-private tile cache (only used by splatting views) */
+	int m_tileSize, m_tileGrid, m_tilesX;
+	std::vector<Float> m_tiles;
+	std::vector<int> m_tileKeys;
 };
 
 
@@ -266,6 +266,17 @@ public:
 	 */
 	inline bool rayIntersect(const RayDifferential &ray);
 
+	/**
+	 * \brief Like \ref rayIntersect(), but use an intersection record that
+	 * was already computed for \c ray and stored in \c its (e.g. by
+	 * \ref Scene::rayIntersectBatch())
+	 *
+	 * Performs steps 2-5 when \c EIntersection is set in \c type.
+	 *
+	 * \return \c true if there is a valid intersection.
+	 */
+	inline bool setIntersection(const RayDifferential &ray);
+
 	/// Retrieve a 2D sample
 	inline Point2 nextSample2D();
 
@@ -24,6 +24,9 @@
 #include <mitsuba/core/properties.h>
 #include <mitsuba/render/shape.h>
 
+/// Maximum number of pixel samples rendered as one batch
+#define MTS_MAX_RAY_BATCH 64
+
 MTS_NAMESPACE_BEGIN
 
 /**
@@ -74,6 +77,12 @@ public:
 	 */
 	virtual bool allocate(const Scene &scene, Sampler *const *samplers, ImageBlock *const *targets, int threadCount);
 
+	/**
+	 * \brief This function is called before the worker threads of a new frame
+	 * enter \ref render(); the default implementation does nothing.
+	 */
+	virtual void prepareFrame(int threadCount);
+
 	/**
 	 * \brief Render the scene as seen by the given sensor (or default sensor, for some path-space algorithms).
 	 */
@@ -104,13 +113,34 @@ public:
  */
 class MTS_EXPORT_RENDER ImageOrderIntegrator : public ResponsiveIntegrator {
 public:
+	/// Order in which the pixels of one sample plane are distributed to the threads
+	enum EPixelOrder {
+		/// Global random permutation of all pixels
+		ERandomPixels = 0,
+		/// Random permutation of small tiles, each traversed along a Hilbert curve
+		ECoherentTiles
+	};
+
 	/**
 	 * \brief Render the scene as seen by the given sensor (or default sensor, for some path-space algorithms).
 	 */
 	virtual int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, Point2i pixel, int threadIdx, int threadCount) = 0;
 
+	/**
+	 * \brief Render a batch of consecutive pixel samples of one chunk
+	 *
+	 * Integrators can override this to trace the rays of several pixels
+	 * together (see \ref Scene::rayIntersectBatch()). The default
+	 * implementation generates and renders the pixels one after another.
+	 * Every pixel has to be generated exactly once, at the sample index
+	 * of the given sampler.
+	 */
+	virtual int renderBatch(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, const Point2i *pixels, int count, int threadIdx, int threadCount);
+
 	// prepare px permutation
 	bool allocate(const Scene &scene, Sampler *const *samplers, ImageBlock *const *targets, int threadCount) override;
+	// distribute the first pass of pixel chunks
+	void prepareFrame(int threadCount) override;
 	// redirect through px permutation
 	int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target
 		, Controls controls, int threadIdx, int threadCount) override;
@@ -123,7 +153,29 @@ public:
 	virtual ~ImageOrderIntegrator();
 
 protected:
+	/// Lock-free range of pixel chunks owned by one worker, packed as [pass | begin | end]
+	struct alignas(64) WorkRange {
+		volatile int64_t range;
+	};
+
+	/**
+	 * \brief Acquire the next range of pixel chunks for the given thread
+	 *
+	 * Pops one chunk from the thread's own range, steals half of the range of
+	 * another thread otherwise, and distributes the next pass over the image
+	 * plane once all ranges are exhausted.
+	 */
+	void acquireChunks(int threadIdx, int threadCount, int &pass, int &begin, int &end);
+
+	/// Reset the range of the given thread to its share of the given pass
+	void distributeChunks(int threadIdx, int threadCount, int pass, int64_t expected);
+
 	std::vector<int> m_pxPermutation;
+	EPixelOrder m_pixelOrder;
+	int m_pixelTileSize;
+	int m_pixelChunkSize, m_chunkCount;
+	int m_rayBatchSize;
+	std::vector<WorkRange> m_workRanges;
 };
 
 struct PixelSample {
@@ -160,6 +212,8 @@ public:
 	bool preprocess(const Scene *scene, const Sensor* sensor, const Sampler* sampler) override;
 	using ImageOrderIntegrator::render;
 	int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, Point2i pixel, int threadIdx, int threadCount) override;
+	// batched primary rays
+	int renderBatch(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, const Point2i *pixels, int count, int threadIdx, int threadCount) override;
 
 	MTS_DECLARE_CLASS()
 
@@ -170,6 +224,10 @@ public:
 
     ref<SamplingIntegrator> classicIntegrator;
 	PixelDifferential pixelDifferential;
+
+protected:
+	/// Per-thread sampler clones holding the state of each pixel of a ray batch
+	std::vector<ref_vector<Sampler> > m_batchSamplers;
 };
 
 MTS_NAMESPACE_END
@@ -27,6 +27,7 @@
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/filesystem.h>
+#include <mitsuba/render/texcache.h>
 #include <fstream>
 
 MTS_NAMESPACE_BEGIN
@@ -38,11 +39,14 @@ MTS_NAMESPACE_BEGIN
 #define MTS_MIPMAP_LUT_SIZE 64
 
 /// MIP map cache file version
-#define MTS_MIPMAP_CACHE_VERSION 0x01
+#define MTS_MIPMAP_CACHE_VERSION 0x02
 
 /// Make sure that the actual cache contents start on a cache line
 #define MTS_MIPMAP_CACHE_ALIGNMENT 64
 
+/// Edge length of the tiles paged in by out-of-core MIP maps (power of two)
+#define MTS_MIPMAP_TILE_SIZE 64
+
 /* Some statistics counters */
 namespace stats {
 	extern MTS_EXPORT_RENDER StatsCounter avgEWASamples;
@@ -75,7 +79,15 @@ enum EMIPFilterType {
  * anisotropy of texture lookups in UV space.
  *
  * Generating good mip maps is costly, and therefore this class provides
- * the means to cache them on disk if desired.
+ * the means to cache them on disk if desired. A cache file can either be
+ * mapped into memory as a whole, or it can be accessed \a out-of-core,
+ * in which case square tiles of texels are paged in on demand through the
+ * global \ref TextureCache and are subject to its memory budget.
+ *
+ * To further reduce memory usage, the levels can optionally be stored in
+ * a lossy block-compressed format (see \ref CompressedBlockedArray), which
+ * is decoded on every texel access. This applies to both in-memory and
+ * cached MIP maps.
  *
  * \tparam Value
  *    This class can be parameterized to yield MIP map classes for
@@ -89,7 +101,8 @@ enum EMIPFilterType {
  *
  * \ingroup librender
  */
-template <typename Value, typename QuantizedValue> class TMIPMap : public Object {
+template <typename Value, typename QuantizedValue> class TMIPMap
+		: public Object, public TextureCache::TileProvider {
 public:
 #if MTS_MIPMAP_BLOCKED == 1
 	/// Use a blocked array to store MIP map data
@@ -99,6 +112,9 @@ public:
 	typedef LinearArray<QuantizedValue> Array2DType;
 #endif
 
+	/// Block-compressed storage of MIP map data
+	typedef CompressedBlockedArray<Value> CompressedArray2DType;
+
 	/// Shortcut
 	typedef ReconstructionFilter::EBoundaryCondition EBoundaryCondition;
 
@@ -152,6 +168,9 @@ public:
 	 *    When an RGB image is transformed into a spectral representation,
 	 *    this parameter specifies what conversion method should be used.
 	 *    See \ref Spectrum::EConversionIntent for further details.
+	 *
+	 * \param compressed
+	 *    Store the MIP map levels in a lossy block-compressed format?
 	 */
 	TMIPMap(Bitmap *bitmap_,
 			Bitmap::EPixelFormat pixelFormat,
@@ -164,9 +183,11 @@ public:
 			fs::pathstr cacheFilename = fs::pathstr(),
 			uint64_t timestamp = 0,
 			Float maxValue = 1.0f,
-			Spectrum::EConversionIntent intent = Spectrum::EReflectance)
+			Spectrum::EConversionIntent intent = Spectrum::EReflectance,
+			bool compressed = false)
 		: m_pixelFormat(pixelFormat), m_bcu(bcu), m_bcv(bcv), m_filterType(filterType),
-		  m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
+		  m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy), m_compressed(NULL),
+		  m_levelInfo(NULL), m_providerID(0), m_cache(NULL) {
 
 		/* Keep track of time */
 		ref<Timer> timer = new Timer();
@@ -177,7 +198,7 @@ public:
 		if (padding)
 			padding = MTS_MIPMAP_CACHE_ALIGNMENT - padding;
 		size_t cacheSize = sizeof(MIPMapHeader) + padding +
-			Array2DType::bufferSize(bitmap_->getSize());
+			levelBufferSize(bitmap_->getSize(), compressed);
 
 		/* 1. Determine the number of MIP levels. The following
 		      code also handles non-power-of-2 input. */
@@ -187,7 +208,7 @@ public:
 			while (size.x > 1 || size.y > 1) {
 				size.x = std::max(1, (size.x + 1) / 2);
 				size.y = std::max(1, (size.y + 1) / 2);
-				cacheSize += Array2DType::bufferSize(size);
+				cacheSize += levelBufferSize(size, compressed);
 				++m_levels;
 			}
 		}
@@ -212,32 +233,38 @@ public:
 		/* 2. Store the base image in a suitable memory layout */
 		m_pyramid = new Array2DType[m_levels];
 		m_sizeRatio = new Vector2[m_levels];
+		if (compressed)
+			m_compressed = new CompressedArray2DType[m_levels];
 
 		/* Allocate memory for the first MIP map level */
-		if (mmapPtr) {
+		if (mmapPtr)
 			mmapPtr += sizeof(MIPMapHeader) + padding;
-			m_pyramid[0].map(mmapPtr, bitmap_->getSize());
-			mmapPtr += m_pyramid[0].getBufferSize();
-		} else {
-			m_pyramid[0].alloc(bitmap_->getSize());
-		}
+		allocLevel(0, bitmap_->getSize(), mmapPtr);
 
 		/* Initialize the first mip map level and extract some general
 		   information (i.e. the minimum, maximum, and average texture value) */
 		ref<Bitmap> bitmap = bitmap_->expand()->convert(pixelFormat,
 			componentFormat, 1.0f, 1.0f, intent);
 
-		m_pyramid[0].cleanup();
-		m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+		Value *data = (Value *) bitmap->getData();
+		if (m_compressed) {
+			m_compressed[0].init(data, m_minimum, m_maximum, m_average);
+		} else {
+			m_pyramid[0].cleanup();
+			m_pyramid[0].init(data, m_minimum, m_maximum, m_average);
+		}
 
 		if (m_minimum.min() < 0) {
 			Log(EWarn, "The texture contains negative pixel values! These will be clamped!");
-			Value *value = (Value *) bitmap->getData();
+			Value *value = data;
 
 			for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
 				(*value++).clampNegative();
 
-			m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+			if (m_compressed)
+				m_compressed[0].init(data, m_minimum, m_maximum, m_average);
+			else
+				m_pyramid[0].init(data, m_minimum, m_maximum, m_average);
 		}
 
 		m_sizeRatio[0] = Vector2(1, 1);
@@ -252,16 +279,15 @@ public:
 				size.y = std::max(1, (size.y + 1) / 2);
 
 				/* Either allocate memory or index into the memory map file */
-				if (mmapPtr) {
-					m_pyramid[m_levels].map(mmapPtr, size);
-					mmapPtr += m_pyramid[m_levels].getBufferSize();
-				} else {
-					m_pyramid[m_levels].alloc(size);
-				}
+				allocLevel(m_levels, size, mmapPtr);
 
 				bitmap = bitmap->resample(rfilter, bcu, bcv, size, 0.0f, maxValue);
-				m_pyramid[m_levels].cleanup();
-				m_pyramid[m_levels].init((Value *) bitmap->getData());
+				if (m_compressed) {
+					m_compressed[m_levels].init((Value *) bitmap->getData());
+				} else {
+					m_pyramid[m_levels].cleanup();
+					m_pyramid[m_levels].init((Value *) bitmap->getData());
+				}
 				m_sizeRatio[m_levels] = Vector2(
 					(Float) size.x / (Float) m_pyramid[0].getWidth(),
 					(Float) size.y / (Float) m_pyramid[0].getHeight());
@@ -281,6 +307,7 @@ public:
 			header.bcu = (uint8_t) bcu;
 			header.bcv = (uint8_t) bcv;
 			header.filterType = (uint8_t) m_filterType;
+			header.compressed = compressed ? 1 : 0;
 			header.gamma = (float) bitmap_->getGamma();
 			header.width = bitmap_->getWidth();
 			header.height = bitmap_->getHeight();
@@ -316,19 +343,36 @@ public:
 	 *    kernel. This is necessary to bound the computational
 	 *    cost of filtered lookups. This parameter is independent of the
 	 *    cache file that was previously created.
+	 *
+	 * \param outOfCore
+	 *    Instead of mapping the whole file into memory, page in tiles
+	 *    on demand through the global \ref TextureCache?
 	 */
-	TMIPMap(fs::pathstr cacheFilename, Float maxAnisotropy = 20.0f)
-			: m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
-		m_mmap = new MemoryMappedFile(cacheFilename);
-		uint8_t *mmapPtr = (uint8_t *) m_mmap->getData();
-		Log(EInfo, "Mapped MIP map cache file \"%s\" into memory (%s).", cacheFilename.s.c_str(),
-			memString(m_mmap->getSize()).c_str());
+	TMIPMap(fs::pathstr cacheFilename, Float maxAnisotropy = 20.0f, bool outOfCore = false)
+			: m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy), m_compressed(NULL),
+			  m_levelInfo(NULL), m_providerID(0), m_cache(NULL) {
+		MIPMapHeader header;
+		uint8_t *mmapPtr = NULL;
 
-		stats::mipStorage += m_mmap->getSize();
+		if (outOfCore) {
+#if MTS_MIPMAP_BLOCKED != 1
+			Log(EError, "Out-of-core MIP maps require blocked storage!");
+#endif
+			m_file = new TileFile(cacheFilename);
+			Log(EInfo, "Accessing MIP map cache file \"%s\" out-of-core (%s).",
+				cacheFilename.s.c_str(), memString(m_file->getSize()).c_str());
+			m_file->read(0, sizeof(MIPMapHeader), &header);
+		} else {
+			m_mmap = new MemoryMappedFile(cacheFilename);
+			mmapPtr = (uint8_t *) m_mmap->getData();
+			Log(EInfo, "Mapped MIP map cache file \"%s\" into memory (%s).", cacheFilename.s.c_str(),
+				memString(m_mmap->getSize()).c_str());
 
-		/* Load the file header, and run some santity checks */
-		MIPMapHeader header;
-		memcpy(&header, mmapPtr, sizeof(MIPMapHeader));
+			stats::mipStorage += m_mmap->getSize();
+			memcpy(&header, mmapPtr, sizeof(MIPMapHeader));
+		}
+
+		/* Run some santity checks on the file header */
 		Assert(header.identifier[0] == 'M' && header.identifier[1] == 'I'
 			&& header.identifier[2] == 'P' && header.version == MTS_MIPMAP_CACHE_VERSION);
 		m_pixelFormat = (Bitmap::EPixelFormat) header.pixelFormat;
@@ -339,34 +383,56 @@ public:
 		m_minimum = header.minimum;
 		m_maximum = header.maximum;
 		m_average = header.average;
+		bool compressed = header.compressed != 0;
 
-		/* Move the pointer to the beginning of the MIP map data */
+		/* Skip to the beginning of the MIP map data */
 		size_t padding = sizeof(MIPMapHeader) % MTS_MIPMAP_CACHE_ALIGNMENT;
 		if (padding)
 			padding = MTS_MIPMAP_CACHE_ALIGNMENT - padding;
-		mmapPtr += sizeof(MIPMapHeader) + padding;
+		uint64_t offset = sizeof(MIPMapHeader) + padding;
 
-		/* Map the highest resolution level */
+		/* Map the levels of the image pyramid. Out-of-core MIP maps only
+		   record their sizes and file offsets; texels are accessed through
+		   the texture cache */
 		m_pyramid = new Array2DType[m_levels];
 		m_sizeRatio = new Vector2[m_levels];
-		Vector2i size(header.width, header.height);
-		m_pyramid[0].map(mmapPtr, size);
-		mmapPtr += m_pyramid[0].getBufferSize();
-		m_sizeRatio[0] = Vector2(1, 1);
+		if (compressed)
+			m_compressed = new CompressedArray2DType[m_levels];
+		if (outOfCore)
+			m_levelInfo = new LevelInfo[m_levels];
 
-		if (m_filterType != ENearest && m_filterType != EBilinear) {
-			/* Map the remainder of the image pyramid */
-			int level = 1;
-			while (size.x > 1 || size.y > 1) {
+		Vector2i size(header.width, header.height);
+		uint32_t tileCount = 0;
+		for (int level = 0; level < m_levels; ++level) {
+			if (level > 0) {
 				size.x = std::max(1, (size.x + 1) / 2);
 				size.y = std::max(1, (size.y + 1) / 2);
-				m_pyramid[level].map(mmapPtr, size);
-				m_sizeRatio[level] = Vector2(
-					(Float) size.x / (Float) m_pyramid[0].getWidth(),
-					(Float) size.y / (Float) m_pyramid[0].getHeight());
-				mmapPtr += m_pyramid[level++].getBufferSize();
 			}
-			Assert(level == m_levels);
+			uint8_t *levelPtr = mmapPtr ? mmapPtr + offset : NULL;
+			if (m_compressed) {
+				m_compressed[level].map(levelPtr, size);
+				m_pyramid[level].map(NULL, size);
+			} else {
+				m_pyramid[level].map(levelPtr, size);
+			}
+			m_sizeRatio[level] = Vector2(
+				(Float) size.x / (Float) m_pyramid[0].getWidth(),
+				(Float) size.y / (Float) m_pyramid[0].getHeight());
+
+			if (m_levelInfo) {
+				LevelInfo &info = m_levelInfo[level];
+				info.offset = offset;
+				info.firstTile = tileCount;
+				info.xTiles = (size.x + MTS_MIPMAP_TILE_SIZE - 1) / MTS_MIPMAP_TILE_SIZE;
+				tileCount += (uint32_t) info.xTiles *
+					(uint32_t) ((size.y + MTS_MIPMAP_TILE_SIZE - 1) / MTS_MIPMAP_TILE_SIZE);
+			}
+			offset += levelBufferSize(size, compressed);
+		}
+
+		if (m_levelInfo) {
+			m_cache = TextureCache::getInstance();
+			m_providerID = m_cache->registerProvider(this);
 		}
 
 		if (m_filterType == EEWA) {
@@ -380,7 +446,12 @@ public:
 
 	/// Release all memory
 	~TMIPMap() {
+		if (m_levelInfo) {
+			m_cache->unregisterProvider(m_providerID);
+			delete[] m_levelInfo;
+		}
 		delete[] m_pyramid;
+		delete[] m_compressed;
 		delete[] m_sizeRatio;
 		if (m_weightLut)
 			freeAligned(m_weightLut);
@@ -401,11 +472,14 @@ public:
 	 * \param gamma
 	 *    If nonzero, it is verified that the provided gamma value
 	 *    matches that of the cache file.
+	 * \param compressed
+	 *    Whether the MIP map levels should be block-compressed
 	 * \return \c true if the texture file is good for use
 	 */
 	static bool validateCacheFile(const fs::pathstr &path, uint64_t timestamp,
 			Bitmap::EPixelFormat pixelFormat, EBoundaryCondition bcu,
-			EBoundaryCondition bcv, EMIPFilterType filterType, Float gamma) {
+			EBoundaryCondition bcv, EMIPFilterType filterType, Float gamma,
+			bool compressed = false) {
 		std::ifstream is(decode_pathstr(path).string().c_str());
 		if (!is.good())
 			return false;
@@ -420,7 +494,8 @@ public:
 			|| header.timestamp != timestamp
 			|| header.bcu != (uint8_t) bcu || header.bcv != (uint8_t) bcv
 			|| header.pixelFormat != (uint8_t) pixelFormat
-			|| header.filterType != (uint8_t) filterType)
+			|| header.filterType != (uint8_t) filterType
+			|| header.compressed != (compressed ? 1 : 0))
 			return false;
 
 		if (gamma != 0 && (float) gamma != header.gamma)
@@ -433,13 +508,13 @@ public:
 
 		Vector2i size(header.width, header.height);
 		size_t expectedFileSize = sizeof(MIPMapHeader) + padding
-			+ Array2DType::bufferSize(size);
+			+ levelBufferSize(size, compressed);
 
 		if (filterType != ENearest && filterType != EBilinear) {
 			while (size.x > 1 || size.y > 1) {
 				size.x = std::max(1, (size.x + 1) / 2);
 				size.y = std::max(1, (size.y + 1) / 2);
-				expectedFileSize += Array2DType::bufferSize(size);
+				expectedFileSize += levelBufferSize(size, compressed);
 			}
 		}
 
@@ -450,7 +525,8 @@ public:
 	size_t getBufferSize() const {
 		size_t size = 0;
 		for (int i=0; i<m_levels; ++i)
-			size += m_pyramid[i].getBufferSize();
+			size += m_compressed ? m_compressed[i].getBufferSize()
+				: m_pyramid[i].getBufferSize();
 		return size;
 	}
 
@@ -478,7 +554,18 @@ public:
 	/// Get the component-wise average
 	inline const Value &getAverage() const { return m_average; }
 
-	/// Return the blocked array used to store a given MIP level
+	/// Is the MIP map accessed out-of-core through the texture cache?
+	inline bool isOutOfCore() const { return m_levelInfo != NULL; }
+
+	/// Are the MIP map levels stored in a block-compressed format?
+	inline bool isCompressed() const { return m_compressed != NULL; }
+
+	/**
+	 * \brief Return the blocked array used to store a given MIP level
+	 *
+	 * The array of an out-of-core or compressed MIP map holds no data; use
+	 * \ref evalTexel() or \ref toBitmap() instead.
+	 */
 	inline const Array2DType &getArray(int level = 0) const {
 		return m_pyramid[level];
 	}
@@ -492,7 +579,14 @@ public:
 			array.getSize()
 		);
 
-		array.copyTo((QuantizedValue *) result->getData());
+		if (m_levelInfo || m_compressed) {
+			QuantizedValue *target = (QuantizedValue *) result->getData();
+			for (int y=0; y<array.getHeight(); ++y)
+				for (int x=0; x<array.getWidth(); ++x)
+					*target++ = QuantizedValue(fetch(level, x, y));
+		} else {
+			array.copyTo((QuantizedValue *) result->getData());
+		}
 
 		return result;
 	}
@@ -560,7 +654,7 @@ public:
 			}
 		}
 
-		return Value(m_pyramid[level](x, y));
+		return fetch(level, x, y);
 	}
 
 	/// Evaluate the texture at the given resolution using a box filter
@@ -722,7 +816,8 @@ public:
 			<< "   pixelFormat = " << m_pixelFormat << "," << endl
 			<< "   size = " << memString(getBufferSize()) << "," << endl
 			<< "   levels = " << m_levels << "," << endl
-			<< "   cached = " << (m_mmap.get() ? "yes" : "no") << "," << endl
+			<< "   cached = " << (m_levelInfo ? "out-of-core" : (m_mmap.get() ? "yes" : "no")) << "," << endl
+			<< "   compressed = " << (m_compressed ? "yes" : "no") << "," << endl
 			<< "   filterType = ";
 
 		switch (m_filterType) {
@@ -740,8 +835,122 @@ public:
 		return oss.str();
 	}
 
+	/// Return the size of the tiles paged in by out-of-core MIP maps
+	size_t getTileSize() const {
+		const size_t tileBlocks = MTS_MIPMAP_TILE_SIZE / tileBlockSize;
+		return tileBlocks * tileBlocks * getBlockBytes();
+	}
+
+	/**
+	 * \brief Load a tile of an out-of-core MIP map from the cache file
+	 *
+	 * Tiles keep the blocked layout of the cache file; a row of blocks
+	 * within a tile hence corresponds to one contiguous read.
+	 */
+	void loadTile(uint32_t tileIndex, uint8_t *target) const {
+		int level = m_levels - 1;
+		while (m_levelInfo[level].firstTile > tileIndex)
+			--level;
+
+		const LevelInfo &info = m_levelInfo[level];
+		const Vector2i &size = m_pyramid[level].getSize();
+		const size_t blockSize = tileBlockSize,
+		      blockBytes = getBlockBytes(),
+		      tileBlocks = MTS_MIPMAP_TILE_SIZE / blockSize,
+		      xBlocks = (size.x + blockSize - 1) / blockSize,
+		      yBlocks = (size.y + blockSize - 1) / blockSize;
+
+		uint32_t index = tileIndex - info.firstTile;
+		size_t xBlock = (index % info.xTiles) * tileBlocks,
+		       yBlock = (index / info.xTiles) * tileBlocks,
+		       xCount = std::min(tileBlocks, xBlocks - xBlock),
+		       yCount = std::min(tileBlocks, yBlocks - yBlock);
+
+		/* Partial tiles along the right and bottom edge */
+		if (xCount < tileBlocks || yCount < tileBlocks)
+			memset(target, 0, getTileSize());
+
+		for (size_t y=0; y<yCount; ++y)
+			m_file->read(info.offset + ((yBlock + y) * xBlocks + xBlock) * blockBytes,
+				xCount * blockBytes, target + y * tileBlocks * blockBytes);
+	}
+
 	MTS_DECLARE_CLASS()
 protected:
+	/// Tile layout of a level of an out-of-core MIP map
+	struct LevelInfo {
+		uint64_t offset;
+		uint32_t firstTile;
+		int xTiles;
+	};
+
+	/**
+	 * \brief Edge length of the blocks that make up a tile
+	 *
+	 * \ref BlockedArray and \ref CompressedBlockedArray
+	 * share the same 4x4 block layout
+	 */
+	static const int tileBlockSize = (int) CompressedArray2DType::blockSize;
+
+	/// Return the storage size of a MIP map level
+	static size_t levelBufferSize(const Vector2i &size, bool compressed) {
+		return compressed ? CompressedArray2DType::bufferSize(size)
+			: Array2DType::bufferSize(size);
+	}
+
+	/// Return the storage size of one 4x4 block of texels
+	inline size_t getBlockBytes() const {
+		return m_compressed ? sizeof(typename CompressedArray2DType::Block)
+			: tileBlockSize * tileBlockSize * sizeof(QuantizedValue);
+	}
+
+	/// Allocate a MIP map level or map it into the cache file
+	void allocLevel(int level, const Vector2i &size, uint8_t *&mmapPtr) {
+		if (m_compressed) {
+			/* The uncompressed array only records the level's size */
+			m_pyramid[level].map(NULL, size);
+			if (mmapPtr) {
+				m_compressed[level].map(mmapPtr, size);
+				mmapPtr += m_compressed[level].getBufferSize();
+			} else {
+				m_compressed[level].alloc(size);
+			}
+		} else {
+			if (mmapPtr) {
+				m_pyramid[level].map(mmapPtr, size);
+				mmapPtr += m_pyramid[level].getBufferSize();
+			} else {
+				m_pyramid[level].alloc(size);
+			}
+		}
+	}
+
+	/// Fetch a texel that is known to lie within the specified level
+	inline Value fetch(int level, int x, int y) const {
+		if (EXPECT_TAKEN(!m_levelInfo)) {
+			if (EXPECT_TAKEN(!m_compressed))
+				return Value(m_pyramid[level](x, y));
+			else
+				return m_compressed[level](x, y);
+		}
+
+		const int tileBlocks = MTS_MIPMAP_TILE_SIZE / tileBlockSize;
+		const LevelInfo &info = m_levelInfo[level];
+		uint32_t tile = info.firstTile + (uint32_t) ((y / MTS_MIPMAP_TILE_SIZE)
+			* info.xTiles + x / MTS_MIPMAP_TILE_SIZE);
+		const uint8_t *data = m_cache->lookup(m_providerID, tile);
+
+		int xo = x & (MTS_MIPMAP_TILE_SIZE - 1), yo = y & (MTS_MIPMAP_TILE_SIZE - 1);
+		int block = (yo / tileBlockSize) * tileBlocks + xo / tileBlockSize,
+		    offset = tileBlockSize * (yo % tileBlockSize) + xo % tileBlockSize;
+
+		if (m_compressed)
+			return ((const typename CompressedArray2DType::Block *) data)[block].eval(offset);
+		else
+			return Value(((const QuantizedValue *) data)[
+				tileBlockSize * tileBlockSize * block + offset]);
+	}
+
 	/// Header file for MIP map cache files
 	struct MIPMapHeader {
 		char identifier[3];
@@ -751,6 +960,7 @@ protected:
 		uint8_t bcu:4;
 		uint8_t bcv:4;
 		uint8_t filterType;
+		uint8_t compressed;
 		float gamma;
 		int width;
 		int height;
@@ -842,10 +1052,15 @@ private:
 	Float m_maxAnisotropy;
 	Vector2 *m_sizeRatio;
 	Array2DType *m_pyramid;
+	CompressedArray2DType *m_compressed;
 	int m_levels;
 	Value m_minimum;
 	Value m_maximum;
 	Value m_average;
+	ref<TileFile> m_file;
+	LevelInfo *m_levelInfo;
+	uint32_t m_providerID;
+	TextureCache *m_cache;
 };
 
 template <typename Value, typename QuantizedValue>
@@ -73,6 +73,12 @@ public:
 	/// Unserialize from a binary data stream
 	Photon(Stream *stream);
 
+	/// Reassemble a photon from the position and data record kept by \ref PhotonMap
+	inline Photon(const Point &pos, const PhotonData &_data) {
+		position = pos;
+		data = _data;
+	}
+
 	/// @}
 	// ======================================================================
 
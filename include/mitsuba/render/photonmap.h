@@ -29,11 +29,17 @@ MTS_NAMESPACE_BEGIN
  * Based on Henrik Wann Jensen's book "Realistic Image Synthesis
  * Using Photon Mapping".
  *
+ * The photons are organized in a \ref CompactPointKDTree, which only
+ * keeps their positions and data records. Building the photon map
+ * reorders the photons, and \ref Photon instances returned by the
+ * accessors are reassembled on the fly (they do not carry any tree
+ * structure).
+ *
  * \ingroup librender
  */
 class MTS_EXPORT_RENDER PhotonMap : public SerializableObject {
 public:
-	typedef PointKDTree<Photon>        PhotonTree;
+	typedef CompactPointKDTree<Point, PhotonData> PhotonTree;
 	typedef PhotonTree::IndexType      IndexType;
 	typedef PhotonTree::SearchResult   SearchResult;
 
@@ -55,22 +61,22 @@ public:
 	// =============================================================
 	//! @{ \name \c stl::vector-like interface
 	// =============================================================
-	/// Clear the kd-tree array
+	/// Remove all photons
 	inline void clear() { m_kdtree.clear(); }
-	/// Resize the kd-tree array
-	inline void resize(size_t size) { m_kdtree.resize(size); }
-	/// Reserve a certain amount of memory for the kd-tree array
+	/// Reserve a certain amount of memory for photons
 	inline void reserve(size_t size) { m_kdtree.reserve(size); }
-	/// Return the size of the kd-tree
+	/// Return the number of photons
 	inline size_t size() const { return m_kdtree.size(); }
-	/// Return the capacity of the kd-tree
+	/// Return the capacity of the photon map
 	inline size_t capacity() const { return m_kdtree.capacity(); }
-	/// Append a kd-tree photon to the photon array
-	inline void push_back(const Photon &photon) { m_kdtree.push_back(photon); }
+	/// Append a photon (only before \ref build() is called)
+	inline void push_back(const Photon &photon) {
+		m_kdtree.push_back(photon.getPosition(), photon.getData());
+	}
 	/// Return one of the photons by index
-	inline Photon &operator[](size_t idx) { return m_kdtree[idx]; }
-	/// Return one of the photons by index (const version)
-	inline const Photon &operator[](size_t idx) const { return m_kdtree[idx]; }
+	inline Photon operator[](size_t idx) const {
+		return Photon(m_kdtree.getPosition(idx), m_kdtree.getData(idx));
+	}
 	//! @}
 	// =============================================================
 
@@ -175,6 +181,9 @@ public:
 	/// Return the depth of the constructed KD-tree
 	inline size_t getDepth() const { return m_kdtree.getDepth(); }
 
+	/// Return the memory used by the photons and the kd-tree in bytes
+	inline size_t getMemoryUsage() const { return m_kdtree.getMemoryUsage(); }
+
 	/// Determine if the photon map is completely filled
 	inline bool isFull() const {
 		return capacity() == size();
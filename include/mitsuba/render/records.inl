@@ -116,8 +116,13 @@ inline const PhaseFunction *MediumSamplingRecord::getPhaseFunction() const {
 
 inline bool RadianceQueryRecord::rayIntersect(const RayDifferential &ray) {
 	/* Only search for an intersection if this was explicitly requested */
-	if (type & EIntersection) {
+	if (type & EIntersection)
 		scene->rayIntersect(ray, its);
+	return setIntersection(ray);
+}
+
+inline bool RadianceQueryRecord::setIntersection(const RayDifferential &ray) {
+	if (type & EIntersection) {
 		if (type & EOpacity) {
 			int unused = INT_MAX;
 
@@ -25,6 +25,7 @@
 #include <mitsuba/core/aabb.h>
 #include <mitsuba/render/trimesh.h>
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/emitterbvh.h>
 #include <mitsuba/render/sensor.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/bsdf.h>
@@ -80,6 +81,21 @@ public:
 	 */
 	void invalidate();
 
+	/**
+	 * \brief Rebuild the top-level kd-tree after shapes were moved
+	 *
+	 * This is the inexpensive alternative to \ref invalidate() when
+	 * only the transformations of instances have changed (see
+	 * \ref Shape::setWorldTransform()). The instances are kept in a
+	 * separate tree, which the scene's kd-tree references as a single
+	 * primitive. Only this tree over the instances is built again, and
+	 * the kd-trees of the shape groups are reused. The scene's kd-tree
+	 * is rebuilt only when the instances leave the bounds it was built
+	 * with. The emitter hierarchy (if any) is rebuilt as well, since
+	 * moved area lights change its bounds.
+	 */
+	void refitKDTree();
+
 	/**
 	 * \brief Initialize the scene for bidirectional rendering algorithms.
 	 *
@@ -242,6 +258,39 @@ public:
 		return m_kdtree->rayIntersect(ray);
 	}
 
+	/**
+	 * \brief Intersect a batch of rays against all primitives stored
+	 * in the scene and return detailed intersection information
+	 *
+	 * The rays are reordered internally so that coherent groups are
+	 * traversed together, which is considerably faster than issuing
+	 * the same queries one by one. Missed rays have <tt>its[i].t</tt>
+	 * set to infinity (i.e. <tt>its[i].isValid()</tt> is \c false).
+	 *
+	 * \param rays
+	 *    Array of \c count rays
+	 *
+	 * \param its
+	 *    Array of \c count intersection records, which will be
+	 *    filled in the order of the input rays
+	 */
+	inline void rayIntersectBatch(const Ray *rays, Intersection *its, size_t count) const {
+		m_kdtree->rayIntersectBatch(rays, its, count);
+	}
+
+	/**
+	 * \brief Test a batch of rays for occlusion
+	 *
+	 * \param rays
+	 *    Array of \c count rays
+	 *
+	 * \param occluded
+	 *    Receives \c true for every ray that hit a primitive
+	 */
+	inline void rayIntersectBatch(const Ray *rays, bool *occluded, size_t count) const {
+		m_kdtree->rayIntersectBatch(rays, occluded, count);
+	}
+
 	/**
 	 * \brief Return the transmittance between \c p1 and \c p2 at the
 	 * specified time.
@@ -849,6 +898,17 @@ public:
 		return emitter->getSamplingWeight() * m_emitterPDF.getNormalization();
 	}
 
+	/**
+	 * \brief Return the discrete probability of choosing a certain
+	 * emitter in \ref sampleEmitterDirect() and the attenuated variants
+	 *
+	 * Unlike \ref pdfEmitterDiscrete(const Emitter *), this accounts for the
+	 * reference point (\c dRec.ref and \c dRec.refN) when the scene uses
+	 * an emitter hierarchy.
+	 */
+	Float pdfEmitterDiscrete(const Emitter *emitter,
+		const DirectSamplingRecord &dRec) const;
+
  	/**
 	 * \brief Importance sample a ray according to the emission profile
 	 * defined by the sensors in the scene
@@ -1071,6 +1131,16 @@ public:
 	/// Return the scene's kd-tree accelerator
 	inline const ShapeKDTree *getKDTree() const { return m_kdtree.get(); }
 
+	/**
+	 * \brief Create a shallow clone of the scene, which traces rays
+	 * using a replica of its acceleration data structure
+	 *
+	 * Shapes, emitters, sensors etc. are shared with this scene. The
+	 * replica is allocated by the calling thread, see
+	 * \ref ShapeKDTree::createReplica().
+	 */
+	ref<Scene> createReplica();
+
 	/// Return the a list of all subsurface integrators
 	inline ref_vector<Subsurface> &getSubsurfaceIntegrators() { return m_ssIntegrators; }
 	/// Return the a list of all subsurface integrators
@@ -1090,6 +1160,17 @@ public:
 	/// Return a set of special shapes related to emitter/sensor geometry in bidirectional renderings
 	inline const ref_vector<Shape> &getSpecialShapes() const { return m_specialShapes; }
 
+	/**
+	 * \brief Return the hierarchy used to choose emitters for direct
+	 * illumination sampling, or \c NULL when they are chosen according
+	 * to their sampling weights
+	 *
+	 * The hierarchy assumes static emitters: it is rebuilt by
+	 * \ref initialize() after emitters were added or the scene was
+	 * invalidated, and by \ref refitKDTree().
+	 */
+	inline const EmitterBVH *getEmitterBVH() const { return m_emitterBVH.get(); }
+
 	/// Return the scene's emitters
 	inline ref_vector<Emitter> &getEmitters() { return m_emitters; }
 	/// Return the scene's emitters
@@ -1148,8 +1229,15 @@ protected:
 	/// Add a shape to the scene
 	void addShape(Shape *shape);
 	/// \endcond
+
+	/// Choose an emitter for direct illumination sampling at \c dRec.ref
+	const Emitter *sampleEmitterDiscrete(const DirectSamplingRecord &dRec,
+		Float &sample, Float &pdf) const;
 private:
 	ref<ShapeKDTree> m_kdtree;
+	/// Tree over the instances, referenced from \c m_kdtree through \c m_instanceLayer
+	ref<ShapeKDTree> m_instanceTree;
+	ref<Shape> m_instanceLayer;
 	ref<Sensor> m_sensor;
 	ref<Integrator> m_integrator;
 	ref<Sampler> m_sampler;
@@ -1166,10 +1254,12 @@ private:
 	fs::pathstr *m_sourceFile;
 	fs::pathstr *m_destinationFile;
 	DiscreteDistribution m_emitterPDF;
+	ref<EmitterBVH> m_emitterBVH;
 	AABB m_aabb;
 	uint32_t m_blockSize;
 	bool m_degenerateSensor;
 	bool m_degenerateEmitters;
+	bool m_useEmitterBVH;
 	bool m_scenePreprocessed;
 	bool m_integratorPreprocessed;
 };
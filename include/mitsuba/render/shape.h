@@ -327,6 +327,24 @@ public:
 	 */
 	virtual void adjustTime(Intersection &its, Float time) const;
 
+	/**
+	 * \brief Return the object-to-world transformation of shapes
+	 * that reference their geometry through a transformation
+	 * (e.g. instances). The default implementation returns NULL.
+	 */
+	virtual const AnimatedTransform *getWorldTransform() const;
+
+	/**
+	 * \brief Move a shape that references its geometry through
+	 * a transformation (e.g. an instance)
+	 *
+	 * Shapes with baked-in world-space geometry return \c false.
+	 * Any internal acceleration data structure of the referenced
+	 * geometry is kept, only \ref Scene::refitKDTree() must be
+	 * called before the scene is queried again.
+	 */
+	virtual bool setWorldTransform(const AnimatedTransform *trafo);
+
 	/**
 	 * \brief Return the internal kd-tree of this shape (if any)
 	 *
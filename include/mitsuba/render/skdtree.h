@@ -23,6 +23,7 @@
 #include <mitsuba/render/shape.h>
 #include <mitsuba/render/sahkdtree3.h>
 #include <mitsuba/render/triaccel.h>
+#include <mitsuba/render/bvh4.h>
 
 #if defined(MTS_KD_CONSERVE_MEMORY)
 #if defined(MTS_HAS_COHERENT_RT)
@@ -62,6 +63,12 @@ typedef const Shape * ConstShapePtr;
  * test is used instead, which doesn't need any extra storage. However, it also
  * tends to be quite a bit slower.
  *
+ * Alternatively, the primitives can be organized in a 4-wide bounding
+ * volume hierarchy (see \ref setAccelerator() and \ref BVH4), which builds
+ * much faster and with less memory on very large meshes. The kd-tree
+ * nodes are not created in that case, so code that walks them directly
+ * (\ref getRoot()) must check \ref getAccelerator() first.
+ *
  * \sa GenericKDTree
  * \ingroup librender
  */
@@ -71,9 +78,19 @@ class MTS_EXPORT_RENDER ShapeKDTree : public SAHKDTree3D<ShapeKDTree> {
 	friend class SAHKDTree3D<ShapeKDTree>;
 	friend class Instance;
 	friend class AnimatedInstance;
+	friend class InstanceLayer;
 	friend class SingleScatter;
+	friend class BVH4;
 
 public:
+	/// Spatial data structures that can be used to organize the primitives
+	enum EAccelerator {
+		/// SAH kd-tree (default)
+		EKDTree = 0,
+		/// 4-wide binned SAH bounding volume hierarchy
+		EBVH
+	};
+
 	// =============================================================
 	//! @{ \name Initialization and tree construction
 	// =============================================================
@@ -100,6 +117,36 @@ public:
 	/// Build the kd-tree (needs to be called before tracing any rays)
 	void build();
 
+	/// Select the data structure created by \ref build()
+	inline void setAccelerator(EAccelerator accel) { m_accel = accel; }
+
+	/// Return the data structure created by \ref build()
+	inline EAccelerator getAccelerator() const { return m_accel; }
+
+	/**
+	 * \brief Return whether or not the acceleration data structure
+	 * selected by \ref setAccelerator() has been built
+	 *
+	 * In contrast to \ref KDTreeBase::isBuilt(), which only refers to
+	 * the kd-tree nodes, this also covers the BVH.
+	 */
+	inline bool isAcceleratorBuilt() const {
+		return m_accel == EBVH ? m_bvh.isBuilt() : isBuilt();
+	}
+
+	/// Return the bounding volume hierarchy (only built when using \ref EBVH)
+	inline const BVH4 &getBVH() const { return m_bvh; }
+
+	/**
+	 * \brief Create a copy of this (fully built) acceleration data structure
+	 *
+	 * Shapes are shared with the original, while the tree itself and the
+	 * precomputed triangle data are duplicated by the calling thread. On
+	 * NUMA machines, this allows each node to trace rays using a replica
+	 * that resides in its local memory.
+	 */
+	ref<ShapeKDTree> createReplica() const;
+
 	//! @}
 	// =============================================================
 
@@ -175,6 +222,20 @@ public:
 	 */
 	bool rayIntersect(const Ray &ray) const;
 
+	/**
+	 * \brief Intersect a batch of rays and store detailed intersection
+	 * records in the order of the input rays
+	 *
+	 * The rays are sorted by direction octant and by origin before
+	 * tracing, so that consecutive queries touch the same nodes. With
+	 * coherent ray tracing support (and the kd-tree accelerator), groups
+	 * of four sorted rays are traced as SIMD packets.
+	 */
+	void rayIntersectBatch(const Ray *rays, Intersection *its, size_t count) const;
+
+	/// Occlusion-only variant of \ref rayIntersectBatch()
+	void rayIntersectBatch(const Ray *rays, bool *occluded, size_t count) const;
+
 #if defined(MTS_HAS_COHERENT_RT)
 	/**
 	 * \brief Intersect four rays with the stored triangle meshes while making
@@ -427,6 +488,20 @@ protected:
 		its.wi = its.toLocal(-ray.d);
 	}
 
+#if defined(MTS_HAS_COHERENT_RT)
+	/// Trace four rays of a sorted batch as a packet (\c its or \c occluded is NULL)
+	void intersectPacket4(const Ray *rays, const uint32_t *order,
+		Intersection *its, bool *occluded) const;
+#endif
+
+	/// Dispatch a ray traversal to the active acceleration data structure
+	template <bool shadowRay> FINLINE bool traverse(const Ray &ray,
+			Float mint, Float maxt, Float &t, void *temp) const {
+		if (m_accel == EBVH)
+			return m_bvh.rayIntersect<shadowRay>(this, ray, mint, maxt, t, temp);
+		return rayIntersectHavran<shadowRay>(ray, mint, maxt, t, temp);
+	}
+
 	/// Plain shadow ray query (used by the 'instance' plugin)
 	inline bool rayIntersect(const Ray &ray, Float _mint, Float _maxt) const {
 		Float mint, maxt, tempT = std::numeric_limits<Float>::infinity();
@@ -435,7 +510,7 @@ protected:
 			if (_maxt < maxt) maxt = _maxt;
 
 			if (EXPECT_TAKEN(maxt > mint))
-				return rayIntersectHavran<true>(ray, mint, maxt, tempT, NULL);
+				return traverse<true>(ray, mint, maxt, tempT, NULL);
 		}
 		return false;
 	}
@@ -448,7 +523,7 @@ protected:
 			if (_maxt < maxt) maxt = _maxt;
 
 			if (EXPECT_TAKEN(maxt > mint)) {
-				if (rayIntersectHavran<false>(ray, mint, maxt, tempT, temp)) {
+				if (traverse<false>(ray, mint, maxt, tempT, temp)) {
 					t = tempT;
 					return true;
 				}
@@ -463,6 +538,11 @@ private:
 	std::vector<const Shape *> m_shapes;
 	std::vector<bool> m_triangleFlag;
 	std::vector<IndexType> m_shapeMap;
+	EAccelerator m_accel;
+	BVH4 m_bvh;
+	/* Packets do not carry the ray time, hence batches are only
+	   traced as packets when there are no animated generic shapes */
+	bool m_triangleOnly;
 #if !defined(MTS_KD_CONSERVE_MEMORY)
 	TriAccel *m_triAccel;
 #endif
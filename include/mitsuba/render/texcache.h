@@ -0,0 +1,149 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TEXCACHE_H_)
+#define __MITSUBA_RENDER_TEXCACHE_H_
+
+#include <mitsuba/mitsuba.h>
+#include <mitsuba/core/filesystem.h>
+#include <memory>
+
+/// Default memory budget of the texture cache (in MiB)
+#define MTS_TEXCACHE_DEFAULT_BUDGET 1024
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Process-wide cache of texture tiles with a global memory budget
+ *
+ * Out-of-core textures (see \ref TMIPMap) do not keep their data in
+ * memory. Instead, they register themselves as a \ref TileProvider and
+ * request fixed-size tiles by index; the cache loads missing tiles on
+ * demand and evicts the least recently used ones once the budget is
+ * exceeded.
+ *
+ * To keep contention low, the cache is split into independently locked
+ * shards (each of which manages an equal part of the budget), and every
+ * thread additionally remembers a handful of recently used tiles, which
+ * it can access without any synchronization. Tiles referenced by these
+ * thread-local slots stay alive until the slot is reused, hence the
+ * actual memory usage may exceed the budget by a small amount per thread.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER TextureCache : public Object {
+public:
+	/// Interface of resources whose data is paged through the cache
+	class MTS_EXPORT_RENDER TileProvider {
+	public:
+		virtual ~TileProvider() { }
+
+		/// Return the size of a tile in bytes
+		virtual size_t getTileSize() const = 0;
+
+		/**
+		 * \brief Load the specified tile into \c target, which
+		 * has room for \ref getTileSize() bytes
+		 *
+		 * This function may be called from several threads at once.
+		 */
+		virtual void loadTile(uint32_t tileIndex, uint8_t *target) const = 0;
+	};
+
+	/// Return the texture cache instance
+	static TextureCache *getInstance();
+
+	/**
+	 * \brief Register a tile provider
+	 *
+	 * \return An identifier that must be passed to \ref lookup().
+	 * Identifiers are never reused.
+	 */
+	uint32_t registerProvider(const TileProvider *provider);
+
+	/// Unregister a tile provider and release all of its cached tiles
+	void unregisterProvider(uint32_t id);
+
+	/**
+	 * \brief Return a pointer to the contents of the specified tile,
+	 * loading it if necessary
+	 *
+	 * The pointer remains valid at least until the calling thread
+	 * has requested a few other tiles (see the class description).
+	 */
+	const uint8_t *lookup(uint32_t id, uint32_t tileIndex);
+
+	/// Set the memory budget in bytes
+	void setBudget(size_t budget);
+
+	/// Return the memory budget in bytes
+	size_t getBudget() const;
+
+	/// Return the amount of memory currently held by the shared cache
+	size_t getMemoryUsage() const;
+
+	/// Return a human-readable string representation
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Create an empty cache
+	TextureCache();
+
+	/// Release all tiles
+	virtual ~TextureCache();
+private:
+	struct TextureCachePrivate;
+	std::unique_ptr<TextureCachePrivate> d;
+};
+
+/**
+ * \brief Read-only file supporting concurrent reads at arbitrary offsets
+ *
+ * Used by \ref TextureCache::TileProvider implementations to page in
+ * tiles from disk.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER TileFile : public Object {
+public:
+	/// Open the specified file
+	TileFile(const fs::pathstr &filename);
+
+	/// Read \c size bytes starting at \c offset (thread-safe)
+	void read(uint64_t offset, size_t size, void *target) const;
+
+	/// Return the size of the file
+	uint64_t getSize() const;
+
+	/// Return the associated filename
+	fs::pathstr getFilename() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Close the file
+	virtual ~TileFile();
+private:
+	struct TileFilePrivate;
+	std::unique_ptr<TileFilePrivate> d;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TEXCACHE_H_ */
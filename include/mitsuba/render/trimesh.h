@@ -307,6 +307,29 @@ public:
 	/// Export a Stanford PLY version of this file
 	void writePLY(const fs::pathstr &path) const;
 
+	/**
+	 * \brief Serialize to the uncompressed, page-aligned variant
+	 * of the stable mesh format
+	 *
+	 * The mesh is written starting at the next page boundary of the
+	 * stream, and its arrays use the same layout as in memory, so that
+	 * the file can later be memory-mapped and referenced without copying.
+	 * Returns the file offset of the mesh, which should be recorded in
+	 * the end-of-file dictionary.
+	 */
+	size_t serializeUncompressed(Stream *stream) const;
+
+	/**
+	 * \brief Return the number of meshes stored in a file that uses
+	 * the stable mesh format (see \ref serialize(Stream *))
+	 *
+	 * This function modifies the position of the stream.
+	 */
+	static int getSerializedMeshCount(Stream *stream);
+
+	/// Does the mesh reference its data directly from a memory-mapped file?
+	inline bool isMapped() const { return m_mapping.get() != NULL; }
+
 	/// Return a string representation
 	std::string toString() const;
 
@@ -324,6 +347,24 @@ protected:
 	/// Load a Mitsuba compressed triangle mesh substream
 	void loadCompressed(Stream *stream, int idx = 0);
 
+	/**
+	 * \brief Load an uncompressed mesh starting at the given
+	 * offset of a memory-mapped file
+	 *
+	 * When the file precision and byte order match the host and the
+	 * mapping is writable, the mesh references the arrays in place and
+	 * keeps the mapping alive. Otherwise, the data is copied.
+	 */
+	void loadMapped(MemoryMappedFile *mapping, size_t offset);
+
+	/**
+	 * \brief Read an uncompressed mesh whose header starts at \c blockStart.
+	 * The stream must be located right after the file format header.
+	 * When \c mapping is provided, it must hold the stream contents.
+	 */
+	void loadUncompressed(Stream *stream, size_t blockStart,
+		MemoryMappedFile *mapping = NULL);
+
 	/**
 	 * \brief Reads the header information of a compressed file, returning
 	 * the version ID.
@@ -360,6 +401,7 @@ protected:
 	Point2 *m_texcoords;
 	TangentSpace *m_tangents;
 	Color3 *m_colors;
+	ref<MemoryMappedFile> m_mapping;
 	size_t m_triangleCount;
 	size_t m_vertexCount;
 	bool m_flipNormals;
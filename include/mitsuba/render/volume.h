@@ -71,6 +71,16 @@ public:
 	 */
 	virtual Float getMaximumFloatValue() const = 0;
 
+	/**
+	 * \brief Return conservative bounds of the values that could be
+	 * returned by \ref lookupFloat within a world-space region
+	 *
+	 * This is used to build local majorants for Woodcock-Tracking.
+	 * The default implementation returns the interval
+	 * <tt>[0, getMaximumFloatValue()]</tt>.
+	 */
+	virtual void getFloatRange(const AABB &aabb, Float &min, Float &max) const;
+
 	MTS_DECLARE_CLASS()
 protected:
 	/// Virtual destructor
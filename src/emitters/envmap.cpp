@@ -64,6 +64,11 @@ MTS_NAMESPACE_BEGIN
  *        \emph{filename}\code{.mip} to be created.
  *        \default{automatic---use caching for images larger than 1M pixels.}
  *     }
+ *     \parameter{outOfCore}{\Boolean}{
+ *        Page in tiles of the MIP map cache file on demand through the
+ *        shared texture cache instead of mapping the entire file into memory
+ *        (see the \code{bitmap} texture). Implies \code{cache=true}. \default{\code{false}}
+ *     }
  *     \parameter{samplingWeight}{\Float}{
  *         Specifies the relative amount of samples
  *         allocated to this emitter. \default{1}
@@ -144,12 +149,19 @@ public:
 		EMIPFilterType filterType = EEWA;
 		Float maxAnisotropy = 10.0f;
 
+		bool outOfCore = props.getBoolean("outOfCore", false);
+		if (outOfCore && cacheFile.empty()) {
+			Log(EWarn, "Out-of-core access requires an image file on disk -- "
+				"keeping the environment map in memory.");
+			outOfCore = false;
+		}
+
 		fs::pathstr scacheFile = fs::encode_pathstr(cacheFile);
 		if (tryReuseCache && MIPMap::validateCacheFile(scacheFile, timestamp,
 				ENVMAP_PIXELFORMAT, ReconstructionFilter::ERepeat,
 				ReconstructionFilter::EClamp, filterType, m_gamma)) {
 			/* Reuse an existing MIP map cache file */
-			m_mipmap = new MIPMap(scacheFile, maxAnisotropy);
+			m_mipmap = new MIPMap(scacheFile, maxAnisotropy, outOfCore);
 		} else {
 			if (bitmap == NULL) {
 				/* Load the input image if necessary */
@@ -176,13 +188,23 @@ public:
 			rfilter->configure();
 
 			/* Potentially create a new MIP map cache file */
-			bool createCache = !cacheFile.empty() && props.getBoolean("cache",
-				bitmap->getSize().x * bitmap->getSize().y > 1024*1024);
+			bool createCache = !cacheFile.empty() && (outOfCore || props.getBoolean("cache",
+				bitmap->getSize().x * bitmap->getSize().y > 1024*1024));
 
 			m_mipmap = new MIPMap(bitmap, ENVMAP_PIXELFORMAT, Bitmap::EFloat,
 				rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::EClamp,
 				filterType, maxAnisotropy, createCache ? scacheFile : fs::pathstr(), timestamp,
 				std::numeric_limits<Float>::infinity(), Spectrum::EIlluminant);
+
+			/* Release the generated pyramid and page it back in from the cache
+			   file (unless the latter could not be created) */
+			if (outOfCore && MIPMap::validateCacheFile(scacheFile, timestamp,
+					ENVMAP_PIXELFORMAT, ReconstructionFilter::ERepeat,
+					ReconstructionFilter::EClamp, filterType, 0)) {
+				bitmap = NULL;
+				delete m_mipmap;
+				m_mipmap = new MIPMap(scacheFile, maxAnisotropy, true);
+			}
 		}
 
 		if (props.hasProperty("intensityScale"))
@@ -266,8 +288,7 @@ public:
 
 		if (!m_rowWeights) {
 			/// Build CDF tables to sample the environment map
-			const MIPMap::Array2DType &array = m_mipmap->getArray();
-			m_size = array.getSize();
+			m_size = m_mipmap->getSize();
 
 			size_t nEntries = (size_t) (m_size.x + 1) * (size_t) m_size.y,
 				totalStorage = sizeof(float) * (m_size.x + 1 + nEntries);
@@ -291,7 +312,7 @@ public:
 
 				m_cdfCols[colPos++] = 0;
 				for (int x=0; x<m_size.x; ++x) {
-					Spectrum value(array(x, y));
+					Spectrum value(m_mipmap->evalTexel(0, x, y));
 
 					colSum += value.getLuminance();
 					m_cdfCols[colPos++] = (float) colSum;
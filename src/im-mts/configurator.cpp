@@ -2,6 +2,8 @@
 #include <mitsuba/render/scene.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/integrator2.h>
+#include <mitsuba/render/shape.h>
+#include <mitsuba/core/track.h>
 #include <imgui.h>
 #include <misc/cpp/imgui_stdlib.h>
 
@@ -202,6 +204,38 @@ namespace impl {
 		};
 		Configuration integrator, film, sensor;
 
+		// movable shapes (instances), edited relative to their loaded transform
+		struct Placement {
+			mitsuba::ref<mitsuba::Shape> shape;
+			mitsuba::ref<const mitsuba::AnimatedTransform> original;
+			double translation[3] = { 0.0, 0.0, 0.0 };
+			double rotation[3] = { 0.0, 0.0, 0.0 };
+			double scale = 1.0;
+			bool modified = false;
+
+			mitsuba::Transform transform() const {
+				using mitsuba::Transform;
+				using mitsuba::Vector;
+				Transform offset = Transform::translate(Vector(translation[0], translation[1], translation[2]))
+					* Transform::rotate(Vector(0, 0, 1), (mitsuba::Float) rotation[2])
+					* Transform::rotate(Vector(0, 1, 0), (mitsuba::Float) rotation[1])
+					* Transform::rotate(Vector(1, 0, 0), (mitsuba::Float) rotation[0])
+					* Transform::scale(Vector((mitsuba::Float) scale));
+				return offset * original->eval(0);
+			}
+
+			bool ui() {
+				bool changes = false;
+				changes |= ImGui::DragScalarN("Translate", ImGuiDataType_Double, translation, 3, .01f);
+				changes |= ImGui::DragScalarN("Rotate", ImGuiDataType_Double, rotation, 3, .5f);
+				changes |= ImGui::DragScalar("Scale", ImGuiDataType_Double, &scale, .01f);
+				modified |= changes;
+				return changes;
+			}
+		};
+		std::vector<Placement> placements;
+		bool placementChanges = false;
+
 		SceneConfigurator(mitsuba::Scene* scene) {
 			this->scene = scene;
 
@@ -212,6 +246,17 @@ namespace impl {
 				if (auto currentFilm = currentSensor->getFilm())
 					this->film.reset(currentFilm->getProperties());
 			}
+
+			// animated transforms are left alone, they would need keyframe editing
+			for (auto& shape : scene->getShapes()) {
+				auto trafo = shape->getWorldTransform();
+				if (!trafo || !trafo->isStatic())
+					continue;
+				Placement p;
+				p.shape = shape;
+				p.original = trafo;
+				this->placements.push_back(p);
+			}
 		}
 
 		bool run() override {
@@ -274,6 +319,23 @@ namespace impl {
 			}
 			haveChanges |= sensor.hadChanges;
 
+			placementChanges = false;
+			if (!placements.empty() && ImGui::BeginTabItem("Instances")) {
+				for (size_t i = 0; i < placements.size(); ++i) {
+					auto& p = placements[i];
+					ImGui::PushID((int) i);
+					std::string name = p.shape->getName();
+					if (ImGui::TreeNode(name.empty() ? "<unnamed>" : name.c_str())) {
+						placementChanges |= p.ui();
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
+				}
+				tabChanges = &placementChanges;
+				ImGui::EndTabItem();
+			}
+			haveChanges |= placementChanges;
+
 			ImGui::EndTabBar();
 
 			if (ImGui::Button("Apply")) {
@@ -290,8 +352,14 @@ namespace impl {
 
 		struct Changes : ::SceneConfigurator::Changes {
 			mitsuba::Properties integrator, film, sensor;
+			std::vector< std::pair<mitsuba::ref<mitsuba::Shape>, mitsuba::Transform> > moves;
 
 			Changes(SceneConfigurator const* configurator) {
+				if (configurator->placementChanges) {
+					for (auto& p : configurator->placements)
+						if (p.modified)
+							moves.emplace_back(p.shape, p.transform());
+				}
 				if (configurator->integrator.hadChanges)
 					integrator = configurator->integrator.createParameters();
 				if (configurator->film.hadChanges)
@@ -301,6 +369,15 @@ namespace impl {
 			}
 
 			void apply(mitsuba::Scene* scene) override {
+				// moving instances only rebuilds the top-level tree, shape group trees are kept
+				if (!moves.empty()) {
+					bool moved = false;
+					for (auto& m : moves)
+						moved |= m.first->setWorldTransform(new mitsuba::AnimatedTransform(m.second));
+					if (moved)
+						scene->refitKDTree();
+				}
+
 				if (!integrator.getPluginName().empty()) {
 					try {
 						mitsuba::ref<mitsuba::ConfigurableObject> newIntegrator
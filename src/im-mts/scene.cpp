@@ -5,6 +5,7 @@
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/thread.h>
+#include <mitsuba/core/workerpool.h>
 #include <mitsuba/core/statistics.h>
 #include <tinyfiledialogs.h>
 #include <cstdlib>
@@ -261,6 +262,9 @@ void register_mitsuba_thread(mitsuba::Thread* parent, char const* name = "im-mts
 #include <random>
 #include <algorithm>
 #include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
 
 #define ATOMIC_SPLAT
 
@@ -280,10 +284,45 @@ namespace impl {
 		std::vector<float volatile*> frambufferData;
 		std::vector<double> sppBase;
 
-		mitsuba::ref_vector<mitsuba::ImageBlock> framebuffersDouble;
-		std::vector<float volatile*> frambufferDataDouble;
+		// triple buffer: the producer fills its back slot and swaps it with the middle slot,
+		// the consumer swaps the middle slot with its front slot whenever a new frame is pending
+		struct FrameChannel {
+			enum { PENDING = 4, INDEX_MASK = 3 };
+			struct Slot {
+				std::vector<float> data;
+				double spp = 0.0;
+				int generation = -1;
+			} slots[3];
+			std::atomic<int> middle{ 1 };
+			int back = 0, front = 2;
+			std::chrono::steady_clock::time_point lastPublish;
+
+			FrameChannel(size_t floatCount) {
+				for (auto& slot : slots)
+					slot.data.resize(floatCount, 0.0f);
+			}
+
+			void publish() {
+				back = middle.exchange(back | PENDING) & INDEX_MASK;
+				lastPublish = std::chrono::steady_clock::now();
+			}
+			bool consume() {
+				if (!(middle.load() & PENDING))
+					return false;
+				front = middle.exchange(front) & INDEX_MASK;
+				return true;
+			}
+			bool pending() const {
+				return (middle.load() & PENDING) != 0;
+			}
+		};
+		std::unique_ptr<FrameChannel> channel;
+		int publishIntervalMS;
+		// bumped before each published frame, workers merge their private tiles when they see a new value
+		std::atomic<int> tileFlushRequest{ 0 };
+		double const volatile* currentSamples = nullptr;
 
-		mitsuba::ref_vector<mitsuba::Thread> workers;
+		mitsuba::WorkerPool workers{ false };
 
 		bool updateSamplersAndIntegrator() {
 			for (auto& s : samplers) {
@@ -308,16 +347,17 @@ namespace impl {
 
 			mitsuba::Vector2i filmSize = scene->getFilm()->getSize();
 
-			for (int i = 0; i < 1 + int(config.doubleBuffered); ++i) {
-				if (i) {
-					swap(this->framebuffersDouble, this->framebuffers);
-					swap(this->frambufferDataDouble, this->frambufferData);
-				}
+			{
 				this->framebuffers.resize(maxThreads);
 #ifdef ATOMIC_SPLAT
-				framebuffers[0] = new mitsuba::ImageBlock(mitsuba::Bitmap::ERGBA, filmSize, scene->getFilm()->getReconstructionFilter());
-				for (int i = 1; i < maxThreads; ++i)
-					framebuffers[i] = framebuffers[0];
+				mitsuba::ref<mitsuba::ImageBlock> sharedTarget = new mitsuba::ImageBlock(mitsuba::Bitmap::ERGBA, filmSize, scene->getFilm()->getReconstructionFilter());
+				for (int i = 0; i < maxThreads; ++i) {
+					// splat through thread-private tiles, merged into the shared target in batches
+					if (config.splatTileSize > 0)
+						framebuffers[i] = new mitsuba::ImageBlock(sharedTarget, config.splatTileSize);
+					else
+						framebuffers[i] = sharedTarget;
+				}
 				this->uniqueTargets = 1;
 #else
 				for (int i = 0; i < maxThreads; ++i)
@@ -332,9 +372,59 @@ namespace impl {
 			}
 			this->imageData = this->frambufferData.data();
 
+			if (config.doubleBuffered) {
+				mitsuba::Bitmap const* bitmap = framebuffers[0]->getBitmap();
+				this->channel.reset(new FrameChannel(bitmap->getPixelCount() * bitmap->getChannelCount()));
+				this->publishIntervalMS = config.publishIntervalMS;
+				this->publishesFrames = true;
+			}
+
 			updateSamplersAndIntegrator();
 		}
 
+		// snapshot all render targets into the back slot and publish it to the preview
+		void publishFrame(int numThreads) {
+			FrameChannel::Slot& slot = channel->slots[channel->back];
+			// stamp before copying, s.t. the snapshot contains at least the stamped samples
+			double spp = 0.0;
+			for (int i = 0; i < numThreads; ++i)
+				spp += currentSamples[i];
+
+			float* dest = slot.data.data();
+			size_t count = slot.data.size();
+			float const* lastData = nullptr;
+			for (int i = 0; i < numThreads; ++i) {
+				float const* data = (float const*) frambufferData[i];
+				if (data == lastData)
+					continue;
+				if (!lastData)
+					memcpy(dest, data, count * sizeof(float));
+				else {
+					for (size_t k = 0; k < count; ++k)
+						dest[k] += data[k];
+				}
+				lastData = data;
+			}
+
+			slot.spp = spp;
+			slot.generation = this->frameGeneration;
+			channel->publish();
+		}
+
+		bool consumeFrame(PublishedFrame& frame) override {
+			if (!channel || !channel->consume())
+				return false;
+			FrameChannel::Slot const& slot = channel->slots[channel->front];
+			frame.data = slot.data.data();
+			frame.spp = slot.spp;
+			frame.generation = slot.generation;
+			return true;
+		}
+
+		bool framePending() const override {
+			return channel && channel->pending();
+		}
+
 		void pause(bool pause) override {
 			{ // lock b/c need to allow atomic check & wait
 				std::lock_guard<std::mutex> lock(this->pause_sync.mutex);
@@ -353,9 +443,14 @@ namespace impl {
 			
 #ifdef ATOMIC_SPLAT
 			this->framebuffers[0]->clear();
+			for (int i = 1; i < numThreads; ++i)
+				if (this->framebuffers[i]->hasTiles())
+					this->framebuffers[i]->discardTiles();
 #endif
 			// Update synchronized in order to ensure consecutive sharing
 			this->imageData = this->frambufferData.data();
+			this->currentSamples = imageSamples;
+			++this->frameGeneration;
 
 			mitsuba::Statistics::getInstance()->resetAll();
 
@@ -377,17 +472,40 @@ namespace impl {
 				struct Interrupt : mitsuba::ResponsiveIntegrator::Interrupt {
 					struct InterruptM {
 						InteractiveSceneProcess* proc;
+						mitsuba::ImageBlock* block;
 						double volatile& sppTarget;
 						double sppBase;
+						int tileFlushSeen;
 					} m;
 					Interrupt(InterruptM const & m) : m(m) { }
 
 					int progress(mitsuba::ResponsiveIntegrator* integrator, const mitsuba::Scene &scene, const mitsuba::Sensor &sensor, mitsuba::Sampler &sampler, mitsuba::ImageBlock& target, double spp
 						, mitsuba::ResponsiveIntegrator::Controls controls, int threadIdx, int threadCount) override {
+						// evicted tiles are merged by the splatting view, the rest only when a new frame is published
+						int flushRequest = m.proc->tileFlushRequest.load(std::memory_order_acquire);
+						if (flushRequest != m.tileFlushSeen) {
+							m.tileFlushSeen = flushRequest;
+							if (m.block->hasTiles())
+								m.block->flushTiles();
+						}
 						if (spp)
 							m.sppTarget = spp + m.sppBase;
 
+						if (threadIdx == 0 && m.proc->channel) {
+							auto sincePublish = std::chrono::steady_clock::now() - m.proc->channel->lastPublish;
+							if (sincePublish >= std::chrono::milliseconds(m.proc->publishIntervalMS) || m.proc->paused) {
+								// other workers merge their tiles on their next progress report, i.e. in time for the next frame
+								m.tileFlushSeen = m.proc->tileFlushRequest.fetch_add(1, std::memory_order_release) + 1;
+								if (m.block->hasTiles())
+									m.block->flushTiles();
+								m.proc->publishFrame(threadCount);
+							}
+						}
+
 						if (m.proc->paused) {
+							// keep the framebuffer complete while idle
+							if (m.block->hasTiles())
+								m.block->flushTiles();
 							std::unique_lock<std::mutex> lock(m.proc->pause_sync.mutex);
 							while (m.proc->paused && !(controls.continu && !*controls.continu) && !(controls.abort && *controls.abort))
 								m.proc->pause_sync.condition.wait(lock);
@@ -395,7 +513,7 @@ namespace impl {
 
 						return 0;
 					}
-				} interrupt = { { this, spp, sppBase } };
+				} interrupt = { { this, block, spp, sppBase, this->tileFlushRequest.load(std::memory_order_relaxed) } };
 
 				struct mitsuba::ResponsiveIntegrator::Controls icontrols = {
 					controls.continu,
@@ -406,31 +524,12 @@ namespace impl {
 				int rc = this->integrator->render(*this->scene, *sensor, *sampler, *block, icontrols, tid, numThreads);
 				if (rc)
 					returnCode = rc;
+				if (block->hasTiles())
+					block->flushTiles();
 
 				// end of parallel execution
 			};
 
-			// build on mitsuba infrastructure instead of OpenMP b/c for classic mitsuba thread-local support etc.
-			if (numThreads > (int) workers.size())
-				workers.resize(numThreads);
-			for (int i = 0; i < numThreads; ++i) {
-				typedef decltype(parallel_execution) par_exe;
-				struct Thread : mitsuba::Thread {
-					int tid;
-					par_exe* parallel_execution;
-					Thread(int tid, par_exe* parallel_execution)
-						: mitsuba::Thread("interactive")
-						, tid(tid)
-						, parallel_execution(parallel_execution) { }
-					void run() override {
-						(*parallel_execution)(tid);
-					}
-				};
-				if (auto* w = workers[i].get())
-					((Thread*) w)->parallel_execution = &parallel_execution;
-				else
-					workers[i] = new Thread(i, &parallel_execution);
-			}
 
 			bool moreRounds = true;
 			int scramble = 0;
@@ -442,12 +541,10 @@ namespace impl {
 				else
 					std::copy_n(imageSamples, numThreads, this->sppBase.begin());
 
-				for (int i = 0; i < numThreads; ++i) {
-					workers[i]->start();
-				}
-				for (int i = numThreads; i-- > 0; ) {
-					workers[i]->join();
-				}
+				this->integrator->prepareFrame(numThreads);
+				workers.run(numThreads, parallel_execution);
+				if (initialRun)
+					this->restartLatency = workers.getRestartLatency();
 
 				initialRun = false;
 				moreRounds = (returnCode == 0);
@@ -460,15 +557,13 @@ namespace impl {
 				}
 			}
 
-			// don't change the contents until next samples are ready, if double buffered
-			if (!framebuffersDouble.empty()) {
+			// publish the final state, the preview keeps it while the next frame is cleared & rendered
+			if (channel) {
 				bool hadRevisions = false;
 				for (int i = 0; i < numThreads; ++i)
 					hadRevisions |= bool(imageSamples[i]);
-				if (hadRevisions) {
-					swap(framebuffers, framebuffersDouble);
-					swap(frambufferData, frambufferDataDouble);
-				}
+				if (hadRevisions)
+					publishFrame(numThreads);
 			}
 		}
 	};
@@ -120,6 +120,7 @@ struct Document {
 			std::unique_ptr<InteractiveSceneProcess> process;
 			std::vector<double> samples;
 			std::unique_ptr<StackedPreview> preview;
+			InteractiveSceneProcess::PublishedFrame frame;
 			float exposureMultiplier[4];
 			double baseTime = 0;
 
@@ -128,7 +129,10 @@ struct Document {
 			Integration(mitsuba::Scene* scene, ProcessConfig const& config) {
 				process.reset( process->create(scene, scene->getSampler(), scene->getIntegrator(), config) );
 				samples.resize(process->maxThreads);
-				preview.reset( preview->create(process->resolution.x, process->resolution.y, process->maxThreads, process->uniqueTargets) );
+				if (process->publishesFrames)
+					preview.reset( preview->create(process->resolution.x, process->resolution.y, 1, 1) );
+				else
+					preview.reset( preview->create(process->resolution.x, process->resolution.y, process->maxThreads, process->uniqueTargets) );
 			}
 
 			void switchFrame() {
@@ -141,15 +145,31 @@ struct Document {
 				preview->runGeneration( programTimeStamp() );
 				process->render(sensor, samples.data(), controls);
 
+				// give the preview a chance to pick up the final state of the frame
 				int waitCounter = 0;
-				while (!preview->upToDate((float const* const*) process->imageData, samples.data(), (int) samples.size()) && waitCounter < 160) {
+				while (!previewUpToDate() && waitCounter < 160) {
 					waitCounter += std::min(std::max(waitCounter, 5), 16);
 					WorkLane::sleep(waitCounter);
 				}
 			}
 
+			bool previewUpToDate() const {
+				if (process->publishesFrames)
+					return !process->framePending();
+				return preview->upToDate((float const* const*) process->imageData, samples.data(), (int) samples.size());
+			}
+
 			void updatePreview() {
-				preview->update(programTimeStamp(), (float const* const*) process->imageData, samples.data(), (int) samples.size());
+				if (process->publishesFrames) {
+					// never blocks, published frames are owned by the preview until the next swap
+					bool newFrame = process->consumeFrame(frame);
+					// re-upload only frames that the preview held back for its update interval
+					if (frame.data && frame.generation == process->frameGeneration
+						&& (newFrame || !preview->upToDate(&frame.data, &frame.spp, 1)))
+						preview->update(programTimeStamp(), &frame.data, &frame.spp, 1);
+				}
+				else
+					preview->update(programTimeStamp(), (float const* const*) process->imageData, samples.data(), (int) samples.size());
 			}
 
 			double timeSeconds() const {
@@ -777,6 +797,7 @@ void run(int argc, char** argv, Window window, ImGuiContext* ui_context) {
 					, spp
 					, sppPerS
 					, document->renderer.integration.process ? document->renderer.integration.process->numActiveThreads : 0 );
+				ImGui::Text("Restart latency: %.3f ms", document->renderer.integration.process->restartLatency);
 				if (mitsuba::ResponsiveIntegrator* igr = document->renderer.integration.process->integrator) {
 					if (char const* stats = igr->getRealtimeStatistics())
 						ImGui::Text("Stats: %s", stats);
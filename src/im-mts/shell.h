@@ -7,6 +7,10 @@ struct ProcessConfig {
 	int concurrentAtomic = 32;
 	int maxThreads = -1;
 	int doubleBuffered = 1;
+	// minimum interval between frames published to the preview, if double buffered
+	int publishIntervalMS = 16;
+	// edge length of thread-private splatting tiles, 0 splats directly into shared framebuffers
+	int splatTileSize = 0;
 
 	static int recommendedThreads();
 	static ProcessConfig resolveDefaults(ProcessConfig const& cfg);
@@ -81,6 +85,19 @@ struct InteractiveSceneProcess {
 	float volatile* *volatile imageData;
 	int numActiveThreads;
 	int volatile paused;
+	// milliseconds from waking the parked workers to the first worker rendering the last frame
+	float restartLatency = 0.0f;
+
+	// snapshot of the accumulated image, published through a triple-buffered channel
+	struct PublishedFrame {
+		float const* data = nullptr;
+		double spp = 0.0;
+		int generation = -1;
+	};
+	// if set, consume published frames instead of reading the live imageData
+	bool publishesFrames = false;
+	// incremented whenever rendering restarts from scratch
+	int volatile frameGeneration = 0;
 
 	static InteractiveSceneProcess* create(mitsuba::Scene* scene, mitsuba::Sampler* sampler, mitsuba::ResponsiveIntegrator* integrator, ProcessConfig const& config);
 	static InteractiveSceneProcess* create(mitsuba::Scene* scene, mitsuba::Sampler* sampler, mitsuba::Integrator* integrator, ProcessConfig const& config);
@@ -92,6 +109,11 @@ struct InteractiveSceneProcess {
 	};
 	virtual void render(mitsuba::Sensor* sensor, double volatile imageSamples[], Controls controls, int maxThreads = -1) = 0;
 	virtual void pause(bool pause) = 0;
+
+	// swap in the most recently published frame, returns false if there was none pending (never blocks)
+	virtual bool consumeFrame(PublishedFrame& frame) = 0;
+	// has a frame been published that was not consumed yet?
+	virtual bool framePending() const = 0;
 };
 
 struct Preview {
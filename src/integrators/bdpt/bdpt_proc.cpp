@@ -30,10 +30,14 @@ MTS_NAMESPACE_BEGIN
 
 class BDPTRenderer : public WorkProcessor {
 public:
-	BDPTRenderer(const BDPTConfiguration &config) : m_config(config) { }
+	BDPTRenderer(const BDPTConfiguration &config) : m_config(config) {
+		m_pool.setArenaMode(true);
+	}
 
 	BDPTRenderer(Stream *stream, InstanceManager *manager)
-		: WorkProcessor(stream, manager), m_config(stream) { }
+		: WorkProcessor(stream, manager), m_config(stream) {
+		m_pool.setArenaMode(true);
+	}
 
 	virtual ~BDPTRenderer() { }
 
@@ -124,8 +128,10 @@ public:
 
 				evaluate(result, emitterSubpath, sensorSubpath);
 
+				/* Return all vertices and edges of this sample at once */
 				emitterSubpath.release(m_pool);
 				sensorSubpath.release(m_pool);
+				m_pool.reset();
 
 				m_sampler->advance();
 			}
@@ -191,6 +197,7 @@ public:
 
 				emitterSubpath.release(m_pool);
 				sensorSubpath.release(m_pool);
+				m_pool.reset();
 			}
 		};
 		std::vector<State> m_state;
@@ -264,6 +271,15 @@ public:
 		Spectrum *importanceWeights = (Spectrum *) alloca(emitterSubpath.vertexCount() * sizeof(Spectrum)),
 				 *radianceWeights  = (Spectrum *) alloca(sensorSubpath.vertexCount()  * sizeof(Spectrum));
 
+		/* Flat copies of the vertex flags, which allow the connection loop
+		   to reject most degenerate strategies without touching the vertices */
+		bool *emitterDegenerate = (bool *) alloca(emitterSubpath.vertexCount() * sizeof(bool)),
+			 *sensorDegenerate  = (bool *) alloca(sensorSubpath.vertexCount()  * sizeof(bool));
+		for (size_t i=0; i<emitterSubpath.vertexCount(); ++i)
+			emitterDegenerate[i] = emitterSubpath.vertex(i)->isDegenerate();
+		for (size_t i=0; i<sensorSubpath.vertexCount(); ++i)
+			sensorDegenerate[i] = sensorSubpath.vertex(i)->isDegenerate();
+
 		importanceWeights[0] = radianceWeights[0] = Spectrum(1.0f);
 		for (size_t i=1; i<emitterSubpath.vertexCount(); ++i)
 			importanceWeights[i] = importanceWeights[i-1] *
@@ -336,7 +352,7 @@ public:
 				} else if (m_config.sampleDirect && ((t == 1 && s > 1) || (s == 1 && t > 1))) {
 					/* s==1/t==1 path: use a direct sampling strategy if requested */
 					if (s == 1) {
-						if (vt->isDegenerate())
+						if (sensorDegenerate[t])
 							continue;
 						/* Generate a position on an emitter using direct sampling */
 						value = radianceWeights[t] * vt->sampleDirect(scene, m_sampler,
@@ -347,7 +363,7 @@ public:
 						value *= vt->eval(scene, vtPred, vs, ERadiance);
 						vt->measure = EArea;
 					} else {
-						if (vs->isDegenerate())
+						if (emitterDegenerate[s])
 							continue;
 						/* Generate a position on the sensor using direct sampling */
 						value = importanceWeights[s] * vs->sampleDirect(scene, m_sampler,
@@ -362,7 +378,7 @@ public:
 					sampleDirect = true;
 				} else {
 					/* Can't connect degenerate endpoints */
-					if (vs->isDegenerate() || vt->isDegenerate())
+					if (emitterDegenerate[s] || sensorDegenerate[t])
 						continue;
 
 					value = importanceWeights[s] * radianceWeights[t] *
@@ -18,6 +18,9 @@
 
 #include <mitsuba/render/scene.h>
 
+/// Number of emitter sampling shadow rays that are traced together
+#define MTS_DIRECT_SHADOW_BATCH 16
+
 MTS_NAMESPACE_BEGIN
 
 /*! \plugin{direct}{Direct illumination integrator}
@@ -216,10 +219,16 @@ public:
 		DirectSamplingRecord dRec(its);
 		if (bsdf->getType() & BSDF::ESmooth) {
 			/* Only use direct illumination sampling when the surface's
-			   BSDF has smooth (i.e. non-Dirac delta) component */
+			   BSDF has smooth (i.e. non-Dirac delta) component. Shadow
+			   rays of nonzero contributions are traced in batches. */
+			Ray shadowRays[MTS_DIRECT_SHADOW_BATCH];
+			Spectrum contributions[MTS_DIRECT_SHADOW_BATCH];
+			bool occluded[MTS_DIRECT_SHADOW_BATCH];
+			size_t pending = 0;
+
 			for (size_t i=0; i<numDirectSamples; ++i) {
 				/* Estimate the direct illumination if this is requested */
-				Spectrum value = scene->sampleEmitterDirect(dRec, sampleArray[i]);
+				Spectrum value = scene->sampleEmitterDirect(dRec, sampleArray[i], false);
 				if (!value.isZero()) {
 					const Emitter *emitter = static_cast<const Emitter *>(dRec.object);
 
@@ -238,8 +247,19 @@ public:
 						const Float weight = miWeight(dRec.pdf * fracLum,
 								bsdfPdf * fracBSDF) * weightLum;
 
-						Li += value * bsdfVal * weight;
+						shadowRays[pending] = Ray(dRec.ref, dRec.d, Epsilon,
+							dRec.dist*(1-ShadowEpsilon), dRec.time);
+						contributions[pending++] = value * bsdfVal * weight;
+					}
+				}
+
+				if (pending == MTS_DIRECT_SHADOW_BATCH || (pending > 0 && i+1 == numDirectSamples)) {
+					scene->rayIntersectBatch(shadowRays, occluded, pending);
+					for (size_t j=0; j<pending; ++j) {
+						if (!occluded[j])
+							Li += contributions[j];
 					}
+					pending = 0;
 				}
 			}
 		}
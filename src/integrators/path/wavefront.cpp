@@ -0,0 +1,571 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/scene.h>
+#include <mitsuba/render/integrator2.h>
+#include <mitsuba/render/imageblock.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/atomic.h>
+#include <mitsuba/core/statistics.h>
+#include <algorithm>
+#include <memory>
+
+MTS_NAMESPACE_BEGIN
+
+static StatsCounter avgPathLength("Wavefront path tracer", "Average path length", EAverage);
+
+/*! \plugin{wavefront}{Wavefront path tracer}
+ * \order{3}
+ * \parameters{
+ *     \parameter{maxDepth}{\Integer}{Specifies the longest path depth
+ *         in the generated output image (where \code{-1} corresponds to $\infty$).
+ *	       \default{\code{-1}}
+ *	   }
+ *	   \parameter{rrDepth}{\Integer}{Specifies the minimum path depth, after
+ *	      which the implementation will start to use the ``russian roulette''
+ *	      path termination criterion. \default{\code{5}}
+ *	   }
+ *     \parameter{strictNormals}{\Boolean}{Be strict about potential
+ *        inconsistencies involving shading normals?
+ *        \default{no, i.e. \code{false}}
+ *     }
+ *     \parameter{hideEmitters}{\Boolean}{Hide directly visible emitters?
+ *        \default{no, i.e. \code{false}}
+ *     }
+ *     \parameter{waveSize}{\Integer}{Number of paths that every rendering
+ *        thread advances together \default{\code{4096}}
+ *     }
+ * }
+ *
+ * This integrator computes the same estimate as \pluginref{path}, but
+ * instead of following one path at a time, every rendering thread collects
+ * a \emph{wave} of camera paths and advances all of them stage by stage:
+ * the next vertices of all paths are found by one batched intersection query
+ * (\emph{extend}), the paths are then shaded in groups of equal BSDFs
+ * (\emph{shade}), all emitter sampling shadow rays are tested together
+ * (\emph{shadow}), and terminated paths are finally splatted into the
+ * image (\emph{accumulate}). The path state is kept in structure-of-arrays
+ * queues per thread, and the throughput of every stage is reported in the
+ * realtime statistics of the interactive viewer.
+ *
+ * Camera ray dimensions are drawn from the scene's sampler; the random
+ * numbers of all subsequent bounces come from an independent sampler, since
+ * the paths of a wave are interleaved. The integrator is only available
+ * through the responsive rendering interface.
+ *
+ * \remarks{
+ *    \item This integrator does not handle participating media
+ * }
+ */
+
+/// Parameters shared by the plugin and its responsive implementation
+struct WavefrontConfiguration {
+	int maxDepth, rrDepth;
+	bool strictNormals, hideEmitters;
+	int waveSize;
+};
+
+class WavefrontResponsive : public ImageOrderIntegrator {
+public:
+	enum EStage {
+		EExtend = 0,
+		EShade,
+		EShadow,
+		EAccumulate,
+		EStageCount
+	};
+
+	/// Queue of paths of one thread in structure-of-arrays layout
+	struct Wave {
+		enum EFlags {
+			/// The next vertex is directly visible from the sensor
+			EPrimary    = 0x01,
+			/// A non-null BSDF component has been sampled
+			EScattered  = 0x02,
+			/// The last BSDF sample was a Dirac delta
+			EDelta      = 0x04,
+			/// The path is complete and awaits splatting
+			ETerminated = 0x08
+		};
+
+		/* Path state, compacted after every bounce */
+		size_t size;
+		std::vector<RayDifferential> rays;
+		std::vector<Spectrum> weight, throughput, radiance;
+		std::vector<Point2> samplePos;
+		std::vector<Float> eta, bsdfPdf, alpha;
+		std::vector<int> depth;
+		std::vector<uint8_t> flags;
+		std::vector<DirectSamplingRecord> dRecs;
+
+		/* Scratch storage of the individual stages */
+		std::vector<Ray> extendRays;
+		std::vector<Intersection> its;
+		std::vector<const BSDF *> bsdfs;
+		std::vector<uint32_t> shadeOrder;
+		size_t shadowCount;
+		std::vector<Ray> shadowRays;
+		std::vector<Spectrum> shadowValues;
+		std::vector<uint32_t> shadowPaths;
+		std::unique_ptr<bool[]> occluded;
+
+		ref<Sampler> sampler;
+		ref<Timer> timer;
+		size_t enqueued;
+
+		Wave(size_t capacity, Sampler *sampler)
+			: size(0), rays(capacity), weight(capacity), throughput(capacity),
+			  radiance(capacity), samplePos(capacity), eta(capacity),
+			  bsdfPdf(capacity), alpha(capacity), depth(capacity),
+			  flags(capacity), dRecs(capacity), extendRays(capacity),
+			  its(capacity), bsdfs(capacity), shadeOrder(capacity),
+			  shadowCount(0), shadowRays(capacity), shadowValues(capacity),
+			  shadowPaths(capacity), occluded(new bool[capacity]),
+			  sampler(sampler), timer(new Timer(false)), enqueued(0) { }
+
+		/// Move the state of a path to another slot
+		inline void move(size_t from, size_t to) {
+			rays[to] = rays[from];
+			weight[to] = weight[from];
+			throughput[to] = throughput[from];
+			radiance[to] = radiance[from];
+			samplePos[to] = samplePos[from];
+			eta[to] = eta[from];
+			bsdfPdf[to] = bsdfPdf[from];
+			alpha[to] = alpha[from];
+			depth[to] = depth[from];
+			flags[to] = flags[from];
+			dRecs[to] = dRecs[from];
+		}
+	};
+
+	/// Forwards progress reports, counting only the samples that were splatted
+	struct WaveInterrupt : Interrupt {
+		Interrupt *forward;
+		Wave *wave;
+		double planeSamples, spp;
+
+		int progress(ResponsiveIntegrator* integrator, const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, double spp
+			, Controls controls, int threadIdx, int threadCount) override {
+			this->spp = spp;
+			wave->enqueued = 0;
+			double splatted = spp - (double) wave->size / planeSamples;
+			return forward->progress(integrator, scene, sensor, sampler, target,
+				splatted > 0 ? splatted : 0.0, controls, threadIdx, threadCount);
+		}
+	};
+
+	WavefrontResponsive(Integrator *integrator, const WavefrontConfiguration *config)
+		: ImageOrderIntegrator(integrator->getProperties()),
+		  m_integrator(integrator), m_config(config), m_pixelDifferential(1) {
+		m_independentSampler = static_cast<Sampler *> (PluginManager::getInstance()->
+			createObject(MTS_CLASS(Sampler), Properties("independent")));
+		m_independentSampler->configure();
+		for (int i=0; i<EStageCount; ++i)
+			m_stageItems[i] = m_stageTime[i] = 0;
+	}
+
+	bool preprocess(const Scene *scene, const Sensor* sensor, const Sampler* sampler) override {
+		m_pixelDifferential = PixelDifferential((int) sampler->getSampleCount());
+		return true;
+	}
+
+	bool allocate(const Scene &scene, Sampler *const *samplers, ImageBlock *const *targets, int threadCount) override {
+		bool result = ImageOrderIntegrator::allocate(scene, samplers, targets, threadCount);
+
+		m_waves.clear();
+		for (int i = 0; i < threadCount; ++i) {
+			ref<Sampler> sampler = m_independentSampler->clone();
+			sampler->generate(Point2i(-1));
+			m_waves.push_back(std::unique_ptr<Wave>(new Wave(m_config->waveSize, sampler)));
+		}
+		for (int i=0; i<EStageCount; ++i)
+			m_stageItems[i] = m_stageTime[i] = 0;
+
+		return result;
+	}
+
+	char const* getRealtimeStatistics() override {
+		static const char *names[EStageCount] = { "extend", "shade", "shadow", "accumulate" };
+		char *pos = m_statisticsBuffer;
+		for (int i=0; i<EStageCount; ++i) {
+			/* Items per microsecond of thread time, i.e. millions per second */
+			double rate = m_stageTime[i] > 0 ? (double) m_stageItems[i] / (m_stageTime[i] * 1e-3) : 0.0;
+			pos += sprintf(pos, "%s%s %.1f", i > 0 ? ", " : "", names[i], rate);
+		}
+		sprintf(pos, " M/s per thread (wave %d)", m_config->waveSize);
+		return m_statisticsBuffer;
+	}
+
+	int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target
+		, Controls controls, int threadIdx, int threadCount) override {
+#if defined(MTS_DEBUG_FP)
+		enableFPExceptions();
+#endif
+		Wave &wave = *m_waves[threadIdx];
+		wave.size = wave.enqueued = 0;
+
+		Vector2i resolution = target.getBitmap()->getSize();
+		WaveInterrupt interrupt;
+		interrupt.forward = controls.interrupt;
+		interrupt.wave = &wave;
+		interrupt.planeSamples = (double) resolution.x * resolution.y;
+		interrupt.spp = 0;
+
+		Controls waveControls = controls;
+		if (controls.interrupt)
+			waveControls.interrupt = &interrupt;
+
+		int returnCode = ImageOrderIntegrator::render(scene, sensor, sampler, target, waveControls, threadIdx, threadCount);
+
+		/* Complete the partial wave unless the frame was abandoned */
+		if (returnCode == 0 && wave.size > 0) {
+			trace(scene, target, wave);
+			if (controls.interrupt)
+				returnCode = controls.interrupt->progress(this, scene, sensor, sampler, target,
+					interrupt.spp + (double) wave.enqueued / interrupt.planeSamples, controls, threadIdx, threadCount);
+		}
+		wave.size = 0;
+
+#if defined(MTS_DEBUG_FP)
+		disableFPExceptions();
+#endif
+		return returnCode;
+	}
+
+	/// Start a camera path and run the stages once the wave is full
+	int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, Point2i pixel, int threadIdx, int threadCount) override {
+		Wave &wave = *m_waves[threadIdx];
+		size_t i = wave.size++;
+
+		PixelSample pxSample;
+		wave.weight[i] = m_pixelDifferential.sample(pxSample, sensor, pixel, sampler);
+		wave.rays[i] = pxSample.ray;
+		wave.samplePos[i] = pxSample.point;
+		wave.throughput[i] = Spectrum(1.0f);
+		wave.radiance[i] = Spectrum(0.0f);
+		wave.eta[i] = 1.0f;
+		wave.bsdfPdf[i] = 0.0f;
+		wave.alpha[i] = 0.0f;
+		wave.depth[i] = 1;
+		wave.flags[i] = Wave::EPrimary;
+		++wave.enqueued;
+
+		if (wave.size == (size_t) m_config->waveSize)
+			trace(scene, target, wave);
+		return 0;
+	}
+
+	/// Advance all paths of a wave until they have terminated
+	void trace(const Scene &scene, ImageBlock &target, Wave &wave) {
+		const WavefrontConfiguration &config = *m_config;
+		uint64_t items[EStageCount] = { 0 }, time[EStageCount] = { 0 };
+		Sampler *sampler = wave.sampler;
+
+		wave.timer->reset();
+		uint64_t last = 0;
+		auto stageEnd = [&](EStage stage, size_t count) {
+			uint64_t now = wave.timer->getNanosecondsSinceStart();
+			time[stage] += now - last;
+			items[stage] += count;
+			last = now;
+		};
+
+		while (wave.size > 0) {
+			const size_t size = wave.size;
+
+			/* ==================================================================== */
+			/*                     Extend: find the next vertices                   */
+			/* ==================================================================== */
+			for (size_t i=0; i<size; ++i)
+				wave.extendRays[i] = wave.rays[i];
+			scene.rayIntersectBatch(&wave.extendRays[0], &wave.its[0], size);
+			stageEnd(EExtend, size);
+
+			/* ==================================================================== */
+			/*           Shade: emission, then materials in BSDF order              */
+			/* ==================================================================== */
+			size_t shadeCount = 0;
+			for (size_t i=0; i<size; ++i) {
+				const RayDifferential &ray = wave.rays[i];
+				Intersection &its = wave.its[i];
+				uint8_t &flags = wave.flags[i];
+
+				if (flags & Wave::EPrimary) {
+					wave.alpha[i] = its.isValid() ? 1.0f : 0.0f;
+					if (!its.isValid()) {
+						if (!config.hideEmitters)
+							wave.radiance[i] += wave.throughput[i] * scene.evalEnvironment(ray);
+						flags |= Wave::ETerminated;
+						continue;
+					}
+					if (its.isEmitter() && !config.hideEmitters)
+						wave.radiance[i] += wave.throughput[i] * its.Le(-ray.d);
+				} else {
+					/* Vertex found by BSDF sampling: weight emission using the power heuristic */
+					DirectSamplingRecord &dRec = wave.dRecs[i];
+					bool hitEmitter = false;
+					Spectrum value;
+					if (its.isValid()) {
+						if (its.isEmitter()) {
+							value = its.Le(-ray.d);
+							dRec.setQuery(ray, its);
+							hitEmitter = true;
+						}
+					} else {
+						const Emitter *env = scene.getEnvironmentEmitter();
+						if (env && !(config.hideEmitters && !(flags & Wave::EScattered))) {
+							value = env->evalEnvironment(ray);
+							hitEmitter = env->fillDirectSamplingRecord(dRec, ray);
+						}
+					}
+
+					if (hitEmitter) {
+						const Float lumPdf = !(flags & Wave::EDelta) ?
+							scene.pdfEmitterDirect(dRec) : 0;
+						wave.radiance[i] += wave.throughput[i] * value * miWeight(wave.bsdfPdf[i], lumPdf);
+					}
+
+					if (!its.isValid()) {
+						flags |= Wave::ETerminated;
+						continue;
+					}
+
+					if (wave.depth[i]++ >= config.rrDepth) {
+						/* Russian roulette, as in the 'path' plugin */
+						Float q = std::min(wave.throughput[i].max() * wave.eta[i] * wave.eta[i], (Float) 0.95f);
+						if (sampler->next1D() >= q) {
+							flags |= Wave::ETerminated;
+							continue;
+						}
+						wave.throughput[i] /= q;
+					}
+				}
+
+				/* Include radiance from a subsurface scattering model */
+				if (its.hasSubsurface())
+					wave.radiance[i] += wave.throughput[i] * its.LoSub(&scene, sampler, -ray.d, wave.depth[i]);
+
+				if ((wave.depth[i] >= config.maxDepth && config.maxDepth > 0)
+					|| (config.strictNormals && dot(ray.d, its.geoFrame.n)
+						* Frame::cosTheta(its.wi) >= 0)) {
+					flags |= Wave::ETerminated;
+					continue;
+				}
+
+				wave.bsdfs[i] = its.getBSDF(ray);
+				wave.shadeOrder[shadeCount++] = (uint32_t) i;
+			}
+
+			/* Group the paths by material to keep the BSDF code paths coherent */
+			std::sort(wave.shadeOrder.begin(), wave.shadeOrder.begin() + shadeCount,
+				[&wave](uint32_t a, uint32_t b) {
+					return std::less<const BSDF *>()(wave.bsdfs[a], wave.bsdfs[b]);
+				});
+
+			wave.shadowCount = 0;
+			for (size_t k=0; k<shadeCount; ++k) {
+				const uint32_t i = wave.shadeOrder[k];
+				const BSDF *bsdf = wave.bsdfs[i];
+				const Intersection &its = wave.its[i];
+				uint8_t &flags = wave.flags[i];
+
+				/* Direct illumination sampling: queue a shadow ray */
+				DirectSamplingRecord &dRec = wave.dRecs[i];
+				dRec = DirectSamplingRecord(its);
+				if (bsdf->getType() & BSDF::ESmooth) {
+					Spectrum value = scene.sampleEmitterDirect(dRec, sampler->next2D(), false);
+					if (!value.isZero()) {
+						const Emitter *emitter = static_cast<const Emitter *>(dRec.object);
+						BSDFSamplingRecord bRec(its, its.toLocal(dRec.d), ERadiance);
+						const Spectrum bsdfVal = bsdf->eval(bRec);
+
+						if (!bsdfVal.isZero() && (!config.strictNormals
+								|| dot(its.geoFrame.n, dRec.d) * Frame::cosTheta(bRec.wo) > 0)) {
+							Float bsdfPdf = (emitter->isOnSurface() && dRec.measure == ESolidAngle)
+								? bsdf->pdf(bRec) : 0;
+							size_t j = wave.shadowCount++;
+							wave.shadowRays[j] = Ray(dRec.ref, dRec.d, Epsilon,
+								dRec.dist*(1-ShadowEpsilon), dRec.time);
+							wave.shadowValues[j] = wave.throughput[i] * value * bsdfVal
+								* miWeight(dRec.pdf, bsdfPdf);
+							wave.shadowPaths[j] = i;
+						}
+					}
+				}
+
+				/* BSDF sampling: set up the extension ray */
+				Float bsdfPdf;
+				BSDFSamplingRecord bRec(its, sampler, ERadiance);
+				Spectrum bsdfWeight = bsdf->sample(bRec, bsdfPdf, sampler->next2D());
+				if (bsdfWeight.isZero()) {
+					flags |= Wave::ETerminated;
+					continue;
+				}
+
+				const Vector wo = its.toWorld(bRec.wo);
+				Float woDotGeoN = dot(its.geoFrame.n, wo);
+				if (config.strictNormals && woDotGeoN * Frame::cosTheta(bRec.wo) <= 0) {
+					flags |= Wave::ETerminated;
+					continue;
+				}
+
+				if (bRec.sampledType != BSDF::ENull)
+					flags |= Wave::EScattered;
+				if (bRec.sampledType & BSDF::EDelta)
+					flags |= Wave::EDelta;
+				else
+					flags &= ~Wave::EDelta;
+				flags &= ~Wave::EPrimary;
+
+				wave.rays[i] = RayDifferential(its.p, wo, wave.rays[i].time);
+				wave.throughput[i] *= bsdfWeight;
+				wave.eta[i] *= bRec.eta;
+				wave.bsdfPdf[i] = bsdfPdf;
+			}
+			stageEnd(EShade, shadeCount);
+
+			/* ==================================================================== */
+			/*                  Shadow: test all queued shadow rays                 */
+			/* ==================================================================== */
+			if (wave.shadowCount > 0) {
+				scene.rayIntersectBatch(&wave.shadowRays[0], wave.occluded.get(), wave.shadowCount);
+				for (size_t j=0; j<wave.shadowCount; ++j) {
+					if (!wave.occluded[j])
+						wave.radiance[wave.shadowPaths[j]] += wave.shadowValues[j];
+				}
+			}
+			stageEnd(EShadow, wave.shadowCount);
+
+			/* ==================================================================== */
+			/*            Accumulate: splat finished paths, compact the rest        */
+			/* ==================================================================== */
+			size_t alive = 0, finished = 0;
+			for (size_t i=0; i<size; ++i) {
+				if (wave.flags[i] & Wave::ETerminated) {
+					Spectrum value = wave.weight[i] * wave.radiance[i];
+#ifndef MTS_NO_ATOMIC_SPLAT
+					target.putAtomic(wave.samplePos[i], value, wave.alpha[i]);
+#else
+					target.put(wave.samplePos[i], value, wave.alpha[i]);
+#endif
+					avgPathLength.incrementBase();
+					avgPathLength += wave.depth[i];
+					++finished;
+				} else {
+					if (alive != i)
+						wave.move(i, alive);
+					++alive;
+				}
+			}
+			wave.size = alive;
+			stageEnd(EAccumulate, finished);
+		}
+
+		for (int i=0; i<EStageCount; ++i) {
+			atomicAdd(&m_stageItems[i], (int64_t) items[i]);
+			atomicAdd(&m_stageTime[i], (int64_t) time[i]);
+		}
+	}
+
+	inline Float miWeight(Float pdfA, Float pdfB) const {
+		pdfA *= pdfA;
+		pdfB *= pdfB;
+		return pdfA / (pdfA + pdfB);
+	}
+
+protected:
+	ref<Integrator> m_integrator;
+	const WavefrontConfiguration *m_config;
+	PixelDifferential m_pixelDifferential;
+	ref<Sampler> m_independentSampler;
+	std::vector<std::unique_ptr<Wave> > m_waves;
+	volatile int64_t m_stageItems[EStageCount], m_stageTime[EStageCount];
+	char m_statisticsBuffer[256];
+};
+
+class WavefrontPathTracer : public Integrator {
+public:
+	WavefrontPathTracer(const Properties &props) : Integrator(props) {
+		m_config.maxDepth = props.getInteger("maxDepth", -1);
+		m_config.rrDepth = props.getInteger("rrDepth", 5);
+		m_config.strictNormals = props.getBoolean("strictNormals", false);
+		m_config.hideEmitters = props.getBoolean("hideEmitters", false);
+		m_config.waveSize = props.getInteger("waveSize", 4096);
+
+		if (m_config.rrDepth <= 0)
+			Log(EError, "'rrDepth' must be set to a value greater than zero!");
+		if (m_config.maxDepth <= 0 && m_config.maxDepth != -1)
+			Log(EError, "'maxDepth' must be set to -1 (infinite) or a value greater than zero!");
+		if (m_config.waveSize <= 0)
+			Log(EError, "'waveSize' must be set to a value greater than zero!");
+	}
+
+	/// Unserialize from a binary data stream
+	WavefrontPathTracer(Stream *stream, InstanceManager *manager)
+		: Integrator(stream, manager) {
+		m_config.maxDepth = stream->readInt();
+		m_config.rrDepth = stream->readInt();
+		m_config.strictNormals = stream->readBool();
+		m_config.hideEmitters = stream->readBool();
+		m_config.waveSize = stream->readInt();
+	}
+
+	void serialize(Stream *stream, InstanceManager *manager) const {
+		Integrator::serialize(stream, manager);
+		stream->writeInt(m_config.maxDepth);
+		stream->writeInt(m_config.rrDepth);
+		stream->writeBool(m_config.strictNormals);
+		stream->writeBool(m_config.hideEmitters);
+		stream->writeInt(m_config.waveSize);
+	}
+
+	bool render(Scene *scene, RenderQueue *queue, const RenderJob *job,
+			int sceneResID, int sensorResID, int samplerResID) {
+		Log(EError, "The wavefront path tracer requires the responsive "
+			"rendering interface (use 'path' for classic rendering)");
+		return false;
+	}
+
+	void cancel() { }
+
+	ref<ResponsiveIntegrator> makeResponsiveIntegrator() override {
+		return new WavefrontResponsive(this, &m_config);
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "WavefrontPathTracer[" << endl
+			<< "  maxDepth = " << m_config.maxDepth << "," << endl
+			<< "  rrDepth = " << m_config.rrDepth << "," << endl
+			<< "  strictNormals = " << m_config.strictNormals << "," << endl
+			<< "  hideEmitters = " << m_config.hideEmitters << "," << endl
+			<< "  waveSize = " << m_config.waveSize << endl
+			<< "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+private:
+	WavefrontConfiguration m_config;
+};
+
+MTS_IMPLEMENT_CLASS_S(WavefrontPathTracer, false, Integrator)
+MTS_EXPORT_PLUGIN(WavefrontPathTracer, "Wavefront path tracer");
+MTS_NAMESPACE_END
@@ -35,7 +35,15 @@ BeamRadianceEstimator::BeamRadianceEstimator(const PhotonMap *pmap, size_t looku
 
 	m_photonCount = pmap->size();
 	m_scaleFactor = pmap->getScaleFactor();
-	m_depth = pmap->getDepth();
+
+	/* The photon map does not store its hierarchy inside the photons,
+	   hence build a separate node tree that is later fitted with boxes */
+	PointKDTree<Photon> tree(0, PointKDTree<Photon>::ESlidingMidpoint);
+	tree.reserve(m_photonCount);
+	for (size_t i=0; i<m_photonCount; ++i)
+		tree.push_back(pmap->operator[](i));
+	tree.build();
+	m_depth = tree.getDepth();
 
 	Log(EInfo, "Allocating %s of memory for the BRE acceleration data structure",
 		memString(sizeof(BRENode) * m_photonCount).c_str());
@@ -63,7 +71,7 @@ BeamRadianceEstimator::BeamRadianceEstimator(const PhotonMap *pmap, size_t looku
 		#endif
 
 		PhotonMap::SearchResult *results = resultsPerThread[tid];
-		const Photon &photon = pmap->operator[](i);
+		const Photon &photon = tree[i];
 		BRENode &node = m_nodes[i];
 		node.photon = photon;
 
@@ -21,6 +21,7 @@
 #include <mitsuba/render/gatherproc.h>
 #include <mitsuba/render/integrator2.h>
 #include <mitsuba/core/lock.h>
+#include <atomic>
 #include "bre.h"
 
 MTS_NAMESPACE_BEGIN
@@ -90,7 +91,7 @@ MTS_NAMESPACE_BEGIN
 class PhotonMapIntegrator : public SamplingIntegrator {
 public:
 	PhotonMapIntegrator(const Properties &props) : SamplingIntegrator(props),
-		  m_parentIntegrator(NULL) {
+		  m_activeMaps(NULL), m_parentIntegrator(NULL) {
 		/* Number of lsamples for direct illumination */
 		m_directSamples = props.getInteger("directSamples", 16);
 		/* Number of BSDF samples when intersecting a glossy material */
@@ -155,7 +156,7 @@ public:
 
 	/// Unserialize from a binary data stream
 	PhotonMapIntegrator(Stream *stream, InstanceManager *manager)
-	 : SamplingIntegrator(stream, manager), m_parentIntegrator(NULL) {
+	 : SamplingIntegrator(stream, manager), m_activeMaps(NULL), m_parentIntegrator(NULL) {
 		m_directSamples = stream->readInt();
 		m_glossySamples = stream->readInt();
 		m_maxDepth = stream->readInt();
@@ -164,16 +165,22 @@ public:
 		m_globalPhotons = stream->readSize();
 		m_causticPhotons = stream->readSize();
 		m_volumePhotons = stream->readSize();
-		m_globalLookupRadius = stream->readFloat();
-		m_causticLookupRadius = stream->readFloat();
+		ref<PhotonMapSet> maps = new PhotonMapSet();
+		maps->globalLookupRadius = stream->readFloat();
+		maps->causticLookupRadius = stream->readFloat();
 		m_globalLookupSize = stream->readInt();
 		m_causticLookupSize = stream->readInt();
 		m_volumeLookupSize = stream->readInt();
+		maps->globalLookupSize = std::max(m_globalLookupSize, 4);
+		maps->causticLookupSize = std::max(m_causticLookupSize, 4);
 		m_gatherLocally = stream->readBool();
 		m_autoCancelGathering = stream->readBool();
 		m_hideEmitters = stream->readBool();
 		m_sppPerPhotonProgression = stream->readFloat();
 		m_causticPhotonMapID = m_globalPhotonMapID = m_breID = 0;
+		/* The photon maps themselves are attached in wakeup() */
+		m_maps = maps;
+		m_activeMaps = maps.get();
 		configure();
 	}
 
@@ -197,8 +204,8 @@ public:
 		stream->writeSize(m_globalPhotons);
 		stream->writeSize(m_causticPhotons);
 		stream->writeSize(m_volumePhotons);
-		stream->writeFloat(m_globalLookupRadius);
-		stream->writeFloat(m_causticLookupRadius);
+		stream->writeFloat(m_maps.get() ? m_maps->globalLookupRadius : (Float) 0);
+		stream->writeFloat(m_maps.get() ? m_maps->causticLookupRadius : (Float) 0);
 		stream->writeInt(m_globalLookupSize);
 		stream->writeInt(m_causticLookupSize);
 		stream->writeInt(m_volumeLookupSize);
@@ -234,19 +241,63 @@ public:
 		m_invGlossySamples = 1.0f / m_glossySamples;
 	}
 
+	/**
+	 * \brief Photon maps and lookup parameters produced by one photon
+	 * tracing pass
+	 *
+	 * A set is immutable once published, so that \ref Li() always sees
+	 * maps and lookup parameters of the same generation.
+	 */
+	struct PhotonMapSet : public Object {
+		ref<PhotonMap> globalPhotonMap;
+		ref<PhotonMap> causticPhotonMap;
+		ref<BeamRadianceEstimator> bre;
+		int globalLookupSize, causticLookupSize;
+		Float globalLookupRadius, causticLookupRadius;
+
+		PhotonMapSet() : globalLookupSize(0), causticLookupSize(0),
+			globalLookupRadius(0), causticLookupRadius(0) { }
+	};
+
 	bool preprocess(const Scene *scene, RenderQueue *queue, const RenderJob *job,
 			int sceneResID, int sensorResID, int samplerResID) {
-		ref<Scheduler> sched = Scheduler::getInstance();
-		size_t coreCount = sched->getCoreCount();
 		/* classic mitsuba rendering */
-		Float photonBoost = 1.0f;
-		int photonCountPercent = 100;
 		if (queue) {
 			m_shrinkingFactor = 1.0f;
 			m_haltonScramble = -1;
 		}
+
+		SamplingIntegrator::preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
+
+		/* Only trace the photon maps that are still missing */
+		ref<PhotonMapSet> maps = new PhotonMapSet();
+		if (m_maps.get()) {
+			maps->globalPhotonMap = m_maps->globalPhotonMap;
+			maps->causticPhotonMap = m_maps->causticPhotonMap;
+			maps->bre = m_maps->bre;
+		}
+		if (!tracePhotons(scene, job, sceneResID, sensorResID, queue == NULL,
+				m_shrinkingFactor, *maps))
+			return false;
+		publishPhotonMaps(maps);
+
+		return true;
+	}
+
+	/**
+	 * \brief Trace and build the photon maps that are missing from \c maps
+	 *
+	 * Does not modify the maps used for rendering, hence it may run
+	 * concurrently to \ref Li() (see \ref publishPhotonMaps()).
+	 */
+	bool tracePhotons(const Scene *scene, const RenderJob *job, int sceneResID,
+			int sensorResID, bool interactive, Float shrinkingFactor, PhotonMapSet &maps) {
+		ref<Scheduler> sched = Scheduler::getInstance();
+		size_t coreCount = sched->getCoreCount();
+		Float photonBoost = 1.0f;
+		int photonCountPercent = 100;
 		/* interactive rendering */
-		else {
+		if (interactive) {
 			Float sppPerThread = threadSppPerProgression(m_sppPerPhotonProgression, coreCount);
 			Float parallelSppPerProgression = sppPerThread * Float(coreCount);
 			photonBoost = parallelSppPerProgression / m_sppPerPhotonProgression;
@@ -254,11 +305,10 @@ public:
 			photonCountPercent = std::max(int(100.0f * photonBoost), 100);
 		}
 		/* Adapt to shrinking */
-		m_globalLookupSizeScaled = std::max(int(float(m_globalLookupSize) * m_shrinkingFactor * m_shrinkingFactor / photonBoost), 4);
-		m_causticLookupSizeScaled = std::max(int(float(m_causticLookupSize) * m_shrinkingFactor * m_shrinkingFactor / photonBoost), 4);
-		m_volumeLookupSizeScaled = std::max(int(float(m_volumeLookupSize) * m_shrinkingFactor * m_shrinkingFactor / photonBoost), 4);
+		maps.globalLookupSize = std::max(int(float(m_globalLookupSize) * shrinkingFactor * shrinkingFactor / photonBoost), 4);
+		maps.causticLookupSize = std::max(int(float(m_causticLookupSize) * shrinkingFactor * shrinkingFactor / photonBoost), 4);
+		int volumeLookupSize = std::max(int(float(m_volumeLookupSize) * shrinkingFactor * shrinkingFactor / photonBoost), 4);
 
-		SamplingIntegrator::preprocess(scene, queue, job, sceneResID, sensorResID, samplerResID);
 		/* Create a deterministic sampler for the photon gathering step */
 		ref<Sampler> sampler;
 		{
@@ -285,7 +335,7 @@ public:
 				Log(EError, "Inhomogeneous media are currently not supported by the photon mapper!");
 		}
 
-		if (m_globalPhotonMap.get() == NULL && m_globalPhotons > 0) {
+		if (maps.globalPhotonMap.get() == NULL && m_globalPhotons > 0) {
 			/* Generate the global photon map */
 			ref<GatherPhotonProcess> proc = new GatherPhotonProcess(
 				GatherPhotonProcess::ESurfacePhotons, m_globalPhotons * photonCountPercent / 100,
@@ -301,22 +351,23 @@ public:
 			sched->wait(proc);
 			m_proc = NULL;
 
-			if (proc->getReturnStatus() != ParallelProcess::ESuccess)
+			if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+				sched->unregisterResource(qmcSamplerID);
 				return false;
+			}
 
 			ref<PhotonMap> globalPhotonMap = proc->getPhotonMap();
 			if (globalPhotonMap->isFull()) {
 				Log(EDebug, "Global photon map full. Shot " SIZE_T_FMT " particles, excess photons due to parallelism: "
 					SIZE_T_FMT, proc->getShotParticles(), proc->getExcessPhotons());
 
-				m_globalPhotonMap = globalPhotonMap;
-				m_globalPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
-				m_globalPhotonMap->build();
-				m_globalPhotonMapID = sched->registerResource(m_globalPhotonMap);
+				globalPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
+				globalPhotonMap->build();
+				maps.globalPhotonMap = globalPhotonMap;
 			}
 		}
 
-		if (m_causticPhotonMap.get() == NULL && m_causticPhotons > 0) {
+		if (maps.causticPhotonMap.get() == NULL && m_causticPhotons > 0) {
 			/* Generate the caustic photon map */
 			ref<GatherPhotonProcess> proc = new GatherPhotonProcess(
 				GatherPhotonProcess::ECausticPhotons, m_causticPhotons * photonCountPercent / 100,
@@ -332,18 +383,19 @@ public:
 			sched->wait(proc);
 			m_proc = NULL;
 
-			if (proc->getReturnStatus() != ParallelProcess::ESuccess)
+			if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+				sched->unregisterResource(qmcSamplerID);
 				return false;
+			}
 
 			ref<PhotonMap> causticPhotonMap = proc->getPhotonMap();
 			if (causticPhotonMap->isFull()) {
 				Log(EDebug, "Caustic photon map full. Shot " SIZE_T_FMT " particles, excess photons due to parallelism: "
 					SIZE_T_FMT, proc->getShotParticles(), proc->getExcessPhotons());
 
-				m_causticPhotonMap = causticPhotonMap;
-				m_causticPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
-				m_causticPhotonMap->build();
-				m_causticPhotonMapID = sched->registerResource(m_causticPhotonMap);
+				causticPhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
+				causticPhotonMap->build();
+				maps.causticPhotonMap = causticPhotonMap;
 			}
 		}
 
@@ -364,8 +416,10 @@ public:
 			sched->wait(proc);
 			m_proc = NULL;
 
-			if (proc->getReturnStatus() != ParallelProcess::ESuccess)
+			if (proc->getReturnStatus() != ParallelProcess::ESuccess) {
+				sched->unregisterResource(qmcSamplerID);
 				return false;
+			}
 
 			ref<PhotonMap> volumePhotonMap = proc->getPhotonMap();
 			if (volumePhotonMap->isFull()) {
@@ -374,20 +428,53 @@ public:
 
 				volumePhotonMap->setScaleFactor(1 / (Float) proc->getShotParticles());
 				volumePhotonMap->build();
-				m_bre = new BeamRadianceEstimator(volumePhotonMap, m_volumeLookupSizeScaled);
-				m_breID = sched->registerResource(m_bre);
+				maps.bre = new BeamRadianceEstimator(volumePhotonMap, volumeLookupSize);
 			}
 		}
 
 		/* Adapt to scene extents */
-		m_globalLookupRadius = m_globalLookupRadiusRel * scene->getBSphere().radius * m_shrinkingFactor / std::sqrt(photonBoost);
-		m_causticLookupRadius = m_causticLookupRadiusRel * scene->getBSphere().radius * m_shrinkingFactor / std::sqrt(photonBoost);
+		maps.globalLookupRadius = m_globalLookupRadiusRel * scene->getBSphere().radius * shrinkingFactor / std::sqrt(photonBoost);
+		maps.causticLookupRadius = m_causticLookupRadiusRel * scene->getBSphere().radius * shrinkingFactor / std::sqrt(photonBoost);
 
 		sched->unregisterResource(qmcSamplerID);
 
 		return true;
 	}
 
+	/**
+	 * \brief Make a set of photon maps visible to \ref Li()
+	 *
+	 * The set is swapped in through a single pointer, which \ref Li() reads
+	 * once per query. Renderers that may still be reading the previous set
+	 * must keep it alive themselves.
+	 */
+	void publishPhotonMaps(PhotonMapSet *maps) {
+		ref<Scheduler> sched = Scheduler::getInstance();
+		ref<PhotonMapSet> current = m_maps;
+		if (!current.get())
+			current = new PhotonMapSet();
+		if (maps->globalPhotonMap.get() != current->globalPhotonMap.get()) {
+			if (m_globalPhotonMapID)
+				sched->unregisterResource(m_globalPhotonMapID);
+			m_globalPhotonMapID = maps->globalPhotonMap.get() ? sched->registerResource(maps->globalPhotonMap) : 0;
+		}
+		if (maps->causticPhotonMap.get() != current->causticPhotonMap.get()) {
+			if (m_causticPhotonMapID)
+				sched->unregisterResource(m_causticPhotonMapID);
+			m_causticPhotonMapID = maps->causticPhotonMap.get() ? sched->registerResource(maps->causticPhotonMap) : 0;
+		}
+		if (maps->bre.get() != current->bre.get()) {
+			if (m_breID)
+				sched->unregisterResource(m_breID);
+			m_breID = maps->bre.get() ? sched->registerResource(maps->bre) : 0;
+		}
+		m_maps = maps;
+		m_activeMaps.store(maps, std::memory_order_release);
+	}
+
+	/// Return the photon maps that are currently visible to \ref Li()
+	inline PhotonMapSet *getPhotonMaps() { return m_maps.get(); }
+
 	void setParent(ConfigurableObject *parent) {
 		if (parent->getClass()->derivesFrom(MTS_CLASS(SamplingIntegrator)))
 			m_parentIntegrator = static_cast<SamplingIntegrator *>(parent);
@@ -397,22 +484,27 @@ public:
 
 	/// Specify globally shared resources
 	void bindUsedResources(ParallelProcess *proc) const {
-		if (m_globalPhotonMap.get())
+		if (!m_maps.get())
+			return;
+		if (m_maps->globalPhotonMap.get())
 			proc->bindResource("globalPhotonMap", m_globalPhotonMapID);
-		if (m_causticPhotonMap.get())
+		if (m_maps->causticPhotonMap.get())
 			proc->bindResource("causticPhotonMap", m_causticPhotonMapID);
-		if (m_bre.get())
+		if (m_maps->bre.get())
 			proc->bindResource("bre", m_breID);
 	}
 
 	/// Connect to globally shared resources
 	void wakeup(ConfigurableObject *parent, std::map<std::string, SerializableObject *> &params) {
-		if (!m_globalPhotonMap.get() && params.find("globalPhotonMap") != params.end())
-			m_globalPhotonMap = static_cast<PhotonMap *>(params["globalPhotonMap"]);
-		if (!m_causticPhotonMap.get() && params.find("causticPhotonMap") != params.end())
-			m_causticPhotonMap = static_cast<PhotonMap *>(params["causticPhotonMap"]);
-		if (!m_bre.get() && params.find("bre") != params.end())
-			m_bre = static_cast<BeamRadianceEstimator *>(params["bre"]);
+		/* Attach the maps to the lookup parameters received during unserialization */
+		if (m_maps.get() && !m_globalPhotonMapID && !m_causticPhotonMapID && !m_breID) {
+			if (!m_maps->globalPhotonMap.get() && params.find("globalPhotonMap") != params.end())
+				m_maps->globalPhotonMap = static_cast<PhotonMap *>(params["globalPhotonMap"]);
+			if (!m_maps->causticPhotonMap.get() && params.find("causticPhotonMap") != params.end())
+				m_maps->causticPhotonMap = static_cast<PhotonMap *>(params["causticPhotonMap"]);
+			if (!m_maps->bre.get() && params.find("bre") != params.end())
+				m_maps->bre = static_cast<BeamRadianceEstimator *>(params["bre"]);
+		}
 
 		if (parent && parent->getClass()->derivesFrom(MTS_CLASS(SamplingIntegrator)))
 			m_parentIntegrator = static_cast<SamplingIntegrator *>(parent);
@@ -430,6 +522,8 @@ public:
 		Spectrum LiSurf(0.0f), LiMedium(0.0f), transmittance(1.0f);
 		Intersection &its = rRec.its;
 		const Scene *scene = rRec.scene;
+		/* Use one consistent set of photon maps for the entire query */
+		const PhotonMapSet *maps = m_activeMaps.load(std::memory_order_acquire);
 
 		bool cacheQuery = (rRec.extra & RadianceQueryRecord::ECacheQuery);
 		bool adaptiveQuery = (rRec.extra & RadianceQueryRecord::EAdaptiveQuery);
@@ -443,8 +537,8 @@ public:
 			transmittance = rRec.medium->evalTransmittance(mediumRaySegment);
 			mediumRaySegment.mint = ray.mint;
 			if (rRec.type & RadianceQueryRecord::EVolumeRadiance &&
-					(rRec.depth < m_maxDepth || m_maxDepth < 0) && m_bre.get() != NULL)
-				LiMedium = m_bre->query(mediumRaySegment, rRec.medium);
+					(rRec.depth < m_maxDepth || m_maxDepth < 0) && maps && maps->bre.get() != NULL)
+				LiMedium = maps->bre->query(mediumRaySegment, rRec.medium);
 		}
 
 		if (!its.isValid()) {
@@ -481,14 +575,14 @@ public:
 		if (isDiffuse && (dot(its.shFrame.n, ray.d) < 0 || (bsdf->getType() & BSDF::EBackSide))) {
 			/* 1. Diffuse indirect */
 			int maxDepth = m_maxDepth == -1 ? INT_MAX : (m_maxDepth-rRec.depth);
-			if (rRec.type & RadianceQueryRecord::EIndirectSurfaceRadiance && m_globalPhotonMap.get())
-				LiSurf += m_globalPhotonMap->estimateIrradiance(its.p,
-					its.shFrame.n, m_globalLookupRadius, maxDepth,
-					m_globalLookupSizeScaled) * bsdf->getDiffuseReflectance(its) * INV_PI;
-			if (rRec.type & RadianceQueryRecord::ECausticRadiance && m_causticPhotonMap.get())
-				LiSurf += m_causticPhotonMap->estimateIrradiance(its.p,
-					its.shFrame.n, m_causticLookupRadius, maxDepth,
-					m_causticLookupSizeScaled) * bsdf->getDiffuseReflectance(its) * INV_PI;
+			if (rRec.type & RadianceQueryRecord::EIndirectSurfaceRadiance && maps && maps->globalPhotonMap.get())
+				LiSurf += maps->globalPhotonMap->estimateIrradiance(its.p,
+					its.shFrame.n, maps->globalLookupRadius, maxDepth,
+					maps->globalLookupSize) * bsdf->getDiffuseReflectance(its) * INV_PI;
+			if (rRec.type & RadianceQueryRecord::ECausticRadiance && maps && maps->causticPhotonMap.get())
+				LiSurf += maps->causticPhotonMap->estimateIrradiance(its.p,
+					its.shFrame.n, maps->causticLookupRadius, maxDepth,
+					maps->causticLookupSize) * bsdf->getDiffuseReflectance(its) * INV_PI;
 		}
 
 		if (hasSpecular && exhaustiveSpecular
@@ -689,8 +783,8 @@ public:
 			<< "  causticPhotons = " << m_causticPhotons << "," << endl
 			<< "  volumePhotons = " << m_volumePhotons << "," << endl
 			<< "  gatherLocally = " << m_gatherLocally << "," << endl
-			<< "  globalLookupRadius = " << m_globalLookupRadius << "," << endl
-			<< "  causticLookupRadius = " << m_causticLookupRadius << "," << endl
+			<< "  globalLookupRadiusRel = " << m_globalLookupRadiusRel << "," << endl
+			<< "  causticLookupRadiusRel = " << m_causticLookupRadiusRel << "," << endl
 			<< "  globalLookupSize = " << m_globalLookupSize << "," << endl
 			<< "  causticLookupSize = " << m_causticLookupSize << "," << endl
 			<< "  volumeLookupSize = " << m_volumeLookupSize << endl
@@ -707,33 +801,82 @@ public:
 		return std::max( minSppPerProgression / Float(threadCount), Float(0.25) );
 	}
 
+	/**
+	 * Responsive photon mapper: the next generation of photon maps is traced
+	 * and built by a background thread while the workers keep gathering
+	 * against the current maps. Completed maps are swapped in by exchanging
+	 * pointers; the previous maps stay alive until every worker has passed
+	 * an interrupt point, after which no gather step can still reference them.
+	 */
 	class PMRefresh : public ClassicSamplingIntegrator {
-		Barrier barrier;
 		#define InitialShrinkingFactor 0.7f
+		/// Marks workers that are currently outside of render()
+		#define InactiveWorker -1
+
+		/// Traces and builds one generation of photon maps
+		class RebuildThread : public Thread {
+		public:
+			RebuildThread(PMRefresh *parent, const Scene *scene, const Sensor *sensor,
+					Float shrinkingFactor) : Thread("pmrebuild"), m_parent(parent),
+					m_scene(scene), m_sensor(sensor), m_shrinkingFactor(shrinkingFactor) { }
+
+			void run() {
+				PhotonMapIntegrator &renderer = m_parent->getRenderer();
+				SchedulerResourceContext ctx(m_scene, m_sensor, m_scene->getSampler());
+				ref<PhotonMapSet> maps = new PhotonMapSet();
+				bool success = renderer.tracePhotons(m_scene, NULL, ctx.sceneID,
+					ctx.sensorID, true, m_shrinkingFactor, *maps);
+				m_parent->finishRebuild(success ? maps.get() : NULL);
+			}
+
+		private:
+			PMRefresh *m_parent;
+			const Scene *m_scene;
+			const Sensor *m_sensor;
+			Float m_shrinkingFactor;
+		};
 
 	public:
 		PMRefresh(PhotonMapIntegrator* classic)
 			: ClassicSamplingIntegrator(classic, classic->getProperties())
-			, barrier(8) { }
+			, m_mutex(new Mutex()), m_epoch(0), m_rebuilding(false)
+			, m_rebuildFailed(false) { }
+
+		~PMRefresh() {
+			waitForRebuild();
+		}
+
+		inline PhotonMapIntegrator &getRenderer() {
+			return static_cast<PhotonMapIntegrator&>(*this->classicIntegrator);
+		}
 
 		bool preprocess(const Scene *scene, const Sensor* sensor, const Sampler* sampler) override {
-			PhotonMapIntegrator& renderer = *static_cast<PhotonMapIntegrator*>(this->classicIntegrator.get());
+			waitForRebuild();
+			m_retired = NULL;
+			m_rebuildFailed.store(false, std::memory_order_relaxed);
+
+			PhotonMapIntegrator& renderer = getRenderer();
 			renderer.m_shrinkingFactor = InitialShrinkingFactor;
 			renderer.m_haltonScramble = 0;
 			return ClassicSamplingIntegrator::preprocess(scene, sensor, sampler);
 		}
 
+		bool allocate(const Scene &scene, Sampler *const *samplers, ImageBlock *const *targets, int threadCount) override {
+			waitForRebuild();
+			m_retired = NULL;
+			m_workerEpoch.assign(threadCount, InactiveWorker);
+			return ClassicSamplingIntegrator::allocate(scene, samplers, targets, threadCount);
+		}
+
 		int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target
 			, Controls controls, int threadIdx, int threadCount) override {
-			PhotonMapIntegrator& renderer = static_cast<PhotonMapIntegrator&>(*this->classicIntegrator);
-			barrier.resize(threadCount);
+			PhotonMapIntegrator& renderer = getRenderer();
 
 			struct Interrupt : ResponsiveIntegrator::Interrupt {
 				struct Interface {
-					PhotonMapIntegrator& renderer;
+					PMRefresh& refresh;
 					ResponsiveIntegrator::Interrupt* nextInterrupt;
 
-					Barrier& barrier;
 					double sppPerProgression;
 				} iface;
 				double lastPhotonSpp = 0;
@@ -747,29 +890,94 @@ public:
 					if (iface.nextInterrupt) {
 						returnCode = iface.nextInterrupt->progress(integrator, scene, sensor, sampler, target, spp, controls, threadIdx, threadCount);
 					}
-					if (iface.barrier.blocking() || returnCode == 0 && spp >= lastPhotonSpp + iface.sppPerProgression) {
-						if (Mutex* m = iface.barrier.waitKeep()) {
-							UniqueLock lock(m, false, true);
-							iface.renderer.m_globalPhotonMap = nullptr;
-							iface.renderer.m_causticPhotonMap = nullptr;
-							iface.renderer.m_volumePhotonMap = nullptr;
-
-							iface.renderer.m_shrinkingFactor = Float( InitialShrinkingFactor / std::max(std::sqrt(std::sqrt(spp * double(threadCount))), 1.0) );
-
-							SchedulerResourceContext ctx(&scene, &sensor, scene.getSampler());
-							if (!iface.renderer.preprocess(&scene, nullptr, nullptr, ctx.sceneID, ctx.sensorID, ctx.samplerID))
-								return 200;
-						}
+					iface.refresh.acknowledge(threadIdx);
+					if (iface.refresh.m_rebuildFailed.load(std::memory_order_acquire))
+						return 200;
+					if (returnCode == 0 && spp >= lastPhotonSpp + iface.sppPerProgression) {
+						Float shrinkingFactor = Float( InitialShrinkingFactor / std::max(std::sqrt(std::sqrt(spp * double(threadCount))), 1.0) );
+						iface.refresh.startRebuild(scene, sensor, shrinkingFactor);
 						lastPhotonSpp = spp;
 					}
 					return returnCode;
 				}
-			} interrupt = { { renderer, controls.interrupt, this->barrier, renderer.threadSppPerProgression(renderer.m_sppPerPhotonProgression, threadCount) } };
+			} interrupt = { { *this, controls.interrupt, renderer.threadSppPerProgression(renderer.m_sppPerPhotonProgression, threadCount) } };
 			controls.interrupt = &interrupt;
 
-			return ClassicSamplingIntegrator::render(scene, sensor, sampler, target, controls, threadIdx, threadCount);
+			acknowledge(threadIdx);
+			int result = ClassicSamplingIntegrator::render(scene, sensor, sampler, target, controls, threadIdx, threadCount);
+			{
+				LockGuard lock(m_mutex);
+				m_workerEpoch[threadIdx] = InactiveWorker;
+				releaseRetired();
+			}
+			return result;
+		}
+
+	protected:
+		/// Record that a worker no longer references older photon maps
+		inline void acknowledge(int threadIdx) {
+			/* Only this worker writes its own slot, hence it can be read without the lock */
+			if (m_workerEpoch[threadIdx] == m_epoch.load(std::memory_order_acquire))
+				return;
+			LockGuard lock(m_mutex);
+			m_workerEpoch[threadIdx] = m_epoch.load(std::memory_order_relaxed);
+			releaseRetired();
+		}
+
+		/// Launch the next photon tracing pass, unless one is still pending
+		void startRebuild(const Scene &scene, const Sensor &sensor, Float shrinkingFactor) {
+			LockGuard lock(m_mutex);
+			if (m_rebuilding.load(std::memory_order_relaxed) || m_retired.get())
+				return;
+			if (m_rebuildThread.get())
+				m_rebuildThread->join();
+			m_rebuilding.store(true, std::memory_order_relaxed);
+			m_rebuildThread = new RebuildThread(this, &scene, &sensor, shrinkingFactor);
+			m_rebuildThread->start();
+		}
+
+		/// Called by the rebuild thread: swap in the new maps and retire the current ones
+		void finishRebuild(PhotonMapSet *maps) {
+			LockGuard lock(m_mutex);
+			PhotonMapIntegrator &renderer = getRenderer();
+			if (maps) {
+				m_retired = renderer.getPhotonMaps();
+				renderer.publishPhotonMaps(maps);
+				/* Release: workers observing the new epoch also see the new maps */
+				m_epoch.fetch_add(1, std::memory_order_release);
+				releaseRetired();
+			} else {
+				m_rebuildFailed.store(true, std::memory_order_release);
+			}
+			m_rebuilding.store(false, std::memory_order_relaxed);
+		}
+
+		/// Drop the retired maps once every active worker has seen the current ones
+		void releaseRetired() {
+			for (size_t i=0; i<m_workerEpoch.size(); ++i) {
+				if (m_workerEpoch[i] != InactiveWorker
+					&& m_workerEpoch[i] != m_epoch.load(std::memory_order_relaxed))
+					return;
+			}
+			m_retired = NULL;
+		}
+
+		void waitForRebuild() {
+			if (m_rebuildThread.get()) {
+				m_rebuildThread->join();
+				m_rebuildThread = NULL;
+			}
 		}
 
+	private:
+		ref<Mutex> m_mutex;
+		ref<RebuildThread> m_rebuildThread;
+		ref<PhotonMapSet> m_retired;
+		std::vector<int> m_workerEpoch;
+		/// Number of published photon map sets (modified with \c m_mutex held)
+		std::atomic<int> m_epoch;
+		std::atomic<bool> m_rebuilding;
+		std::atomic<bool> m_rebuildFailed;
 	};
 
 	ref<ResponsiveIntegrator> makeResponsiveIntegrator() override {
@@ -782,18 +990,16 @@ public:
 
 	MTS_DECLARE_CLASS()
 private:
-	ref<PhotonMap> m_globalPhotonMap;
-	ref<PhotonMap> m_causticPhotonMap;
+	ref<PhotonMapSet> m_maps;
+	/// Published photon maps, read once per query by Li()
+	std::atomic<const PhotonMapSet *> m_activeMaps;
 	ref<PhotonMap> m_volumePhotonMap;
-	ref<BeamRadianceEstimator> m_bre;
 	ref<ParallelProcess> m_proc;
 	SamplingIntegrator *m_parentIntegrator;
 	int m_globalPhotonMapID, m_causticPhotonMapID, m_breID;
 	size_t m_globalPhotons, m_causticPhotons, m_volumePhotons;
 	int m_globalLookupSize, m_causticLookupSize, m_volumeLookupSize;
-	int m_globalLookupSizeScaled, m_causticLookupSizeScaled, m_volumeLookupSizeScaled;
-	Float m_globalLookupRadiusRel, m_globalLookupRadius;
-	Float m_causticLookupRadiusRel, m_causticLookupRadius;
+	Float m_globalLookupRadiusRel, m_causticLookupRadiusRel;
 	Float m_invEmitterSamples, m_invGlossySamples;
 	int m_granularity, m_directSamples, m_glossySamples;
 	int m_rrDepth, m_maxDepth, m_maxSpecularDepth;
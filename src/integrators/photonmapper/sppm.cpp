@@ -18,8 +18,12 @@
 
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/atomic.h>
+#include <mitsuba/core/timer.h>
 #include <mitsuba/render/gatherproc.h>
 #include <mitsuba/render/renderqueue.h>
+#include <mitsuba/render/integrator2.h>
+#include <mitsuba/render/imageblock.h>
 
 #if defined(MTS_OPENMP)
 # include <omp.h>
@@ -61,6 +65,11 @@ MTS_NAMESPACE_BEGIN
  * number of samples per pixel are not necessary. As with \pluginref{ppm}, once started,
  * the rendering process continues indefinitely until it is manually stopped.
  *
+ * In the interactive viewer, all rendering threads cooperate on every pass. The
+ * gather points are stored in a hashed grid, into which the threads splat their
+ * photons directly while tracing them (hence no photon map is built); the
+ * \code{granularity} parameter is not used there.
+ *
  * \remarks{
  *    \item Due to the data dependencies of this algorithm, the parallelization is
  *    limited to the local machine (i.e. cluster-wide renderings are not implemented)
@@ -258,57 +267,91 @@ public:
 					sample += Vector2((Float) gatherPoint.pos.x, (Float) gatherPoint.pos.y);
 					RayDifferential ray;
 					sensor->sampleRayDifferential(ray, sample, apertureSample, timeSample);
-					Spectrum weight(1.0f);
-					int depth = 1;
-					gatherPoint.emission = Spectrum(0.0f);
-
-					while (true) {
-						if (scene->rayIntersect(ray, gatherPoint.its)) {
-							if (gatherPoint.its.isEmitter())
-								gatherPoint.emission += weight * gatherPoint.its.Le(-ray.d);
-
-							if (depth >= m_maxDepth && m_maxDepth != -1) {
-								gatherPoint.depth = -1;
-								break;
-							}
-
-							const BSDF *bsdf = gatherPoint.its.getBSDF();
-
-							/* Create hit point if this is a diffuse material or a glossy
-							   one, and there has been a previous interaction with
-							   a glossy material */
-							if ((bsdf->getType() & BSDF::EAll) == BSDF::EDiffuseReflection ||
-								(bsdf->getType() & BSDF::EAll) == BSDF::EDiffuseTransmission ||
-								(depth + 1 > m_maxDepth && m_maxDepth != -1)) {
-								gatherPoint.weight = weight;
-								gatherPoint.depth = depth;
-								break;
-							} else {
-								/* Recurse for dielectric materials and (specific to SPPM):
-								   recursive "final gathering" for glossy materials */
-								BSDFSamplingRecord bRec(gatherPoint.its, sampler);
-								weight *= bsdf->sample(bRec, sampler->next2D());
-								if (weight.isZero()) {
-									gatherPoint.depth = -1;
-									break;
-								}
-								ray = RayDifferential(gatherPoint.its.p,
-									gatherPoint.its.toWorld(bRec.wo), ray.time);
-								++depth;
-							}
-						} else {
-							/* Generate an invalid sample */
-							gatherPoint.depth = -1;
-							gatherPoint.emission += weight * scene->evalEnvironment(ray);
-							break;
-						}
-					}
+					traceGatherPoint(scene, sampler, ray, Spectrum(1.0f), gatherPoint);
 					sampler->advance();
 				}
 			}
 		}
 	}
 
+	/// Follow a camera ray through specular and glossy interactions until a gather point is found
+	void traceGatherPoint(const Scene *scene, Sampler *sampler, RayDifferential &ray,
+			Spectrum weight, GatherPoint &gatherPoint) const {
+		int depth = 1;
+		gatherPoint.emission = Spectrum(0.0f);
+
+		while (true) {
+			if (scene->rayIntersect(ray, gatherPoint.its)) {
+				if (gatherPoint.its.isEmitter())
+					gatherPoint.emission += weight * gatherPoint.its.Le(-ray.d);
+
+				if (depth >= m_maxDepth && m_maxDepth != -1) {
+					gatherPoint.depth = -1;
+					break;
+				}
+
+				const BSDF *bsdf = gatherPoint.its.getBSDF();
+
+				/* Create hit point if this is a diffuse material or a glossy
+				   one, and there has been a previous interaction with
+				   a glossy material */
+				if ((bsdf->getType() & BSDF::EAll) == BSDF::EDiffuseReflection ||
+					(bsdf->getType() & BSDF::EAll) == BSDF::EDiffuseTransmission ||
+					(depth + 1 > m_maxDepth && m_maxDepth != -1)) {
+					gatherPoint.weight = weight;
+					gatherPoint.depth = depth;
+					break;
+				} else {
+					/* Recurse for dielectric materials and (specific to SPPM):
+					   recursive "final gathering" for glossy materials */
+					BSDFSamplingRecord bRec(gatherPoint.its, sampler);
+					weight *= bsdf->sample(bRec, sampler->next2D());
+					if (weight.isZero()) {
+						gatherPoint.depth = -1;
+						break;
+					}
+					ray = RayDifferential(gatherPoint.its.p,
+						gatherPoint.its.toWorld(bRec.wo), ray.time);
+					++depth;
+				}
+			} else {
+				/* Generate an invalid sample */
+				gatherPoint.depth = -1;
+				gatherPoint.emission += weight * scene->evalEnvironment(ray);
+				break;
+			}
+		}
+	}
+
+	/**
+	 * \brief Apply the progressive radius reduction to a gather point
+	 *
+	 * \c M photons carrying the flux \c flux were found within the radius
+	 * in a pass that emitted \c shotParticles particles. Returns the
+	 * current radiance estimate of the gather point.
+	 */
+	Spectrum updateGatherPoint(GatherPoint &gp, Float M, const Spectrum &flux,
+			size_t shotParticles, size_t totalEmitted) const {
+		Float N = gp.N;
+
+		if (N == 0 && !gp.emission.isZero())
+			gp.N = N = 1;
+
+		if (N+M == 0) {
+			gp.flux = Spectrum(0.0f);
+			return Spectrum(0.0f);
+		}
+
+		Float ratio = (N + m_alpha * M) / (N + M);
+		gp.radius = gp.radius * std::sqrt(ratio);
+
+		gp.flux = (gp.flux +
+				gp.weight * flux +
+				gp.emission * (Float) shotParticles * M_PI * gp.radius*gp.radius) * ratio;
+		gp.N = N + m_alpha * M;
+		return gp.flux / ((Float) totalEmitted * gp.radius*gp.radius * M_PI);
+	}
+
 	void photonMapPass(int it, RenderQueue *queue, const RenderJob *job,
 			Film *film, int sceneResID, int sensorResID, int samplerResID) {
 		Log(EInfo, "Performing a photon mapping pass %i (" SIZE_T_FMT " photons so far)",
@@ -346,8 +389,8 @@ public:
 			Spectrum *target = (Spectrum *) m_bitmap->getUInt8Data();
 			for (size_t i=0; i<gatherPoints.size(); ++i) {
 				GatherPoint &gp = gatherPoints[i];
-				Float M, N = gp.N;
-				Spectrum flux, contrib;
+				Float M;
+				Spectrum flux;
 
 				if (gp.depth != -1) {
 					M = (Float) photonMap->estimateRadianceRaw(
@@ -357,21 +400,8 @@ public:
 					flux = Spectrum(0.0f);
 				}
 
-				if (N == 0 && !gp.emission.isZero())
-					gp.N = N = 1;
-
-				if (N+M == 0) {
-					gp.flux = contrib = Spectrum(0.0f);
-				} else {
-					Float ratio = (N + m_alpha * M) / (N + M);
-					gp.radius = gp.radius * std::sqrt(ratio);
-
-					gp.flux = (gp.flux +
-							gp.weight * flux +
-							gp.emission * (Float) proc->getShotParticles() * M_PI * gp.radius*gp.radius) * ratio;
-					gp.N = N + m_alpha * M;
-					contrib = gp.flux / ((Float) m_totalEmitted * gp.radius*gp.radius * M_PI);
-				}
+				Spectrum contrib = updateGatherPoint(gp, M, flux,
+					proc->getShotParticles(), m_totalEmitted);
 
 				target[gp.pos.y * m_bitmap->getWidth() + gp.pos.x] = contrib;
 			}
@@ -394,23 +424,460 @@ public:
 		return oss.str();
 	}
 	
+	/**
+	 * \brief Responsive implementation of SPPM
+	 *
+	 * All rendering threads cooperate on every pass: the gather points of
+	 * interleaved image rows are traced by their owning thread and inserted
+	 * into a lock-free hashed grid, photons are then traced by all threads
+	 * and splatted directly into the gather points of the grid cell they
+	 * land in. Finally, every thread updates the radii of the gather points
+	 * it owns and writes the current estimate into its pixels. The three
+	 * phases are separated by barriers, no photon map is built.
+	 */
+	class SPPMResponsive : public ResponsiveIntegrator {
+	public:
+		/// Reference to a gather point from one bucket of the hashed grid
+		struct GridEntry {
+			int32_t point;
+			int32_t next;
+		};
+
+		SPPMResponsive(SPPMIntegrator *integrator)
+			: ResponsiveIntegrator(integrator->getProperties()),
+			  m_integrator(integrator), m_barrier(1) {
+			m_independentSampler = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), Properties("independent")));
+			m_independentSampler->configure();
+			m_timer = new Timer();
+			m_statisticsBuffer[0] = '\0';
+			m_pass = 0;
+			m_gridRefs = 0;
+			m_droppedRefs = 0;
+		}
+
+		bool preprocess(const Scene *scene, const Sensor* sensor, const Sampler* sampler) override {
+			return m_integrator->preprocess(scene, NULL, NULL, -1, -1, -1);
+		}
+
+		bool allocate(const Scene &scene, Sampler *const *samplers, ImageBlock *const *targets, int threadCount) override {
+			m_size = targets[0]->getSize();
+			size_t pointCount = (size_t) m_size.x * (size_t) m_size.y;
+
+			m_points.resize(pointCount);
+			m_photonFlux.resize(pointCount * SPECTRUM_SAMPLES);
+			m_photonCounts.resize(pointCount);
+
+			/* The cell size is twice the largest radius, hence the
+			   region of a gather point overlaps at most eight cells */
+			m_entries.resize(pointCount * 8);
+			m_cells.resize(math::roundToPowerOfTwo(std::max(pointCount * 2, (size_t) 2)));
+			m_cellMask = (uint32_t) (m_cells.size() - 1);
+			m_gridOrigin = scene.getAABB().min;
+
+			m_samplers.clear();
+			for (int i=0; i<threadCount; ++i)
+				m_samplers.push_back(m_independentSampler->clone());
+			return true;
+		}
+
+		void prepareFrame(int threadCount) override {
+			m_barrier.resize(threadCount);
+			m_threadCodes.assign(threadCount, 0);
+			m_maxRadius.assign(threadCount, m_integrator->m_initialRadius);
+
+			for (size_t i=0; i<m_points.size(); ++i) {
+				GatherPoint &gp = m_points[i];
+				gp.radius = m_integrator->m_initialRadius;
+				gp.flux = Spectrum(0.0f);
+				gp.N = 0;
+			}
+			std::fill(m_photonFlux.begin(), m_photonFlux.end(), (Float) 0);
+			std::fill(m_photonCounts.begin(), m_photonCounts.end(), 0);
+			std::fill(m_cells.begin(), m_cells.end(), -1);
+			m_entryCount = 0;
+
+			m_pass = 0;
+			m_passActive = false;
+			m_abandoned = false;
+			m_returnCode = 0;
+			m_passEmitted = 0;
+			m_totalEmitted = 0;
+			m_timer->reset();
+		}
+
+		char const* getRealtimeStatistics() override {
+			Float seconds = m_timer->getSecondsSinceStart();
+			double passRate = seconds > 0 ? (double) m_pass / seconds : 0.0;
+			sprintf(m_statisticsBuffer, "%.2f passes/s, %.2fM photons/s, %.1f grid refs/point",
+				passRate, passRate * m_integrator->m_photonCount * 1e-6,
+				m_points.empty() ? 0.0 : (double) m_gridRefs / m_points.size());
+			return m_statisticsBuffer;
+		}
+
+		int render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target
+			, Controls controls, int threadIdx, int threadCount) override {
+#if defined(MTS_DEBUG_FP)
+			enableFPExceptions();
+#endif
+			Sampler *threadSampler = m_samplers[threadIdx];
+			int passes = 0;
+
+			while (true) {
+				int returnCode = 0;
+				if (!stopRequested(controls, returnCode) && controls.interrupt)
+					returnCode = controls.interrupt->progress(this, scene, sensor, sampler, target,
+						(double) passes / threadCount, controls, threadIdx, threadCount);
+				m_threadCodes[threadIdx] = returnCode;
+
+				/* Commit the previous pass and agree on whether to continue */
+				if (Mutex *mutex = m_barrier.waitKeep()) {
+					startPass(threadCount);
+					mutex->unlock();
+				}
+				if (m_returnCode != 0)
+					break;
+
+				/* Trace the gather points of the rows owned by this thread */
+				for (int y=threadIdx; y<m_size.y; y += threadCount) {
+					if (stopRequested(controls, returnCode)) {
+						m_abandoned = true;
+						break;
+					}
+					for (int x=0; x<m_size.x; ++x)
+						traceGatherPoint(scene, sensor, threadSampler, Point2i(x, y));
+				}
+				m_barrier.wait();
+
+				/* Trace this thread's share of the photons */
+				if (!m_abandoned) {
+					size_t photonCount = (size_t) m_integrator->m_photonCount / threadCount
+						+ ((size_t) threadIdx < (size_t) m_integrator->m_photonCount % threadCount ? 1 : 0);
+					size_t shot = tracePhotons(scene, sensor, threadSampler, photonCount, controls);
+					atomicAdd(&m_passEmitted, (int64_t) shot);
+				}
+				m_barrier.wait();
+
+				/* Update the gather points of the owned rows */
+				if (!m_abandoned) {
+					updateRows(target, threadIdx, threadCount);
+					++passes;
+				}
+
+				/* Clear a slice of the grid for the next pass */
+				size_t cellCount = m_cells.size(),
+				       begin = cellCount * threadIdx / threadCount,
+				       end = cellCount * (threadIdx + 1) / threadCount;
+				std::fill(m_cells.begin() + begin, m_cells.begin() + end, -1);
+			}
+
+#if defined(MTS_DEBUG_FP)
+			disableFPExceptions();
+#endif
+			return m_returnCode;
+		}
+
+	protected:
+		/// Check the external controls without blocking
+		static inline bool stopRequested(const Controls &controls, int &returnCode) {
+			if (controls.abort && *controls.abort)
+				returnCode = -1;
+			else if (controls.continu && !*controls.continu)
+				returnCode = -2;
+			else
+				return false;
+			return true;
+		}
+
+		/// Serial section between two passes, executed by the last thread to arrive
+		void startPass(int threadCount) {
+			if (m_passActive && !m_abandoned) {
+				m_totalEmitted += (size_t) m_passEmitted;
+				++m_pass;
+			}
+			m_gridRefs = std::min((int32_t) m_entryCount, (int32_t) m_entries.size());
+			if (m_droppedRefs > 0) {
+				Log(EWarn, "The hashed grid overflowed and dropped %i references to "
+					"gather points, the last pass is biased!", (int) m_droppedRefs);
+				m_droppedRefs = 0;
+			}
+			m_passEmitted = 0;
+			m_entryCount = 0;
+			m_abandoned = false;
+			m_passActive = true;
+
+			m_returnCode = 0;
+			for (int i=0; i<threadCount && m_returnCode == 0; ++i)
+				m_returnCode = m_threadCodes[i];
+			/* A positive code ends the frame once the requested passes are complete */
+			if (m_returnCode == 0 && m_integrator->m_maxPasses != -1
+					&& m_pass >= m_integrator->m_maxPasses)
+				m_returnCode = 1;
+
+			Float maxRadius = 0;
+			for (int i=0; i<threadCount; ++i)
+				maxRadius = std::max(maxRadius, m_maxRadius[i]);
+			/* Pad the cells slightly, so that rounding can never make
+			   the region of a gather point straddle three cells */
+			if (maxRadius > 0)
+				m_invCellSize = 1 / (2 * maxRadius * (Float) 1.001f);
+		}
+
+		static inline uint32_t hashCell(int x, int y, int z) {
+			return ((uint32_t) x * 73856093u) ^ ((uint32_t) y * 19349663u)
+				^ ((uint32_t) z * 83492791u);
+		}
+
+		/// Generate the gather point of a pixel and insert it into the grid
+		void traceGatherPoint(const Scene &scene, const Sensor &sensor, Sampler *sampler, const Point2i &pixel) {
+			int32_t index = pixel.y * m_size.x + pixel.x;
+			GatherPoint &gp = m_points[index];
+			gp.pos = pixel;
+
+			sampler->generate(pixel);
+			Point2 apertureSample(0.5f);
+			Float timeSample = 0.5f;
+			if (sensor.needsApertureSample())
+				apertureSample = sampler->next2D();
+			if (sensor.needsTimeSample())
+				timeSample = sampler->next1D();
+			Point2 sample = Point2(pixel) + Vector2(sampler->next2D());
+
+			RayDifferential ray;
+			Spectrum weight = sensor.sampleRayDifferential(ray, sample, apertureSample, timeSample);
+			m_integrator->traceGatherPoint(&scene, sampler, ray, weight, gp);
+			sampler->advance();
+
+			if (gp.depth == -1)
+				return;
+
+			/* Link the point into every bucket that its region overlaps */
+			Vector rel = gp.its.p - m_gridOrigin;
+			Point3i lo, hi;
+			for (int i=0; i<3; ++i) {
+				lo[i] = math::floorToInt((rel[i] - gp.radius) * m_invCellSize);
+				hi[i] = math::floorToInt((rel[i] + gp.radius) * m_invCellSize);
+				/* At most two cells per axis, as assumed by the sizes of
+				   'buckets' and 'm_entries' */
+				hi[i] = std::min(hi[i], lo[i] + 1);
+			}
+
+			uint32_t buckets[8];
+			int bucketCount = 0;
+			for (int z=lo.z; z<=hi.z; ++z) {
+				for (int y=lo.y; y<=hi.y; ++y) {
+					for (int x=lo.x; x<=hi.x; ++x) {
+						uint32_t bucket = hashCell(x, y, z) & m_cellMask;
+						if (std::find(buckets, buckets + bucketCount, bucket) != buckets + bucketCount)
+							continue; /* Colliding cells must not count photons twice */
+						buckets[bucketCount++] = bucket;
+
+						/* 'm_entries' holds eight entries per pixel, which is the worst
+						   case. Should that ever be exceeded, count the lost references
+						   so that the bias does not go unnoticed. */
+						int32_t entry = atomicAdd(&m_entryCount, 1) - 1;
+						if (EXPECT_NOT_TAKEN(entry >= (int32_t) m_entries.size())) {
+							atomicAdd(&m_droppedRefs, 1);
+							return;
+						}
+						volatile int32_t *head = &m_cells[bucket];
+						int32_t next;
+						m_entries[entry].point = index;
+						do {
+							next = *head;
+							m_entries[entry].next = next;
+						} while (!atomicCompareAndExchange(head, entry, next));
+					}
+				}
+			}
+		}
+
+		/// Accumulate a photon into all gather points within range
+		void splatPhoton(const Intersection &its, const Vector &wi, const Spectrum &power, int depth) {
+			Vector rel = its.p - m_gridOrigin;
+			uint32_t bucket = hashCell(
+				math::floorToInt(rel.x * m_invCellSize),
+				math::floorToInt(rel.y * m_invCellSize),
+				math::floorToInt(rel.z * m_invCellSize)) & m_cellMask;
+
+			const Normal &n = its.geoFrame.n;
+			Float wiDotGeoN = absDot(n, wi);
+			int maxDepth = m_integrator->m_maxDepth;
+
+			for (int32_t entry = m_cells[bucket]; entry != -1; entry = m_entries[entry].next) {
+				int32_t index = m_entries[entry].point;
+				const GatherPoint &gp = m_points[index];
+				if ((gp.its.p - its.p).lengthSquared() > gp.radius * gp.radius)
+					continue;
+				atomicAdd(&m_photonCounts[index], 1);
+
+				/* Same filter as the raw radiance query of the photon map */
+				if ((maxDepth != -1 && depth > maxDepth - gp.depth)
+					|| dot(n, gp.its.shFrame.n) < 1e-1f
+					|| wiDotGeoN < 1e-2f)
+					continue;
+
+				BSDFSamplingRecord bRec(gp.its, gp.its.toLocal(wi), gp.its.wi, EImportance);
+				Spectrum value = power * gp.its.getBSDF()->eval(bRec);
+				if (value.isZero())
+					continue;
+
+				/* Account for non-symmetry due to shading normals */
+				value *= std::abs(Frame::cosTheta(bRec.wi) /
+					(wiDotGeoN * Frame::cosTheta(bRec.wo)));
+
+				volatile Float *flux = &m_photonFlux[index * SPECTRUM_SAMPLES];
+				for (int i=0; i<SPECTRUM_SAMPLES; ++i)
+					atomicAdd(flux + i, value[i]);
+			}
+		}
+
+		/// Trace particles from the emitters, returns the number of emitted particles
+		size_t tracePhotons(const Scene &scene, const Sensor &sensor, Sampler *sampler,
+				size_t count, const Controls &controls) {
+			int maxDepth = m_integrator->m_maxDepth == -1 ? -1 : m_integrator->m_maxDepth - 1;
+			int rrDepth = m_integrator->m_rrDepth;
+			bool needsTimeSample = sensor.needsTimeSample();
+			Float time = sensor.getShutterOpen() + 0.5f * sensor.getShutterOpenTime();
+			Intersection its;
+			int returnCode;
+
+			size_t shot = 0;
+			for (; shot < count; ++shot) {
+				if ((shot & 1023) == 0 && stopRequested(controls, returnCode)) {
+					m_abandoned = true;
+					break;
+				}
+
+				if (needsTimeSample)
+					time = sensor.sampleTime(sampler->next1D());
+
+				const Emitter *emitter = NULL;
+				Ray ray;
+				Spectrum power = scene.sampleEmitterRay(ray, emitter,
+					sampler->next2D(), sampler->next2D(), time);
+
+				int depth = 1, nullInteractions = 0;
+				Spectrum throughput(1.0f);
+				while (!throughput.isZero() && (depth <= maxDepth || maxDepth < 0)) {
+					if (!scene.rayIntersectAll(ray, its))
+						break;
+
+					const BSDF *bsdf = its.getBSDF();
+					int bsdfType = bsdf->getType();
+					Vector wi = -ray.d;
+					if ((bsdfType & BSDF::EDiffuseReflection) || (bsdfType & BSDF::EGlossyReflection))
+						splatPhoton(its, wi, throughput * power, depth - nullInteractions);
+
+					BSDFSamplingRecord bRec(its, sampler, EImportance);
+					Spectrum bsdfWeight = bsdf->sample(bRec, sampler->next2D());
+					if (bsdfWeight.isZero())
+						break;
+
+					/* Prevent light leaks due to the use of shading normals */
+					Vector wo = its.toWorld(bRec.wo);
+					Float wiDotGeoN = dot(its.geoFrame.n, wi),
+					      woDotGeoN = dot(its.geoFrame.n, wo);
+					if (wiDotGeoN * Frame::cosTheta(bRec.wi) <= 0 ||
+						woDotGeoN * Frame::cosTheta(bRec.wo) <= 0)
+						break;
+
+					throughput *= bsdfWeight;
+					if (bRec.sampledType & BSDF::ENull)
+						++nullInteractions;
+
+					ray.setOrigin(its.p);
+					ray.setDirection(wo);
+					ray.mint = Epsilon;
+
+					if (depth++ >= rrDepth) {
+						Float q = std::min(throughput.max(), (Float) 0.95f);
+						if (sampler->next1D() >= q)
+							break;
+						throughput /= q;
+					}
+				}
+			}
+			return shot;
+		}
+
+		/**
+		 * \brief Update the gather points of the rows owned by a thread
+		 *
+		 * Pixels are never shared between threads, hence the current
+		 * estimate overwrites the pixel instead of being splatted.
+		 */
+		void updateRows(ImageBlock &target, int threadIdx, int threadCount) {
+			Bitmap *bitmap = target.getBitmap();
+			const int channels = bitmap->getChannelCount(),
+			          border = target.getBorderSize();
+			const Point2i offset = target.getOffset();
+			size_t shot = (size_t) m_passEmitted,
+			       totalEmitted = m_totalEmitted + shot;
+			Float maxRadius = 0;
+
+			for (int y=threadIdx; y<m_size.y; y += threadCount) {
+				Float *dest = bitmap->getFloatData() + ((size_t) (y - offset.y + border)
+					* bitmap->getWidth() + (border - offset.x)) * channels;
+				for (int x=0; x<m_size.x; ++x, dest += channels) {
+					size_t index = (size_t) y * m_size.x + x;
+					GatherPoint &gp = m_points[index];
+					Float *photonFlux = &m_photonFlux[index * SPECTRUM_SAMPLES];
+
+					Spectrum flux;
+					for (int i=0; i<SPECTRUM_SAMPLES; ++i) {
+						flux[i] = photonFlux[i];
+						photonFlux[i] = 0;
+					}
+					Float M = (Float) m_photonCounts[index];
+					m_photonCounts[index] = 0;
+
+					Spectrum contrib = m_integrator->updateGatherPoint(gp, M, flux, shot, totalEmitted);
+					maxRadius = std::max(maxRadius, gp.radius);
+
+					/* Spectrum, followed by unit alpha and filter weight */
+					for (int i=0; i<channels; ++i)
+						dest[i] = i < SPECTRUM_SAMPLES ? contrib[i] : (Float) 1;
+				}
+			}
+			m_maxRadius[threadIdx] = maxRadius;
+		}
+
+	private:
+		SPPMIntegrator *m_integrator;
+		ref<Sampler> m_independentSampler;
+		ref_vector<Sampler> m_samplers;
+		Vector2i m_size;
+
+		std::vector<GatherPoint> m_points;
+		std::vector<Float> m_photonFlux;
+		std::vector<int32_t> m_photonCounts;
+
+		std::vector<int32_t> m_cells;
+		std::vector<GridEntry> m_entries;
+		uint32_t m_cellMask;
+		Point m_gridOrigin;
+		Float m_invCellSize;
+		volatile int32_t m_entryCount;
+		int32_t m_gridRefs;
+		volatile int32_t m_droppedRefs;
+
+		Barrier m_barrier;
+		std::vector<int> m_threadCodes;
+		std::vector<Float> m_maxRadius;
+		volatile int64_t m_passEmitted;
+		size_t m_totalEmitted;
+		int m_pass;
+		bool m_passActive;
+		volatile bool m_abandoned;
+		int m_returnCode;
+
+		ref<Timer> m_timer;
+		char m_statisticsBuffer[256];
+	};
+
 	ref<ResponsiveIntegrator> makeResponsiveIntegrator() override {
-		if (getProperties().getBoolean("strictConfiguration", true))
-			return nullptr;
-		else
-			Log(EWarn, "Interactive implementation uses different integrator!");
-
-		mitsuba::Properties pmProps(getProperties());
-		pmProps.setPluginName("photonmapper");
-
-		mitsuba::ref<mitsuba::PluginManager> pluginMgr = mitsuba::PluginManager::getInstance();
-		mitsuba::ref<mitsuba::Integrator> newIntegrator = static_cast<mitsuba::Integrator *>(
-			pluginMgr->createObject(MTS_CLASS(mitsuba::Integrator), pmProps)
-			);
-
-		newIntegrator->setParent(this); // ok, not a sampling integrator so ignored in PM recursion
-		newIntegrator->configure();
-		return newIntegrator->makeResponsiveIntegrator();
+		return new SPPMResponsive(this);
 	}
 
 	MTS_DECLARE_CLASS()
@@ -70,6 +70,13 @@ void PathSampler::sampleSplats(const Point2i &offset, SplatList &list) {
 				if (sensor->needsTimeSample())
 					time = sensor->sampleTime(m_sensorSampler->next1D());
 
+				/* The subpaths only live until the end of this function. Unless
+				   the pool also holds longer-lived paths (e.g. the state of an
+				   MLT chain), allocate them from an arena and reset it at once */
+				bool arena = !m_pool.isArenaMode() && m_pool.unused();
+				if (arena)
+					m_pool.setArenaMode(true);
+
 				/* Initialize the path endpoints */
 				m_emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
 				m_sensorSubpath.initialize(m_scene, time, ERadiance, m_pool);
@@ -269,6 +276,10 @@ void PathSampler::sampleSplats(const Point2i &offset, SplatList &list) {
 				/* Release any used edges and vertices back to the memory pool */
 				m_sensorSubpath.release(m_pool);
 				m_emitterSubpath.release(m_pool);
+				if (arena) {
+					m_pool.reset();
+					m_pool.setArenaMode(false);
+				}
 			}
 			break;
 
@@ -20,6 +20,7 @@
 #define BOOST_MPL_LIMIT_VECTOR_SIZE 40
 
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/sse.h>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/for_each.hpp>
 #include <boost/mpl/fold.hpp>
@@ -37,10 +38,16 @@ namespace mpl = boost::mpl;
 /*  for each possible combination of source & target pixel and component    */
 /*  formats. The switch() and Boost MPL craziness below does exactly this:  */
 /*  it produces code for each possible pair                                 */
+/*  Large conversions are split into chunks that are processed in parallel, */
+/*  and conversions to half precision and 8 bit integers (i.e. the common   */
+/*  output formats of the films) use dedicated SSE store kernels.           */
 /****************************************************************************/
-/*  Note that some cases in this file really scream for SSE optimization    */
-/*  (in case they ever become a bottleneck, that is..)                      */
-/****************************************************************************/
+
+/// Number of pixels above which a conversion is split into parallel chunks
+#define MTS_FMTCONV_CHUNK_SIZE 16384
+
+/// Number of staged values that are packed at once by the store kernels
+#define MTS_FMTCONV_STAGING_SIZE 1024
 
 namespace detail {
 	/* Mapping from a C++ type to Bitmap::EComponentFormat */
@@ -77,6 +84,174 @@ namespace detail {
 	template <> inline half safe_cast(double a) {
 		return static_cast<half>(static_cast<float>(a));
 	}
+
+	/// Return the number of channels of a pixel format
+	inline int getChannelCount(Bitmap::EPixelFormat format, int channelCount) {
+		switch (format) {
+			case Bitmap::ELuminance:            return 1;
+			case Bitmap::ELuminanceAlpha:       return 2;
+			case Bitmap::ERGB:
+			case Bitmap::EXYZ:                  return 3;
+			case Bitmap::EXYZA:
+			case Bitmap::ERGBA:                 return 4;
+			case Bitmap::ESpectrum:             return SPECTRUM_SAMPLES;
+			case Bitmap::ESpectrumAlpha:        return SPECTRUM_SAMPLES + 1;
+			case Bitmap::ESpectrumAlphaWeight:  return SPECTRUM_SAMPLES + 2;
+			case Bitmap::EMultiChannel:         return channelCount;
+			default:
+				SLog(EError, "Unsupported source/target pixel format!");
+				return 0;
+		}
+	}
+
+	/// Return the number of leading channels that carry color (i.e. not alpha or weight)
+	inline int getColorChannelCount(Bitmap::EPixelFormat format, int channelCount) {
+		switch (format) {
+			case Bitmap::ELuminanceAlpha:       return 1;
+			case Bitmap::ERGBA:
+			case Bitmap::EXYZA:                 return 3;
+			case Bitmap::ESpectrumAlpha:
+			case Bitmap::ESpectrumAlphaWeight:  return SPECTRUM_SAMPLES;
+			default:                            return getChannelCount(format, channelCount);
+		}
+	}
+
+	/**
+	 * \brief Quantizes linear values to 8 bit while applying a gamma curve
+	 *
+	 * Rather than evaluating the curve for every value, this class precomputes
+	 * the linear-space thresholds at which the quantized output changes and
+	 * locates values using a branch-free bisection. The result is identical
+	 * to rounding the gamma-corrected value to the nearest integer.
+	 */
+	class GammaEncoder8 {
+	public:
+		/// Create an encoder for the given gamma value (-1 denotes sRGB)
+		GammaEncoder8(Float gamma) {
+			m_thresholds[0] = -std::numeric_limits<Float>::infinity();
+			for (int i=1; i<256; ++i) {
+				Float value = (i - (Float) 0.5f) * (Float) (1.0 / 255.0), linear;
+				if (gamma == -1) {
+					if (value <= (Float) 0.04045)
+						linear = value * (Float) (1.0 / 12.92);
+					else
+						linear = std::pow((Float) ((value + (Float) 0.055) * (Float) (1.0 / 1.055)), (Float) 2.4);
+				} else {
+					linear = std::pow(value, gamma);
+				}
+				m_thresholds[i] = linear;
+			}
+		}
+
+		/// Quantize a linear value
+		inline uint8_t operator()(Float value) const {
+			int index = 0;
+			for (int step = 128; step > 0; step >>= 1)
+				index += (value >= m_thresholds[index + step]) ? step : 0;
+			return (uint8_t) index;
+		}
+	private:
+		Float m_thresholds[256];
+	};
+
+	/// Clamp and round a value in [0, 1] to 8 bit
+	inline uint8_t quantize8(Float value) {
+		return (uint8_t) std::min((Float) 255, std::max((Float) 0, value * (Float) 255 + (Float) 0.5f));
+	}
+
+	/// Pack a sequence of values into 8 bit, optionally applying a gamma curve to the color channels
+	inline void packValues(const Float *source, uint8_t *dest, size_t count,
+			int channels, int colorChannels, const GammaEncoder8 *encoder) {
+		if (encoder) {
+			for (size_t i=0; i<count; i += channels) {
+				for (int j=0; j<colorChannels; ++j)
+					dest[i+j] = (*encoder)(source[i+j]);
+				for (int j=colorChannels; j<channels; ++j)
+					dest[i+j] = quantize8(source[i+j]);
+			}
+			return;
+		}
+
+		size_t i = 0;
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+		const __m128 scale = _mm_set1_ps(255.0f), offset = _mm_set1_ps(0.5f),
+		             zero = _mm_setzero_ps();
+		for (; i+16 <= count; i += 16) {
+			__m128i q[4];
+			for (int j=0; j<4; ++j) {
+				__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(source + i + 4*j), scale), offset);
+				v = _mm_min_ps(_mm_max_ps(v, zero), scale);
+				q[j] = _mm_cvttps_epi32(v);
+			}
+			/* Values are in [0, 255], hence the saturating packs are exact */
+			__m128i packed = _mm_packus_epi16(
+				_mm_packs_epi32(q[0], q[1]), _mm_packs_epi32(q[2], q[3]));
+			_mm_storeu_si128((__m128i *) (dest + i), packed);
+		}
+#endif
+		for (; i<count; ++i)
+			dest[i] = quantize8(source[i]);
+	}
+
+	/// Pack a sequence of values into half precision (rounding to nearest even)
+	inline void packValues(const Float *source, half *dest, size_t count,
+			int, int, const GammaEncoder8 *) {
+		size_t i = 0;
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION)
+		/* Branch-free float->half conversion after F. Giesen's
+		   'float_to_half_fast3_rtne'. Handles denormals, overflow,
+		   infinities and NaNs like the scalar conversion. */
+		const __m128i signMask   = _mm_set1_epi32((int) 0x80000000),
+		              f32infty   = _mm_set1_epi32(255 << 23),
+		              f16max     = _mm_set1_epi32((127 + 16) << 23),
+		              denormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23),
+		              minNormal  = _mm_set1_epi32(113 << 23),
+		              roundBias  = _mm_set1_epi32(((15 - 127) << 23) + 0xfff),
+		              one        = _mm_set1_epi32(1),
+		              infNan     = _mm_set1_epi32(0x7e00),
+		              inf        = _mm_set1_epi32(0x7c00);
+
+		for (; i+4 <= count; i += 4) {
+			__m128i f = _mm_castps_si128(_mm_loadu_ps(source + i));
+			__m128i sign = _mm_and_si128(f, signMask);
+			f = _mm_xor_si128(f, sign);
+
+			/* Overflow, infinity and NaN */
+			__m128i isOverflow = _mm_cmpgt_epi32(f, _mm_sub_epi32(f16max, one));
+			__m128i isNaN = _mm_cmpgt_epi32(f, f32infty);
+			__m128i special = _mm_or_si128(
+				_mm_and_si128(isNaN, infNan), _mm_andnot_si128(isNaN, inf));
+
+			/* Denormalized results: let the FPU do the rounding */
+			__m128i isDenorm = _mm_cmplt_epi32(f, minNormal);
+			__m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(
+				_mm_castsi128_ps(f), _mm_castsi128_ps(denormMagic))), denormMagic);
+
+			/* Normalized results: rebias the exponent, round to nearest even */
+			__m128i mantOdd = _mm_and_si128(_mm_srli_epi32(f, 13), one);
+			__m128i normal = _mm_srli_epi32(_mm_add_epi32(
+				_mm_add_epi32(f, roundBias), mantOdd), 13);
+
+			__m128i result = _mm_or_si128(_mm_and_si128(isDenorm, denorm),
+				_mm_andnot_si128(isDenorm, normal));
+			result = _mm_or_si128(_mm_and_si128(isOverflow, special),
+				_mm_andnot_si128(isOverflow, result));
+			result = _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+
+			/* Narrow to 16 bit (the sign bit rules out a saturating pack) */
+			result = _mm_shufflelo_epi16(result, _MM_SHUFFLE(3, 3, 2, 0));
+			result = _mm_shufflehi_epi16(result, _MM_SHUFFLE(3, 3, 2, 0));
+			result = _mm_shuffle_epi32(result, _MM_SHUFFLE(3, 3, 2, 0));
+			_mm_storel_epi64((__m128i *) (dest + i), result);
+		}
+#endif
+		for (; i<count; ++i)
+			dest[i] = half((float) source[i]);
+	}
+
+	/// Fallback for formats without a dedicated store kernel (never called)
+	template <typename T> inline void packValues(const Float *, T *, size_t,
+			int, int, const GammaEncoder8 *) { }
 }
 
 template <typename T> struct FormatConverterImpl : public FormatConverter {
@@ -124,22 +299,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 		/* Revert to memcpy when the underlying data needs no transformation */
 		if ((int) detail::get_pixelformat<SourceFormat>::value == (int) detail::get_pixelformat<DestFormat>::value &&
 			sourceFormat == destFormat && sourceGamma == destGamma && multiplier == 1.0) {
-			switch (sourceFormat) {
-				case Bitmap::ELuminance:            channelCount = 1; break;
-				case Bitmap::ELuminanceAlpha:       channelCount = 2; break;
-				case Bitmap::ERGB:
-				case Bitmap::EXYZ:                  channelCount = 3; break;
-				case Bitmap::EXYZA:
-				case Bitmap::ERGBA:                 channelCount = 4; break;
-				case Bitmap::ESpectrum:             channelCount = SPECTRUM_SAMPLES; break;
-				case Bitmap::ESpectrumAlpha:        channelCount = SPECTRUM_SAMPLES + 1; break;
-				case Bitmap::ESpectrumAlphaWeight:  channelCount = SPECTRUM_SAMPLES + 2; break;
-				case Bitmap::EMultiChannel:         break;
-				default:
-					SLog(EError, "Unsupported source/target pixel format!");
-					return;
-			}
-			memcpy(_dest, _source, sizeof(SourceFormat) * channelCount * count);
+			memcpy(_dest, _source, sizeof(SourceFormat) * detail::getChannelCount(sourceFormat, channelCount) * count);
 			return;
 		}
 
@@ -157,7 +317,132 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 				precomp[i] = convertScalar<DestFormat>(detail::safe_cast<SourceFormat>(i), sourceGamma, NULL, multiplier, invDestGamma);
 		}
 
-		const DestFormat one = convertScalar<DestFormat>(1.0f);
+		/* Gamma-corrected 8 bit output is produced by a table-based encoder.
+		   Its setup costs ~255 pow() evaluations, hence only use it for
+		   conversions that are large enough to amortize this */
+		detail::GammaEncoder8 *encoder = NULL;
+		const int sourceChannels = detail::getChannelCount(sourceFormat, channelCount),
+		          destChannels = detail::getChannelCount(destFormat, channelCount);
+		if (boost::is_same<DestFormat, uint8_t>::value && !precomp && destGamma != 1
+				&& count * destChannels >= 4 * MTS_FMTCONV_STAGING_SIZE)
+			encoder = new (alloca(sizeof(detail::GammaEncoder8))) detail::GammaEncoder8(destGamma);
+
+		/* Large conversions (e.g. when developing a film) are split into chunks
+		   that are converted in parallel. The first chunk is processed on the
+		   calling thread, which also reports unsupported format combinations
+		   (exceptions cannot propagate out of the parallel region) */
+		const size_t chunkSize = MTS_FMTCONV_CHUNK_SIZE;
+		convertChunk(sourceFormat, sourceGamma, source, destFormat, invDestGamma, dest,
+			std::min(count, chunkSize), multiplier, intent, channelCount, precomp, encoder);
+		if (count <= chunkSize)
+			return;
+
+		const int nChunks = (int) ((count + chunkSize - 1) / chunkSize);
+		#if defined(MTS_OPENMP)
+			#pragma omp parallel for schedule(dynamic)
+		#endif
+		for (int i=1; i<nChunks; ++i) {
+			size_t offset = (size_t) i * chunkSize;
+			convertChunk(sourceFormat, sourceGamma, source + offset * sourceChannels,
+				destFormat, invDestGamma, dest + offset * destChannels,
+				std::min(count - offset, chunkSize), multiplier, intent,
+				channelCount, precomp, encoder);
+		}
+	}
+
+private:
+	/**
+	 * \brief Convert a range of pixels
+	 *
+	 * Conversions to half precision and 8 bit integers first produce
+	 * floating point values in a small staging buffer, which are then
+	 * packed using the SSE kernels in the \c detail namespace.
+	 */
+	void convertChunk(Bitmap::EPixelFormat sourceFormat, Float sourceGamma, const SourceFormat *source,
+			Bitmap::EPixelFormat destFormat, Float invDestGamma, DestFormat *dest,
+			size_t count, Float multiplier, Spectrum::EConversionIntent intent, int channelCount,
+			DestFormat *precomp, const detail::GammaEncoder8 *encoder) const {
+		const bool staged = (boost::is_same<DestFormat, half>::value
+			|| boost::is_same<DestFormat, uint8_t>::value) && !precomp;
+
+		if (!staged) {
+			convertPixels<DestFormat>(sourceFormat, sourceGamma, source, destFormat,
+				invDestGamma, dest, count, multiplier, intent, channelCount, precomp);
+			return;
+		}
+
+		const int sourceChannels = detail::getChannelCount(sourceFormat, channelCount),
+		          destChannels = detail::getChannelCount(destFormat, channelCount),
+		          colorChannels = detail::getColorChannelCount(destFormat, channelCount);
+		const size_t pixelsPerPass = std::max((size_t) 1,
+			(size_t) (MTS_FMTCONV_STAGING_SIZE / destChannels));
+
+		/* The encoder applies the gamma curve itself */
+		Float stagingInvGamma = encoder ? (Float) 1 : invDestGamma;
+		Float *staging = (Float *) alloca(sizeof(Float)
+			* std::max(MTS_FMTCONV_STAGING_SIZE, destChannels));
+
+		for (size_t i=0; i<count; i += pixelsPerPass) {
+			size_t n = std::min(pixelsPerPass, count - i);
+			convertPixels<Float>(sourceFormat, sourceGamma, source + i * sourceChannels,
+				destFormat, stagingInvGamma, staging, n, multiplier, intent, channelCount, NULL);
+			detail::packValues(staging, dest + i * destChannels, n * destChannels,
+				destChannels, colorChannels, encoder);
+		}
+	}
+
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION) && SPECTRUM_SAMPLES == 3
+	/**
+	 * \brief Develop weighted RGB samples (the internal format of the films)
+	 * into RGB or RGBA using SSE
+	 *
+	 * Equivalent to the generic code path, which applies the same
+	 * operations with the same rounding.
+	 */
+	static void developRGB(const float *source, float *dest, size_t count,
+			float multiplier, bool alpha) {
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+		/* Scale the color channels by the multiplier, the alpha channel only by 1/weight */
+		const __m128 scale = _mm_setr_ps(multiplier, multiplier, multiplier, 1.0f);
+		float MM_ALIGN16 temp[4];
+
+		for (size_t i=0; i<count; ++i) {
+			/* r, g, b, alpha (the weight follows in the next slot) */
+			__m128 value = _mm_loadu_ps(source);
+			__m128 weight = _mm_set1_ps(source[4]);
+			__m128 mask = _mm_cmpneq_ps(weight, zero);
+			__m128 invWeight = _mm_or_ps(_mm_and_ps(mask, _mm_div_ps(one, weight)),
+				_mm_andnot_ps(mask, weight));
+			value = _mm_mul_ps(_mm_mul_ps(value, invWeight), scale);
+			source += 5;
+
+			if (alpha) {
+				_mm_storeu_ps(dest, value);
+				dest += 4;
+			} else {
+				_mm_store_ps(temp, value);
+				dest[0] = temp[0]; dest[1] = temp[1]; dest[2] = temp[2];
+				dest += 3;
+			}
+		}
+	}
+#endif
+
+	template <typename DestFmt> void convertPixels(Bitmap::EPixelFormat sourceFormat,
+			Float sourceGamma, const SourceFormat *source, Bitmap::EPixelFormat destFormat,
+			Float invDestGamma, DestFmt *dest, size_t count, Float multiplier,
+			Spectrum::EConversionIntent intent, int channelCount, DestFmt *precomp) const {
+#if defined(MTS_SSE) && defined(SINGLE_PRECISION) && SPECTRUM_SAMPLES == 3
+		if (boost::is_same<SourceFormat, float>::value && boost::is_same<DestFmt, float>::value
+				&& sourceFormat == Bitmap::ESpectrumAlphaWeight && sourceGamma == 1 && invDestGamma == 1
+				&& (destFormat == Bitmap::ERGB || destFormat == Bitmap::ERGBA)) {
+			developRGB(reinterpret_cast<const float *>(source), reinterpret_cast<float *>(dest),
+				count, (float) multiplier, destFormat == Bitmap::ERGBA);
+			return;
+		}
+#endif
+
+		const DestFmt one = convertScalar<DestFmt>(1.0f);
 
 		Spectrum spec;
 
@@ -166,26 +451,26 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 					switch (destFormat) {
 						case Bitmap::ELuminance:
 							for (size_t i=0; i<count; ++i)
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							break;
 
 						case Bitmap::ELuminanceAlpha:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
 
 						case Bitmap::ERGB:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = value; *dest++ = value; *dest++ = value;
 							}
 							break;
 
 						case Bitmap::ERGBA:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = value; *dest++ = value; *dest++ = value; *dest++ = one;
 							}
 							break;
@@ -193,25 +478,25 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::EXYZ:
 							for (size_t i=0; i<count; ++i) {
 								Float value = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
 						case Bitmap::EXYZA:
 							for (size_t i=0; i<count; ++i) {
 								Float value = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
 
 						case Bitmap::ESpectrum:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
 							}
@@ -219,7 +504,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 
 						case Bitmap::ESpectrumAlpha:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
 								*dest++ = one;
@@ -228,7 +513,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 
 						case Bitmap::ESpectrumAlphaWeight:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
 								*dest++ = one; *dest++ = one;
@@ -245,21 +530,21 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 					switch (destFormat) {
 						case Bitmap::ELuminance:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								source++;
 							}
 							break;
 
 						case Bitmap::ELuminanceAlpha:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ERGB:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = value; *dest++ = value; *dest++ = value;
 								source++;
 							}
@@ -267,18 +552,18 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 
 						case Bitmap::ERGBA:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = value; *dest++ = value; *dest++ = value;
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::EXYZ:
 							for (size_t i=0; i<count; ++i) {
 								Float value = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -286,16 +571,16 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::EXYZA:
 							for (size_t i=0; i<count; ++i) {
 								Float value = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(value * 0.950456f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(value * 1.08875f, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ESpectrum:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
 								source++;
@@ -304,19 +589,19 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 
 						case Bitmap::ESpectrumAlpha:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ESpectrumAlphaWeight:
 							for (size_t i=0; i<count; ++i) {
-								DestFormat value = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								DestFmt value = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									*dest++ = value;
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++);
 								*dest++ = one;
 							}
 							break;
@@ -335,7 +620,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Float luminance = RGBToLuminance(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -345,24 +630,24 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Float luminance = RGBToLuminance(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
 
 						case Bitmap::ERGB:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							}
 							break;
 
 						case Bitmap::ERGBA:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -373,9 +658,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Color3 xyz = RGBToXYZ(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -385,9 +670,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Color3 xyz = RGBToXYZ(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -399,7 +684,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -410,7 +695,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -422,7 +707,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one; *dest++ = one;
 							}
 							break;
@@ -441,7 +726,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Float luminance = RGBToLuminance(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -452,26 +737,26 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Float luminance = RGBToLuminance(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ERGB:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								source++;
 							}
 							break;
 
 						case Bitmap::ERGBA:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -481,9 +766,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Color3 xyz = RGBToXYZ(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -494,10 +779,10 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float g = convertScalar<Float>(*source++, sourceGamma);
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								Color3 xyz = RGBToXYZ(Color3(r, g, b));
-								*dest++ = convertScalar<DestFormat>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(xyz[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(xyz[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -508,7 +793,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -520,8 +805,8 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -532,9 +817,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float b = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromLinearRGB(r, g, b, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
-								*dest++ = convertScalar<DestFormat>(1.0f);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
+								*dest++ = convertScalar<DestFmt>(1.0f);
 							}
 							break;
 
@@ -549,7 +834,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ELuminance:
 							for (size_t i=0; i<count; ++i) {
 								Float luminance = convertScalar<Float>(source[1], sourceGamma);
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								source += 3;
 							}
 							break;
@@ -557,7 +842,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ELuminanceAlpha:
 							for (size_t i=0; i<count; ++i) {
 								Float luminance = convertScalar<Float>(source[1], sourceGamma);
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 								source += 3;
 							}
@@ -569,9 +854,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float y = convertScalar<Float>(*source++, sourceGamma);
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								Color3 rgb = XYZToRGB(Color3(x, y, z));
-								*dest++ = convertScalar<DestFormat>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -581,26 +866,26 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float y = convertScalar<Float>(*source++, sourceGamma);
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								Color3 rgb = XYZToRGB(Color3(x, y, z));
-								*dest++ = convertScalar<DestFormat>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
 
 						case Bitmap::EXYZ:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							}
 							break;
 
 						case Bitmap::EXYZA:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -612,7 +897,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -623,7 +908,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -635,7 +920,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one; *dest++ = one;
 							}
 							break;
@@ -651,7 +936,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ELuminance:
 							for (size_t i=0; i<count; ++i) {
 								Float luminance = convertScalar<Float>(source[1], sourceGamma);
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								source += 4;
 							}
 							break;
@@ -659,9 +944,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ELuminanceAlpha:
 							for (size_t i=0; i<count; ++i) {
 								Float luminance = convertScalar<Float>(source[1], sourceGamma);
-								*dest++ = convertScalar<DestFormat>(luminance, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(luminance, 1.0f, NULL, multiplier, invDestGamma);
 								source += 3;
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -671,9 +956,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float y = convertScalar<Float>(*source++, sourceGamma);
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								Color3 rgb = XYZToRGB(Color3(x, y, z));
-								*dest++ = convertScalar<DestFormat>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -684,28 +969,28 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float y = convertScalar<Float>(*source++, sourceGamma);
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								Color3 rgb = XYZToRGB(Color3(x, y, z));
-								*dest++ = convertScalar<DestFormat>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(rgb[0], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[1], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(rgb[2], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::EXYZ:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								source++;
 							}
 							break;
 
 						case Bitmap::EXYZA:
 							for (size_t i=0; i<count; ++i) {
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -717,7 +1002,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								source++;
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -728,8 +1013,8 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -740,8 +1025,8 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float z = convertScalar<Float>(*source++, sourceGamma);
 								spec.fromXYZ(x, y, z, intent);
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 								*dest++ = one;
 							}
 							break;
@@ -759,7 +1044,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -767,7 +1052,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -778,9 +1063,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float r, g, b;
 								spec.toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -790,9 +1075,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float r, g, b;
 								spec.toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -803,9 +1088,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float x, y, z;
 								spec.toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -815,22 +1100,22 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float x, y, z;
 								spec.toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
 
 						case Bitmap::ESpectrum:
 							for (size_t i=0, n = count*SPECTRUM_SAMPLES; i<n; ++i)
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							break;
 
 						case Bitmap::ESpectrumAlpha:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = one;
 							}
 							break;
@@ -838,7 +1123,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ESpectrumAlphaWeight:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								*dest++ = one; *dest++ = one;
 							}
 							break;
@@ -855,7 +1140,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -864,8 +1149,8 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance(), 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -875,9 +1160,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float r, g, b;
 								spec.toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -888,10 +1173,10 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float r, g, b;
 								spec.toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -901,9 +1186,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float x, y, z;
 								spec.toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -914,17 +1199,17 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float x, y, z;
 								spec.toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ESpectrum:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 								source++;
 							}
 							break;
@@ -932,16 +1217,16 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 						case Bitmap::ESpectrumAlpha:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
 						case Bitmap::ESpectrumAlphaWeight:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
 								*dest++ = one;
 							}
 							break;
@@ -960,7 +1245,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								source++;
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance()*invWeight, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance()*invWeight, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -970,8 +1255,8 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 									spec[j] = convertScalar<Float>(*source++, sourceGamma);
 								Float alpha = convertScalar<Float>(*source++);
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
-								*dest++ = convertScalar<DestFormat>(spec.getLuminance()*invWeight, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(alpha * invWeight);
+								*dest++ = convertScalar<DestFmt>(spec.getLuminance()*invWeight, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(alpha * invWeight);
 							}
 							break;
 
@@ -983,9 +1268,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								Float r, g, b;
 								Spectrum(spec * invWeight).toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
 							}
 							break;
 
@@ -997,10 +1282,10 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								Float r, g, b;
 								Spectrum(spec * invWeight).toLinearRGB(r, g, b);
-								*dest++ = convertScalar<DestFormat>(r, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(g, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(b, 1.0f, NULL, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(alpha * invWeight);
+								*dest++ = convertScalar<DestFmt>(r, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(g, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(b, 1.0f, NULL, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(alpha * invWeight);
 							}
 							break;
 
@@ -1012,9 +1297,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								Float x, y, z;
 								Spectrum(spec * invWeight * multiplier).toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, 1.0f, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, 1.0f, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, 1.0f, invDestGamma);
 							}
 							break;
 
@@ -1026,10 +1311,10 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								Float x, y, z;
 								Spectrum(spec * invWeight * multiplier).toXYZ(x, y, z);
-								*dest++ = convertScalar<DestFormat>(x, 1.0f, NULL, 1.0f, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(y, 1.0f, NULL, 1.0f, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(z, 1.0f, NULL, 1.0f, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(alpha * invWeight);
+								*dest++ = convertScalar<DestFmt>(x, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(y, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(z, 1.0f, NULL, 1.0f, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(alpha * invWeight);
 							}
 							break;
 
@@ -1040,7 +1325,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								++source;
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier*invWeight, invDestGamma);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier*invWeight, invDestGamma);
 							}
 							break;
 
@@ -1051,17 +1336,17 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 								Float alpha = convertScalar<Float>(*source++);
 								Float weight = convertScalar<Float>(*source++), invWeight = (weight != 0) ? 1 / weight : weight;
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(spec[j], 1.0f, NULL, multiplier*invWeight, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(alpha * invWeight);
+									*dest++ = convertScalar<DestFmt>(spec[j], 1.0f, NULL, multiplier*invWeight, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(alpha * invWeight);
 							}
 							break;
 
 						case Bitmap::ESpectrumAlphaWeight:
 							for (size_t i=0; i<count; ++i) {
 								for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-									*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
-								*dest++ = convertScalar<DestFormat>(*source++);
-								*dest++ = convertScalar<DestFormat>(*source++);
+									*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++);
+								*dest++ = convertScalar<DestFmt>(*source++);
 							}
 							break;
 
@@ -1075,7 +1360,7 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 					switch (destFormat) {
 						case Bitmap::EMultiChannel:
 							for (size_t i=0; i<count*channelCount; ++i)
-								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
+								*dest++ = convertScalar<DestFmt>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							break;
 						default:
 							SLog(EError, "Unsupported destination pixel format!");
@@ -1089,7 +1374,6 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 		}
 	}
 
-private:
 	static Float undoGamma(Float value, Float gamma) {
 		if (gamma == -1) {
 			if (value <= (Float) 0.04045)
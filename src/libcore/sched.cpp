@@ -20,10 +20,162 @@
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/mstream.h>
 
+#include <chrono>
 #include <thread>
 
+/// Targeted processing time of a batch of work units generated for a local worker (in seconds)
+#define MTS_SCHED_BATCH_TIME 0.0005
+
+/// Maximum number of work units generated for a local worker at once
+#define MTS_SCHED_MAX_BATCH  16
+
 MTS_NAMESPACE_BEGIN
 
+/* ==================================================================== */
+/*                        Local worker task queue                       */
+/* ==================================================================== */
+
+/**
+ * Bounded work-stealing deque after Chase and Lev (using the memory
+ * orderings of Le et al., "Correct and Efficient Work-Stealing for Weak
+ * Memory Models"). The owner pushes and pops at the bottom, other workers
+ * steal from the top. The owner only pushes a new batch once its queue is
+ * empty, hence the capacity never needs to grow.
+ */
+class TaskQueue {
+public:
+	typedef Scheduler::Task Task;
+	enum { ECapacity = 2 * MTS_SCHED_MAX_BATCH, EMask = ECapacity - 1 };
+
+	TaskQueue() : m_top(0), m_bottom(0) {
+		for (int i=0; i<ECapacity; ++i)
+			m_tasks[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	/// Append a task (owner only)
+	inline void push(Task *task) {
+		int64_t b = m_bottom.load(std::memory_order_relaxed);
+		m_tasks[b & EMask].store(task, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		m_bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	/// Remove the most recently pushed task (owner only)
+	inline Task *pop() {
+		int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = m_top.load(std::memory_order_relaxed);
+
+		if (t > b) {
+			/* Empty */
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+			return NULL;
+		}
+
+		Task *task = m_tasks[b & EMask].load(std::memory_order_relaxed);
+		if (t == b) {
+			/* Last task -- race against thieves */
+			if (!m_top.compare_exchange_strong(t, t + 1,
+					std::memory_order_seq_cst, std::memory_order_relaxed))
+				task = NULL;
+			m_bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return task;
+	}
+
+	/// Remove the oldest task (any thread)
+	inline Task *steal() {
+		int64_t t = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t b = m_bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return NULL;
+
+		Task *task = m_tasks[t & EMask].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(t, t + 1,
+				std::memory_order_seq_cst, std::memory_order_relaxed))
+			return NULL; /* Lost the race */
+		return task;
+	}
+private:
+	/* Keep the indices on separate cache lines */
+	std::atomic<int64_t> m_top;
+	char m_pad1[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<int64_t> m_bottom;
+	char m_pad2[64 - sizeof(std::atomic<int64_t>)];
+	std::atomic<Task *> m_tasks[ECapacity];
+};
+
+struct LocalWorker::LocalWorkerPrivate {
+	/// Work units that are ready to be processed
+	TaskQueue queue;
+
+	/// Processed tasks, which can be reused
+	std::vector<Scheduler::Task *> freeTasks;
+
+	/// Work units that were processed, but not yet reported to the scheduler
+	struct Completion {
+		ParallelProcess *proc;
+		Scheduler::ProcessRecord *rec;
+		int count;
+		bool stopped;
+	};
+	std::vector<Completion> completed;
+
+	/// Index into Scheduler::m_localWorkers
+	int index;
+
+	/// State of the random number generator used to select steal victims
+	uint32_t rngState;
+
+	/// Moving average of the time taken by one work unit (in seconds)
+	double unitTime;
+
+	LocalWorkerPrivate() : index(-1), rngState(1), unitTime(0) { }
+
+	~LocalWorkerPrivate() {
+		clear();
+	}
+
+	void clear() {
+		Scheduler::Task *task;
+		while ((task = queue.pop()) != NULL)
+			delete task;
+		for (size_t i=0; i<freeTasks.size(); ++i)
+			delete freeTasks[i];
+		freeTasks.clear();
+		completed.clear();
+		unitTime = 0;
+	}
+
+	/// Number of work units to generate at once
+	inline int getBatchSize() const {
+		if (unitTime <= 0)
+			return 1;
+		return (int) std::max(1.0, std::min((double) MTS_SCHED_MAX_BATCH,
+			MTS_SCHED_BATCH_TIME / unitTime));
+	}
+
+	inline void complete(ParallelProcess *proc, Scheduler::ProcessRecord *rec, bool stopped) {
+		if (!completed.empty() && completed.back().rec == rec) {
+			completed.back().count++;
+			completed.back().stopped |= stopped;
+		} else {
+			Completion c = { proc, rec, 1, stopped };
+			completed.push_back(c);
+		}
+	}
+
+	inline uint32_t nextRandom() {
+		/* xorshift32 */
+		rngState ^= rngState << 13;
+		rngState ^= rngState >> 17;
+		rngState ^= rngState << 5;
+		return rngState;
+	}
+};
+
 SerializableObject *WorkProcessor::getResource(const std::string &name) {
 	if (m_resources.find(name) == m_resources.end())
 		Log(EError, "Could not find a resource named \"%s\"!", name.c_str());
@@ -51,7 +203,7 @@ bool ParallelProcess::isLocal() const {
 
 ref<Scheduler> Scheduler::m_scheduler;
 
-Scheduler::Scheduler() {
+Scheduler::Scheduler() : m_queuedTasks(0) {
 	m_mutex = new Mutex();
 	m_workAvailable = new ConditionVariable(m_mutex);
 	m_resourceCounter = 0;
@@ -76,6 +228,8 @@ void Scheduler::unregisterWorker(Worker *worker) {
 	LockGuard lock(m_mutex);
 	m_workers.erase(std::remove(m_workers.begin(), m_workers.end(), worker),
 		m_workers.end());
+	m_localWorkers.erase(std::remove(m_localWorkers.begin(), m_localWorkers.end(), worker),
+		m_localWorkers.end());
 	worker->decRef();
 }
 
@@ -382,6 +536,9 @@ bool Scheduler::cancel(ParallelProcess *process, bool reduceInflight) {
 	Log(rec->logLevel, "Cancelling process %i (%i work units in flight)..", rec->id, rec->inflight);
 #endif
 
+	/* Publish the flag before signaling the workers: a work unit that starts
+	   executing concurrently either sees it or is stopped by the signal */
+	rec->cancelled = true;
 	for (size_t i=0; i<m_workers.size(); ++i)
 		m_workers[i]->signalProcessCancellation(rec->id);
 
@@ -394,7 +551,6 @@ bool Scheduler::cancel(ParallelProcess *process, bool reduceInflight) {
 	/* Ensure that the process won't be considered 'done' when the
 	   last in-flight work unit is returned */
 	rec->morework = true;
-	rec->cancelled = true;
 
 	/* Now wait until no more work from this process circulates and release
 	   the lock while waiting. */
@@ -519,6 +675,151 @@ Scheduler::EStatus Scheduler::acquireWork(Item &item,
 	return EOK;
 }
 
+Scheduler::EStatus Scheduler::acquireLocalWork(LocalWorker *worker, int batchSize) {
+	LocalWorker::LocalWorkerPrivate *lw = worker->m_local.get();
+	Item &item = worker->m_schedItem;
+	UniqueLock lock(m_mutex);
+
+	retireWork(worker);
+
+	while (true) {
+		if (!m_running)
+			return EStop;
+
+		/* Try to create a batch of work units from the parallel
+		   process currently on top of the queue */
+		ParallelProcess::EStatus wStatus = ParallelProcess::EUnknown;
+		int generated = 0;
+		try {
+			for (std::deque<int>::iterator it = m_localQueue.begin(); it != m_localQueue.end(); ++it) {
+				int id = *it;
+				ParallelProcess *proc = m_idToProcess[id];
+				ProcessRecord* rec = m_processes[proc];
+
+				if (rec->workerCount > 0) {
+					bool workerInRange = rec->workerOffset <= item.workerIndex && item.workerIndex < rec->workerOffset + rec->workerCount;
+					int wrapAroundOffset = (rec->workerOffset + rec->workerCount) % (int) m_workers.size();
+					workerInRange |= wrapAroundOffset <= rec->workerOffset && item.workerIndex < wrapAroundOffset;
+					if (!workerInRange)
+						continue;
+				}
+
+				if (item.id != id) {
+					/* First work unit from this parallel process - establish
+					   connections to referenced resources and prepare the
+					   work processor */
+					setProcessByID(item, id);
+				}
+
+				/* Processes with a restricted set of workers don't take part in
+				   work stealing, hence their batches must not be too large */
+				int count = rec->workerCount > 0 ? 1 : batchSize;
+				for (; generated < count; ++generated) {
+					Task *task;
+					if (!lw->freeTasks.empty()) {
+						task = lw->freeTasks.back();
+						lw->freeTasks.pop_back();
+					} else {
+						task = new Task();
+					}
+					if (task->id != id || !task->workUnit)
+						task->workUnit = item.wp->createWorkUnit();
+					task->id = id;
+					task->proc = item.proc;
+					task->rec = item.rec;
+
+					wStatus = item.proc->generateWork(task->workUnit, item.workerIndex);
+					if (wStatus != ParallelProcess::ESuccess) {
+						lw->freeTasks.push_back(task);
+						break;
+					}
+					item.rec->inflight++;
+					lw->queue.push(task);
+					m_queuedTasks++;
+				}
+				break;
+			}
+		} catch (const std::exception &ex) {
+			Log(EWarn, "Caught an exception - canceling process %i: %s",
+				item.id, ex.what());
+			worker->discardTasks(item.id);
+			retireWork(worker);
+			cancel(item.proc);
+			continue;
+		}
+
+		if (wStatus == ParallelProcess::EFailure) {
+#if defined(DEBUG_SCHED)
+			if (item.rec->morework)
+				Log(item.rec->logLevel, "Process %i has finished generating work", item.rec->id);
+#endif
+			item.rec->morework = false;
+			item.rec->active = false;
+			m_localQueue.erase(std::remove(m_localQueue.begin(), m_localQueue.end(), item.id),
+				m_localQueue.end());
+			if (item.rec->inflight == 0)
+				signalProcessTermination(item.proc, item.rec);
+		} else if (wStatus == ParallelProcess::EPause) {
+#if defined(DEBUG_SCHED)
+			Log(item.rec->logLevel, "Pausing process %i", item.rec->id);
+#endif
+			item.rec->active = false;
+			m_localQueue.erase(std::remove(m_localQueue.begin(), m_localQueue.end(), item.id),
+				m_localQueue.end());
+		}
+
+		if (generated > 0) {
+			/* Let idle workers steal from this batch */
+			if (generated > 1 && m_maxWorkersPerProcess <= 0)
+				m_workAvailable->broadcast();
+			return EOK;
+		} else if (wStatus == ParallelProcess::EUnknown) {
+			/* Nothing to generate. Rather than going to sleep,
+			   help with the work units queued by other workers */
+			if (m_queuedTasks.load() > 0 && m_maxWorkersPerProcess <= 0)
+				return ENone;
+			m_workAvailable->wait();
+		}
+	}
+}
+
+Scheduler::Task *Scheduler::stealWork(LocalWorker *thief) {
+	LocalWorker::LocalWorkerPrivate *lw = thief->m_local.get();
+	size_t count = m_localWorkers.size();
+	/* Workers that are restricted to certain processes must not steal */
+	if (count < 2 || m_maxWorkersPerProcess > 0 || m_queuedTasks.load(std::memory_order_relaxed) <= 0)
+		return NULL;
+
+	size_t offset = lw->nextRandom() % count;
+	for (size_t i=0; i<count; ++i) {
+		LocalWorker *victim = m_localWorkers[(offset + i) % count];
+		if (victim == thief)
+			continue;
+		Task *task = victim->m_local->queue.steal();
+		if (task) {
+			m_queuedTasks--;
+			return task;
+		}
+	}
+	return NULL;
+}
+
+void Scheduler::retireWork(LocalWorker *worker) {
+	std::vector<LocalWorker::LocalWorkerPrivate::Completion> &completed = worker->m_local->completed;
+	if (completed.empty())
+		return;
+
+	LockGuard lock(m_mutex);
+	for (size_t i=0; i<completed.size(); ++i) {
+		ProcessRecord *rec = completed[i].rec;
+		rec->inflight -= completed[i].count;
+		rec->cond->signal();
+		if (rec->inflight == 0 && !rec->morework && !completed[i].stopped)
+			signalProcessTermination(completed[i].proc, rec);
+	}
+	completed.clear();
+}
+
 void Scheduler::signalProcessTermination(ParallelProcess *proc, ProcessRecord *rec) {
 #if defined(DEBUG_SCHED)
 	Log(rec->logLevel, "Process %i is complete.", rec->id);
@@ -553,6 +854,16 @@ void Scheduler::start() {
 	if (m_workers.size() == 0)
 		Log(EError, "Cannot start the scheduler - there are no registered workers!");
 
+	m_localWorkers.clear();
+	for (size_t i=0; i<m_workers.size(); ++i) {
+		LocalWorker *worker = dynamic_cast<LocalWorker *>(m_workers[i]);
+		if (worker) {
+			worker->m_local->index = (int) m_localWorkers.size();
+			worker->m_local->rngState = 0x9E3779B9u * (uint32_t) (i + 1);
+			m_localWorkers.push_back(worker);
+		}
+	}
+
 	int coreIndex = 0;
 	for (size_t i=0; i<m_workers.size(); ++i) {
 		m_workers[i]->start(this, (int) i, coreIndex);
@@ -656,7 +967,7 @@ void Worker::start(Scheduler *scheduler, int workerIndex, int coreOffset) {
 }
 
 LocalWorker::LocalWorker(int coreID, const std::string &name,
-		Thread::EThreadPriority priority) : Worker(name) {
+		Thread::EThreadPriority priority) : Worker(name), m_local(new LocalWorkerPrivate()) {
 	if (coreID >= 0)
 		setCoreAffinity(coreID);
 	m_coreCount = 1;
@@ -671,21 +982,117 @@ LocalWorker::~LocalWorker() {
 }
 
 void LocalWorker::run() {
-	while (acquireWork(true) != Scheduler::EStop) {
+	while (true) {
+		Scheduler::Task *task = m_local->queue.pop();
+		if (task)
+			m_scheduler->m_queuedTasks--;
+		else
+			task = m_scheduler->stealWork(this);
+
+		if (!task) {
+			Scheduler::EStatus status = m_scheduler->acquireLocalWork(this, m_local->getBatchSize());
+			if (status == Scheduler::EStop)
+				break;
+			else if (status == Scheduler::ENone)
+				std::this_thread::yield();
+			continue;
+		}
+
+		execute(task);
+	}
+}
+
+void LocalWorker::execute(Scheduler::Task *task) {
+	ParallelProcess *proc = task->proc;
+	Scheduler::ProcessRecord *rec = task->rec;
+	int id = task->id;
+
+	if (m_schedItem.id != id) {
+		/* Work unit of another process (e.g. stolen from
+		   another worker) -- prepare a work processor */
 		try {
-			m_schedItem.wp->process(m_schedItem.workUnit, m_schedItem.workResult, m_schedItem.stop);
+			setProcessByID(m_schedItem, id);
 		} catch (const std::exception &ex) {
-			m_schedItem.stop = true;
-			releaseWork(m_schedItem);
-			ELogLevel warnLogLevel = Thread::getThread()->getLogger()->getErrorLevel() == EError
-				? EWarn : EInfo;
-			Log(warnLogLevel, "Caught an exception - canceling process %i: %s",
-				m_schedItem.id, ex.what());
-			cancel(false);
-			continue;
+			Log(EWarn, "Caught an exception - canceling process %i: %s",
+				id, ex.what());
+			Worker::clear();
+			m_local->freeTasks.push_back(task);
+			m_local->complete(proc, rec, true);
+			discardTasks(id);
+			m_scheduler->retireWork(this);
+			m_scheduler->cancel(proc);
+			return;
+		}
+	}
+
+	/* Pairs with cancel(), which sets 'cancelled' before signaling the
+	   workers: either the flag is visible here, or the subsequent
+	   signalProcessCancellation() sets 'stop' after it was reset */
+	m_schedItem.stop = false;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (rec->cancelled)
+		m_schedItem.stop = true;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	try {
+		m_schedItem.wp->process(task->workUnit, m_schedItem.workResult, m_schedItem.stop);
+	} catch (const std::exception &ex) {
+		m_local->freeTasks.push_back(task);
+		m_schedItem.stop = true;
+		try {
+			proc->processResult(m_schedItem.workResult, true);
+		} catch (const std::exception &) { }
+		m_local->complete(proc, rec, true);
+		ELogLevel warnLogLevel = Thread::getThread()->getLogger()->getErrorLevel() == EError
+			? EWarn : EInfo;
+		Log(warnLogLevel, "Caught an exception - canceling process %i: %s",
+			m_schedItem.id, ex.what());
+		discardTasks(id);
+		m_scheduler->retireWork(this);
+		cancel(false);
+		return;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	m_local->unitTime = m_local->unitTime == 0 ? elapsed
+		: 0.75 * m_local->unitTime + 0.25 * elapsed;
+	m_local->freeTasks.push_back(task);
+
+	try {
+		proc->processResult(m_schedItem.workResult, m_schedItem.stop);
+	} catch (const std::exception &ex) {
+		Log(EWarn, "Caught an exception - canceling process %i: %s",
+			id, ex.what());
+		discardTasks(id);
+		m_scheduler->retireWork(this);
+		cancel(true);
+		return;
+	}
+	m_local->complete(proc, rec, m_schedItem.stop);
+}
+
+void LocalWorker::discardTasks(int id) {
+	std::vector<Scheduler::Task *> keep;
+	Scheduler::Task *task;
+	while ((task = m_local->queue.pop()) != NULL) {
+		m_scheduler->m_queuedTasks--;
+		if (task->id == id) {
+			m_local->complete(task->proc, task->rec, true);
+			m_local->freeTasks.push_back(task);
+		} else {
+			keep.push_back(task);
 		}
-		releaseWork(m_schedItem);
 	}
+	for (size_t i=keep.size(); i-- > 0; ) {
+		m_local->queue.push(keep[i]);
+		m_scheduler->m_queuedTasks++;
+	}
+}
+
+void LocalWorker::clear() {
+	Worker::clear();
+	m_local->clear();
 }
 
 void LocalWorker::signalResourceExpiration(int id) {
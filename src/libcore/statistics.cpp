@@ -19,6 +19,7 @@
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/lock.h>
+#include <mutex>
 
 MTS_NAMESPACE_BEGIN
 
@@ -84,6 +85,63 @@ void ProgressReporter::update(long long value) {
 	}
 }
 
+#if defined(__WINDOWS__)
+namespace detail {
+	/// Counter shard owned by the calling thread (-1 if none has been assigned yet)
+	static thread_local int t_statsShard = -1;
+}
+#else
+__thread int detail::t_statsShard = -1;
+#endif
+
+namespace {
+	/// Protects the shard ownership table
+	std::mutex shardMutex;
+	/// Which shards are currently owned by a thread (shard 0 is always shared)
+	bool shardOwned[NUM_COUNTERS];
+
+	/// Returns the shard of a thread to the pool when the thread terminates
+	struct ShardOwner {
+		int shard = 0;
+
+		~ShardOwner() {
+			if (shard > 0) {
+				std::lock_guard<std::mutex> guard(shardMutex);
+				shardOwned[shard] = false;
+			}
+			/* Any remaining updates go to the shared shard */
+			detail::t_statsShard = 0;
+		}
+	};
+
+	thread_local ShardOwner shardOwner;
+}
+
+#if defined(__WINDOWS__)
+int StatsCounter::getShard() {
+	int shard = detail::t_statsShard;
+	return shard >= 0 ? shard : acquireShard();
+}
+#endif
+
+int StatsCounter::acquireShard() {
+	int shard = 0;
+	{
+		std::lock_guard<std::mutex> guard(shardMutex);
+		for (int i=1; i<NUM_COUNTERS; ++i) {
+			if (!shardOwned[i]) {
+				shardOwned[i] = true;
+				shard = i;
+				break;
+			}
+		}
+	}
+	/* The first access constructs the owner, which releases the shard again */
+	shardOwner.shard = shard;
+	detail::t_statsShard = shard;
+	return shard;
+}
+
 StatsCounter::StatsCounter(const std::string &cat, const std::string &name, EStatsType type, uint64_t initial, uint64_t base)
  : m_category(cat), m_name(name), m_type(type) {
 	m_value = (CacheLineCounter *) allocAligned(sizeof(CacheLineCounter) * NUM_COUNTERS);
@@ -272,5 +330,80 @@ std::string Statistics::getStats() {
 	return oss.str();
 }
 
+static std::string escapeJSON(const std::string &str) {
+	std::string result;
+	for (size_t i=0; i<str.length(); ++i) {
+		char c = str[i];
+		if (c == '"' || c == '\\')
+			result += '\\';
+		if ((unsigned char) c < 0x20)
+			result += formatString("\\u%04x", (int) c);
+		else
+			result += c;
+	}
+	return result;
+}
+
+static std::string escapeCSV(const std::string &str) {
+	if (str.find_first_of(",\"\r\n") == std::string::npos)
+		return str;
+	std::string result = "\"";
+	for (size_t i=0; i<str.length(); ++i) {
+		if (str[i] == '"')
+			result += '"';
+		result += str[i];
+	}
+	return result + "\"";
+}
+
+std::string Statistics::getSnapshot(ESnapshotFormat format, const std::string &category) {
+	static const char *typeNames[] = {
+		"number", "bytes", "percentage", "minimum", "maximum", "average"
+	};
+
+	std::ostringstream oss;
+	LockGuard lock(m_mutex);
+
+	if (format == EJSON)
+		oss << "{\"counters\":[";
+	else
+		oss << "category,name,type,value,base" << endl;
+
+	bool first = true;
+	for (size_t i=0; i<m_counters.size(); ++i) {
+		const StatsCounter *counter = m_counters[i];
+		if (!category.empty() && counter->getCategory() != category)
+			continue;
+
+		EStatsType type = counter->getType();
+		uint64_t value;
+		if (type == EMinimumValue)
+			value = counter->getMinimum();
+		else if (type == EMaximumValue)
+			value = counter->getMaximum();
+		else
+			value = counter->getValue();
+
+		if (format == EJSON) {
+			oss << (first ? "" : ",")
+				<< "{\"category\":\"" << escapeJSON(counter->getCategory())
+				<< "\",\"name\":\"" << escapeJSON(counter->getName())
+				<< "\",\"type\":\"" << typeNames[type]
+				<< "\",\"value\":" << value
+				<< ",\"base\":" << counter->getBase() << "}";
+		} else {
+			oss << escapeCSV(counter->getCategory()) << ","
+				<< escapeCSV(counter->getName()) << ","
+				<< typeNames[type] << "," << value << ","
+				<< counter->getBase() << endl;
+		}
+		first = false;
+	}
+
+	if (format == EJSON)
+		oss << "]}";
+	return oss.str();
+}
+
 MTS_IMPLEMENT_CLASS(Statistics, false, Object)
 MTS_NAMESPACE_END
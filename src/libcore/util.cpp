@@ -51,6 +51,10 @@
 # include <fenv.h>
 #endif
 
+#if defined(__LINUX__)
+# include <dirent.h>
+#endif
+
 // SSE is not enabled in general when using double precision, however it is
 // required in OS X for FP exception handling
 #if defined(__OSX__) && !defined(MTS_SSE)
@@ -218,6 +222,123 @@ done:
 #endif
 }
 
+#if defined(__LINUX__)
+/// Determine the NUMA node of every core that is available to this process
+static std::vector<int> detectCoreNUMANodes() {
+	int nLogicalCores = sysconf(_SC_NPROCESSORS_CONF);
+	std::vector<int> result;
+
+	/* Map logical cores to (sparse) node IDs */
+	std::vector<int> cpuNode(nLogicalCores, -1);
+	std::vector<int> nodeIDs;
+	DIR *dir = opendir("/sys/devices/system/node");
+	if (dir) {
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			int nodeID;
+			char tail;
+			if (sscanf(entry->d_name, "node%i%c", &nodeID, &tail) == 1)
+				nodeIDs.push_back(nodeID);
+		}
+		closedir(dir);
+	}
+	std::sort(nodeIDs.begin(), nodeIDs.end());
+
+	for (size_t i=0; i<nodeIDs.size(); ++i) {
+		char filename[64], buf[4096];
+		snprintf(filename, sizeof(filename),
+			"/sys/devices/system/node/node%i/cpulist", nodeIDs[i]);
+		FILE *f = fopen(filename, "r");
+		if (!f)
+			continue;
+		size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+		fclose(f);
+		buf[len] = '\0';
+
+		/* Parse a list of ranges, e.g. "0-7,16-23" */
+		char *ptr = buf;
+		while (*ptr != '\0' && *ptr != '\n') {
+			char *end;
+			long first = strtol(ptr, &end, 10), last = first;
+			if (end == ptr)
+				break;
+			if (*end == '-')
+				last = strtol(end + 1, &end, 10);
+			for (long j=first; j<=last && j<nLogicalCores; ++j)
+				cpuNode[j] = (int) i;
+			ptr = (*end == ',') ? end + 1 : end;
+		}
+	}
+
+	/* Enumerate the cores in the order used by Thread::setCoreAffinity() */
+	cpu_set_t *cpuset = NULL;
+	size_t size = 0;
+	int retval = 0;
+	for (int i = 0; i<6; ++i) {
+		size = CPU_ALLOC_SIZE(nLogicalCores);
+		cpuset = CPU_ALLOC(nLogicalCores);
+		if (!cpuset)
+			return result;
+		CPU_ZERO_S(size, cpuset);
+		retval = pthread_getaffinity_np(pthread_self(), size, cpuset);
+		if (retval == 0)
+			break;
+		CPU_FREE(cpuset);
+		cpuset = NULL;
+		nLogicalCores *= 2;
+	}
+	if (retval || !cpuset)
+		return result;
+
+	for (int i=0; i<nLogicalCores; ++i) {
+		if (CPU_ISSET_S(i, size, cpuset))
+			result.push_back(i < (int) cpuNode.size() && cpuNode[i] >= 0 ? cpuNode[i] : 0);
+	}
+	CPU_FREE(cpuset);
+
+	/* Only count nodes with available cores */
+	std::vector<int> remap(nodeIDs.size() + 1, -1);
+	int nodeCount = 0;
+	for (size_t i=0; i<result.size(); ++i) {
+		if (remap[result[i]] < 0)
+			remap[result[i]] = nodeCount++;
+		result[i] = remap[result[i]];
+	}
+	return result;
+}
+
+static const std::vector<int> &getCoreNUMANodes() {
+	static const std::vector<int> nodes = detectCoreNUMANodes();
+	return nodes;
+}
+
+static int getNUMANodeCountInternal() {
+	const std::vector<int> &nodes = getCoreNUMANodes();
+	int count = 1;
+	for (size_t i=0; i<nodes.size(); ++i)
+		count = std::max(count, nodes[i] + 1);
+	return count;
+}
+#endif
+
+int getNUMANodeCount() {
+#if defined(__LINUX__)
+	static const int count = getNUMANodeCountInternal();
+	return count;
+#else
+	return 1;
+#endif
+}
+
+int getCoreNUMANode(int core) {
+#if defined(__LINUX__)
+	const std::vector<int> &nodes = getCoreNUMANodes();
+	if (core >= 0 && core < (int) nodes.size())
+		return nodes[core];
+#endif
+	return 0;
+}
+
 size_t getTotalSystemMemory() {
 #if defined(__WINDOWS__)
 	MEMORYSTATUSEX status;
@@ -0,0 +1,105 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/workerpool.h>
+#include <mitsuba/core/thread.h>
+
+MTS_NAMESPACE_BEGIN
+
+class WorkerPool::Worker : public Thread {
+public:
+	Worker(WorkerPool *pool, int tid, int core)
+		: Thread("interactive"), m_pool(pool), m_tid(tid),
+		  m_generation(pool->m_generation) {
+		if (core >= 0)
+			setCoreAffinity(core);
+	}
+
+	void run() {
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(m_pool->m_mutex);
+				while (m_pool->m_generation == m_generation && !m_pool->m_quit)
+					m_pool->m_wake.wait(lock);
+				if (m_pool->m_quit)
+					return;
+				m_generation = m_pool->m_generation;
+				if (m_tid >= m_pool->m_numThreads)
+					continue;
+			}
+			if (!m_pool->m_started.exchange(true))
+				m_pool->m_restartLatency = std::chrono::duration<float, std::milli>(
+					std::chrono::steady_clock::now() - m_pool->m_wakeTime).count();
+
+			m_pool->m_task(m_tid);
+
+			std::lock_guard<std::mutex> lock(m_pool->m_mutex);
+			if (--m_pool->m_running == 0)
+				m_pool->m_done.notify_all();
+		}
+	}
+
+private:
+	WorkerPool *m_pool;
+	int m_tid;
+	unsigned int m_generation;
+};
+
+WorkerPool::WorkerPool(bool pinCores)
+	: m_generation(0), m_numThreads(0), m_running(0), m_quit(false),
+	  m_pinCores(pinCores), m_started(false), m_restartLatency(0.0f) { }
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (size_t i=0; i<m_workers.size(); ++i)
+		m_workers[i]->join();
+}
+
+void WorkerPool::setCores(const std::vector<int> &cores) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_cores = cores;
+}
+
+void WorkerPool::run(int numThreads, const std::function<void(int)> &task) {
+	/* Build on Mitsuba threads rather than OpenMP for the sake of
+	   thread-local storage and logging */
+	for (int i = (int) m_workers.size(); i < numThreads; ++i) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		int core = !m_pinCores ? -1 : (i < (int) m_cores.size() ? m_cores[i] : i);
+		m_workers.push_back(new Worker(this, i, core));
+		m_workers.back()->start();
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_task = task;
+	m_numThreads = numThreads;
+	m_running = numThreads;
+	m_started = false;
+	m_wakeTime = std::chrono::steady_clock::now();
+	++m_generation;
+	m_wake.notify_all();
+	while (m_running)
+		m_done.wait(lock);
+	m_task = nullptr;
+}
+
+MTS_NAMESPACE_END
@@ -1114,6 +1114,7 @@ BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(fromIPT_overloads, fromIPT, 3, 4)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(reset_overloads, reset, 0, 1)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(resample1_overloads, resample, 4, 7)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(resample2_overloads, resample, 6, 4)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(getSnapshot_overloads, getSnapshot, 0, 2)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(filter1_overloads, filter, 4, 7)
 BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(filter2_overloads, filter, 3, 5)
 
@@ -1728,11 +1729,19 @@ void export_core() {
 
 	BP_CLASS(Statistics, Object, bp::no_init)
 		.def("getStats", &Statistics::getStats, BP_RETURN_VALUE)
+		.def("getSnapshot", &Statistics::getSnapshot, getSnapshot_overloads())
 		.def("resetAll", &Statistics::resetAll)
 		.def("printStats", &Statistics::printStats)
 		.def("getInstance", &Statistics::getInstance, BP_RETURN_VALUE)
 		.staticmethod("getInstance");
 
+	BP_SETSCOPE(Statistics_class);
+	bp::enum_<Statistics::ESnapshotFormat>("ESnapshotFormat")
+		.value("EJSON", Statistics::EJSON)
+		.value("ECSV", Statistics::ECSV)
+		.export_values();
+	BP_SETSCOPE(coreModule);
+
 	BP_CLASS(WorkUnit, Object, bp::no_init)
 		.def("set", &WorkUnit::set)
 		.def("load", &WorkUnit::load)
@@ -2362,6 +2371,8 @@ void export_core() {
 	bp::def("timeString", &timeString1);
 	bp::def("timeString", &timeString2);
 	bp::def("getCoreCount", &getCoreCount);
+	bp::def("getNUMANodeCount", &getNUMANodeCount);
+	bp::def("getCoreNUMANode", &getCoreNUMANode);
 	bp::def("getHostName", &getHostName);
 	bp::def("getPrivateMemoryUsage", &getPrivateMemoryUsage);
 	bp::def("getTotalSystemMemory", &getTotalSystemMemory);
@@ -64,7 +64,7 @@ static AABB shapekdtree_getAABB(const ShapeKDTree *kdtree) {
 }
 
 static bool shapekdtree_isBuilt(const ShapeKDTree *kdtree) {
-	return kdtree->isBuilt();
+	return kdtree->isAcceleratorBuilt();
 }
 
 static bp::object shapekdtree_rayIntersect(const ShapeKDTree *kdtree, const Ray &ray) {
@@ -0,0 +1,308 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/bvh4.h>
+#include <mitsuba/core/timer.h>
+#include <algorithm>
+#include <cmath>
+
+/// Number of centroid bins evaluated per axis
+#define MTS_BVH_BINS 16
+/// Leaves are only created below this size unless the SAH insists on splitting
+#define MTS_BVH_MAX_LEAF 8
+/// Relative cost of a node traversal w.r.t. a primitive intersection
+#define MTS_BVH_TRAVERSAL_COST 1.0f
+/// Subtrees with more primitives are built in a separate task
+#define MTS_BVH_TASK_THRESHOLD 32768
+
+MTS_NAMESPACE_BEGIN
+
+struct BVH4::BuildContext {
+	const std::vector<AABB> &bounds;
+	IndexType *indices;
+	bool parallel;
+
+	BuildContext(const std::vector<AABB> &bounds, IndexType *indices, bool parallel)
+		: bounds(bounds), indices(indices), parallel(parallel) { }
+};
+
+namespace {
+	/// Primitive range of a child, as collected while filling a node
+	struct BuildRange {
+		BVH4::IndexType begin, end;
+		AABB bounds, centroidBounds;
+		bool closed;
+
+		inline BVH4::IndexType size() const { return end - begin; }
+	};
+
+	void computeBounds(const BVH4::IndexType *indices, const std::vector<AABB> &bounds,
+			BuildRange &range) {
+		range.bounds.reset();
+		range.centroidBounds.reset();
+		for (BVH4::IndexType i = range.begin; i < range.end; ++i) {
+			const AABB &aabb = bounds[indices[i]];
+			range.bounds.expandBy(aabb);
+			range.centroidBounds.expandBy(aabb.getCenter());
+		}
+		range.closed = range.size() <= 1;
+	}
+
+	/* Round outwards when storing bounds in single precision */
+	inline float roundDown(Float value) {
+		float result = (float) value;
+		return (Float) result > value ? std::nextafter(result, -std::numeric_limits<float>::infinity()) : result;
+	}
+
+	inline float roundUp(Float value) {
+		float result = (float) value;
+		return (Float) result < value ? std::nextafter(result, std::numeric_limits<float>::infinity()) : result;
+	}
+}
+
+BVH4::BVH4() { }
+
+void BVH4::clear() {
+	std::vector<Node>().swap(m_nodes);
+	std::vector<IndexType>().swap(m_indices);
+}
+
+/**
+ * Split a range along the best binned SAH plane. Returns \c false
+ * when a leaf is cheaper, otherwise \c mid receives the split position.
+ */
+static bool splitRange(BVH4::IndexType *indices, const std::vector<AABB> &bounds,
+		const BuildRange &range, BVH4::IndexType &mid) {
+	const BVH4::IndexType count = range.size();
+	const AABB &cb = range.centroidBounds;
+
+	int bestAxis = -1, bestBin = -1;
+	Float bestCost = std::numeric_limits<Float>::infinity();
+
+	for (int axis=0; axis<3; ++axis) {
+		Float extent = cb.max[axis] - cb.min[axis];
+		if (!(extent > 0))
+			continue;
+		Float scale = MTS_BVH_BINS * (1 - 1e-4f) / extent;
+
+		BVH4::IndexType binCount[MTS_BVH_BINS];
+		AABB binBounds[MTS_BVH_BINS];
+		for (int i=0; i<MTS_BVH_BINS; ++i) {
+			binCount[i] = 0;
+			binBounds[i].reset();
+		}
+		for (BVH4::IndexType i = range.begin; i < range.end; ++i) {
+			const AABB &aabb = bounds[indices[i]];
+			Float c = (aabb.min[axis] + aabb.max[axis]) * (Float) 0.5f;
+			int bin = std::min(MTS_BVH_BINS - 1, (int) ((c - cb.min[axis]) * scale));
+			binCount[bin]++;
+			binBounds[bin].expandBy(aabb);
+		}
+
+		/* Sweep from the right, then evaluate every plane from the left */
+		Float rightArea[MTS_BVH_BINS];
+		BVH4::IndexType rightCount[MTS_BVH_BINS];
+		AABB accum;
+		accum.reset();
+		BVH4::IndexType accumCount = 0;
+		for (int i=MTS_BVH_BINS-1; i>0; --i) {
+			accum.expandBy(binBounds[i]);
+			accumCount += binCount[i];
+			rightArea[i] = accumCount ? accum.getSurfaceArea() : 0;
+			rightCount[i] = accumCount;
+		}
+		accum.reset();
+		accumCount = 0;
+		for (int i=0; i<MTS_BVH_BINS-1; ++i) {
+			accum.expandBy(binBounds[i]);
+			accumCount += binCount[i];
+			if (accumCount == 0 || rightCount[i+1] == 0)
+				continue;
+			Float cost = accumCount * accum.getSurfaceArea()
+				+ rightCount[i+1] * rightArea[i+1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = i;
+			}
+		}
+	}
+
+	if (bestAxis != -1) {
+		Float area = range.bounds.getSurfaceArea();
+		Float splitCost = MTS_BVH_TRAVERSAL_COST + (area > 0 ? bestCost / area : 0);
+		if (count <= MTS_BVH_MAX_LEAF && (Float) count <= splitCost)
+			return false;
+
+		Float scale = MTS_BVH_BINS * (1 - 1e-4f) / (cb.max[bestAxis] - cb.min[bestAxis]);
+		Float minValue = cb.min[bestAxis];
+		BVH4::IndexType *split = std::partition(indices + range.begin, indices + range.end,
+			[&](BVH4::IndexType idx) {
+				const AABB &aabb = bounds[idx];
+				Float c = (aabb.min[bestAxis] + aabb.max[bestAxis]) * (Float) 0.5f;
+				return std::min(MTS_BVH_BINS - 1, (int) ((c - minValue) * scale)) <= bestBin;
+			});
+		mid = (BVH4::IndexType) (split - indices);
+		if (mid != range.begin && mid != range.end)
+			return true;
+	} else if (count <= MTS_BVH_MAX_LEAF) {
+		return false;
+	}
+
+	/* Coincident centroids or a degenerate partition: split at the median */
+	int axis = cb.getLargestAxis();
+	mid = range.begin + count / 2;
+	std::nth_element(indices + range.begin, indices + mid, indices + range.end,
+		[&](BVH4::IndexType a, BVH4::IndexType b) {
+			return bounds[a].getCenter()[axis] < bounds[b].getCenter()[axis];
+		});
+	return true;
+}
+
+BVH4::IndexType BVH4::buildSubtree(BuildContext &ctx, std::vector<Node> &nodes,
+		IndexType begin, IndexType end, int depth) const {
+	BuildRange children[4];
+	int childCount = 1;
+	children[0].begin = begin;
+	children[0].end = end;
+	computeBounds(ctx.indices, ctx.bounds, children[0]);
+	if (depth >= MTS_BVH_MAXDEPTH - 1)
+		children[0].closed = true;
+
+	/* Open up the child with the largest surface area until the node is full */
+	while (childCount < 4) {
+		int best = -1;
+		Float bestArea = -1;
+		for (int i=0; i<childCount; ++i) {
+			if (children[i].closed)
+				continue;
+			Float area = children[i].bounds.getSurfaceArea();
+			if (area > bestArea) {
+				bestArea = area;
+				best = i;
+			}
+		}
+		if (best == -1)
+			break;
+
+		IndexType mid;
+		if (!splitRange(ctx.indices, ctx.bounds, children[best], mid)) {
+			children[best].closed = true;
+			continue;
+		}
+
+		BuildRange &right = children[childCount++];
+		right.begin = mid;
+		right.end = children[best].end;
+		children[best].end = mid;
+		computeBounds(ctx.indices, ctx.bounds, children[best]);
+		computeBounds(ctx.indices, ctx.bounds, right);
+	}
+
+	IndexType nodeIndex = (IndexType) nodes.size();
+	nodes.push_back(Node());
+	{
+		Node &node = nodes[nodeIndex];
+		for (int i=0; i<4; ++i) {
+			for (int axis=0; axis<3; ++axis) {
+				node.bounds[0][axis][i] = std::numeric_limits<float>::infinity();
+				node.bounds[1][axis][i] = -std::numeric_limits<float>::infinity();
+			}
+			node.child[i] = KEmptySlot;
+			node.count[i] = 0;
+		}
+		for (int i=0; i<childCount; ++i) {
+			const BuildRange &range = children[i];
+			if (range.size() == 0)
+				continue; /* Only happens for an empty hierarchy */
+			for (int axis=0; axis<3; ++axis) {
+				node.bounds[0][axis][i] = roundDown(range.bounds.min[axis]);
+				node.bounds[1][axis][i] = roundUp(range.bounds.max[axis]);
+			}
+			bool leaf = range.size() <= 1 || depth >= MTS_BVH_MAXDEPTH - 1
+				|| (range.closed && range.size() <= MTS_BVH_MAX_LEAF);
+			if (leaf) {
+				node.child[i] = range.begin;
+				node.count[i] = range.size();
+			}
+		}
+	}
+
+	/* Recurse into the remaining children, large ones as separate tasks */
+	std::vector<Node> taskNodes[4];
+	for (int i=0; i<childCount; ++i) {
+		if (nodes[nodeIndex].count[i] != 0 || children[i].size() == 0)
+			continue;
+		const BuildRange &range = children[i];
+		if (ctx.parallel && range.size() > MTS_BVH_TASK_THRESHOLD) {
+#if defined(MTS_OPENMP)
+			#pragma omp task default(shared) firstprivate(i)
+#endif
+			buildSubtree(ctx, taskNodes[i], children[i].begin, children[i].end, depth + 1);
+		} else {
+			IndexType childIndex = buildSubtree(ctx, nodes, range.begin, range.end, depth + 1);
+			nodes[nodeIndex].child[i] = childIndex;
+		}
+	}
+#if defined(MTS_OPENMP)
+	#pragma omp taskwait
+#endif
+
+	/* Append the subtrees built by tasks and relocate their child references */
+	for (int i=0; i<childCount; ++i) {
+		if (taskNodes[i].empty())
+			continue;
+		IndexType offset = (IndexType) nodes.size();
+		for (size_t j=0; j<taskNodes[i].size(); ++j) {
+			Node &node = taskNodes[i][j];
+			for (int k=0; k<4; ++k)
+				if (node.count[k] == 0 && node.child[k] != KEmptySlot)
+					node.child[k] += offset;
+		}
+		nodes.insert(nodes.end(), taskNodes[i].begin(), taskNodes[i].end());
+		nodes[nodeIndex].child[i] = offset;
+	}
+
+	return nodeIndex;
+}
+
+void BVH4::build(const std::vector<AABB> &primBounds, bool parallel) {
+	ref<Timer> timer = new Timer();
+	IndexType primCount = (IndexType) primBounds.size();
+
+	clear();
+	m_indices.resize(primCount);
+	for (IndexType i=0; i<primCount; ++i)
+		m_indices[i] = i;
+
+	BuildContext ctx(primBounds, m_indices.empty() ? NULL : &m_indices[0], parallel);
+
+#if defined(MTS_OPENMP)
+	#pragma omp parallel if (parallel && primCount > MTS_BVH_TASK_THRESHOLD)
+	#pragma omp single
+#endif
+	buildSubtree(ctx, m_nodes, 0, primCount, 0);
+
+	std::vector<Node>(m_nodes).swap(m_nodes);
+
+	SLog(EDebug, "Built a 4-wide BVH over %u primitives: %u nodes, %s, took %i ms",
+		primCount, (IndexType) m_nodes.size(), memString(getMemoryUsage()).c_str(),
+		timer->getMilliseconds());
+}
+
+MTS_NAMESPACE_END
@@ -0,0 +1,476 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/emitterbvh.h>
+#include <mitsuba/render/trimesh.h>
+#include <mitsuba/core/timer.h>
+
+/// Number of centroid buckets per axis considered when splitting a node
+#define MTS_EMITTERBVH_BUCKETS 12
+
+MTS_NAMESPACE_BEGIN
+
+/// Marks lookup entries referring to an emitter outside of the hierarchy
+static const EmitterBVH::IndexType KUnbounded = 0x80000000;
+
+namespace {
+	/* cos(max(0, a-b)) and sin(max(0, a-b)) given the sines and cosines of two angles */
+	inline Float cosSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+		return cosA > cosB ? (Float) 1 : cosA * cosB + sinA * sinB;
+	}
+
+	inline Float sinSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+		return cosA > cosB ? (Float) 0 : sinA * cosB - cosA * sinB;
+	}
+
+	/// Merge two normal cones into a cone that contains both of them
+	void mergeCones(Vector &axis, Float &cosTheta, const Vector &axis2, Float cosTheta2) {
+		if (cosTheta2 <= -1 || cosTheta <= -1) {
+			cosTheta = -1;
+			return;
+		}
+		Float theta = math::safe_acos(cosTheta), theta2 = math::safe_acos(cosTheta2),
+		      thetaD = unitAngle(axis, axis2);
+
+		if (std::min(thetaD + theta2, (Float) M_PI) <= theta)
+			return;
+		if (std::min(thetaD + theta, (Float) M_PI) <= theta2) {
+			axis = axis2;
+			cosTheta = cosTheta2;
+			return;
+		}
+
+		/* Rotate the first axis towards the second one */
+		Float thetaO = (theta + thetaD + theta2) / 2;
+		Vector rotAxis = cross(axis, axis2);
+		if (thetaO >= M_PI || rotAxis.lengthSquared() == 0) {
+			cosTheta = -1;
+			return;
+		}
+		axis = normalize(Transform::rotate(rotAxis, radToDeg(thetaO - theta))(axis));
+		cosTheta = std::cos(thetaO);
+	}
+
+	/// Merge the emitter bounds \c b into \c a
+	void mergeBounds(EmitterBVH::Node &a, const EmitterBVH::Node &b) {
+		if (b.power == 0)
+			return;
+		if (a.power == 0) {
+			a.aabb = b.aabb;
+			a.axis = b.axis;
+			a.cosThetaO = b.cosThetaO;
+			a.cosThetaE = b.cosThetaE;
+			a.power = b.power;
+			return;
+		}
+		a.aabb.expandBy(b.aabb);
+		mergeCones(a.axis, a.cosThetaO, b.axis, b.cosThetaO);
+		a.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+		a.power += b.power;
+	}
+
+	/// Surface area orientation heuristic of a (tentative) node
+	Float evalCost(const EmitterBVH::Node &node, Float maxExtent, int axis) {
+		if (node.power == 0)
+			return 0.0f;
+		Float thetaO = math::safe_acos(node.cosThetaO),
+		      thetaE = math::safe_acos(node.cosThetaE),
+		      thetaW = std::min(thetaO + thetaE, (Float) M_PI),
+		      sinThetaO = math::safe_sqrt(1 - node.cosThetaO * node.cosThetaO);
+
+		/* Solid angle measure of the emission directions */
+		Float mOmega = 2 * M_PI * (1 - node.cosThetaO) + 0.5f * M_PI *
+			(2 * thetaW * sinThetaO - std::cos(thetaO - 2 * thetaW)
+			 - 2 * thetaO * sinThetaO + node.cosThetaO);
+
+		/* Discourage splits producing elongated boxes */
+		Float extent = node.aabb.getExtents()[axis],
+		      kr = extent > 0 ? maxExtent / extent : 1.0f;
+
+		return node.power * mOmega * kr * node.aabb.getSurfaceArea();
+	}
+
+	/// Compute a cone bounding the normals of an area emitter
+	void computeNormalCone(const Shape *shape, Vector &axis, Float &cosTheta) {
+		axis = Vector(0, 0, 1);
+		cosTheta = -1;
+
+		std::vector<Vector> normals;
+		if (shape->getClass()->derivesFrom(MTS_CLASS(TriMesh))) {
+			const TriMesh *mesh = static_cast<const TriMesh *>(shape);
+			const Triangle *triangles = mesh->getTriangles();
+			const Point *positions = mesh->getVertexPositions();
+			const Normal *vertexNormals = mesh->getVertexNormals();
+			for (size_t i=0; i<mesh->getTriangleCount(); ++i) {
+				const Triangle &tri = triangles[i];
+				Vector n = cross(positions[tri.idx[1]] - positions[tri.idx[0]],
+					positions[tri.idx[2]] - positions[tri.idx[0]]);
+				if (n.lengthSquared() > 0)
+					normals.push_back(normalize(n));
+			}
+			if (vertexNormals) {
+				for (size_t i=0; i<mesh->getVertexCount(); ++i) {
+					if (!vertexNormals[i].isZero())
+						normals.push_back(normalize(Vector(vertexNormals[i])));
+				}
+			}
+		} else {
+			/* Other shapes are only recognized when they are flat: sample a
+			   few positions and check that they share the normal and lie in
+			   a common plane. Everything else gets an unbounded cone. */
+			const int res = 8;
+			PositionSamplingRecord pRec(0.0f), pRec0(0.0f);
+			Float scale = shape->getAABB().getExtents().length();
+			for (int i=0; i<res*res; ++i) {
+				shape->samplePosition(pRec,
+					Point2((i % res + 0.5f) / res, (i / res + 0.5f) / res));
+				if (i == 0)
+					pRec0 = pRec;
+				if (absDot(Vector(pRec0.n), pRec.p - pRec0.p) > 1e-4f * scale)
+					return;
+				normals.push_back(normalize(Vector(pRec.n)));
+			}
+		}
+
+		if (normals.empty())
+			return;
+
+		axis = normals[0];
+		cosTheta = 1;
+		for (size_t i=1; i<normals.size(); ++i) {
+			mergeCones(axis, cosTheta, normals[i], 1);
+			if (cosTheta <= -1)
+				return;
+		}
+
+		if (cosTheta < 0) {
+			/* Interpolated shading normals are only guaranteed
+			   to remain inside cones up to a hemisphere */
+			cosTheta = -1;
+		} else {
+			/* Leave some room for roundoff errors */
+			cosTheta = std::cos(std::min(math::safe_acos(cosTheta) + 1e-3f, (Float) (0.5f * M_PI)));
+		}
+	}
+}
+
+EmitterBVH::EmitterBVH(const ref_vector<Emitter> &emitters) {
+	ref<Timer> timer = new Timer();
+	std::vector<Node> emitterBounds;
+
+	for (size_t i=0; i<emitters.size(); ++i) {
+		const Emitter *emitter = emitters[i].get();
+		uint32_t type = emitter->getType();
+		const Shape *shape = emitter->getShape();
+
+		bool bounded = !emitter->isEnvironmentEmitter() &&
+			((emitter->isOnSurface() && shape != NULL) ||
+			 ((type & Emitter::EDeltaPosition) && !(type & Emitter::EDeltaDirection)));
+
+		if (!bounded) {
+			m_lookup[emitter] = KUnbounded | (IndexType) m_unbounded.size();
+			m_unbounded.push_back(emitter);
+			m_topPDF.append(emitter->getSamplingWeight());
+			continue;
+		}
+
+		Node bounds;
+		bounds.aabb = emitter->getAABB();
+		bounds.parent = 0;
+		bounds.index = (IndexType) m_bounded.size();
+		bounds.leaf = true;
+
+		/* Estimate the emitted power from a few position samples */
+		const int res = 4;
+		Spectrum power(0.0f);
+		for (int j=0; j<res*res; ++j) {
+			PositionSamplingRecord pRec(0.0f);
+			power += emitter->samplePosition(pRec,
+				Point2((j % res + 0.5f) / res, (j / res + 0.5f) / res));
+		}
+		bounds.power = std::max((Float) 0, power.getLuminance() / (res*res)
+			* emitter->getSamplingWeight());
+
+		if (shape) {
+			/* Area emitters radiate into the hemisphere above each point */
+			computeNormalCone(shape, bounds.axis, bounds.cosThetaO);
+			bounds.cosThetaE = 0;
+		} else {
+			bounds.axis = Vector(0, 0, 1);
+			bounds.cosThetaO = -1;
+			bounds.cosThetaE = 0;
+		}
+
+		if (!bounds.aabb.isValid() || !std::isfinite(bounds.power)) {
+			Log(EWarn, "Emitter \"%s\" has invalid bounds or power, it will not "
+				"be sampled for direct illumination!", emitter->toString().c_str());
+			bounds.power = 0;
+		}
+
+		m_lookup[emitter] = 0;
+		m_bounded.push_back(emitter);
+		emitterBounds.push_back(bounds);
+	}
+
+	if (!m_bounded.empty()) {
+		m_topPDF.append(1.0f);
+		m_nodes.reserve(2 * m_bounded.size() - 1);
+		build(emitterBounds, 0, emitterBounds.size(), 0);
+	}
+	m_topPDF.normalize();
+
+	Log(EInfo, "Built an emitter hierarchy over " SIZE_T_FMT " emitters ("
+		SIZE_T_FMT " nodes, " SIZE_T_FMT " emitters outside, %i ms)",
+		m_bounded.size(), m_nodes.size(), m_unbounded.size(),
+		timer->getMilliseconds());
+}
+
+EmitterBVH::IndexType EmitterBVH::build(std::vector<Node> &emitterBounds,
+		size_t start, size_t end, IndexType parent) {
+	IndexType nodeIndex = (IndexType) m_nodes.size();
+	m_nodes.push_back(Node());
+
+	Node node;
+	node.power = 0;
+	node.axis = Vector(0, 0, 1);
+	node.cosThetaO = 1;
+	node.cosThetaE = 1;
+	AABB centroids;
+	for (size_t i=start; i<end; ++i) {
+		mergeBounds(node, emitterBounds[i]);
+		if (emitterBounds[i].aabb.isValid())
+			centroids.expandBy(emitterBounds[i].aabb.getCenter());
+	}
+	if (node.power == 0) {
+		/* Only black emitters -- keep the geometric bounds */
+		node.aabb = centroids;
+		node.cosThetaO = -1;
+	}
+	node.parent = parent;
+
+	if (end - start == 1) {
+		node.index = emitterBounds[start].index;
+		node.leaf = true;
+		m_lookup[m_bounded[node.index]] = nodeIndex;
+		m_nodes[nodeIndex] = node;
+		return nodeIndex;
+	}
+
+	/* Search for the cheapest split among bucketed centroids */
+	Float bestCost = std::numeric_limits<Float>::infinity();
+	int bestAxis = -1, bestBucket = -1;
+	const Vector centroidExtents = centroids.isValid()
+		? centroids.getExtents() : Vector(0.0f);
+	const Vector extents = node.aabb.isValid() ? node.aabb.getExtents() : Vector(0.0f);
+	const Float maxExtent = std::max(std::max(extents.x, extents.y), extents.z);
+
+	for (int axis=0; axis<3; ++axis) {
+		if (centroidExtents[axis] <= 0)
+			continue;
+
+		Node buckets[MTS_EMITTERBVH_BUCKETS];
+		size_t counts[MTS_EMITTERBVH_BUCKETS];
+		for (int b=0; b<MTS_EMITTERBVH_BUCKETS; ++b) {
+			buckets[b].power = 0;
+			counts[b] = 0;
+		}
+
+		for (size_t i=start; i<end; ++i) {
+			const Node &eb = emitterBounds[i];
+			int b = MTS_EMITTERBVH_BUCKETS - 1;
+			if (eb.aabb.isValid())
+				b = std::min(b, (int) (MTS_EMITTERBVH_BUCKETS *
+					(eb.aabb.getCenter()[axis] - centroids.min[axis]) / centroidExtents[axis]));
+			mergeBounds(buckets[b], eb);
+			counts[b]++;
+		}
+
+		for (int split=0; split<MTS_EMITTERBVH_BUCKETS-1; ++split) {
+			Node left, right;
+			left.power = right.power = 0;
+			size_t leftCount = 0, rightCount = 0;
+			for (int b=0; b<=split; ++b) {
+				mergeBounds(left, buckets[b]);
+				leftCount += counts[b];
+			}
+			for (int b=split+1; b<MTS_EMITTERBVH_BUCKETS; ++b) {
+				mergeBounds(right, buckets[b]);
+				rightCount += counts[b];
+			}
+			if (leftCount == 0 || rightCount == 0)
+				continue;
+
+			Float cost = evalCost(left, maxExtent, axis) + evalCost(right, maxExtent, axis);
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBucket = split;
+			}
+		}
+	}
+
+	size_t mid;
+	if (bestAxis != -1 && bestCost > 0) {
+		mid = std::partition(emitterBounds.begin() + start, emitterBounds.begin() + end,
+			[&](const Node &eb) {
+				if (!eb.aabb.isValid())
+					return false;
+				int b = std::min(MTS_EMITTERBVH_BUCKETS - 1, (int) (MTS_EMITTERBVH_BUCKETS *
+					(eb.aabb.getCenter()[bestAxis] - centroids.min[bestAxis])
+					/ centroidExtents[bestAxis]));
+				return b <= bestBucket;
+			}) - emitterBounds.begin();
+		if (mid == start || mid == end) /* Roundoff errors */
+			mid = (start + end) / 2;
+	} else {
+		/* Degenerate bounds (e.g. collinear point emitters): median split */
+		mid = (start + end) / 2;
+		if (centroids.isValid()) {
+			int axis = centroids.getLargestAxis();
+			std::nth_element(emitterBounds.begin() + start, emitterBounds.begin() + mid,
+				emitterBounds.begin() + end, [&](const Node &a, const Node &b) {
+					Float ca = a.aabb.isValid() ? a.aabb.getCenter()[axis] : 0,
+					      cb = b.aabb.isValid() ? b.aabb.getCenter()[axis] : 0;
+					return ca < cb;
+				});
+		}
+	}
+
+	build(emitterBounds, start, mid, nodeIndex);
+	node.index = build(emitterBounds, mid, end, nodeIndex);
+	node.leaf = false;
+	m_nodes[nodeIndex] = node;
+	return nodeIndex;
+}
+
+Float EmitterBVH::importance(const Node &node, const Point &ref, const Normal &refN) const {
+	if (node.power == 0)
+		return 0.0f;
+
+	const Point center = node.aabb.getCenter();
+	Vector wi = ref - center;
+	Float distSqr = wi.lengthSquared(),
+	      radiusSqr = 0.25f * (node.aabb.max - node.aabb.min).lengthSquared();
+
+	/* Cosine of the half-angle subtended by the bounding sphere */
+	Float cosThetaB = -1, sinThetaB = 0;
+	if (distSqr > radiusSqr) {
+		Float sinSqr = radiusSqr / distSqr;
+		cosThetaB = math::safe_sqrt(1 - sinSqr);
+		sinThetaB = std::sqrt(sinSqr);
+		wi /= std::sqrt(distSqr);
+	} else if (distSqr > 0) {
+		wi /= std::sqrt(distSqr);
+	}
+
+	/* Minimal angle between the emission directions and the direction to
+	   the reference point, which must be below the emission angle */
+	Float cosThetaW = dot(node.axis, wi),
+	      sinThetaW = math::safe_sqrt(1 - cosThetaW * cosThetaW),
+	      sinThetaO = math::safe_sqrt(1 - node.cosThetaO * node.cosThetaO),
+	      cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO),
+	      sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, node.cosThetaO),
+	      cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+	if (cosThetaP <= node.cosThetaE)
+		return 0.0f;
+
+	Float result = node.power * cosThetaP
+		/ std::max(std::max(distSqr, radiusSqr), (Float) (Epsilon * Epsilon));
+
+	if (!refN.isZero()) {
+		/* Bound the foreshortening at the receiver */
+		Float cosThetaI = absDot(wi, refN),
+		      sinThetaI = math::safe_sqrt(1 - cosThetaI * cosThetaI);
+		result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+
+	return std::max(result, (Float) 0);
+}
+
+const Emitter *EmitterBVH::sample(const Point &ref, const Normal &refN,
+		Float &sample, Float &pdf) const {
+	size_t index = m_topPDF.sampleReuse(sample, pdf);
+	if (index < m_unbounded.size())
+		return m_unbounded[index];
+
+	IndexType nodeIndex = 0;
+	while (!m_nodes[nodeIndex].leaf) {
+		const Node &node = m_nodes[nodeIndex];
+		Float left = importance(m_nodes[nodeIndex + 1], ref, refN),
+		      right = importance(m_nodes[node.index], ref, refN),
+		      total = left + right;
+
+		if (total <= 0 || !std::isfinite(total)) {
+			pdf = 0.0f;
+			return NULL;
+		}
+
+		Float probLeft = left / total;
+		if (sample < probLeft) {
+			sample = std::min(sample / probLeft, (Float) ONE_MINUS_EPS);
+			pdf *= probLeft;
+			nodeIndex = nodeIndex + 1;
+		} else {
+			sample = std::min((sample - probLeft) / (1 - probLeft), (Float) ONE_MINUS_EPS);
+			pdf *= right / total;
+			nodeIndex = node.index;
+		}
+	}
+
+	return m_bounded[m_nodes[nodeIndex].index];
+}
+
+Float EmitterBVH::pdf(const Emitter *emitter, const Point &ref, const Normal &refN) const {
+	std::unordered_map<const Emitter *, IndexType>::const_iterator it
+		= m_lookup.find(emitter);
+	if (it == m_lookup.end())
+		return 0.0f;
+	if (it->second & KUnbounded)
+		return m_topPDF[it->second & ~KUnbounded];
+
+	Float pdf = m_topPDF[m_unbounded.size()];
+	IndexType nodeIndex = it->second;
+	while (nodeIndex != 0) {
+		IndexType parent = m_nodes[nodeIndex].parent;
+		Float left = importance(m_nodes[parent + 1], ref, refN),
+		      right = importance(m_nodes[m_nodes[parent].index], ref, refN),
+		      total = left + right;
+
+		if (total <= 0 || !std::isfinite(total))
+			return 0.0f;
+
+		pdf *= (nodeIndex == parent + 1 ? left : right) / total;
+		nodeIndex = parent;
+	}
+
+	return pdf;
+}
+
+std::string EmitterBVH::toString() const {
+	std::ostringstream oss;
+	oss << "EmitterBVH[" << endl
+		<< "  boundedEmitters = " << m_bounded.size() << "," << endl
+		<< "  unboundedEmitters = " << m_unbounded.size() << "," << endl
+		<< "  nodes = " << m_nodes.size() << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(EmitterBVH, false, Object)
+MTS_NAMESPACE_END
@@ -17,12 +17,14 @@
 */
 
 #include <mitsuba/render/imageblock.h>
+#include <mitsuba/core/atomic.h>
 
 MTS_NAMESPACE_BEGIN
 
 ImageBlock::ImageBlock(Bitmap::EPixelFormat fmt, const Vector2i &size,
 		const ReconstructionFilter *filter, int channels, bool warn) : m_offset(0),
-		m_size(size), m_filter(filter), m_weightsX(NULL), m_weightsY(NULL), m_warn(warn) {
+		m_size(size), m_filter(filter), m_weightsX(NULL), m_weightsY(NULL), m_warn(warn),
+		m_tileSize(0), m_tileGrid(0), m_tilesX(0) {
 	m_borderSize = filter ? filter->getBorderSize() : 0;
 
 	/* Allocate a small bitmap data structure for the block */
@@ -37,11 +39,134 @@ ImageBlock::ImageBlock(Bitmap::EPixelFormat fmt, const Vector2i &size,
 	}
 }
 
+ImageBlock::ImageBlock(ImageBlock *target, int tileSize, int tileCount)
+	: m_bitmap(target->m_bitmap), m_offset(target->m_offset), m_size(target->m_size),
+	  m_borderSize(target->m_borderSize), m_filter(target->m_filter),
+	  m_weightsX(NULL), m_weightsY(NULL), m_warn(target->m_warn) {
+	if (m_filter) {
+		/* Private temporary buffers, the target's are not thread-safe */
+		int tempBufferSize = (int) std::ceil(2*m_filter->getRadius()) + 1;
+		m_weightsX = new Float[2*tempBufferSize];
+		m_weightsY = m_weightsX + tempBufferSize;
+	}
+
+	m_tileSize = std::max(tileSize, 1);
+	m_tileGrid = std::max((int) std::sqrt((Float) tileCount), 1);
+	m_tilesX = (m_bitmap->getWidth() + m_tileSize - 1) / m_tileSize;
+
+	m_tiles.resize((size_t) m_tileGrid * m_tileGrid * m_tileSize * m_tileSize
+		* m_bitmap->getChannelCount());
+	m_tileKeys.resize((size_t) m_tileGrid * m_tileGrid, -1);
+}
+
 ImageBlock::~ImageBlock() {
 	if (m_weightsX)
 		delete[] m_weightsX;
 }
 
+void ImageBlock::putTiled(const Point2 &_pos, const Float *value) {
+	const int channels = m_bitmap->getChannelCount();
+	const int tileSize = m_tileSize;
+	const Float filterRadius = m_filter->getRadius();
+	const Vector2i &size = m_bitmap->getSize();
+
+	/* Convert to pixel coordinates within the image block */
+	const Point2 pos(
+		_pos.x - 0.5f - (m_offset.x - m_borderSize),
+		_pos.y - 0.5f - (m_offset.y - m_borderSize));
+
+	/* Determine the affected range of pixels */
+	const Point2i min(std::max((int) std::ceil (pos.x - filterRadius), 0),
+	                  std::max((int) std::ceil (pos.y - filterRadius), 0)),
+	              max(std::min((int) std::floor(pos.x + filterRadius), size.x - 1),
+	                  std::min((int) std::floor(pos.y + filterRadius), size.y - 1));
+
+	/* Lookup values from the pre-rasterized filter */
+	for (int x=min.x, idx = 0; x<=max.x; ++x)
+		m_weightsX[idx++] = m_filter->evalDiscretized(x-pos.x);
+	for (int y=min.y, idx = 0; y<=max.y; ++y)
+		m_weightsY[idx++] = m_filter->evalDiscretized(y-pos.y);
+
+	/* Rasterize the filtered sample into all overlapped private tiles */
+	for (int ty = min.y / tileSize; ty <= max.y / tileSize; ++ty) {
+		const int y0 = std::max(min.y, ty * tileSize),
+		          y1 = std::min(max.y, ty * tileSize + tileSize - 1);
+
+		for (int tx = min.x / tileSize; tx <= max.x / tileSize; ++tx) {
+			const int x0 = std::max(min.x, tx * tileSize),
+			          x1 = std::min(max.x, tx * tileSize + tileSize - 1);
+			Float *tile = acquireTile(tx, ty);
+
+			for (int y=y0; y<=y1; ++y) {
+				const Float weightY = m_weightsY[y - min.y];
+				Float *dest = tile + ((y - ty * tileSize) * tileSize
+					+ (x0 - tx * tileSize)) * channels;
+
+				for (int x=x0; x<=x1; ++x) {
+					const Float weight = m_weightsX[x - min.x] * weightY;
+
+					for (int k=0; k<channels; ++k)
+						*dest++ += weight * value[k];
+				}
+			}
+		}
+	}
+}
+
+Float *ImageBlock::acquireTile(int tx, int ty) {
+	const int slot = (tx % m_tileGrid) + (ty % m_tileGrid) * m_tileGrid;
+	const int key = tx + ty * m_tilesX;
+	const size_t tileFloats = (size_t) m_tileSize * m_tileSize * m_bitmap->getChannelCount();
+	Float *tile = &m_tiles[slot * tileFloats];
+
+	if (EXPECT_NOT_TAKEN(m_tileKeys[slot] != key)) {
+		if (m_tileKeys[slot] >= 0)
+			mergeTile(slot);
+		m_tileKeys[slot] = key;
+		memset(tile, 0, tileFloats * sizeof(Float));
+	}
+
+	return tile;
+}
+
+void ImageBlock::mergeTile(int slot) {
+	const int channels = m_bitmap->getChannelCount();
+	const int key = m_tileKeys[slot];
+	const int tx = key % m_tilesX, ty = key / m_tilesX;
+	const Vector2i &size = m_bitmap->getSize();
+	const Point2i min(tx * m_tileSize, ty * m_tileSize),
+	              max(std::min(min.x + m_tileSize, size.x),
+	                  std::min(min.y + m_tileSize, size.y));
+	const Float *tile = &m_tiles[slot * (size_t) m_tileSize * m_tileSize * channels];
+
+	for (int y=min.y; y<max.y; ++y) {
+		const Float *src = tile + (y - min.y) * (size_t) m_tileSize * channels;
+		Float volatile *dest = m_bitmap->getFloatData()
+			+ (y * (size_t) size.x + min.x) * channels;
+
+		for (int x=min.x; x<max.x; ++x, src += channels, dest += channels) {
+			/* Skip channels that did not receive any contribution */
+			for (int k=0; k<channels; ++k) {
+				if (src[k] != 0)
+					atomicAdd(dest + k, src[k]);
+			}
+		}
+	}
+}
+
+void ImageBlock::flushTiles() {
+	for (size_t slot = 0; slot < m_tileKeys.size(); ++slot) {
+		if (m_tileKeys[slot] >= 0) {
+			mergeTile((int) slot);
+			m_tileKeys[slot] = -1;
+		}
+	}
+}
+
+void ImageBlock::discardTiles() {
+	std::fill(m_tileKeys.begin(), m_tileKeys.end(), -1);
+}
+
 void ImageBlock::load(Stream *stream) {
 	m_offset = Point2i(stream);
 	m_size = Vector2i(stream);
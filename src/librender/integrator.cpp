@@ -20,6 +20,8 @@
 #include <mitsuba/render/integrator2.h>
 #include <mitsuba/render/renderproc.h>
 #include <mitsuba/core/sched.h>
+#include <mitsuba/core/sfcurve.h>
+#include <mitsuba/core/atomic.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -297,6 +299,8 @@ bool ResponsiveIntegrator::allocate(const Scene &scene, Sampler *const *samplers
 	return true;
 }
 
+void ResponsiveIntegrator::prepareFrame(int threadCount) { }
+
 Float ResponsiveIntegrator::getLowerSampleBound() const {
 	return 1.0f;
 }
@@ -306,7 +310,32 @@ char const* ResponsiveIntegrator::getRealtimeStatistics() {
 }
 
 ImageOrderIntegrator::ImageOrderIntegrator(const Properties &props)
-	: ResponsiveIntegrator(props) { }
+	: ResponsiveIntegrator(props) {
+	/* Spatially coherent tiles keep textures, acceleration structure
+	   nodes and the splatting target warm in the caches of each thread */
+	std::string pixelOrder = to_lower_copy(props.getString("pixelOrder", "tiles"));
+	if (pixelOrder == "tiles")
+		m_pixelOrder = ECoherentTiles;
+	else if (pixelOrder == "random")
+		m_pixelOrder = ERandomPixels;
+	else
+		Log(EError, "Unknown pixel order \"%s\", must be \"tiles\" or \"random\"", pixelOrder.c_str());
+
+	m_pixelTileSize = props.getInteger("pixelTileSize", 8);
+	if (m_pixelTileSize <= 0)
+		Log(EError, "The 'pixelTileSize' parameter must be positive!");
+
+	/* Granularity of the work distributed and stolen between threads */
+	m_pixelChunkSize = props.getInteger("pixelChunkSize", 256);
+	if (m_pixelChunkSize <= 0)
+		Log(EError, "The 'pixelChunkSize' parameter must be positive!");
+	m_chunkCount = 0;
+
+	/* Number of consecutive pixel samples handed to renderBatch() */
+	m_rayBatchSize = props.getInteger("rayBatchSize", 16);
+	if (m_rayBatchSize <= 0 || m_rayBatchSize > MTS_MAX_RAY_BATCH)
+		Log(EError, "The 'rayBatchSize' parameter must be in [1, %i]!", MTS_MAX_RAY_BATCH);
+}
 
 ImageOrderIntegrator::~ImageOrderIntegrator() { }
 
@@ -316,27 +345,163 @@ bool ImageOrderIntegrator::allocate(const Scene &scene, Sampler *const *samplers
 	if (this->m_pxPermutation.size() != pixelCount) {
 		this->m_pxPermutation.resize(pixelCount);
 		int* pixels = m_pxPermutation.data();
-		for (int i = 0; i < pixelCount; ++i) {
-			pixels[i] = i;
-		}
-		{
-			std::random_device rd;
-			std::mt19937 g(rd());
+		std::random_device rd;
+		std::mt19937 g(rd());
+
+		if (m_pixelOrder == ECoherentTiles) {
+			/* Shuffle the tiles to retain a uniform progressive look,
+			   but traverse the pixels within each tile coherently */
+			int tileSize = m_pixelTileSize;
+			Vector2i tileCount((resolution.x + tileSize - 1) / tileSize,
+				(resolution.y + tileSize - 1) / tileSize);
+			std::vector<int> tiles(tileCount.x * tileCount.y);
+			for (int i = 0; i < (int) tiles.size(); ++i)
+				tiles[i] = i;
+			std::shuffle(tiles.begin(), tiles.end(), g);
+
+			HilbertCurve2D<int> curve;
+			curve.initialize(Vector2i(tileSize));
+
+			int *pixel = pixels;
+			for (int tile : tiles) {
+				Point2i tileOffset((tile % tileCount.x) * tileSize, (tile / tileCount.x) * tileSize);
+				for (size_t i = 0; i < curve.getPointCount(); ++i) {
+					Point2i px = tileOffset + Vector2i(curve[i]);
+					if (px.x < resolution.x && px.y < resolution.y)
+						*pixel++ = px.x + px.y * resolution.x;
+				}
+			}
+			Assert(pixel == pixels + pixelCount);
+		} else {
+			for (int i = 0; i < pixelCount; ++i) {
+				pixels[i] = i;
+			}
 			std::shuffle(pixels, pixels + pixelCount, g);
 		}
 	}
+	prepareFrame(threadCount);
 	return true;
 }
 
+namespace {
+	/* Work ranges are packed into 64 bits: 24 bits of pass index,
+	   20 bits each for the begin and end chunk indices */
+	const int64_t WORK_PASS_MASK = (1 << 24) - 1;
+	const int64_t WORK_CHUNK_MASK = (1 << 20) - 1;
+
+	inline int64_t packWorkRange(int pass, int begin, int end) {
+		return ((int64_t) (pass & WORK_PASS_MASK) << 40)
+			| ((int64_t) begin << 20) | (int64_t) end;
+	}
+
+	inline void unpackWorkRange(int64_t range, int &pass, int &begin, int &end) {
+		pass = (int) ((range >> 40) & WORK_PASS_MASK);
+		begin = (int) ((range >> 20) & WORK_CHUNK_MASK);
+		end = (int) (range & WORK_CHUNK_MASK);
+	}
+};
+
+void ImageOrderIntegrator::prepareFrame(int threadCount) {
+	int pixelCount = (int) m_pxPermutation.size();
+	/* Coarsen the chunks if the image does not fit the packed chunk indices */
+	int chunkSize = std::max(m_pixelChunkSize, (int) ((pixelCount + WORK_CHUNK_MASK - 1) / WORK_CHUNK_MASK));
+	m_chunkCount = (pixelCount + chunkSize - 1) / chunkSize;
+
+	if ((int) m_workRanges.size() != threadCount)
+		m_workRanges = std::vector<WorkRange>(threadCount);
+	for (int i = 0; i < threadCount; ++i)
+		distributeChunks(i, threadCount, 0, m_workRanges[i].range);
+}
+
+void ImageOrderIntegrator::distributeChunks(int threadIdx, int threadCount, int pass, int64_t expected) {
+	/* Rotate the static share of each thread from pass to pass */
+	int share = (int) ((threadIdx + 17 * (int64_t) pass) % threadCount);
+	int begin = (int) ((int64_t) share * m_chunkCount / threadCount),
+	    end = (int) ((int64_t) (share + 1) * m_chunkCount / threadCount);
+	atomicCompareAndExchange(&m_workRanges[threadIdx].range,
+		packWorkRange(pass, begin, end), expected);
+}
+
+void ImageOrderIntegrator::acquireChunks(int threadIdx, int threadCount, int &pass, int &begin, int &end) {
+	WorkRange *ranges = m_workRanges.data();
+
+	while (true) {
+		/* Pop a single chunk from the front of the own range */
+		int64_t own = ranges[threadIdx].range;
+		int ownPass, ownBegin, ownEnd;
+		unpackWorkRange(own, ownPass, ownBegin, ownEnd);
+		if (ownBegin < ownEnd) {
+			if (atomicCompareAndExchange(&ranges[threadIdx].range,
+					packWorkRange(ownPass, ownBegin + 1, ownEnd), own)) {
+				pass = ownPass; begin = ownBegin; end = ownBegin + 1;
+				return;
+			}
+			continue;
+		}
+
+		/* Steal the back half of the range of another thread in the same pass */
+		bool allEmpty = true, contended = false, behind = false, ahead = false;
+		for (int i = 1; i < threadCount; ++i) {
+			int victimIdx = (threadIdx + i) % threadCount;
+			int64_t victim = ranges[victimIdx].range;
+			int victimPass, victimBegin, victimEnd;
+			unpackWorkRange(victim, victimPass, victimBegin, victimEnd);
+			/* Passes of different ranges differ by at most one */
+			if (victimPass == ((ownPass + 1) & WORK_PASS_MASK))
+				behind = true;
+			else if (victimPass != ownPass)
+				ahead = true;
+			if (victimBegin == victimEnd)
+				continue;
+
+			allEmpty = false;
+			if (victimPass != ownPass)
+				continue; // the own range lags behind, distribute it first
+			int split = victimEnd - (victimEnd - victimBegin + 1) / 2;
+			if (!atomicCompareAndExchange(&ranges[victimIdx].range,
+					packWorkRange(victimPass, victimBegin, split), victim)) {
+				contended = true;
+				continue;
+			}
+
+			/* Keep one chunk, publish the rest for further stealing */
+			pass = victimPass; begin = split; end = victimEnd;
+			if (end - begin > 1 && atomicCompareAndExchange(&ranges[threadIdx].range,
+					packWorkRange(pass, begin + 1, end), own))
+				end = begin + 1;
+			return;
+		}
+
+		if (contended || (!allEmpty && !behind))
+			continue;
+
+		/* Distribute the shares of the next pass once every range is exhausted,
+		   or help distributing the newest pass to ranges that lag behind */
+		int nextPass = behind || !ahead ? (ownPass + 1) & WORK_PASS_MASK : ownPass;
+		for (int i = 0; i < threadCount; ++i) {
+			int64_t range = ranges[i].range;
+			int rangePass, rangeBegin, rangeEnd;
+			unpackWorkRange(range, rangePass, rangeBegin, rangeEnd);
+			if (rangePass != nextPass && rangeBegin == rangeEnd)
+				distributeChunks(i, threadCount, nextPass, range);
+		}
+	}
+}
+
 int ImageOrderIntegrator::render(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target
 	, Controls controls, int threadIdx, int threadCount) {
 	Vector2i resolution = target.getBitmap()->getSize();
 	int planeSamples = resolution.x * resolution.y;
 	assert(planeSamples == this->m_pxPermutation.size());
+	if ((int) m_workRanges.size() != threadCount)
+		Log(EError, "Work distribution was prepared for %d instead of %d threads!", (int) m_workRanges.size(), threadCount);
 
-	int blockSize = (planeSamples + (threadCount - 1)) / threadCount;
-	int const* workBegin = 0, *workEnd = 0, *work = 0;
-	int completedBlocks = -1;
+	int chunkSize = (planeSamples + m_chunkCount - 1) / m_chunkCount;
+	int const* workEnd = 0, *work = 0;
+	int chunkPass = 0, chunkBegin = 0, chunkEnd = 0;
+	int samplerPass = 0; // every frame starts at pass 0
+	size_t sampleIndex = 0;
+	bool samplerReady = false;
 
 	int currentSamples = 0, completedPlanes = 0;
 	double spp = 0.0f;
@@ -345,18 +510,24 @@ int ImageOrderIntegrator::render(const Scene &scene, const Sensor &sensor, Sampl
 	while (returnCode == 0) {
 		// work distribution
 		if (work == workEnd) {
-			++completedBlocks;
-			int wid = (threadIdx + 17 * completedBlocks) % threadCount;
-			// advance the sampler (note: random pixels inefficient for samplers that pre-generate)
-			if (completedBlocks) {
-//				SLog(EInfo, "Thread [%d] sample index: %d", threadIdx, (int) sampler.getSampleIndex());
-				if (sampler.getSampleIndex() + 1 >= sampler.getSampleCount())
+			if (chunkBegin == chunkEnd)
+				acquireChunks(threadIdx, threadCount, chunkPass, chunkBegin, chunkEnd);
+			/* The sample index is derived from the pass rather than advanced
+			   per thread: chunks are stolen across threads, and a pixel must
+			   never see the same sample index twice. Packed passes wrap
+			   around, but no thread falls 2^24 passes behind. */
+			if (!samplerReady || chunkPass != samplerPass) {
+				sampleIndex += (size_t) ((chunkPass - samplerPass) & WORK_PASS_MASK);
+//				SLog(EInfo, "Thread [%d] sample index: %d", threadIdx, (int) sampleIndex);
+				if (sampleIndex >= sampler.getSampleCount())
 					break;
-				sampler.advance();
+				sampler.setSampleIndex(sampleIndex);
+				samplerPass = chunkPass;
+				samplerReady = true;
 			}
-			workBegin = wid * blockSize + this->m_pxPermutation.data();
-			workEnd = std::min((wid+1) * blockSize, planeSamples) + this->m_pxPermutation.data();
-			work = workBegin;
+			work = chunkBegin * chunkSize + this->m_pxPermutation.data();
+			workEnd = std::min((chunkBegin + 1) * chunkSize, planeSamples) + this->m_pxPermutation.data();
+			++chunkBegin;
 		}
 
 		if ((currentSamples & 0x3f) == 0 || currentSamples == 1) { // allow fast abort before and after first sample (in case of lazy init code)
@@ -377,14 +548,24 @@ int ImageOrderIntegrator::render(const Scene &scene, const Sensor &sensor, Sampl
 			}
 		}
 
-		// one sample
-		int j = *work++;
-		mitsuba::Point2i offset(j % resolution.x, j / resolution.x);
-		sampler.generate(offset, ~0);
+		// batch of samples up to the next control point (the first sample is rendered alone)
+		int batchSize = 1;
+		if (currentSamples != 0) {
+			batchSize = std::min(m_rayBatchSize, 0x40 - (currentSamples & 0x3f));
+			batchSize = std::min(batchSize, (int) (workEnd - work));
+			batchSize = std::min(batchSize, planeSamples - currentSamples);
+		}
+
+		// note: random pixels inefficient for samplers that pre-generate
+		mitsuba::Point2i offsets[MTS_MAX_RAY_BATCH];
+		for (int i = 0; i < batchSize; ++i) {
+			int j = *work++;
+			offsets[i] = mitsuba::Point2i(j % resolution.x, j / resolution.x);
+		}
 
-		returnCode = this->render(scene, sensor, sampler, target, offset, threadIdx, threadCount);
+		returnCode = this->renderBatch(scene, sensor, sampler, target, offsets, batchSize, threadIdx, threadCount);
 
-		++currentSamples;
+		currentSamples += batchSize;
 		// precise sample tracking
 		if (currentSamples == planeSamples) {
 			++completedPlanes;
@@ -396,6 +577,16 @@ int ImageOrderIntegrator::render(const Scene &scene, const Sensor &sensor, Sampl
 	return returnCode;
 }
 
+int ImageOrderIntegrator::renderBatch(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, const Point2i *pixels, int count, int threadIdx, int threadCount) {
+	for (int i = 0; i < count; ++i) {
+		sampler.generate(pixels[i], ~0);
+		int returnCode = this->render(scene, sensor, sampler, target, pixels[i], threadIdx, threadCount);
+		if (returnCode != 0)
+			return returnCode;
+	}
+	return 0;
+}
+
 PixelDifferential::PixelDifferential(int sampleCount) {
 	scale = 1.0f / std::sqrt((Float) sampleCount);
 }
@@ -448,6 +639,10 @@ bool ClassicSamplingIntegrator::allocate(const Scene &scene, Sampler *const *sam
 	for (int i = 0; i < threadCount; ++i)
 		classicIntegrator->configureSampler(&scene, samplers[i]);
 
+	/* Batch samplers are cloned by the workers once they are needed */
+	m_batchSamplers.clear();
+	m_batchSamplers.resize(threadCount);
+
 	return result;
 }
 
@@ -476,6 +671,50 @@ int  ClassicSamplingIntegrator::render(const Scene &scene, const Sensor &sensor,
 	return 0;
 }
 
+int ClassicSamplingIntegrator::renderBatch(const Scene &scene, const Sensor &sensor, Sampler &sampler, ImageBlock& target, const Point2i *pixels, int count, int threadIdx, int threadCount) {
+	if (count == 1)
+		return ImageOrderIntegrator::renderBatch(scene, sensor, sampler, target, pixels, count, threadIdx, threadCount);
+
+	PixelSample pxSamples[MTS_MAX_RAY_BATCH];
+	Spectrum weights[MTS_MAX_RAY_BATCH];
+	Ray rays[MTS_MAX_RAY_BATCH];
+	Intersection its[MTS_MAX_RAY_BATCH];
+
+	/* Every pixel of the batch is generated once into a sampler of its own,
+	   which Li() continues with after the sensor dimensions */
+	ref_vector<Sampler> &batchSamplers = m_batchSamplers[threadIdx];
+	while ((int) batchSamplers.size() < count)
+		batchSamplers.push_back(sampler.clone());
+
+	for (int i = 0; i < count; ++i) {
+		Sampler *pixelSampler = batchSamplers[i];
+		pixelSampler->generate(pixels[i], sampler.getSampleIndex());
+		weights[i] = this->pixelDifferential.sample(pxSamples[i], sensor, pixels[i], *pixelSampler);
+		rays[i] = pxSamples[i].ray;
+	}
+
+	scene.rayIntersectBatch(rays, its, count);
+
+	for (int i = 0; i < count; ++i) {
+		const PixelSample &pxSample = pxSamples[i];
+		RadianceQueryRecord rRec(&scene, batchSamplers[i]);
+		rRec.newQuery(RadianceQueryRecord::ESensorRay, sensor.getMedium());
+		rRec.its = its[i];
+		rRec.setIntersection(pxSample.ray);
+		Spectrum spec = weights[i] * this->classicIntegrator->Li(pxSample.ray, rRec);
+
+		if (rRec.alpha >= 0.0f) {
+#ifndef MTS_NO_ATOMIC_SPLAT
+			target.putAtomic(pxSample.point, spec, rRec.alpha);
+#else
+			target.put(pxSample.point, spec, rRec.alpha);
+#endif
+		}
+	}
+
+	return 0;
+}
+
 MTS_IMPLEMENT_CLASS(ResponsiveIntegrator, true, Object)
 MTS_IMPLEMENT_CLASS(ImageOrderIntegrator, true, ResponsiveIntegrator)
 MTS_IMPLEMENT_CLASS(ClassicSamplingIntegrator, false, ImageOrderIntegrator)
@@ -24,32 +24,34 @@
 MTS_NAMESPACE_BEGIN
 
 PhotonMap::PhotonMap(size_t photonCount)
-		: m_kdtree(0, PhotonTree::ESlidingMidpoint), m_scale(1.0f) {
+		: m_scale(1.0f) {
 	m_kdtree.reserve(photonCount);
 	Assert(Photon::m_precompTableReady);
 }
 
 PhotonMap::PhotonMap(Stream *stream, InstanceManager *manager)
-    : SerializableObject(stream, manager),
-	  m_kdtree(0, PhotonTree::ESlidingMidpoint) {
+    : SerializableObject(stream, manager) {
 	Assert(Photon::m_precompTableReady);
 	m_scale = (Float) stream->readFloat();
-	m_kdtree.resize(stream->readSize());
-	m_kdtree.setDepth(stream->readSize());
+	size_t photonCount = stream->readSize();
+	stream->readSize(); /* The tree is rebuilt below */
 	m_kdtree.setAABB(AABB(stream));
-	for (size_t i=0; i<m_kdtree.size(); ++i)
-		m_kdtree[i] = Photon(stream);
+	m_kdtree.reserve(photonCount);
+	for (size_t i=0; i<photonCount; ++i)
+		push_back(Photon(stream));
+	if (photonCount > 0)
+		m_kdtree.build();
 }
 
 void PhotonMap::serialize(Stream *stream, InstanceManager *manager) const {
 	Log(EDebug, "Serializing a photon map (%s)",
-		memString(m_kdtree.size() * sizeof(Photon)).c_str());
+		memString(m_kdtree.getMemoryUsage()).c_str());
 	stream->writeFloat(m_scale);
 	stream->writeSize(m_kdtree.size());
 	stream->writeSize(m_kdtree.getDepth());
 	m_kdtree.getAABB().serialize(stream);
 	for (size_t i=0; i<m_kdtree.size(); ++i)
-		m_kdtree[i].serialize(stream);
+		(*this)[i].serialize(stream);
 }
 
 PhotonMap::~PhotonMap() {
@@ -62,6 +64,7 @@ std::string PhotonMap::toString() const {
 		<< "  capacity = " << m_kdtree.capacity() << "," << endl
 		<< "  aabb = " << m_kdtree.getAABB().toString() << "," << endl
 		<< "  depth = " << m_kdtree.getDepth() << "," << endl
+		<< "  memory = " << memString(m_kdtree.getMemoryUsage()) << "," << endl
 		<< "  scale = " << m_scale << endl
 		<< "]";
 	return oss.str();
@@ -70,7 +73,7 @@ void PhotonMap::dumpOBJ(const std::string &filename) {
 	std::ofstream os(filename.c_str());
 	os << "o Photons" << endl;
 	for (size_t i=0; i<m_kdtree.size(); ++i) {
-		const Point &p = m_kdtree[i].getPosition();
+		Point p = m_kdtree.getPosition(i);
 		os << "v " << p.x << " " << p.y << " " << p.z << endl;
 	}
 
@@ -94,7 +97,7 @@ Spectrum PhotonMap::estimateIrradiance(
 	Spectrum result(0.0f);
 	for (size_t i=0; i<resultCount; i++) {
 		const SearchResult &searchResult = results[i];
-		const Photon &photon = m_kdtree[searchResult.index];
+		const Photon photon = (*this)[searchResult.index];
 		if (photon.getDepth() > maxDepth)
 			continue;
 
@@ -134,7 +137,7 @@ Spectrum PhotonMap::estimateRadiance(const Intersection &its,
 	const BSDF *bsdf = its.getBSDF();
 	for (size_t i=0; i<resultCount; i++) {
 		const SearchResult &searchResult = results[i];
-		const Photon &photon = m_kdtree[searchResult.index];
+		const Photon photon = (*this)[searchResult.index];
 		Float sqrTerm = 1.0f - searchResult.distSquared*invSquaredRadius;
 
 		Vector wi = its.toLocal(-photon.getDirection());
@@ -150,18 +153,22 @@ Spectrum PhotonMap::estimateRadiance(const Intersection &its,
 }
 
 struct RawRadianceQuery {
-	RawRadianceQuery(const Intersection &its, int maxDepth)
-	  : its(its), maxDepth(maxDepth), result(0.0f) {
+	RawRadianceQuery(const PhotonMap::PhotonTree &kdtree, const Intersection &its, int maxDepth)
+	  : kdtree(kdtree), its(its), maxDepth(maxDepth), result(0.0f) {
 		bsdf = its.getBSDF();
 	}
 
-	inline void operator()(const Photon &photon) {
+	inline void operator()(PhotonMap::IndexType index) {
+		const PhotonData &data = kdtree.getData(index);
+		if (data.depth > maxDepth)
+			return;
+
+		const Photon photon(kdtree.getPosition(index), data);
 		Normal photonNormal(photon.getNormal());
 		Vector wi = -photon.getDirection();
 		Float wiDotGeoN = absDot(photonNormal, wi);
 
-		if (photon.getDepth() > maxDepth
-			|| dot(photonNormal, its.shFrame.n) < 1e-1f
+		if (dot(photonNormal, its.shFrame.n) < 1e-1f
 			|| wiDotGeoN < 1e-2f)
 			return;
 
@@ -178,6 +185,7 @@ struct RawRadianceQuery {
 		result += value;
 	}
 
+	const PhotonMap::PhotonTree &kdtree;
 	const Intersection &its;
 	const BSDF *bsdf;
 	int maxDepth;
@@ -186,7 +194,7 @@ struct RawRadianceQuery {
 
 size_t PhotonMap::estimateRadianceRaw(const Intersection &its,
 		Float searchRadius, Spectrum &result, int maxDepth) const {
-	RawRadianceQuery query(its, maxDepth);
+	RawRadianceQuery query(m_kdtree, its, maxDepth);
 	size_t count = m_kdtree.executeQuery(its.p, searchRadius, query);
 	result = query.result;
 	return count;
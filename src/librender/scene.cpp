@@ -34,6 +34,7 @@ Scene::Scene()
 	m_kdtree = new ShapeKDTree();
 	m_sourceFile = new fs::pathstr();
 	m_destinationFile = new fs::pathstr();
+	m_useEmitterBVH = false;
 	m_scenePreprocessed = false;
 	m_integratorPreprocessed = false;
 }
@@ -78,6 +79,26 @@ Scene::Scene(const Properties &props)
 	   in succession before a leaf node will be created.*/
 	if (props.hasProperty("kdMaxBadRefines"))
 		m_kdtree->setMaxBadRefines(props.getInteger("kdMaxBadRefines"));
+	/* Acceleration data structure: SAH kd-tree ("kd", default) or a
+	   4-wide BVH ("bvh"), which builds much faster on huge meshes */
+	std::string accel = to_lower_copy(props.getString("accel", "kd"));
+	if (accel == "bvh")
+		m_kdtree->setAccelerator(ShapeKDTree::EBVH);
+	else if (accel != "kd")
+		Log(EError, "Unknown acceleration data structure \"%s\" (must be "
+			"\"kd\" or \"bvh\")", accel.c_str());
+	/* Emitter selection for direct illumination: proportional to the
+	   sampling weights ("weight", default), or using a hierarchy that
+	   accounts for the position of the reference point ("bvh"). The
+	   hierarchy assumes static lights, see getEmitterBVH() */
+	std::string emitterSampling = to_lower_copy(props.getString("emitterSampling", "weight"));
+	if (emitterSampling == "bvh")
+		m_useEmitterBVH = true;
+	else if (emitterSampling == "weight")
+		m_useEmitterBVH = false;
+	else
+		Log(EError, "Unknown emitter sampling technique \"%s\" (must be "
+			"\"weight\" or \"bvh\")", emitterSampling.c_str());
 	m_sourceFile = new fs::pathstr();
 	m_destinationFile = new fs::pathstr();
 	m_scenePreprocessed = false;
@@ -86,6 +107,8 @@ Scene::Scene(const Properties &props)
 
 Scene::Scene(Scene *scene) : NetworkedObject(Properties()) {
 	m_kdtree = scene->m_kdtree;
+	m_instanceTree = scene->m_instanceTree;
+	m_instanceLayer = scene->m_instanceLayer;
 	m_blockSize = scene->m_blockSize;
 	m_aabb = scene->m_aabb;
 	m_environmentEmitter = scene->m_environmentEmitter;
@@ -94,6 +117,8 @@ Scene::Scene(Scene *scene) : NetworkedObject(Properties()) {
 	m_sourceFile = new fs::pathstr(*scene->m_sourceFile);
 	m_destinationFile = new fs::pathstr(*scene->m_destinationFile);
 	m_emitterPDF = scene->m_emitterPDF;
+	m_emitterBVH = scene->m_emitterBVH;
+	m_useEmitterBVH = scene->m_useEmitterBVH;
 	m_shapes = scene->m_shapes;
 	m_sensors = scene->m_sensors;
 	m_meshes = scene->m_meshes;
@@ -122,9 +147,11 @@ Scene::Scene(Stream *stream, InstanceManager *manager)
 	m_kdtree->setParallelBuild(stream->readBool());
 	m_kdtree->setRetract(stream->readBool());
 	m_kdtree->setMaxBadRefines(stream->readUInt());
+	m_kdtree->setAccelerator((ShapeKDTree::EAccelerator) stream->readInt());
 	m_blockSize = stream->readUInt();
 	m_degenerateSensor = stream->readBool();
 	m_degenerateEmitters = stream->readBool();
+	m_useEmitterBVH = stream->readBool();
 	m_aabb = AABB(stream);
 	m_environmentEmitter = static_cast<Emitter *>(manager->getInstance(stream));
 	m_sourceFile = new fs::pathstr(stream->readString());
@@ -172,6 +199,15 @@ Scene::Scene(Stream *stream, InstanceManager *manager)
 	initialize();
 }
 
+ref<Scene> Scene::createReplica() {
+	ref<Scene> replica = new Scene(this);
+	replica->m_kdtree = m_kdtree->createReplica();
+	replica->m_sampler = m_sampler;
+	replica->m_scenePreprocessed = m_scenePreprocessed;
+	replica->m_integratorPreprocessed = m_integratorPreprocessed;
+	return replica;
+}
+
 Scene::~Scene() {
 	delete m_destinationFile;
 	delete m_sourceFile;
@@ -190,9 +226,11 @@ void Scene::serialize(Stream *stream, InstanceManager *manager) const {
 	stream->writeBool(m_kdtree->getParallelBuild());
 	stream->writeBool(m_kdtree->getRetract());
 	stream->writeUInt(m_kdtree->getMaxBadRefines());
+	stream->writeInt(m_kdtree->getAccelerator());
 	stream->writeUInt(m_blockSize);
 	stream->writeBool(m_degenerateSensor);
 	stream->writeBool(m_degenerateEmitters);
+	stream->writeBool(m_useEmitterBVH);
 	m_aabb.serialize(stream);
 	manager->serialize(stream, m_environmentEmitter.get());
 	stream->writeString(m_sourceFile->s);
@@ -324,12 +362,137 @@ void Scene::configure() {
 }
 
 void Scene::invalidate() {
+	ShapeKDTree::EAccelerator accel = m_kdtree->getAccelerator();
 	m_kdtree = new ShapeKDTree();
+	m_kdtree->setAccelerator(accel);
+	m_instanceTree = NULL;
+	m_instanceLayer = NULL;
+	m_emitterBVH = NULL;
+}
+
+/**
+ * \brief Single primitive of the scene's kd-tree, which stands for all
+ * instances of the scene
+ *
+ * Intersections are delegated to a separate tree over the instances. The
+ * shape keeps reporting the bounds that the scene's kd-tree was built with,
+ * so the instances may move within them by only replacing that tree.
+ */
+class InstanceLayer : public Shape {
+public:
+	InstanceLayer(ShapeKDTree *kdtree) : Shape(Properties()),
+		m_kdtree(kdtree), m_bounds(kdtree->getAABB()) { }
+
+	/// Replace the tree over the instances, but keep the reported bounds
+	inline void setKDTree(ShapeKDTree *kdtree) { m_kdtree = kdtree; }
+
+	/// Set the bounds reported to the scene's kd-tree
+	inline void setBounds(const AABB &aabb) { m_bounds = aabb; }
+
+	AABB getAABB() const { return m_bounds; }
+
+	bool rayIntersect(const Ray &ray, Float mint,
+			Float maxt, Float &t, void *temp) const {
+		return m_kdtree->rayIntersect(ray, mint, maxt, t, temp);
+	}
+
+	bool rayIntersect(const Ray &ray, Float mint, Float maxt) const {
+		return m_kdtree->rayIntersect(ray, mint, maxt);
+	}
+
+	void fillIntersectionRecord(const Ray &ray,
+			const void *temp, Intersection &its) const {
+		m_kdtree->fillIntersectionRecord<false>(ray, temp, its);
+	}
+
+	size_t getPrimitiveCount() const {
+		return 0;
+	}
+
+	size_t getEffectivePrimitiveCount() const {
+		const std::vector<const Shape *> &shapes = m_kdtree->getShapes();
+		size_t result = 0;
+		for (size_t i=0; i<shapes.size(); ++i)
+			result += shapes[i]->getEffectivePrimitiveCount();
+		return result;
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "InstanceLayer[" << endl
+			<< "  instances = " << m_kdtree->getShapes().size() << "," << endl
+			<< "  bounds = " << m_bounds.toString() << endl
+			<< "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+private:
+	ref<ShapeKDTree> m_kdtree;
+	AABB m_bounds;
+};
+
+/// Create an empty kd-tree with the build parameters of \c kdtree
+static ref<ShapeKDTree> createKDTreeLike(const ShapeKDTree *kdtree) {
+	ref<ShapeKDTree> result = new ShapeKDTree();
+	result->setClip(kdtree->getClip());
+	result->setQueryCost(kdtree->getQueryCost());
+	result->setTraversalCost(kdtree->getTraversalCost());
+	result->setEmptySpaceBonus(kdtree->getEmptySpaceBonus());
+	result->setStopPrims(kdtree->getStopPrims());
+	result->setMaxDepth(kdtree->getMaxDepth());
+	result->setExactPrimitiveThreshold(kdtree->getExactPrimitiveThreshold());
+	result->setParallelBuild(kdtree->getParallelBuild());
+	result->setRetract(kdtree->getRetract());
+	result->setMaxBadRefines(kdtree->getMaxBadRefines());
+	result->setLogLevel(kdtree->getLogLevel());
+	result->setAccelerator(kdtree->getAccelerator());
+	return result;
+}
+
+void Scene::refitKDTree() {
+	if (!m_kdtree->isAcceleratorBuilt())
+		return; /* Will be built by initialize() */
+
+	if (m_instanceTree) {
+		/* Only the instances can move: rebuild the tree over them,
+		   the shape groups keep their trees */
+		ref<ShapeKDTree> instanceTree = createKDTreeLike(m_instanceTree);
+		const std::vector<const Shape *> &instances = m_instanceTree->getShapes();
+		for (size_t i=0; i<instances.size(); ++i)
+			instanceTree->addShape(instances[i]);
+		instanceTree->build();
+
+		InstanceLayer *layer = static_cast<InstanceLayer *>(m_instanceLayer.get());
+		AABB oldBounds = layer->getAABB();
+		layer->setKDTree(instanceTree);
+		m_instanceTree = instanceTree;
+
+		if (!oldBounds.contains(instanceTree->getAABB())) {
+			/* The instances left the region that the scene's kd-tree
+			   references the layer in, so it has to be built again */
+			layer->setBounds(instanceTree->getAABB());
+			ref<ShapeKDTree> kdtree = createKDTreeLike(m_kdtree);
+			const std::vector<const Shape *> &shapes = m_kdtree->getShapes();
+			for (size_t i=0; i<shapes.size(); ++i)
+				kdtree->addShape(shapes[i]);
+			kdtree->build();
+			m_kdtree = kdtree;
+		}
+	}
+
+	/* Moved area lights change the bounds and normal cones */
+	if (m_useEmitterBVH)
+		m_emitterBVH = new EmitterBVH(m_emitters);
+
+	initializeBidirectional();
 }
 
 void Scene::initialize() {
-	if (!m_kdtree->isBuilt()) {
+	if (!m_kdtree->isAcceleratorBuilt()) {
 		/* Expand all geometry */
+		m_instanceTree = createKDTreeLike(m_kdtree);
+		m_instanceLayer = NULL;
 		ref_vector<Shape> temp;
 		temp.reserve(m_shapes.size());
 
@@ -349,6 +512,16 @@ void Scene::initialize() {
 				SIZE_T_FMT ".", primitiveCount, effPrimitiveCount);
 		}
 
+		/* Insert all instances as a single primitive backed by their own
+		   tree, which refitKDTree() can rebuild after instances were moved */
+		if (m_instanceTree->getShapes().empty()) {
+			m_instanceTree = NULL;
+		} else {
+			m_instanceTree->build();
+			m_instanceLayer = new InstanceLayer(m_instanceTree);
+			m_kdtree->addShape(m_instanceLayer);
+		}
+
 		/* Build the kd-tree */
 		m_kdtree->build();
 
@@ -388,6 +561,9 @@ void Scene::initialize() {
 		m_emitterPDF.normalize();
 	}
 
+	if (m_useEmitterBVH && !m_emitterBVH)
+		m_emitterBVH = new EmitterBVH(m_emitters);
+
 	initializeBidirectional();
 }
 
@@ -542,6 +718,7 @@ void Scene::addChild(const std::string &name, ConfigurableObject *child) {
 		}
 
 		m_emitters.push_back(emitter);
+		m_emitterBVH = NULL;
 	} else if (cClass->derivesFrom(MTS_CLASS(Shape))) {
 		Shape *shape = static_cast<Shape *>(child);
 		if (shape->isSensor()) // determine sensors as early as possible
@@ -595,8 +772,10 @@ void Scene::addShape(Shape *shape) {
 	} else {
 		if (shape->isSensor() && !m_sensors.contains(shape->getSensor()))
 			m_sensors.push_back(shape->getSensor());
-		if (shape->isEmitter())
+		if (shape->isEmitter()) {
 			m_emitters.push_back(shape->getEmitter());
+			m_emitterBVH = NULL;
+		}
 		if (shape->hasSubsurface()) {
 			m_netObjects.push_back(shape->getSubsurface());
 			m_ssIntegrators.push_back(shape->getSubsurface());
@@ -614,7 +793,10 @@ void Scene::addShape(Shape *shape) {
 		if (shape->getClass()->derivesFrom(MTS_CLASS(TriMesh)))
 			m_meshes.push_back(static_cast<TriMesh *>(shape));
 
-		m_kdtree->addShape(shape);
+		if (m_instanceTree && shape->getClass()->getName() == "Instance")
+			m_instanceTree->addShape(shape);
+		else
+			m_kdtree->addShape(shape);
 		m_shapes.push_back(shape);
 	}
 }
@@ -854,14 +1036,32 @@ Spectrum Scene::evalTransmittanceAll(const Point &p1, bool p1OnSurface, const Po
 //                Emission and direct illumination sampling
 // ===========================================================================
 
+const Emitter *Scene::sampleEmitterDiscrete(const DirectSamplingRecord &dRec,
+		Float &sample, Float &pdf) const {
+	if (m_emitterBVH.get())
+		return m_emitterBVH->sample(dRec.ref, dRec.refN, sample, pdf);
+	size_t index = m_emitterPDF.sampleReuse(sample, pdf);
+	return m_emitters[index].get();
+}
+
+Float Scene::pdfEmitterDiscrete(const Emitter *emitter,
+		const DirectSamplingRecord &dRec) const {
+	if (m_emitterBVH.get())
+		return m_emitterBVH->pdf(emitter, dRec.ref, dRec.refN);
+	return pdfEmitterDiscrete(emitter);
+}
+
 Spectrum Scene::sampleEmitterDirect(DirectSamplingRecord &dRec,
 		const Point2 &_sample, bool testVisibility) const {
 	Point2 sample(_sample);
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-	const Emitter *emitter = m_emitters[index].get();
+	const Emitter *emitter = sampleEmitterDiscrete(dRec, sample.x, emPdf);
+	if (!emitter) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
 	if (dRec.pdf != 0) {
@@ -886,8 +1086,11 @@ Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-	const Emitter *emitter = m_emitters[index].get();
+	const Emitter *emitter = sampleEmitterDiscrete(dRec, sample.x, emPdf);
+	if (!emitter) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
 	if (dRec.pdf != 0) {
@@ -909,8 +1112,11 @@ Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
-	const Emitter *emitter = m_emitters[index].get();
+	const Emitter *emitter = sampleEmitterDiscrete(dRec, sample.x, emPdf);
+	if (!emitter) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
 	if (dRec.pdf != 0) {
@@ -977,7 +1183,7 @@ Spectrum Scene::sampleAttenuatedSensorDirect(DirectSamplingRecord &dRec,
 
 Float Scene::pdfEmitterDirect(const DirectSamplingRecord &dRec) const {
 	const Emitter *emitter = static_cast<const Emitter *>(dRec.object);
-	return emitter->pdfDirect(dRec) * pdfEmitterDiscrete(emitter);
+	return emitter->pdfDirect(dRec) * pdfEmitterDiscrete(emitter, dRec);
 }
 
 Float Scene::pdfSensorDirect(const DirectSamplingRecord &dRec) const {
@@ -1023,5 +1229,6 @@ Spectrum Scene::sampleEmitterRay(Ray &ray,
 	return emitter->sampleRay(ray, sample, directionalSample, time) / emPdf;
 }
 
+MTS_IMPLEMENT_CLASS(InstanceLayer, false, Shape)
 MTS_IMPLEMENT_CLASS_S(Scene, false, ConfigurableObject)
 MTS_NAMESPACE_END
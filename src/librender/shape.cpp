@@ -81,6 +81,14 @@ void Shape::adjustTime(Intersection &its, Float time) const {
 	/* Do nothing else by default */
 }
 
+const AnimatedTransform *Shape::getWorldTransform() const {
+	return NULL;
+}
+
+bool Shape::setWorldTransform(const AnimatedTransform *) {
+	return false;
+}
+
 bool Shape::isCompound() const {
 	return false;
 }
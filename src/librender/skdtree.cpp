@@ -27,7 +27,7 @@
 
 MTS_NAMESPACE_BEGIN
 
-ShapeKDTree::ShapeKDTree() {
+ShapeKDTree::ShapeKDTree() : m_accel(EKDTree), m_triangleOnly(true) {
 #if !defined(MTS_KD_CONSERVE_MEMORY)
 	m_triAccel = NULL;
 #endif
@@ -47,7 +47,7 @@ static StatsCounter raysTraced("General", "Normal rays traced");
 static StatsCounter shadowRaysTraced("General", "Shadow rays traced");
 
 void ShapeKDTree::addShape(const Shape *shape) {
-	Assert(!isBuilt());
+	Assert(!isAcceleratorBuilt());
 	if (shape->isCompound())
 		Log(EError, "Cannot add compound shapes to a kd-tree - expand them first!");
 	if (shape->getClass()->derivesFrom(MTS_CLASS(TriMesh))) {
@@ -60,6 +60,7 @@ void ShapeKDTree::addShape(const Shape *shape) {
 	} else {
 		m_shapeMap.push_back(1);
 		m_triangleFlag.push_back(false);
+		m_triangleOnly = false;
 	}
 	shape->incRef();
 	m_shapes.push_back(shape);
@@ -69,7 +70,34 @@ void ShapeKDTree::build() {
 	for (size_t i=1; i<m_shapeMap.size(); ++i)
 		m_shapeMap[i] += m_shapeMap[i-1];
 
-	SAHKDTree3D<ShapeKDTree>::buildInternal();
+	if (m_accel == EBVH) {
+		SizeType primCount = getPrimitiveCount();
+		Log(m_logLevel, "Constructing a 4-wide BVH over %i primitives (%s of temporary storage)",
+			primCount, memString(primCount * sizeof(AABB)).c_str());
+		std::vector<AABB> primBounds(primCount);
+		AABB aabb;
+#if defined(MTS_OPENMP)
+		#pragma omp parallel for if (getParallelBuild())
+#endif
+		for (int i=0; i<(int) primCount; ++i)
+			primBounds[i] = getAABB((IndexType) i);
+		for (SizeType i=0; i<primCount; ++i)
+			aabb.expandBy(primBounds[i]);
+
+		m_bvh.build(primBounds, getParallelBuild());
+
+		/* Slightly enlarge the bounding box, as done by the kd-tree */
+		m_tightAABB = aabb;
+		if (aabb.isValid()) {
+			const Float eps = MTS_KD_AABB_EPSILON;
+			aabb.min -= (aabb.max-aabb.min) * eps + Vector(eps);
+			aabb.max += (aabb.max-aabb.min) * eps + Vector(eps);
+		}
+		m_aabb = aabb;
+		Log(m_logLevel, "BVH storage cost: %s", memString(m_bvh.getMemoryUsage()).c_str());
+	} else {
+		SAHKDTree3D<ShapeKDTree>::buildInternal();
+	}
 
 #if !defined(MTS_KD_CONSERVE_MEMORY)
 	ref<Timer> timer = new Timer();
@@ -109,6 +137,34 @@ void ShapeKDTree::build() {
 #endif
 }
 
+ref<ShapeKDTree> ShapeKDTree::createReplica() const {
+	Assert(isAcceleratorBuilt());
+	ref<ShapeKDTree> replica = new ShapeKDTree();
+	for (size_t i=0; i<m_shapes.size(); ++i)
+		m_shapes[i]->incRef();
+	replica->m_shapes = m_shapes;
+	replica->m_triangleFlag = m_triangleFlag;
+	replica->m_shapeMap = m_shapeMap;
+	replica->m_accel = m_accel;
+	replica->m_triangleOnly = m_triangleOnly;
+
+	if (m_accel == EBVH) {
+		replica->m_bvh = m_bvh;
+		replica->m_aabb = m_aabb;
+		replica->m_tightAABB = m_tightAABB;
+		replica->m_logLevel = m_logLevel;
+	} else {
+		replica->copyTree(*this);
+	}
+
+#if !defined(MTS_KD_CONSERVE_MEMORY)
+	SizeType primCount = getPrimitiveCount();
+	replica->m_triAccel = static_cast<TriAccel *>(allocAligned(primCount * sizeof(TriAccel)));
+	memcpy(replica->m_triAccel, m_triAccel, primCount * sizeof(TriAccel));
+#endif
+	return replica;
+}
+
 bool ShapeKDTree::rayIntersect(const Ray &ray, Intersection &its) const {
 	uint8_t temp[MTS_KD_INTERSECTION_TEMP];
 	its.t = std::numeric_limits<Float>::infinity();
@@ -132,7 +188,7 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Intersection &its) const {
 		if (ray.maxt < maxt) maxt = ray.maxt;
 
 		if (EXPECT_TAKEN(maxt > mint)) {
-			if (rayIntersectHavran<false>(ray, mint, maxt, its.t, temp)) {
+			if (traverse<false>(ray, mint, maxt, its.t, temp)) {
 				fillIntersectionRecord<true>(ray, temp, its);
 				return true;
 			}
@@ -160,7 +216,7 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Float &t, ConstShapePtr &shape,
 		if (ray.maxt < maxt) maxt = ray.maxt;
 
 		if (EXPECT_TAKEN(maxt > mint)) {
-			if (rayIntersectHavran<false>(ray, mint, maxt, t, temp)) {
+			if (traverse<false>(ray, mint, maxt, t, temp)) {
 				const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(temp);
 				shape = m_shapes[cache->shapeIndex];
 
@@ -219,13 +275,147 @@ bool ShapeKDTree::rayIntersect(const Ray &ray) const {
 		if (ray.maxt < maxt) maxt = ray.maxt;
 
 		if (EXPECT_TAKEN(maxt > mint))
-			if (rayIntersectHavran<true>(ray, mint, maxt, t, NULL))
+			if (traverse<true>(ray, mint, maxt, t, NULL))
 				return true;
 	}
 	return false;
 }
 
+/// Batched queries are sorted and traced in blocks of this many rays
+#define MTS_KD_BATCH_BLOCK 64
+
+namespace {
+	/* Order a block of rays by direction octant, then by
+	   origin along a Morton curve over the scene bounds */
+	void sortBatch(const Ray *rays, size_t count, const AABB &aabb, uint32_t *order) {
+		uint64_t keys[MTS_KD_BATCH_BLOCK];
+		Vector extents = aabb.getExtents();
+		for (size_t i=0; i<count; ++i) {
+			const Ray &ray = rays[i];
+			uint32_t morton = 0;
+			for (int axis=0; axis<3; ++axis) {
+				Float rel = extents[axis] > 0 ? (ray.o[axis] - aabb.min[axis]) / extents[axis] : 0;
+				if (!(rel > 0))
+					rel = 0;
+				uint32_t q = (uint32_t) std::min((Float) 127, rel * 128);
+				for (int bit=0; bit<7; ++bit)
+					morton |= ((q >> bit) & 1) << (3*bit + axis);
+			}
+			uint32_t octant = (ray.d.x < 0 ? 1 : 0) | (ray.d.y < 0 ? 2 : 0) | (ray.d.z < 0 ? 4 : 0);
+			keys[i] = ((uint64_t) ((octant << 21) | morton) << 32) | (uint64_t) i;
+		}
+		std::sort(keys, keys + count);
+		for (size_t i=0; i<count; ++i)
+			order[i] = (uint32_t) keys[i];
+	}
+}
+
+void ShapeKDTree::rayIntersectBatch(const Ray *rays, Intersection *its, size_t count) const {
+	uint32_t order[MTS_KD_BATCH_BLOCK];
+	for (size_t offset = 0; offset < count; offset += MTS_KD_BATCH_BLOCK) {
+		size_t blockSize = std::min(count - offset, (size_t) MTS_KD_BATCH_BLOCK), i = 0;
+		const Ray *block = rays + offset;
+		Intersection *blockIts = its + offset;
+		sortBatch(block, blockSize, m_aabb, order);
 #if defined(MTS_HAS_COHERENT_RT)
+		if (m_accel == EKDTree && m_triangleOnly) {
+			for (; i + 4 <= blockSize; i += 4)
+				intersectPacket4(block, order + i, blockIts, NULL);
+		}
+#endif
+		for (; i<blockSize; ++i)
+			rayIntersect(block[order[i]], blockIts[order[i]]);
+	}
+}
+
+void ShapeKDTree::rayIntersectBatch(const Ray *rays, bool *occluded, size_t count) const {
+	uint32_t order[MTS_KD_BATCH_BLOCK];
+	for (size_t offset = 0; offset < count; offset += MTS_KD_BATCH_BLOCK) {
+		size_t blockSize = std::min(count - offset, (size_t) MTS_KD_BATCH_BLOCK), i = 0;
+		const Ray *block = rays + offset;
+		bool *blockOccluded = occluded + offset;
+		sortBatch(block, blockSize, m_aabb, order);
+#if defined(MTS_HAS_COHERENT_RT)
+		if (m_accel == EKDTree && m_triangleOnly) {
+			for (; i + 4 <= blockSize; i += 4)
+				intersectPacket4(block, order + i, NULL, blockOccluded);
+		}
+#endif
+		for (; i<blockSize; ++i)
+			blockOccluded[order[i]] = rayIntersect(block[order[i]]);
+	}
+}
+
+#if defined(MTS_HAS_COHERENT_RT)
+
+void ShapeKDTree::intersectPacket4(const Ray *rays, const uint32_t *order,
+		Intersection *its, bool *occluded) const {
+	RayPacket4 packet;
+	RayInterval4 interval;
+	Intersection4 its4;
+	uint8_t MM_ALIGN16 temp[4 * MTS_KD_INTERSECTION_TEMP];
+
+	for (int i=0; i<4; ++i) {
+		const Ray &ray = rays[order[i]];
+		for (int axis=0; axis<3; ++axis) {
+			packet.o[axis].f[i] = ray.o[axis];
+			packet.d[axis].f[i] = ray.d[axis];
+			packet.dRcp[axis].f[i] = ray.dRcp[axis];
+			packet.signs[axis][i] = ray.d[axis] < 0 ? 1 : 0;
+			if (packet.signs[axis][i] != packet.signs[axis][0]) {
+				/* Rays of different octants: trace them one by one */
+				for (int j=0; j<4; ++j) {
+					if (its)
+						rayIntersect(rays[order[j]], its[order[j]]);
+					else
+						occluded[order[j]] = rayIntersect(rays[order[j]]);
+				}
+				return;
+			}
+		}
+
+		/* Use the same adaptive ray epsilon as the single-ray queries */
+		Float rayMinT = ray.mint;
+		if (rayMinT == Epsilon) {
+			Float scale = std::max(std::max(std::abs(ray.o.x),
+				std::abs(ray.o.y)), std::abs(ray.o.z));
+			rayMinT *= its ? std::max(scale, Epsilon) : scale;
+		}
+		interval.mint.f[i] = rayMinT;
+		interval.maxt.f[i] = ray.maxt;
+	}
+
+	if (its)
+		raysTraced += 4;
+	else
+		shadowRaysTraced += 4;
+
+	rayIntersectPacket(packet, interval, its4, temp);
+
+	for (int i=0; i<4; ++i) {
+		bool found = its4.shapeIndex.ui[i] != KNoTriangleFlag;
+		if (!its) {
+			occluded[order[i]] = found;
+			continue;
+		}
+
+		Intersection &record = its[order[i]];
+		if (!found) {
+			record.t = std::numeric_limits<Float>::infinity();
+			continue;
+		}
+
+		/* Recreate the cache of a single-ray query */
+		uint8_t *rayTemp = temp + i * MTS_KD_INTERSECTION_TEMP;
+		IntersectionCache *cache = reinterpret_cast<IntersectionCache *>(rayTemp);
+		cache->shapeIndex = its4.shapeIndex.ui[i];
+		cache->primIndex = its4.primIndex.ui[i];
+		cache->u = its4.u.f[i];
+		cache->v = its4.v.f[i];
+		record.t = its4.t.f[i];
+		fillIntersectionRecord<true>(rays[order[i]], rayTemp, record);
+	}
+}
 
 /// Ray traversal stack entry for uncoherent ray tracing
 struct CoherentKDStackEntry {
@@ -240,6 +430,12 @@ static StatsCounter incoherentPackets("General", "Incoherent ray packets");
 
 void ShapeKDTree::rayIntersectPacket(const RayPacket4 &packet,
 		const RayInterval4 &rayInterval, Intersection4 &its, void *temp) const {
+	if (m_accel == EBVH) {
+		/* Packet traversal is only implemented for the kd-tree */
+		rayIntersectPacketIncoherent(packet, rayInterval, its, temp);
+		return;
+	}
+
 	CoherentKDStackEntry MM_ALIGN16 stack[MTS_KD_MAXDEPTH];
 	RayInterval4 MM_ALIGN16 interval;
 
@@ -370,7 +566,7 @@ void ShapeKDTree::rayIntersectPacketIncoherent(const RayPacket4 &packet,
 		ray.mint = rayInterval.mint.f[i];
 		ray.maxt = rayInterval.maxt.f[i];
 		uint8_t *rayTemp = reinterpret_cast<uint8_t *>(temp) + i * MTS_KD_INTERSECTION_TEMP;
-		if (ray.mint < ray.maxt && rayIntersectHavran<false>(ray, ray.mint, ray.maxt, t, rayTemp)) {
+		if (ray.mint < ray.maxt && traverse<false>(ray, ray.mint, ray.maxt, t, rayTemp)) {
 			const IntersectionCache *cache = reinterpret_cast<const IntersectionCache *>(rayTemp);
 			its4.t.f[i] = t;
 			its4.shapeIndex.i[i] = cache->shapeIndex;
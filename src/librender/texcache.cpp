@@ -0,0 +1,349 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/texcache.h>
+#include <mitsuba/core/statistics.h>
+#include <unordered_map>
+#include <list>
+#include <mutex>
+#include <atomic>
+
+#if defined(__LINUX__) || defined(__OSX__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <errno.h>
+#elif defined(__WINDOWS__)
+# include <windows.h>
+#endif
+
+/// Number of independently locked parts of the cache
+#define MTS_TEXCACHE_SHARDS 64
+
+/// Number of recently used tiles remembered by each thread (power of two)
+#define MTS_TEXCACHE_THREAD_SLOTS 16
+
+MTS_NAMESPACE_BEGIN
+
+namespace stats {
+	static StatsCounter tileMisses("Texture cache", "Tile misses", EPercentage);
+	static StatsCounter threadLocalHits("Texture cache", "Thread-local tile hits", EPercentage);
+	static StatsCounter tileEvictions("Texture cache", "Evicted tiles");
+	static StatsCounter tileBytesRead("Texture cache", "Tile data read from disk", EByteCount);
+};
+
+namespace {
+	/// Reference-counted block of tile data
+	class Tile : public Object {
+	public:
+		Tile(size_t size) : m_size(size) {
+			m_data = static_cast<uint8_t *>(allocAligned(size));
+		}
+
+		inline uint8_t *getData() { return m_data; }
+		inline size_t getSize() const { return m_size; }
+	protected:
+		virtual ~Tile() {
+			freeAligned(m_data);
+		}
+	private:
+		uint8_t *m_data;
+		size_t m_size;
+	};
+
+	/// Recently used tiles of the current thread (accessed without locking)
+	struct ThreadSlots {
+		struct Slot {
+			uint64_t key;
+			ref<Tile> tile;
+
+			Slot() : key((uint64_t) -1) { }
+		};
+
+		Slot slots[MTS_TEXCACHE_THREAD_SLOTS];
+	};
+
+	static thread_local ThreadSlots threadSlots;
+
+	inline uint32_t slotIndex(uint64_t key) {
+		/* Neighboring tiles of one provider go to different slots */
+		uint32_t h = (uint32_t) key ^ (uint32_t) (key >> 32) * 0x9E3779B9u;
+		return h & (MTS_TEXCACHE_THREAD_SLOTS - 1);
+	}
+
+	inline uint32_t shardIndex(uint64_t key) {
+		uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+		return (uint32_t) (h >> 40) % MTS_TEXCACHE_SHARDS;
+	}
+};
+
+struct TextureCache::TextureCachePrivate {
+	struct Entry {
+		uint64_t key;
+		ref<Tile> tile;
+	};
+
+	typedef std::list<Entry> LRUList;
+
+	/// Least recently used list and lookup table protected by one lock
+	struct Shard {
+		std::mutex mutex;
+		LRUList lru; /* Most recently used tiles first */
+		std::unordered_map<uint64_t, LRUList::iterator> table;
+		size_t memory;
+
+		Shard() : memory(0) { }
+	};
+
+	Shard shards[MTS_TEXCACHE_SHARDS];
+	std::mutex providerMutex;
+	std::unordered_map<uint32_t, const TileProvider *> providers;
+	uint32_t nextID;
+	std::atomic<size_t> budget; /* Read by evict() while setBudget() runs */
+
+	TextureCachePrivate() : nextID(0),
+		budget((size_t) MTS_TEXCACHE_DEFAULT_BUDGET * 1024 * 1024) { }
+
+	/// Release tiles until the shard fits into its part of the budget
+	void evict(Shard &shard, size_t reserve) {
+		size_t shardBudget = budget.load(std::memory_order_relaxed) / MTS_TEXCACHE_SHARDS;
+		while (!shard.lru.empty() && shard.memory + reserve > shardBudget) {
+			Entry &entry = shard.lru.back();
+			shard.memory -= entry.tile->getSize();
+			shard.table.erase(entry.key);
+			shard.lru.pop_back();
+			++stats::tileEvictions;
+		}
+	}
+};
+
+TextureCache::TextureCache() : d(new TextureCachePrivate()) { }
+
+TextureCache::~TextureCache() { }
+
+TextureCache *TextureCache::getInstance() {
+	static ref<TextureCache> instance = new TextureCache();
+	return instance;
+}
+
+uint32_t TextureCache::registerProvider(const TileProvider *provider) {
+	std::lock_guard<std::mutex> lock(d->providerMutex);
+	uint32_t id = d->nextID++;
+	d->providers[id] = provider;
+	return id;
+}
+
+void TextureCache::unregisterProvider(uint32_t id) {
+	{
+		std::lock_guard<std::mutex> lock(d->providerMutex);
+		d->providers.erase(id);
+	}
+
+	for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+		TextureCachePrivate::Shard &shard = d->shards[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		for (TextureCachePrivate::LRUList::iterator it = shard.lru.begin();
+				it != shard.lru.end(); ) {
+			if ((uint32_t) (it->key >> 32) == id) {
+				shard.memory -= it->tile->getSize();
+				shard.table.erase(it->key);
+				it = shard.lru.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
+const uint8_t *TextureCache::lookup(uint32_t id, uint32_t tileIndex) {
+	uint64_t key = ((uint64_t) id << 32) | tileIndex;
+	ThreadSlots &local = threadSlots;
+	ThreadSlots::Slot &slot = local.slots[slotIndex(key)];
+
+	/* The counters update a shard private to this thread and are summed
+	   up when the statistics are read, hence there is nothing to flush */
+	stats::threadLocalHits.incrementBase();
+	if (EXPECT_TAKEN(slot.key == key)) {
+		++stats::threadLocalHits;
+		return slot.tile->getData();
+	}
+
+	stats::tileMisses.incrementBase();
+
+	TextureCachePrivate::Shard &shard = d->shards[shardIndex(key)];
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		std::unordered_map<uint64_t, TextureCachePrivate::LRUList::iterator>::iterator
+			it = shard.table.find(key);
+		if (it != shard.table.end()) {
+			shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+			slot.key = key;
+			slot.tile = it->second->tile;
+			return slot.tile->getData();
+		}
+	}
+
+	const TileProvider *provider;
+	{
+		std::lock_guard<std::mutex> lock(d->providerMutex);
+		std::unordered_map<uint32_t, const TileProvider *>::iterator
+			it = d->providers.find(id);
+		if (it == d->providers.end())
+			Log(EError, "lookup(): unknown tile provider %u!", id);
+		provider = it->second;
+	}
+
+	/* Load the tile without holding the lock. Another thread may do the
+	   same in the meantime, in which case the first copy is kept */
+	ref<Tile> tile = new Tile(provider->getTileSize());
+	provider->loadTile(tileIndex, tile->getData());
+	++stats::tileMisses;
+	stats::tileBytesRead += tile->getSize();
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		std::unordered_map<uint64_t, TextureCachePrivate::LRUList::iterator>::iterator
+			it = shard.table.find(key);
+		if (it != shard.table.end()) {
+			tile = it->second->tile;
+		} else {
+			d->evict(shard, tile->getSize());
+			TextureCachePrivate::Entry entry;
+			entry.key = key;
+			entry.tile = tile;
+			shard.lru.push_front(entry);
+			shard.table[key] = shard.lru.begin();
+			shard.memory += tile->getSize();
+		}
+	}
+
+	slot.key = key;
+	slot.tile = tile;
+	return tile->getData();
+}
+
+void TextureCache::setBudget(size_t budget) {
+	d->budget.store(budget, std::memory_order_relaxed);
+	for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+		TextureCachePrivate::Shard &shard = d->shards[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		d->evict(shard, 0);
+	}
+}
+
+size_t TextureCache::getBudget() const {
+	return d->budget.load(std::memory_order_relaxed);
+}
+
+size_t TextureCache::getMemoryUsage() const {
+	size_t memory = 0;
+	for (int i=0; i<MTS_TEXCACHE_SHARDS; ++i) {
+		TextureCachePrivate::Shard &shard = d->shards[i];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		memory += shard.memory;
+	}
+	return memory;
+}
+
+std::string TextureCache::toString() const {
+	std::ostringstream oss;
+	oss << "TextureCache[" << endl
+		<< "  budget = " << memString(getBudget()) << "," << endl
+		<< "  memoryUsage = " << memString(getMemoryUsage()) << endl
+		<< "]";
+	return oss.str();
+}
+
+struct TileFile::TileFilePrivate {
+	fs::path filename;
+	uint64_t size;
+#if defined(__WINDOWS__)
+	HANDLE file;
+#else
+	int fd;
+#endif
+};
+
+TileFile::TileFile(const fs::pathstr &filename) : d(new TileFilePrivate()) {
+	d->filename = fs::decode_pathstr(filename);
+	if (!fs::exists(d->filename))
+		Log(EError, "The file \"%s\" does not exist!", d->filename.string().c_str());
+	d->size = (uint64_t) fs::file_size(d->filename);
+
+#if defined(__WINDOWS__)
+	d->file = CreateFileW(d->filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (d->file == INVALID_HANDLE_VALUE)
+		Log(EError, "Could not open \"%s\": %s", d->filename.string().c_str(),
+			lastErrorText().c_str());
+#else
+	d->fd = open(d->filename.string().c_str(), O_RDONLY);
+	if (d->fd == -1)
+		Log(EError, "Could not open \"%s\": %s", d->filename.string().c_str(),
+			strerror(errno));
+#endif
+}
+
+TileFile::~TileFile() {
+#if defined(__WINDOWS__)
+	CloseHandle(d->file);
+#else
+	close(d->fd);
+#endif
+}
+
+void TileFile::read(uint64_t offset, size_t size, void *target) const {
+	if (offset + size > d->size)
+		Log(EError, "read(): attempted to read past the end of \"%s\"!",
+			d->filename.string().c_str());
+
+	uint8_t *ptr = static_cast<uint8_t *>(target);
+	while (size > 0) {
+#if defined(__WINDOWS__)
+		OVERLAPPED overlapped;
+		memset(&overlapped, 0, sizeof(OVERLAPPED));
+		overlapped.Offset = (DWORD) offset;
+		overlapped.OffsetHigh = (DWORD) (offset >> 32);
+		DWORD request = (DWORD) std::min(size, (size_t) 0x40000000), count = 0;
+		if (!ReadFile(d->file, ptr, request, &count, &overlapped) || count == 0)
+			Log(EError, "read(): error while reading from \"%s\": %s",
+				d->filename.string().c_str(), lastErrorText().c_str());
+#else
+		ssize_t count = pread(d->fd, ptr, size, (off_t) offset);
+		if (count == -1 && errno == EINTR)
+			continue;
+		if (count <= 0)
+			Log(EError, "read(): error while reading from \"%s\": %s",
+				d->filename.string().c_str(), strerror(errno));
+#endif
+		ptr += count;
+		offset += (uint64_t) count;
+		size -= (size_t) count;
+	}
+}
+
+uint64_t TileFile::getSize() const {
+	return d->size;
+}
+
+fs::pathstr TileFile::getFilename() const {
+	return fs::encode_pathstr(d->filename);
+}
+
+MTS_IMPLEMENT_CLASS(TextureCache, false, Object)
+MTS_IMPLEMENT_CLASS(TileFile, false, Object)
+MTS_NAMESPACE_END
@@ -21,6 +21,8 @@
 #include <mitsuba/core/random.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/zstream.h>
+#include <mitsuba/core/mstream.h>
+#include <mitsuba/core/mmap.h>
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/lock.h>
 #include <mitsuba/core/properties.h>
@@ -35,6 +37,13 @@
 #define MTS_FILEFORMAT_HEADER     0x041C
 #define MTS_FILEFORMAT_VERSION_V3 0x0003
 #define MTS_FILEFORMAT_VERSION_V4 0x0004
+#define MTS_FILEFORMAT_VERSION_V5 0x0005
+
+/* Uncompressed meshes (version 5) start at page boundaries, and
+   their arrays are aligned to cache lines after a fixed-size header */
+#define MTS_FILEFORMAT_PAGE_SIZE   4096
+#define MTS_FILEFORMAT_ALIGNMENT   64
+#define MTS_FILEFORMAT_HEADER_SIZE 64
 
 MTS_NAMESPACE_BEGIN
 
@@ -97,6 +106,27 @@ enum ETriMeshFlags {
 	EDoublePrecision = 0x2000
 };
 
+/* Arrays of an uncompressed mesh, in the order of their offset table */
+enum EMeshArray {
+	EPositionArray = 0,
+	ENormalArray,
+	ETexcoordArray,
+	EColorArray,
+	ETriangleArray,
+	EMeshArrayCount
+};
+
+/// Free an array unless it references the contents of a memory-mapped file
+template <typename T> static void releaseArray(T *&ptr, const MemoryMappedFile *mapping) {
+	if (ptr) {
+		const uint8_t *p = reinterpret_cast<const uint8_t *>(ptr);
+		const uint8_t *data = mapping ? static_cast<const uint8_t *>(mapping->getData()) : NULL;
+		if (!data || p < data || p >= data + mapping->getSize())
+			delete[] ptr;
+	}
+	ptr = NULL;
+}
+
 TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
 	: Shape(stream, manager), m_tangents(NULL) {
 	m_name = stream->readString();
@@ -188,6 +218,11 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 		stream->skip(sizeof(short) * 2); // Skip the header
 	}
 
+	if (version == MTS_FILEFORMAT_VERSION_V5) {
+		loadUncompressed(stream, stream->getPos() - sizeof(short) * 2);
+		return;
+	}
+
 	stream = new ZStream(stream);
 	stream->setByteOrder(Stream::ELittleEndian);
 
@@ -200,17 +235,18 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 	bool fileDoublePrecision = flags & EDoublePrecision;
 	m_faceNormals = flags & EFaceNormals;
 
-	if (m_positions)
-		delete[] m_positions;
+	releaseArray(m_positions, m_mapping);
+	releaseArray(m_normals, m_mapping);
+	releaseArray(m_texcoords, m_mapping);
+	releaseArray(m_colors, m_mapping);
+	releaseArray(m_triangles, m_mapping);
+	m_mapping = NULL;
 
 	m_positions = new Point[m_vertexCount];
 	readHelper(stream, fileDoublePrecision,
 			reinterpret_cast<Float *>(m_positions),
 			m_vertexCount, sizeof(Point)/sizeof(Float));
 
-	if (m_normals)
-		delete[] m_normals;
-
 	if (flags & EHasNormals) {
 		m_normals = new Normal[m_vertexCount];
 		readHelper(stream, fileDoublePrecision,
@@ -220,9 +256,6 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 		m_normals = NULL;
 	}
 
-	if (m_texcoords)
-		delete[] m_texcoords;
-
 	if (flags & EHasTexcoords) {
 		m_texcoords = new Point2[m_vertexCount];
 		readHelper(stream, fileDoublePrecision,
@@ -232,9 +265,6 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 		m_texcoords = NULL;
 	}
 
-	if (m_colors)
-		delete[] m_colors;
-
 	if (flags & EHasColors) {
 		m_colors = new Color3[m_vertexCount];
 		readHelper(stream, fileDoublePrecision,
@@ -252,6 +282,135 @@ void TriMesh::loadCompressed(Stream *_stream, int index) {
 	m_flipNormals = false;
 }
 
+void TriMesh::loadUncompressed(Stream *stream, size_t blockStart,
+		MemoryMappedFile *mapping) {
+#if defined(SINGLE_PRECISION)
+	bool hostDoublePrecision = false;
+#else
+	bool hostDoublePrecision = true;
+#endif
+	uint32_t flags = stream->readUInt();
+	m_vertexCount = stream->readSize();
+	m_triangleCount = stream->readSize();
+	uint64_t offsets[EMeshArrayCount];
+	stream->readULongArray(offsets, EMeshArrayCount);
+	stream->seek(blockStart + MTS_FILEFORMAT_HEADER_SIZE);
+	m_name = stream->readString();
+
+	bool fileDoublePrecision = flags & EDoublePrecision;
+	m_faceNormals = flags & EFaceNormals;
+
+	/* Validate the array extents before touching any data. The comparisons
+	   are arranged so that corrupted counts and offsets cannot overflow */
+	const size_t fileSize = stream->getSize();
+	if (blockStart > fileSize || m_vertexCount > fileSize || m_triangleCount > fileSize)
+		Log(EError, "Encountered a corrupted uncompressed mesh \"%s\"!",
+			m_name.c_str());
+	const size_t floatSize = fileDoublePrecision ? sizeof(double) : sizeof(float);
+	const size_t arraySize[EMeshArrayCount] = {
+		m_vertexCount * 3 * floatSize, m_vertexCount * 3 * floatSize,
+		m_vertexCount * 2 * floatSize, m_vertexCount * 3 * floatSize,
+		m_triangleCount * 3 * sizeof(uint32_t)
+	};
+	const bool hasArray[EMeshArrayCount] = {
+		true, (flags & EHasNormals) != 0, (flags & EHasTexcoords) != 0,
+		(flags & EHasColors) != 0, true
+	};
+	for (int i=0; i<EMeshArrayCount; ++i) {
+		if (hasArray[i] && (offsets[i] < MTS_FILEFORMAT_HEADER_SIZE
+				|| offsets[i] % MTS_FILEFORMAT_ALIGNMENT != 0
+				|| offsets[i] > fileSize - blockStart
+				|| arraySize[i] > fileSize - blockStart - offsets[i]))
+			Log(EError, "Encountered a corrupted uncompressed mesh \"%s\"!",
+				m_name.c_str());
+	}
+
+	releaseArray(m_positions, m_mapping);
+	releaseArray(m_normals, m_mapping);
+	releaseArray(m_texcoords, m_mapping);
+	releaseArray(m_colors, m_mapping);
+	releaseArray(m_triangles, m_mapping);
+	m_mapping = NULL;
+
+	/* Reference the arrays in place if their layout matches the host */
+	uint8_t *data = mapping ? static_cast<uint8_t *>(mapping->getData()) + blockStart : NULL;
+	bool zeroCopy = data && !mapping->isReadOnly()
+		&& Stream::getHostByteOrder() == Stream::ELittleEndian
+		&& fileDoublePrecision == hostDoublePrecision
+		&& ((uintptr_t) data) % MTS_FILEFORMAT_ALIGNMENT == 0
+		&& sizeof(Point) == 3 * sizeof(Float) && sizeof(Normal) == 3 * sizeof(Float)
+		&& sizeof(Point2) == 2 * sizeof(Float) && sizeof(Color3) == 3 * sizeof(Float)
+		&& sizeof(Triangle) == 3 * sizeof(uint32_t);
+
+	if (zeroCopy) {
+		m_mapping = mapping;
+		m_positions = reinterpret_cast<Point *>(data + offsets[EPositionArray]);
+		m_normals = hasArray[ENormalArray] ?
+			reinterpret_cast<Normal *>(data + offsets[ENormalArray]) : NULL;
+		m_texcoords = hasArray[ETexcoordArray] ?
+			reinterpret_cast<Point2 *>(data + offsets[ETexcoordArray]) : NULL;
+		m_colors = hasArray[EColorArray] ?
+			reinterpret_cast<Color3 *>(data + offsets[EColorArray]) : NULL;
+		m_triangles = reinterpret_cast<Triangle *>(data + offsets[ETriangleArray]);
+	} else {
+		m_positions = new Point[m_vertexCount];
+		stream->seek(blockStart + offsets[EPositionArray]);
+		readHelper(stream, fileDoublePrecision,
+				reinterpret_cast<Float *>(m_positions),
+				m_vertexCount, sizeof(Point)/sizeof(Float));
+
+		if (hasArray[ENormalArray]) {
+			m_normals = new Normal[m_vertexCount];
+			stream->seek(blockStart + offsets[ENormalArray]);
+			readHelper(stream, fileDoublePrecision,
+					reinterpret_cast<Float *>(m_normals),
+					m_vertexCount, sizeof(Normal)/sizeof(Float));
+		}
+
+		if (hasArray[ETexcoordArray]) {
+			m_texcoords = new Point2[m_vertexCount];
+			stream->seek(blockStart + offsets[ETexcoordArray]);
+			readHelper(stream, fileDoublePrecision,
+					reinterpret_cast<Float *>(m_texcoords),
+					m_vertexCount, sizeof(Point2)/sizeof(Float));
+		}
+
+		if (hasArray[EColorArray]) {
+			m_colors = new Color3[m_vertexCount];
+			stream->seek(blockStart + offsets[EColorArray]);
+			readHelper(stream, fileDoublePrecision,
+					reinterpret_cast<Float *>(m_colors),
+					m_vertexCount, sizeof(Color3)/sizeof(Float));
+		}
+
+		m_triangles = new Triangle[m_triangleCount];
+		stream->seek(blockStart + offsets[ETriangleArray]);
+		stream->readUIntArray(reinterpret_cast<uint32_t *>(m_triangles),
+			m_triangleCount * sizeof(Triangle)/sizeof(uint32_t));
+	}
+
+	m_aabb.reset();
+	m_surfaceArea = m_invSurfaceArea = -1;
+	m_flipNormals = false;
+}
+
+void TriMesh::loadMapped(MemoryMappedFile *mapping, size_t offset) {
+	if (offset > mapping->getSize()
+			|| MTS_FILEFORMAT_HEADER_SIZE > mapping->getSize() - offset)
+		Log(EError, "Unable to load a mesh at offset " SIZE_T_FMT
+			" of the memory-mapped file \"%s\"!", offset,
+			fs::decode_pathstr(mapping->getFilename()).string().c_str());
+
+	/* Parse the header through a stream, which takes care of the byte order */
+	ref<MemoryStream> stream = new MemoryStream(mapping->getData(), mapping->getSize());
+	stream->setByteOrder(Stream::ELittleEndian);
+	stream->seek(offset);
+	if (readHeader(stream) != MTS_FILEFORMAT_VERSION_V5)
+		Log(EError, "The file \"%s\" does not contain uncompressed meshes!",
+			fs::decode_pathstr(mapping->getFilename()).string().c_str());
+	loadUncompressed(stream, offset, mapping);
+}
+
 short TriMesh::readHeader(Stream *stream) {
 	short format = stream->readShort();
 	if (format == 0x1C04) {
@@ -264,7 +423,8 @@ short TriMesh::readHeader(Stream *stream) {
 	}
 	short version = stream->readShort();
 	if (version != MTS_FILEFORMAT_VERSION_V3 &&
-	    version != MTS_FILEFORMAT_VERSION_V4) {
+	    version != MTS_FILEFORMAT_VERSION_V4 &&
+	    version != MTS_FILEFORMAT_VERSION_V5) {
 		Log(EError, "Encountered an incompatible file version!");
 	}
 	return version;
@@ -284,7 +444,7 @@ size_t TriMesh::readOffset(Stream *stream, short version, int idx) {
 	}
 
 	// Seek to the correct position
-	if (version == MTS_FILEFORMAT_VERSION_V4) {
+	if (version != MTS_FILEFORMAT_VERSION_V3) {
 		stream->seek(stream->getSize() - sizeof(uint64_t) * (count-idx) - sizeof(uint32_t));
 		return stream->readSize();
 	} else {
@@ -311,7 +471,7 @@ int TriMesh::readOffsetDictionary(Stream *stream, short version,
 
 	if (streamSize >= minSize) {
 		outOffsets.resize(count);
-		if (version == MTS_FILEFORMAT_VERSION_V4) {
+		if (version != MTS_FILEFORMAT_VERSION_V3) {
 			stream->seek(stream->getSize() - sizeof(uint64_t) * count - sizeof(uint32_t));
 			if (typeid(size_t) == typeid(uint64_t)) {
 				stream->readArray(&outOffsets[0], count);
@@ -338,18 +498,12 @@ int TriMesh::readOffsetDictionary(Stream *stream, short version,
 }
 
 TriMesh::~TriMesh() {
-	if (m_positions)
-		delete[] m_positions;
-	if (m_normals)
-		delete[] m_normals;
-	if (m_texcoords)
-		delete[] m_texcoords;
-	if (m_tangents)
-		delete[] m_tangents;
-	if (m_colors)
-		delete[] m_colors;
-	if (m_triangles)
-		delete[] m_triangles;
+	releaseArray(m_positions, m_mapping);
+	releaseArray(m_normals, m_mapping);
+	releaseArray(m_texcoords, m_mapping);
+	releaseArray(m_tangents, m_mapping);
+	releaseArray(m_colors, m_mapping);
+	releaseArray(m_triangles, m_mapping);
 }
 
 AABB TriMesh::getAABB() const {
@@ -471,10 +625,7 @@ void TriMesh::rebuildTopology(Float maxAngle) {
 	const Float dpThresh = std::cos(degToRad(maxAngle));
 	size_t degenerateTriangles = 0;
 
-	if (m_normals) {
-		delete[] m_normals;
-		m_normals = NULL;
-	}
+	releaseArray(m_normals, m_mapping);
 
 	if (m_tangents) {
 		delete[] m_tangents;
@@ -575,25 +726,28 @@ void TriMesh::rebuildTopology(Float maxAngle) {
 		for (int j=0; j<3; ++j)
 			Assert(newTriangles[i].idx[j] != 0xFFFFFFFFU);
 
-	delete[] m_triangles;
+	releaseArray(m_triangles, m_mapping);
 	m_triangles = newTriangles;
 
-	delete[] m_positions;
+	releaseArray(m_positions, m_mapping);
 	m_positions = new Point[newPositions.size()];
 	memcpy(m_positions, &newPositions[0], sizeof(Point) * newPositions.size());
 
 	if (m_texcoords) {
-		delete[] m_texcoords;
+		releaseArray(m_texcoords, m_mapping);
 		m_texcoords = new Point2[newTexcoords.size()];
 		memcpy(m_texcoords, &newTexcoords[0], sizeof(Point2) * newTexcoords.size());
 	}
 
 	if (m_colors) {
-		delete[] m_colors;
+		releaseArray(m_colors, m_mapping);
 		m_colors = new Color3[newColors.size()];
 		memcpy(m_colors, &newColors[0], sizeof(Color3) * newColors.size());
 	}
 
+	/* Nothing references the memory-mapped file anymore */
+	m_mapping = NULL;
+
 	m_vertexCount = newPositions.size();
 
 	if (degenerateTriangles > 0)
@@ -608,10 +762,7 @@ void TriMesh::rebuildTopology(Float maxAngle) {
 void TriMesh::computeNormals(bool force) {
 	int invalidNormals = 0;
 	if (m_faceNormals) {
-		if (m_normals) {
-			delete[] m_normals;
-			m_normals = NULL;
-		}
+		releaseArray(m_normals, m_mapping);
 
 		if (m_flipNormals) {
 			/* Change the winding order */
@@ -1174,6 +1325,89 @@ void TriMesh::serialize(Stream *_stream) const {
 		m_triangleCount * sizeof(Triangle)/sizeof(uint32_t));
 }
 
+size_t TriMesh::serializeUncompressed(Stream *stream) const {
+	if (stream->getByteOrder() != Stream::ELittleEndian)
+		Log(EError, "Tried to serialize a shape to a stream, "
+			"which was not previously set to little endian byte order!");
+
+#if defined(SINGLE_PRECISION)
+	uint32_t flags = ESinglePrecision;
+#else
+	uint32_t flags = EDoublePrecision;
+#endif
+
+	if (m_normals)
+		flags |= EHasNormals;
+	if (m_texcoords)
+		flags |= EHasTexcoords;
+	if (m_colors)
+		flags |= EHasColors;
+	if (m_faceNormals)
+		flags |= EFaceNormals;
+
+	/* Lay out the arrays after the header and name */
+	const size_t arraySize[EMeshArrayCount] = {
+		m_vertexCount * sizeof(Point),
+		m_normals ? m_vertexCount * sizeof(Normal) : 0,
+		m_texcoords ? m_vertexCount * sizeof(Point2) : 0,
+		m_colors ? m_vertexCount * sizeof(Color3) : 0,
+		m_triangleCount * sizeof(Triangle)
+	};
+	const void *arrays[EMeshArrayCount] = {
+		m_positions, m_normals, m_texcoords, m_colors, m_triangles
+	};
+	uint64_t offsets[EMeshArrayCount];
+	size_t pos = MTS_FILEFORMAT_HEADER_SIZE + m_name.length() + 1;
+	for (int i=0; i<EMeshArrayCount; ++i) {
+		if (!arrays[i]) {
+			offsets[i] = 0;
+			continue;
+		}
+		pos = (pos + MTS_FILEFORMAT_ALIGNMENT - 1) / MTS_FILEFORMAT_ALIGNMENT
+			* MTS_FILEFORMAT_ALIGNMENT;
+		offsets[i] = pos;
+		pos += arraySize[i];
+	}
+
+	/* Start the mesh on a fresh page */
+	const uint8_t zero[MTS_FILEFORMAT_PAGE_SIZE] = { 0 };
+	size_t blockStart = stream->getPos();
+	size_t padding = (MTS_FILEFORMAT_PAGE_SIZE - blockStart % MTS_FILEFORMAT_PAGE_SIZE)
+		% MTS_FILEFORMAT_PAGE_SIZE;
+	stream->write(zero, padding);
+	blockStart += padding;
+
+	stream->writeShort(MTS_FILEFORMAT_HEADER);
+	stream->writeShort(MTS_FILEFORMAT_VERSION_V5);
+	stream->writeUInt(flags);
+	stream->writeSize(m_vertexCount);
+	stream->writeSize(m_triangleCount);
+	stream->writeULongArray(offsets, EMeshArrayCount);
+	stream->write(zero, MTS_FILEFORMAT_HEADER_SIZE - (stream->getPos() - blockStart));
+	stream->writeString(m_name);
+
+	for (int i=0; i<EMeshArrayCount; ++i) {
+		if (!arrays[i])
+			continue;
+		stream->write(zero, blockStart + offsets[i] - stream->getPos());
+		if (i == ETriangleArray)
+			stream->writeUIntArray(reinterpret_cast<const uint32_t *>(arrays[i]),
+				arraySize[i] / sizeof(uint32_t));
+		else
+			stream->writeFloatArray(reinterpret_cast<const Float *>(arrays[i]),
+				arraySize[i] / sizeof(Float));
+	}
+
+	return blockStart;
+}
+
+int TriMesh::getSerializedMeshCount(Stream *stream) {
+	const short version = readHeader(stream);
+	std::vector<size_t> offsets;
+	int count = readOffsetDictionary(stream, version, offsets);
+	return count < 0 ? 1 : count;
+}
+
 size_t TriMesh::getPrimitiveCount() const {
 	return m_triangleCount;
 }
@@ -54,6 +54,11 @@ Vector VolumeDataSource::lookupVector(const Point &p) const {
 	return Vector();
 }
 
+void VolumeDataSource::getFloatRange(const AABB &aabb, Float &min, Float &max) const {
+	min = 0.0f;
+	max = getMaximumFloatValue();
+}
+
 bool VolumeDataSource::supportsFloatLookups() const {
 	return false;
 }
@@ -44,6 +44,9 @@ static StatsCounter earlyExits("Heterogeneous volume",
 		"Number of early exits", EPercentage);
 #endif
 
+static StatsCounter nullCollisions("Heterogeneous volume",
+		"Null collisions (Woodcock tracking)", EPercentage);
+
 /*!\plugin{heterogeneous}{Heterogeneous participating medium}
  * \order{2}
  * \parameters{
@@ -81,6 +84,13 @@ static StatsCounter earlyExits("Heterogeneous volume",
  *         Provided for convenience when accomodating data based on different units,
  *         or to simply tweak the density of the medium. \default{1}
  *     }
+ *     \parameter{majorantResolution}{\Integer}{
+ *         Woodcock tracking bounds the density using a coarse grid of local
+ *         maxima, which lets it skip empty space and take long steps through
+ *         thin regions of the medium. This parameter specifies the resolution
+ *         of this grid along the longest axis of the volume. A value of
+ *         \code{1} reverts to a single global bound. \default{16}
+ *     }
  *     \parameter{\Unnamed}{\Phase}{
  *          A nested phase function that describes the directional
  *          scattering properties of the medium. When none is specified,
@@ -184,6 +194,9 @@ public:
 		: Medium(props) {
 		m_stepSize = props.getFloat("stepSize", 0);
 		m_scale = props.getFloat("scale", 1);
+		m_majorantResolution = props.getInteger("majorantResolution", 16);
+		if (m_majorantResolution < 1)
+			Log(EError, "The 'majorantResolution' parameter must be positive!");
 		if (props.hasProperty("sigmaS") || props.hasProperty("sigmaA"))
 			Log(EError, "The 'sigmaS' and 'sigmaA' properties are only supported by "
 				"homogeneous media. Please use nested volume instances to supply "
@@ -210,6 +223,7 @@ public:
 		m_albedo = static_cast<VolumeDataSource *>(manager->getInstance(stream));
 		m_orientation = static_cast<VolumeDataSource *>(manager->getInstance(stream));
 		m_stepSize = stream->readFloat();
+		m_majorantResolution = stream->readInt();
 		configure();
 	}
 
@@ -222,6 +236,7 @@ public:
 		manager->serialize(stream, m_albedo.get());
 		manager->serialize(stream, m_orientation.get());
 		stream->writeFloat(m_stepSize);
+		stream->writeInt(m_majorantResolution);
 	}
 
 	void configure() {
@@ -234,12 +249,8 @@ public:
 		m_anisotropicMedium =
 			m_phaseFunction->needsDirectionallyVaryingCoefficients();
 
-		/* Assumes that the density medium does not
-		   contain values greater than one! */
-		m_maxDensity = m_scale * m_density->getMaximumFloatValue();
-		if (m_anisotropicMedium)
-			m_maxDensity *= m_phaseFunction->sigmaDirMax();
-		m_invMaxDensity = 1.0f/m_maxDensity;
+		if (m_method == EWoodcockTracking)
+			buildMajorantGrid();
 
 		if (m_stepSize == 0) {
 			m_stepSize = std::min(
@@ -563,23 +574,27 @@ public:
 			Float result = 0;
 
 			for (int i=0; i<nSamples; ++i) {
-				Float t = mint;
+				MajorantTracker tracker;
+				initTracking(ray, mint, maxt, tracker);
+				Float majorant;
 				while (true) {
-					t -= math::fastlog(1-sampler->next1D()) * m_invMaxDensity;
-					if (t >= maxt) {
+					if (!sampleCollision(tracker,
+							-math::fastlog(1-sampler->next1D()), majorant)) {
 						result += 1;
 						break;
 					}
 
-					Point p = ray(t);
+					Point p = ray(tracker.t);
 					Float density = lookupDensity(p, ray.d) * m_scale;
 
 					#if defined(HETVOL_STATISTICS)
 						++avgRayMarchingStepsTransmittance;
 					#endif
 
-					if (density * m_invMaxDensity > sampler->next1D())
+					nullCollisions.incrementBase();
+					if (density > majorant * sampler->next1D())
 						break;
+					++nullCollisions;
 				}
 			}
 			return Spectrum(result/nSamples);
@@ -629,18 +644,19 @@ public:
 			mint = std::max(mint, ray.mint);
 			maxt = std::min(maxt, ray.maxt);
 
-			Float t = mint, densityAtT = 0;
-			while (true) {
-				t -= math::fastlog(1-sampler->next1D()) * m_invMaxDensity;
-				if (t >= maxt)
-					break;
-
+			MajorantTracker tracker;
+			initTracking(ray, mint, maxt, tracker);
+			Float densityAtT = 0, majorant;
+			while (sampleCollision(tracker,
+					-math::fastlog(1-sampler->next1D()), majorant)) {
+				Float t = tracker.t;
 				Point p = ray(t);
 				densityAtT = lookupDensity(p, ray.d) * m_scale;
 				#if defined(HETVOL_STATISTICS)
 					++avgRayMarchingStepsSampling;
 				#endif
-				if (densityAtT * m_invMaxDensity > sampler->next1D()) {
+				nullCollisions.incrementBase();
+				if (densityAtT > majorant * sampler->next1D()) {
 					mRec.t = t;
 					mRec.p = p;
 					Spectrum albedo = m_albedo->lookupSpectrum(p);
@@ -655,6 +671,7 @@ public:
 					success = true;
 					break;
 				}
+				++nullCollisions;
 			}
 		}
 		mRec.medium = this;
@@ -701,13 +718,137 @@ public:
 			<< "  albedo = " << indent(m_albedo.toString()) << "," << endl
 			<< "  orientation = " << indent(m_orientation.toString()) << "," << endl
 			<< "  stepSize = " << m_stepSize << "," << endl
-			<< "  scale = " << m_scale << endl
+			<< "  scale = " << m_scale << "," << endl
+			<< "  majorantResolution = " << m_majorantResolution << endl
 			<< "]";
 		return oss.str();
 	}
 
 	MTS_DECLARE_CLASS()
 protected:
+	/// State of a 3D-DDA traversal of the majorant grid along a ray
+	struct MajorantTracker {
+		int cell[3], step[3], exit[3];
+		Float tNext[3], tDelta[3];
+		Float t, maxt;
+	};
+
+	/// Compute local bounds of the density for Woodcock tracking
+	void buildMajorantGrid() {
+		Float dirScale = m_anisotropicMedium ? m_phaseFunction->sigmaDirMax() : 1.0f;
+
+		if (!m_densityAABB.isValid()) {
+			m_majorantRes = Vector3i(1);
+			m_cellSize = Vector(0.0f);
+			m_majorants.assign(1, m_scale * m_density->getMaximumFloatValue() * dirScale);
+			return;
+		}
+
+		Vector extents = m_densityAABB.getExtents();
+		Float maxExtent = std::max(std::max(extents.x, extents.y), extents.z);
+		for (int i=0; i<3; ++i) {
+			m_majorantRes[i] = maxExtent > 0 ? std::max(1,
+				math::roundToInt(m_majorantResolution * extents[i] / maxExtent)) : 1;
+			m_cellSize[i] = extents[i] / m_majorantRes[i];
+		}
+		m_majorants.resize((size_t) m_majorantRes.x * m_majorantRes.y * m_majorantRes.z);
+
+		size_t idx = 0, emptyCells = 0;
+		Float maxMajorant = 0;
+		for (int z=0; z<m_majorantRes.z; ++z) {
+			for (int y=0; y<m_majorantRes.y; ++y) {
+				for (int x=0; x<m_majorantRes.x; ++x) {
+					Vector offset(x * m_cellSize.x, y * m_cellSize.y, z * m_cellSize.z);
+					AABB cell(m_densityAABB.min + offset, m_densityAABB.min + offset + m_cellSize);
+
+					/* Be robust with respect to roundoff errors during the traversal */
+					cell.min -= m_cellSize * 1e-3f;
+					cell.max += m_cellSize * 1e-3f;
+
+					Float minDensity, maxDensity;
+					m_density->getFloatRange(cell, minDensity, maxDensity);
+					Float majorant = std::max(maxDensity, (Float) 0) * m_scale * dirScale;
+
+					m_majorants[idx++] = majorant;
+					maxMajorant = std::max(maxMajorant, majorant);
+					if (majorant == 0)
+						++emptyCells;
+				}
+			}
+		}
+
+		Log(EDebug, "Majorant grid: %s cells, %.1f%% empty, max. density = %f",
+			m_majorantRes.toString().c_str(), 100.0f * emptyCells / m_majorants.size(),
+			maxMajorant);
+	}
+
+	/// Prepare a traversal of the majorant grid along <tt>[mint, maxt]</tt>
+	inline void initTracking(const Ray &ray, Float mint, Float maxt,
+			MajorantTracker &tracker) const {
+		const Point p = ray(mint);
+		tracker.t = mint;
+		tracker.maxt = maxt;
+
+		for (int i=0; i<3; ++i) {
+			Float offset = p[i] - m_densityAABB.min[i];
+			int cell = m_cellSize[i] > 0 ? math::floorToInt(offset / m_cellSize[i]) : 0;
+			cell = math::clamp(cell, 0, m_majorantRes[i] - 1);
+			tracker.cell[i] = cell;
+
+			if (ray.d[i] > 0) {
+				tracker.step[i] = 1;
+				tracker.exit[i] = m_majorantRes[i];
+				tracker.tNext[i] = mint + ((cell+1) * m_cellSize[i] - offset) / ray.d[i];
+				tracker.tDelta[i] = m_cellSize[i] / ray.d[i];
+			} else if (ray.d[i] < 0) {
+				tracker.step[i] = -1;
+				tracker.exit[i] = -1;
+				tracker.tNext[i] = mint + (cell * m_cellSize[i] - offset) / ray.d[i];
+				tracker.tDelta[i] = -m_cellSize[i] / ray.d[i];
+			} else {
+				tracker.step[i] = 0;
+				tracker.exit[i] = -1;
+				tracker.tNext[i] = std::numeric_limits<Float>::infinity();
+				tracker.tDelta[i] = std::numeric_limits<Float>::infinity();
+			}
+		}
+	}
+
+	/**
+	 * \brief Advance to the next tentative collision, whose distance
+	 * corresponds to the optical depth \c tau with respect to the
+	 * local majorants. Cells with a majorant of zero are skipped.
+	 *
+	 * \return \c false if the ray segment was left before that
+	 */
+	inline bool sampleCollision(MajorantTracker &tracker, Float tau,
+			Float &majorant) const {
+		while (true) {
+			const int axis = tracker.tNext[0] < tracker.tNext[1]
+				? (tracker.tNext[0] < tracker.tNext[2] ? 0 : 2)
+				: (tracker.tNext[1] < tracker.tNext[2] ? 1 : 2);
+			const Float tExit = std::min(tracker.tNext[axis], tracker.maxt);
+			const Float mu = m_majorants[((size_t) tracker.cell[2] * m_majorantRes.y
+				+ tracker.cell[1]) * m_majorantRes.x + tracker.cell[0]];
+			const Float depth = mu * (tExit - tracker.t);
+
+			if (depth > tau) {
+				tracker.t += tau / mu;
+				majorant = mu;
+				return true;
+			}
+
+			tau -= depth;
+			tracker.t = tExit;
+			if (tExit >= tracker.maxt)
+				return false;
+			tracker.cell[axis] += tracker.step[axis];
+			if (tracker.cell[axis] == tracker.exit[axis])
+				return false;
+			tracker.tNext[axis] += tracker.tDelta[axis];
+		}
+	}
+
 	inline Float lookupDensity(const Point &p, const Vector &d) const {
 		Float density = m_density->lookupFloat(p);
 		if (m_anisotropicMedium && density != 0) {
@@ -728,8 +869,10 @@ protected:
 	bool m_anisotropicMedium;
 	Float m_stepSize;
 	AABB m_densityAABB;
-	Float m_maxDensity;
-	Float m_invMaxDensity;
+	int m_majorantResolution;
+	Vector3i m_majorantRes;
+	Vector m_cellSize;
+	std::vector<Float> m_majorants;
 };
 
 MTS_IMPLEMENT_CLASS_S(HeterogeneousMedium, false, Medium)
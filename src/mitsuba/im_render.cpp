@@ -6,6 +6,7 @@
 #include <mitsuba/render/scene.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/thread.h>
+#include <mitsuba/core/workerpool.h>
 #include <mitsuba/core/fresolver.h>
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/timer.h>
@@ -32,12 +33,116 @@ void register_mitsuba_thread(mitsuba::Thread* parent, char const* name = "im-mts
 #include <random>
 #include <algorithm>
 #include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <deque>
 
 #define ATOMIC_SPLAT
 #define CORES_PER_FRAMEBUFFER 8
 
 namespace impl {
 
+	// background stage normalizing, encoding and writing intermediate images, so flushes only cost the workers a snapshot
+	struct ImageWriter : mitsuba::Thread {
+		struct Job {
+			mitsuba::ref<mitsuba::ImageBlock> snapshot;
+			double spp;
+			long long milliseconds;
+		};
+
+		std::function<void(Job const&)> write;
+		std::mutex mutex;
+		std::condition_variable queued, finished;
+		std::deque<Job> queue;
+		// snapshot buffers that were written and can be reused
+		std::vector<mitsuba::ref<mitsuba::ImageBlock>> spare;
+		size_t capacity;
+		size_t dropped = 0;
+		bool busy = false, quit = false;
+
+		ImageWriter(size_t capacity, std::function<void(Job const&)> const& write)
+			: mitsuba::Thread("im-writer")
+			, write(write)
+			, capacity(capacity) { }
+
+		// buffer for the next snapshot, reusing the ones already written
+		mitsuba::ref<mitsuba::ImageBlock> acquire(mitsuba::Vector2i size) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				while (!spare.empty()) {
+					mitsuba::ref<mitsuba::ImageBlock> block = spare.back();
+					spare.pop_back();
+					if (block->getSize() == size)
+						return block;
+				}
+			}
+			return new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, size);
+		}
+
+		// queue a snapshot; when full, either waits (progression series, every image counts) or supersedes the oldest pending one
+		void push(Job const& job, bool keepAll) {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (keepAll) {
+				while (queue.size() >= capacity)
+					finished.wait(lock);
+			}
+			else if (queue.size() >= capacity) {
+				spare.push_back(queue.front().snapshot);
+				queue.pop_front();
+				++dropped;
+			}
+			queue.push_back(job);
+			queued.notify_one();
+		}
+
+		// returns once all queued images have been written
+		void drain() {
+			std::unique_lock<std::mutex> lock(mutex);
+			while (!queue.empty() || busy)
+				finished.wait(lock);
+		}
+
+		void shutdown() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			queued.notify_all();
+			join();
+			if (dropped)
+				SLog(mitsuba::EInfo, "Background writer skipped " SIZE_T_FMT " superseded intermediate images", dropped);
+		}
+
+		void run() override {
+			while (true) {
+				Job job;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					while (queue.empty() && !quit)
+						queued.wait(lock);
+					// pending images are still written on shutdown
+					if (queue.empty())
+						return;
+					job = queue.front();
+					queue.pop_front();
+					busy = true;
+				}
+
+				try {
+					write(job);
+				} catch (std::exception const& e) {
+					SLog(mitsuba::EWarn, "Could not write intermediate image: %s", e.what());
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				spare.push_back(job.snapshot);
+				busy = false;
+				finished.notify_all();
+			}
+		}
+	};
+
 	struct InteractiveSceneProcess: ::InteractiveSceneProcess{
 		mitsuba::ref<mitsuba::Sampler> samplerPrototype;
 
@@ -45,14 +150,33 @@ namespace impl {
 		mitsuba::ref_vector<mitsuba::Sampler> samplers;
 		mitsuba::ref_vector<mitsuba::ImageBlock> framebuffers;
 		std::vector<float volatile*> frambufferData;
+		// worker owning the shared framebuffer each worker splats into
+		std::vector<int> targetOwners;
+		// shared framebuffers, indexed by their owning worker (empty for other workers)
+		mitsuba::ref_vector<mitsuba::ImageBlock> sharedTargets;
+		// bumped before each intermediate develop, workers merge their private tiles when they see a new value
+		std::atomic<int> tileFlushRequest{ 0 };
+
+		// NUMA node of each worker, and per-node scene replicas (empty unless replicating the kd-tree)
+		std::vector<int> threadNodes;
+		mitsuba::ref_vector<mitsuba::Scene> nodeScenes;
+		bool numaPlacement = false;
 
-		mitsuba::ref_vector<mitsuba::Thread> workers;
+		mitsuba::WorkerPool workers{ true };
+		mitsuba::ref<ImageWriter> writer;
 
 		double lastWriteSpp = 0.0f;
 
 		bool updateSamplersAndIntegrator() {
-			for (auto& s : samplers) {
-				s = this->samplerPrototype->clone();
+			if (numaPlacement) {
+				// clone on the workers, so sampler state is first touched on their nodes
+				workers.run(maxThreads, [this](int tid) {
+					samplers[tid] = this->samplerPrototype->clone();
+				});
+			} else {
+				for (auto& s : samplers) {
+					s = this->samplerPrototype->clone();
+				}
 			}
 
 			return integrator->allocate(*scene, (mitsuba::Sampler*const*) samplers.data(), (mitsuba::ImageBlock*const*) framebuffers.data(), maxThreads);
@@ -67,29 +191,74 @@ namespace impl {
 			if (config.maxThreads > 0 && config.maxThreads < maxThreads)
 				maxThreads = config.maxThreads;
 
+			this->threadNodes.assign(maxThreads, 0);
+			this->numaPlacement = config.numaPlacement || config.replicateKDTree;
+			if (numaPlacement)
+				placeWorkers();
+
 			this->samplerPrototype = sampler;
 			this->samplers.resize(maxThreads);
 
 			mitsuba::Vector2i filmSize = scene->getFilm()->getSize();
+			mitsuba::ReconstructionFilter* rfilter = scene->getFilm()->getReconstructionFilter();
 			{
 				this->framebuffers.resize(maxThreads);
+				this->targetOwners.resize(maxThreads);
+				this->sharedTargets.resize(maxThreads);
 #ifdef ATOMIC_SPLAT
+				// workers share framebuffers in groups, which never span NUMA nodes
 				this->uniqueTargets = 0;
-				for (int i = 0; i < maxThreads; ++i) {
-					if (i % CORES_PER_FRAMEBUFFER == 0) {
-						framebuffers[i] = new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, filmSize, scene->getFilm()->getReconstructionFilter());
+				for (int i = 0, owner = 0; i < maxThreads; ++i) {
+					if (i == 0 || i - owner == CORES_PER_FRAMEBUFFER || threadNodes[i] != threadNodes[i - 1]) {
+						owner = i;
 						++this->uniqueTargets;
 					}
+					targetOwners[i] = owner;
+				}
+				int splatTileSize = config.splatTileSize;
+				auto allocateTarget = [this, filmSize, rfilter](int tid) {
+					if (targetOwners[tid] == tid) {
+						sharedTargets[tid] = new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, filmSize, rfilter);
+						sharedTargets[tid]->clear();
+					}
+				};
+				// splat through thread-private tiles, merged into the shared target in batches
+				auto allocateTiles = [this, splatTileSize](int tid) {
+					mitsuba::ImageBlock* sharedTarget = sharedTargets[targetOwners[tid]];
+					if (splatTileSize > 0)
+						framebuffers[tid] = new mitsuba::ImageBlock(sharedTarget, splatTileSize);
 					else
-						framebuffers[i] = framebuffers[i - 1];
+						framebuffers[tid] = sharedTarget;
+				};
+				if (numaPlacement) {
+					// allocate and clear on the workers, so the pages are first touched on their nodes
+					workers.run(maxThreads, allocateTarget);
+					workers.run(maxThreads, allocateTiles);
+				} else {
+					for (int i = 0; i < maxThreads; ++i)
+						allocateTarget(i);
+					for (int i = 0; i < maxThreads; ++i)
+						allocateTiles(i);
 				}
 #else
-				for (int i = 0; i < maxThreads; ++i)
-					framebuffers[i] = new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, filmSize, scene->getFilm()->getReconstructionFilter());
+				auto allocateTarget = [this, filmSize, rfilter](int tid) {
+					sharedTargets[tid] = new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, filmSize, rfilter);
+					sharedTargets[tid]->clear();
+					framebuffers[tid] = sharedTargets[tid];
+					targetOwners[tid] = tid;
+				};
+				if (numaPlacement)
+					workers.run(maxThreads, allocateTarget);
+				else
+					for (int i = 0; i < maxThreads; ++i)
+						allocateTarget(i);
 				this->uniqueTargets = maxThreads;
 #endif
 			}
 
+			if (config.replicateKDTree)
+				replicateScene();
+
 			this->frambufferData.resize(maxThreads);
 			for (int i = 0; i < maxThreads; ++i) {
 				frambufferData[i] = framebuffers[i]->getBitmap()->getFloatData();
@@ -98,6 +267,66 @@ namespace impl {
 			this->imageData = this->frambufferData.data();
 
 			updateSamplersAndIntegrator();
+
+			if (config.writerQueueSize > 0) {
+				writer = new ImageWriter(config.writerQueueSize, [this](ImageWriter::Job const& job) {
+					write(job, true);
+				});
+				writer->start();
+			}
+		}
+		~InteractiveSceneProcess() {
+			if (writer)
+				writer->shutdown();
+		}
+
+		// pin the workers node by node, spreading them evenly over all NUMA nodes
+		void placeWorkers() {
+			int coreCount = mitsuba::getCoreCount(), nodeCount = mitsuba::getNUMANodeCount();
+			std::vector<std::vector<int>> nodeCores(nodeCount);
+			for (int core = 0; core < coreCount; ++core)
+				nodeCores[mitsuba::getCoreNUMANode(core)].push_back(core);
+
+			std::vector<int> nodeThreads(nodeCount, 0);
+			for (int i = 0, placed = 1; i < maxThreads && placed; ) {
+				placed = 0;
+				for (int node = 0; node < nodeCount && i < maxThreads; ++node) {
+					if (nodeThreads[node] < (int) nodeCores[node].size()) {
+						++nodeThreads[node];
+						++placed;
+						++i;
+					}
+				}
+			}
+
+			std::vector<int> cores;
+			threadNodes.clear();
+			for (int node = 0; node < nodeCount; ++node) {
+				for (int i = 0; i < nodeThreads[node]; ++i) {
+					cores.push_back(nodeCores[node][i]);
+					threadNodes.push_back(node);
+				}
+			}
+			workers.setCores(cores);
+			maxThreads = (int) threadNodes.size();
+			SLog(mitsuba::EInfo, "Placing %i workers on %i NUMA node(s)", maxThreads, nodeCount);
+		}
+
+		// give each NUMA node its own copy of the read-only kd-tree
+		void replicateScene() {
+			if (!scene->getKDTree()->isAcceleratorBuilt()) {
+				SLog(mitsuba::EWarn, "The kd-tree has not been built yet, not replicating it");
+				return;
+			}
+			int nodeCount = threadNodes.back() + 1;
+			if (nodeCount < 2)
+				return;
+			nodeScenes.resize(nodeCount);
+			workers.run(maxThreads, [this](int tid) {
+				if (tid == 0 || threadNodes[tid] != threadNodes[tid - 1])
+					nodeScenes[threadNodes[tid]] = scene->createReplica();
+			});
+			SLog(mitsuba::EInfo, "Replicated the kd-tree on %i NUMA nodes", nodeCount);
 		}
 
 		void render(mitsuba::Sensor* sensor, double volatile imageSamples[], Controls controls, int numThreads) override {
@@ -108,9 +337,12 @@ namespace impl {
 			this->lastWriteSpp = 0.0f;
 			
 #ifdef ATOMIC_SPLAT
-			for (int i = 0; i < numThreads; ++i)
-				if (i % CORES_PER_FRAMEBUFFER == 0)
-					framebuffers[i]->clear();
+			for (int i = 0; i < numThreads; ++i) {
+				if (targetOwners[i] == i)
+					sharedTargets[i]->clear();
+				if (framebuffers[i]->hasTiles())
+					framebuffers[i]->discardTiles();
+			}
 #endif
 
 			mitsuba::Statistics::getInstance()->resetAll();
@@ -121,6 +353,7 @@ namespace impl {
 				mitsuba::Vector2i resolution = this->resolution;
 				mitsuba::Sampler* sampler = this->samplers[tid];
 				mitsuba::ImageBlock* block = this->framebuffers[tid];
+				mitsuba::Scene* scene = nodeScenes.empty() ? this->scene.get() : this->nodeScenes[threadNodes[tid]].get();
 				double volatile& spp = imageSamples[tid];
 
 				if (initialRun) {
@@ -132,11 +365,13 @@ namespace impl {
 				struct Interrupt : mitsuba::ResponsiveIntegrator::Interrupt {
 					struct InterruptM {
 						InteractiveSceneProcess* proc;
+						mitsuba::ImageBlock* block;
 						float* imageData;
 						volatile float *volatile& imageDataTarget;
 						double volatile& sppTarget;
 						int maxSpp;
 						int timeout, flushTimer;
+						int tileFlushSeen;
 					} m;
 					mitsuba::ref<mitsuba::Timer> timer;
 					Interrupt(InterruptM const & m)
@@ -147,6 +382,13 @@ namespace impl {
 
 					int progress(mitsuba::ResponsiveIntegrator* integrator, const mitsuba::Scene &scene, const mitsuba::Sensor &sensor, mitsuba::Sampler &sampler, mitsuba::ImageBlock& target, double spp
 						, mitsuba::ResponsiveIntegrator::Controls controls, int threadIdx, int threadCount) override {
+						// evicted tiles are merged by the splatting view, the rest only when a develop asks for them
+						int flushRequest = m.proc->tileFlushRequest.load(std::memory_order_acquire);
+						if (flushRequest != m.tileFlushSeen) {
+							m.tileFlushSeen = flushRequest;
+							if (m.block->hasTiles())
+								m.block->flushTiles();
+						}
 						if (spp) {
 							m.imageDataTarget = m.imageData;
 							m.sppTarget = spp;
@@ -166,6 +408,10 @@ namespace impl {
 							// intermediate output
 							else if (threadIdx == 0 && timer->getSecondsSinceStart() >= m.flushTimer) {
 								timer->stop();
+								// other workers merge their tiles on their next progress report, i.e. in time for the next develop
+								m.tileFlushSeen = m.proc->tileFlushRequest.fetch_add(1, std::memory_order_release) + 1;
+								if (m.block->hasTiles())
+									m.block->flushTiles();
 								m.proc->develop(&m.sppTarget, threadCount, totalTime, true);
 								timer->start();
 							}
@@ -173,9 +419,10 @@ namespace impl {
 						return 0;
 					}
 				} interrupt = {
-					  { this, block->getBitmap()->getFloatData(), this->imageData[tid], spp, (int) sampler->getSampleCount()
+					  { this, block, block->getBitmap()->getFloatData(), this->imageData[tid], spp, (int) sampler->getSampleCount()
 						, timeout
 						, tid == 0 ? flushTimer : -1
+						, this->tileFlushRequest.load(std::memory_order_relaxed)
 					} };
 
 				struct mitsuba::ResponsiveIntegrator::Controls icontrols = {
@@ -184,42 +431,18 @@ namespace impl {
 					&interrupt
 				};
 
-				int rc = this->integrator->render(*this->scene, *sensor, *sampler, *block, icontrols, tid, numThreads);
+				int rc = this->integrator->render(*scene, *sensor, *sampler, *block, icontrols, tid, numThreads);
 				if (rc)
 					returnCode = rc;
+				if (block->hasTiles())
+					block->flushTiles();
 
 				// end of parallel execution
 			};
 
-			// build on mitsuba infrastructure instead of OpenMP b/c for classic mitsuba thread-local support etc.
-			if (numThreads > (int) workers.size())
-				workers.resize(numThreads);
-			for (int i = 0; i < numThreads; ++i) {
-				typedef decltype(parallel_execution) par_exe;
-				struct Thread : mitsuba::Thread {
-					int tid;
-					par_exe* parallel_execution;
-					Thread(int tid, par_exe* parallel_execution)
-						: mitsuba::Thread("interactive")
-						, tid(tid)
-						, parallel_execution(parallel_execution) { setCoreAffinity(tid); }
-					void run() override {
-						(*parallel_execution)(tid);
-					}
-				};
-				if (auto* w = workers[i].get())
-					((Thread*) w)->parallel_execution = &parallel_execution;
-				else
-					workers[i] = new Thread(i, &parallel_execution);
-			}
-
-
-			for (int i = 0; i < numThreads; ++i) {
-				workers[i]->start();
-			}
-			for (int i = numThreads; i-- > 0; ) {
-				workers[i]->join();
-			}
+			this->integrator->prepareFrame(numThreads);
+			workers.run(numThreads, parallel_execution);
+			this->restartLatency = workers.getRestartLatency();
 		}
 
 		void develop(const volatile double* spps, int numThreads, long long milliseconds = 0, bool flush = false) {
@@ -233,18 +456,35 @@ namespace impl {
 //			if (intermediate && !(spp > 512.0f && spp > lastWriteSpp * 1.5f))
 //				return;
 
-			mitsuba::ref<mitsuba::ImageBlock> developBuffer = new mitsuba::ImageBlock(
-				  mitsuba::Bitmap::ESpectrumAlpha, scene->getFilm()->getCropSize());
+			// snapshot of the accumulated framebuffers, all further processing works on the copy
+			mitsuba::Vector2i cropSize = scene->getFilm()->getCropSize();
+			mitsuba::ref<mitsuba::ImageBlock> developBuffer = writer ? writer->acquire(cropSize)
+				: mitsuba::ref<mitsuba::ImageBlock>(new mitsuba::ImageBlock(mitsuba::Bitmap::ESpectrumAlpha, cropSize));
 			developBuffer->clear();
 			for (int i = 0; i < numThreads; ++i)
-				if (i % CORES_PER_FRAMEBUFFER == 0)
-					developBuffer->put(framebuffers[i]);
-			float* data = developBuffer->getBitmap()->getFloatData();
-			for (size_t i = 0, ie = developBuffer->getBitmap()->getPixelCount() * developBuffer->getBitmap()->getChannelCount(); i < ie; ++i) {
+				if (targetOwners[i] == i)
+					developBuffer->put(sharedTargets[i]);
+
+			ImageWriter::Job job = { developBuffer, spp, milliseconds };
+			if (flush && writer) {
+				writer->push(job, writeProgression != 0);
+				return;
+			}
+			// the film is shared with the writer
+			if (writer)
+				writer->drain();
+			write(job, flush);
+		}
+
+		void write(ImageWriter::Job job, bool flush) {
+			double spp = job.spp;
+			long long milliseconds = job.milliseconds;
+			float* data = job.snapshot->getBitmap()->getFloatData();
+			for (size_t i = 0, ie = job.snapshot->getBitmap()->getPixelCount() * job.snapshot->getBitmap()->getChannelCount(); i < ie; ++i) {
 				*data = float(*data / spp);
 				++data;
 			}
-			scene->getFilm()->setBitmap(developBuffer->getBitmap());
+			scene->getFilm()->setBitmap(job.snapshot->getBitmap());
 
 			if (flush) {
 				fs::pathstr destFile;
@@ -295,3 +535,7 @@ InteractiveSceneProcess* InteractiveSceneProcess::create(mitsuba::Scene* scene,
 	return create(scene, sampler, rintegrator, config);
 }
 InteractiveSceneProcess::~InteractiveSceneProcess() = default;
+
+std::string InteractiveSceneProcess::getStatistics(bool csv) const {
+	return mitsuba::Statistics::getInstance()->getSnapshot(csv ? mitsuba::Statistics::ECSV : mitsuba::Statistics::EJSON);
+}
@@ -3,6 +3,14 @@
 struct ProcessConfig {
 	int concurrentAtomic = 32;
 	int maxThreads = -1;
+	// edge length of thread-private splatting tiles, 0 splats directly into shared framebuffers
+	int splatTileSize = 0;
+	// intermediate images pending in the background writer, 0 writes them synchronously on the flushing worker
+	int writerQueueSize = 2;
+	// pin workers node by node and allocate their framebuffers and samplers on the local NUMA node
+	bool numaPlacement = false;
+	// additionally trace rays against a per-node copy of the kd-tree (implies numaPlacement)
+	bool replicateKDTree = false;
 
 	static int recommendedThreads();
 	static ProcessConfig resolveDefaults(ProcessConfig const& cfg);
@@ -17,6 +25,8 @@ struct InteractiveSceneProcess {
 
 	float volatile *volatile *imageData;
 	int numActiveThreads;
+	// milliseconds from waking the parked workers to the first worker rendering the last frame
+	float restartLatency = 0.0f;
 
 	int timeout = -1;
 	int flushTimer = -1;
@@ -32,4 +42,7 @@ struct InteractiveSceneProcess {
 	};
 	virtual void render(mitsuba::Sensor* sensor, double volatile imageSamples[], Controls controls, int maxThreads = -1) = 0;
 	virtual void render(int maxThreads = -1) = 0;
+
+	// machine-readable snapshot of all statistics counters (JSON, or CSV), cheap enough to poll every frame
+	std::string getStatistics(bool csv = false) const;
 };
@@ -32,6 +32,7 @@
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/sceneloader.h>
+#include <mitsuba/render/texcache.h>
 #include <fstream>
 #include <memory>
 #include <stdexcept>
@@ -78,8 +79,21 @@ void help() {
 	cout <<  "   -r sec      Write (partial) output images every 'sec' seconds" << endl << endl;
 	cout <<  "   -C          Force classic mitsuba render job scheduling / code paths" << endl << endl;
 	cout <<  "   -S          Write progressive sequence of images to separate files" << endl << endl;
+	cout <<  "   -W count    Number of intermediate images (see -r) that may be queued for" << endl;
+	cout <<  "               writing in the background (default: 2, 0 writes them on a render" << endl;
+	cout <<  "               thread). Only applies to responsive integrators." << endl << endl;
+	cout <<  "   -N          Pin render threads node by node and allocate their framebuffers" << endl;
+	cout <<  "               and samplers in local memory on NUMA machines. Only applies to" << endl;
+	cout <<  "               responsive integrators." << endl << endl;
+	cout <<  "   -K          Like -N, and additionally trace rays using a copy of the" << endl;
+	cout <<  "               kd-tree in the local memory of each NUMA node" << endl << endl;
 	cout <<  "   -b res      Specify the block resolution used to split images into parallel" << endl;
 	cout <<  "               workloads (default: 32). Only applies to some integrators." << endl << endl;
+	cout <<  "   -T res      Accumulate samples in thread-private tiles of the given size" << endl;
+	cout <<  "               that are merged into shared framebuffers in batches (default: 0," << endl;
+	cout <<  "               i.e. direct atomic splatting). Only applies to responsive integrators." << endl << endl;
+	cout <<  "   -m MiB      Memory budget of the cache used by out-of-core textures" << endl;
+	cout <<  "               (default: " << MTS_TEXCACHE_DEFAULT_BUDGET << ")" << endl << endl;
 	cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
 	cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
 	cout <<  "   -w          Treat warnings as errors" << endl << endl;
@@ -146,6 +160,7 @@ int mitsuba_app(int argc, char*const* argv) {
 		int flushTimer = -1;
 		bool classicRendering = false;
 		bool saveProgression = false;
+		ProcessConfig processConfig;
 
 		if (argc < 2) {
 			help();
@@ -154,7 +169,7 @@ int mitsuba_app(int argc, char*const* argv) {
 
 		optind = 1;
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:qhzvtwxCS")) != -1) {
+		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:T:W:m:qhzvtwxCSNK")) != -1) {
 			switch (optchar) {
 				case 'a': {
 						std::vector<std::string> paths = tokenize(optarg, ";");
@@ -194,6 +209,12 @@ int mitsuba_app(int argc, char*const* argv) {
 					saveProgression = true;
 					break;
 				}
+				case 'N':
+					processConfig.numaPlacement = true;
+					break;
+				case 'K':
+					processConfig.replicateKDTree = true;
+					break;
 				case 'n':
 					nodeName = optarg;
 					break;
@@ -247,6 +268,29 @@ int mitsuba_app(int argc, char*const* argv) {
 					if (blockSize < 2 || blockSize > 128)
 						SLog(EError, "Invalid block size (should be in the range 2-128)");
 					break;
+				case 'T':
+					processConfig.splatTileSize = strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0')
+						SLog(EError, "Could not parse the splatting tile size!");
+					if (processConfig.splatTileSize < 0 || processConfig.splatTileSize > 128)
+						SLog(EError, "Invalid splatting tile size (should be in the range 0-128)");
+					break;
+				case 'W':
+					processConfig.writerQueueSize = strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0')
+						SLog(EError, "Could not parse the writer queue size!");
+					if (processConfig.writerQueueSize < 0)
+						SLog(EError, "Invalid writer queue size (should be non-negative)");
+					break;
+				case 'm': {
+						long budget = strtol(optarg, &end_ptr, 10);
+						if (*end_ptr != '\0')
+							SLog(EError, "Could not parse the texture cache budget!");
+						if (budget <= 0)
+							SLog(EError, "Invalid texture cache budget (should be positive)");
+						TextureCache::getInstance()->setBudget((size_t) budget * 1024 * 1024);
+					}
+					break;
 				case 'z':
 					progressBars = false;
 					break;
@@ -386,7 +430,7 @@ int mitsuba_app(int argc, char*const* argv) {
 
 			std::unique_ptr<InteractiveSceneProcess> ithr(
 				classicRendering ? nullptr :
-				InteractiveSceneProcess::create(scene, scene->getSampler(), scene->getIntegrator(), ProcessConfig())
+				InteractiveSceneProcess::create(scene, scene->getSampler(), scene->getIntegrator(), processConfig)
 			);
 			if (ithr) {
 				SLog(EInfo, "Using responsive integrator interface");
@@ -1302,7 +1302,10 @@ void GLWidget::paintGL() {
 			m_renderer->setBlendMode(Renderer::EBlendAdditive);
 
 			if (m_context->showKDTree) {
-				oglRenderKDTree(m_context->scene->getKDTree());
+				/* Only kd-trees can be visualized, there are no nodes to draw when using a BVH */
+				const ShapeKDTree *kdtree = m_context->scene->getKDTree();
+				if (kdtree->getAccelerator() != ShapeKDTree::EBVH)
+					oglRenderKDTree(kdtree);
 				const ref_vector<Shape> &shapes = m_context->scene->getShapes();
 				for (size_t j=0; j<shapes.size(); ++j)
 					if (shapes[j]->getKDTree())
@@ -1320,6 +1323,9 @@ void GLWidget::paintGL() {
 }
 
 void GLWidget::oglRenderKDTree(const KDTreeBase<AABB> *kdtree) {
+	if (!kdtree->isBuilt())
+		return;
+
 	std::stack<std::tuple<const KDTreeBase<AABB>::KDNode *, AABB, uint32_t> > stack;
 
 	stack.push(std::make_tuple(kdtree->getRoot(), kdtree->getTightAABB(), 0));
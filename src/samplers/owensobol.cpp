@@ -0,0 +1,266 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/sampler.h>
+#include "sobolseq.h"
+
+MTS_NAMESPACE_BEGIN
+
+/*!\plugin{owensobol}{Owen-scrambled Sobol sampler}
+ * \order{7}
+ * \parameters{
+ *     \parameter{sampleCount}{\Integer}{
+ *       Number of samples per pixel; should be a power of two
+ *       (e.g. 1, 2, 4, 8, 16, etc.), or it will be rounded up to the next one
+ *       \default{4}
+ *     }
+ *     \parameter{seed}{\Integer}{
+ *       Seed of the scrambling. Set this to the frame index when rendering
+ *       an animation to obtain decorrelated noise patterns. \default{0}
+ *     }
+ * }
+ *
+ * This plugin implements a Quasi-Monte Carlo (QMC) sample generator based on
+ * the first two dimensions of the Sobol sequence, which are randomized by
+ * hash-based Owen scrambling (following ``Practical Hash-based Owen
+ * Scrambling'' by Brent Burley). Every dimension requested by the integrator
+ * (i.e. every call to \c next1D() or \c next2D()) uses an independent
+ * scramble and an independently shuffled sample order, which are derived
+ * from the pixel position and the dimension index. Like with the
+ * \pluginref{ldsampler}, the samples of each pixel are thus well-stratified
+ * in every 1D and 2D projection and decorrelated across dimensions.
+ *
+ * In contrast to the \pluginref{ldsampler}, which pre-generates a table of
+ * all samples of a pixel and all dimensions every time a pixel is visited,
+ * this sampler computes every value on demand in constant time. It keeps no
+ * per-pixel state, so that the memory usage per thread does not depend on
+ * the sample count or path depth, and visiting the pixels of the image one
+ * sample at a time (as the progressive renderers of the interactive
+ * interface do) is as cheap as with the \pluginref{independent} sampler.
+ * There is also no upper bound on the number of dimensions.
+ *
+ * The scrambling is completely deterministic, hence subsequent runs of
+ * Mitsuba will always compute the same image regardless of the number
+ * of threads or machines.
+ */
+class OwenSobolSampler : public Sampler {
+public:
+	OwenSobolSampler() : Sampler(Properties()) { }
+
+	OwenSobolSampler(const Properties &props) : Sampler(props) {
+		/* Sample count (will be rounded up to the next power of two) */
+		m_sampleCount = props.getSize("sampleCount", 4);
+
+		if (!math::isPowerOfTwo(m_sampleCount)) {
+			m_sampleCount = math::roundToPowerOfTwo(m_sampleCount);
+			Log(EWarn, "Sample count should be a power of two -- rounding to "
+					SIZE_T_FMT, m_sampleCount);
+		}
+
+		/* Seed of the scrambling, e.g. the frame index of an animation */
+		m_seed = mixBits((uint64_t) props.getSize("seed", 0));
+		m_pixelSeed = m_seed;
+		m_dimension = 0;
+	}
+
+	OwenSobolSampler(Stream *stream, InstanceManager *manager)
+	 : Sampler(stream, manager) {
+		m_seed = stream->readULong();
+		m_pixelSeed = m_seed;
+		m_dimension = 0;
+	}
+
+	void serialize(Stream *stream, InstanceManager *manager) const {
+		Sampler::serialize(stream, manager);
+		stream->writeULong(m_seed);
+	}
+
+	ref<Sampler> clone() {
+		ref<OwenSobolSampler> sampler = new OwenSobolSampler();
+		sampler->m_sampleCount = m_sampleCount;
+		sampler->m_sampleIndex = m_sampleIndex;
+		sampler->m_seed = m_seed;
+		sampler->m_pixelSeed = m_pixelSeed;
+		sampler->m_dimension = m_dimension;
+		for (size_t i=0; i<m_req1D.size(); ++i)
+			sampler->request1DArray(m_req1D[i]);
+		for (size_t i=0; i<m_req2D.size(); ++i)
+			sampler->request2DArray(m_req2D[i]);
+		return sampler.get();
+	}
+
+	void generate(const Point2i &pos, size_t nextSampleIdx) {
+		m_pixelSeed = mixBits(m_seed ^ (((uint64_t) (uint32_t) pos.x << 32)
+			| (uint64_t) (uint32_t) pos.y));
+		setSampleIndex(nextSampleIdx != (size_t) ~0 ? nextSampleIdx : m_sampleIndex);
+	}
+
+	void advance() {
+		setSampleIndex(m_sampleIndex + 1);
+	}
+
+	void setSampleIndex(size_t sampleIndex) {
+		m_sampleIndex = sampleIndex;
+		m_dimension = 0;
+		m_dimension1DArray = m_dimension2DArray = 0;
+
+		if (m_sampleIndex >= m_sampleCount)
+			return;
+
+		/* Only the part of the sample arrays belonging to the current
+		   sample is computed. The arrays of all samples of a pixel use
+		   consecutive indices, hence they are stratified as a whole. */
+		for (size_t i=0; i<m_req1D.size(); i++) {
+			const size_t size = m_req1D[i];
+			const uint64_t hash = dimensionHash(EArrayDimension + i);
+			Float *values = m_sampleArrays1D[i] + m_sampleIndex * size;
+			for (size_t j=0; j<size; ++j)
+				values[j] = sample1D(m_sampleIndex * size + j, hash);
+		}
+
+		for (size_t i=0; i<m_req2D.size(); i++) {
+			const size_t size = m_req2D[i];
+			const uint64_t hash = dimensionHash(EArrayDimension + m_req1D.size() + i);
+			Point2 *values = m_sampleArrays2D[i] + m_sampleIndex * size;
+			for (size_t j=0; j<size; ++j)
+				values[j] = sample2D(m_sampleIndex * size + j, hash);
+		}
+	}
+
+	Float next1D() {
+		return sample1D(m_sampleIndex, dimensionHash(m_dimension++));
+	}
+
+	Point2 next2D() {
+		return sample2D(m_sampleIndex, dimensionHash(m_dimension++));
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "OwenSobolSampler[" << endl
+			<< "  sampleCount = " << m_sampleCount << "," << endl
+			<< "  sampleIndex = " << m_sampleIndex << "," << endl
+			<< "  seed = " << m_seed << endl
+			<< "]";
+		return oss.str();
+	}
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Dimension indices starting from here are reserved for sample arrays
+	enum {
+		EArrayDimension = 0x40000000
+	};
+
+	/// 64-bit finalizer of MurmurHash3, used to derive scrambling seeds
+	static inline uint64_t mixBits(uint64_t v) {
+		v ^= v >> 33;
+		v *= 0xff51afd7ed558ccdULL;
+		v ^= v >> 33;
+		v *= 0xc4ceb9fe1a85ec53ULL;
+		v ^= v >> 33;
+		return v;
+	}
+
+	/// Reverse the order of the bits in a 32-bit integer
+	static inline uint32_t reverseBits(uint32_t n) {
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 2))) || defined(__clang__)
+		n = __builtin_bswap32(n);
+#else
+		n = (n << 16) | (n >> 16);
+		n = ((n & 0x00ff00ff) << 8) | ((n & 0xff00ff00) >> 8);
+#endif
+		n = ((n & 0x0f0f0f0f) << 4) | ((n & 0xf0f0f0f0) >> 4);
+		n = ((n & 0x33333333) << 2) | ((n & 0xcccccccc) >> 2);
+		n = ((n & 0x55555555) << 1) | ((n & 0xaaaaaaaa) >> 1);
+		return n;
+	}
+
+	/**
+	 * \brief Nested uniform (Owen) scrambling of a 32-bit fixed point value
+	 *
+	 * Uses the hash-based construction by Laine and Karras in the variant
+	 * given by Burley. Every bit is only flipped depending on the more
+	 * significant bits and the seed. Applied to a sample index, this
+	 * randomly shuffles the order of the points while mapping every aligned
+	 * block of 2^k indices onto another one.
+	 */
+	static inline uint32_t owenScramble(uint32_t v, uint32_t seed) {
+		v = reverseBits(v);
+		v ^= v * 0x3d20adea;
+		v += seed;
+		v *= (seed >> 16) | 1;
+		v ^= v * 0x05526c56;
+		v ^= v * 0x53a22864;
+		return reverseBits(v);
+	}
+
+	/**
+	 * \brief Evaluate one of the first dimensions of the Sobol sequence as
+	 * a fixed point value
+	 *
+	 * The shuffled indices generally have all 32 bits populated, hence
+	 * the generator matrix is applied without data-dependent branches.
+	 * The first dimension is the Van der Corput sequence.
+	 */
+	static inline uint32_t sobolBits(uint32_t index, uint32_t dimension) {
+		if (dimension == 0)
+			return reverseBits(index);
+
+		const uint32_t *matrix = sobol::Matrices::matrices32
+			+ dimension * sobol::Matrices::size;
+		uint32_t result = 0;
+		for (int i=0; i<32; ++i, index >>= 1)
+			result ^= matrix[i] & (0U - (index & 1));
+		return result;
+	}
+
+	/// Convert a 32-bit fixed point value into a floating point value on [0, 1)
+	static inline Float toFloat(uint32_t value) {
+		return std::min((Float) value * (Float) (1.0 / 4294967296.0), (Float) ONE_MINUS_EPS);
+	}
+
+	/// Derive the scrambling seeds of a dimension in the current pixel
+	inline uint64_t dimensionHash(uint64_t dimension) const {
+		return mixBits(m_pixelSeed ^ mixBits(dimension + 1));
+	}
+
+	/// Compute a sample of a 1D dimension of the current pixel
+	inline Float sample1D(uint64_t index, uint64_t hash) const {
+		uint32_t shuffled = owenScramble((uint32_t) index, (uint32_t) hash);
+		return toFloat(owenScramble(sobolBits(shuffled, 0), (uint32_t) (hash >> 32)));
+	}
+
+	/// Compute a sample of a 2D dimension of the current pixel
+	inline Point2 sample2D(uint64_t index, uint64_t hash) const {
+		uint32_t shuffled = owenScramble((uint32_t) index, (uint32_t) hash);
+		uint64_t hash2 = mixBits(hash);
+		return Point2(
+			toFloat(owenScramble(sobolBits(shuffled, 0), (uint32_t) (hash >> 32))),
+			toFloat(owenScramble(sobolBits(shuffled, 1), (uint32_t) hash2)));
+	}
+
+private:
+	uint64_t m_seed;
+	uint64_t m_pixelSeed;
+	uint64_t m_dimension;
+};
+
+MTS_IMPLEMENT_CLASS_S(OwenSobolSampler, false, Sampler)
+MTS_EXPORT_PLUGIN(OwenSobolSampler, "Owen-scrambled Sobol sampler");
+MTS_NAMESPACE_END
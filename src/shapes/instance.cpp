@@ -75,6 +75,13 @@ void Instance::configure() {
 		Log(EError, "A reference to a 'shapegroup' must be specified!");
 }
 
+bool Instance::setWorldTransform(const AnimatedTransform *trafo) {
+	if (!trafo)
+		return false;
+	m_transform = trafo;
+	return true;
+}
+
 AABB Instance::getAABB() const {
 	const ShapeKDTree *kdtree = m_shapeGroup->getKDTree();
 	const AABB &aabb = kdtree->getAABB();
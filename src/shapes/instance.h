@@ -40,7 +40,10 @@ public:
 	void configure();
 
 	/// Return the object-to-world transformation used by this instance
-	inline const AnimatedTransform *getWorldTransform() const { return m_transform.get(); }
+	const AnimatedTransform *getWorldTransform() const { return m_transform.get(); }
+
+	/// Move the instance, the kd-tree of the shape group is left untouched
+	bool setWorldTransform(const AnimatedTransform *trafo);
 
 	/// Add a child ConfigurableObject
 	void addChild(const std::string &name, ConfigurableObject *child);
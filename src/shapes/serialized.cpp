@@ -19,6 +19,7 @@
 #include <mitsuba/render/trimesh.h>
 #include <mitsuba/core/properties.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mmap.h>
 #include <mitsuba/core/fresolver.h>
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/lrucache.h>
@@ -28,6 +29,9 @@
 /// How many files to keep open in the cache, per thread
 #define MTS_SERIALIZED_CACHE_SIZE 4
 
+/// Version identifier of the uncompressed, memory-mappable format
+#define MTS_SERIALIZED_VERSION_UNCOMPRESSED 0x0005
+
 MTS_NAMESPACE_BEGIN
 
 /* Avoid having to include scenehandler.h */
@@ -142,6 +146,37 @@ extern MTS_EXPORT_RENDER void pushSceneCleanupHandler(void (*cleanup)());
  * \bottomrule
  * \end{longtable}
  * \end{center}
+ *
+ * \paragraph{Uncompressed variant:}
+ * The \code{mtsutil serialized2mmap} utility converts a \code{.serialized}
+ * file into an uncompressed variant (version identifier \code{0x0005}) that
+ * is memory-mapped when loaded. When its precision matches the renderer,
+ * meshes then reference the file contents directly instead of decompressing
+ * them, and render processes on the same machine share the pages through
+ * the operating system's file cache. Each mesh starts at a multiple of 4096
+ * bytes with the following 64-byte header:
+ * \begin{center}
+ * \begin{longtable}{>{\bfseries}p{2cm}p{11cm}}
+ * \toprule
+ * Type & Content\\
+ * \midrule
+ * \code{uint16}&   File format identifier: \ \  \code{0x041C}\\
+ * \code{uint16}&   File version identifier: \ \  \code{0x0005}\\
+ * \code{uint32}&   Flags (as above)\\
+ * \code{uint64}&   Number of vertices in the mesh\\
+ * \code{uint64}&   Number of triangles in the mesh\\
+ * \code{uint64}$\times 5$& Offsets of the position, normal, texture coordinate,
+ * vertex color and triangle arrays relative to the start of the mesh.
+ * Missing arrays have an offset of zero.\\
+ * \code{padding}& Zeros up to a size of 64 bytes\\
+ * \bottomrule
+ * \end{longtable}
+ * \end{center}
+ * The header is followed by the null-terminated name of the shape. Every array
+ * starts at a multiple of 64 bytes and uses the same encoding as above. The file
+ * concludes with the end-of-file dictionary. Modifications applied while
+ * loading (e.g. a \code{toWorld} transformation) are never written back to
+ * the file; they only duplicate the affected pages in memory.
  */
 class SerializedMesh : public TriMesh {
 public:
@@ -235,6 +270,28 @@ private:
 				// Assume there is a single mesh in the file at offset 0
 				m_offsets.resize(1, 0);
 			}
+
+			/* Uncompressed files are mapped into memory and referenced
+			   in place. The mapping is copy-on-write, hence transforming
+			   the vertices only duplicates the affected pages */
+			if (version == MTS_SERIALIZED_VERSION_UNCOMPRESSED &&
+				Stream::getHostByteOrder() == Stream::ELittleEndian) {
+				m_filePath = filePath;
+				m_mapping = MemoryMappedFile::createCopyOnWrite(
+					fs::encode_pathstr(filePath));
+				m_mapped.resize(m_offsets.size(), false);
+				m_fstream = NULL;
+			}
+		}
+
+		/// Return the file offset of the given shape index
+		inline size_t getOffset(size_t shapeIndex) const {
+			if (shapeIndex >= m_offsets.size()) {
+				SLog(EError, "Unable to unserialize mesh, "
+					"shape index is out of range! (requested %i out of 0..%i)",
+					(int) shapeIndex, (int) (m_offsets.size()-1));
+			}
+			return m_offsets[shapeIndex];
 		}
 
 		/**
@@ -242,19 +299,34 @@ private:
 		 * Returns the modified stream.
 		 */
 		inline FileStream* seekStream(size_t shapeIndex) {
-			if (shapeIndex > m_offsets.size()) {
-				SLog(EError, "Unable to unserialize mesh, "
-					"shape index is out of range! (requested %i out of 0..%i)",
-					shapeIndex, (int) (m_offsets.size()-1));
-			}
-			const size_t pos = m_offsets[shapeIndex];
-			m_fstream->seek(pos);
+			m_fstream->seek(getOffset(shapeIndex));
 			return m_fstream;
 		}
 
+		/// Is this the loader of an uncompressed, memory-mapped file?
+		inline bool isMapped() const { return m_mapping.get() != NULL; }
+
+		/**
+		 * Return a mapping of the file, in which the given shape has not
+		 * been referenced yet. Meshes modify their data in place, hence
+		 * repeated loads of the same shape get a fresh mapping.
+		 */
+		inline MemoryMappedFile *getMapping(size_t shapeIndex) {
+			if (m_mapped[shapeIndex]) {
+				m_mapping = MemoryMappedFile::createCopyOnWrite(
+					fs::encode_pathstr(m_filePath));
+				std::fill(m_mapped.begin(), m_mapped.end(), false);
+			}
+			m_mapped[shapeIndex] = true;
+			return m_mapping;
+		}
+
 	private:
 		std::vector<size_t> m_offsets;
 		ref<FileStream> m_fstream;
+		ref<MemoryMappedFile> m_mapping;
+		std::vector<bool> m_mapped;
+		fs::path m_filePath;
 	};
 
 	typedef LRUCache<fs::path, std::less<fs::path>,
@@ -298,7 +370,12 @@ private:
 
 		std::shared_ptr<MeshLoader> meshLoader = cache->get(filePath);
 		Assert(meshLoader != NULL);
-		TriMesh::loadCompressed(meshLoader->seekStream((size_t) idx));
+		if (meshLoader->isMapped()) {
+			size_t offset = meshLoader->getOffset((size_t) idx);
+			TriMesh::loadMapped(meshLoader->getMapping((size_t) idx), offset);
+		} else {
+			TriMesh::loadCompressed(meshLoader->seekStream((size_t) idx));
+		}
 	}
 
 	static ThreadLocal<FileStreamCache> m_cache;
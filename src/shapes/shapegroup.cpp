@@ -97,7 +97,7 @@ void ShapeGroup::configure() {
 	   from SketchUp which create hundreds of tiny shape groups */
 	if (m_kdtree->getPrimitiveCount() < 100*1024)
 		m_kdtree->setLogLevel(ETrace);
-	if (!m_kdtree->isBuilt())
+	if (!m_kdtree->isAcceleratorBuilt())
 		m_kdtree->build();
 }
 
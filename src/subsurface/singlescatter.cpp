@@ -1594,6 +1594,10 @@ public:
 						MTS_CLASS(SamplingIntegrator)))
 					Log(EError, "Single scatter requires a sampling-based "
 								"surface integrator!");
+				if (!m_fastSingleScatter && scene->getKDTree()->getAccelerator()
+						!= ShapeKDTree::EKDTree)
+					Log(EError, "Exact single scattering traverses the scene's "
+								"kd-tree and cannot be combined with accel=\"bvh\"!");
 			}
 		}
 
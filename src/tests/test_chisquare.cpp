@@ -20,7 +20,9 @@
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/chisquare.h>
 #include <mitsuba/core/fresolver.h>
+#include <mitsuba/render/emitterbvh.h>
 #include <mitsuba/render/testcase.h>
+#include <boost/math/distributions/chi_squared.hpp>
 #include <functional>
 #include <tuple>
 
@@ -53,6 +55,7 @@ public:
 	MTS_DECLARE_TEST(test01_BSDF)
 	MTS_DECLARE_TEST(test02_PhaseFunction)
 	MTS_DECLARE_TEST(test03_EmitterDirect)
+	MTS_DECLARE_TEST(test04_EmitterHierarchy)
 	MTS_END_TESTCASE()
 
 	/**
@@ -620,6 +623,110 @@ public:
 		}
 		Log(EInfo, "%i/%i emitter checks succeeded", testCount-failureCount, testCount);
 	}
+
+	void test04_EmitterHierarchy() {
+		/* Scatter point emitters of varying intensity over a box */
+		ref<Random> random = new Random();
+		ref_vector<Emitter> emitters;
+		const int emitterCount = 24, refCount = 8, sampleCount = 200000;
+		for (int i=0; i<emitterCount; ++i) {
+			Properties props("point");
+			props.setPoint("position", Point(random->nextFloat(),
+				random->nextFloat(), random->nextFloat()) * 10.0f);
+			props.setSpectrum("intensity", Spectrum(1 + 9 * random->nextFloat()));
+			emitters.push_back(static_cast<Emitter *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Emitter), props)));
+		}
+
+		ref<EmitterBVH> bvh = new EmitterBVH(emitters);
+		int failureCount = 0, testCount = 0;
+
+		/* Sidak-corrected significance level of the individual tests */
+		Float alpha = 1 - std::pow(1 - SIGNIFICANCE_LEVEL, 1 / (Float) refCount);
+
+		Log(EInfo, "Verifying the emitter hierarchy ..");
+		for (int i=0; i<refCount; ++i) {
+			Point p = Point(random->nextFloat(), random->nextFloat(),
+				random->nextFloat()) * 14.0f - Vector(2.0f);
+			Normal n(warp::squareToUniformSphere(
+				Point2(random->nextFloat(), random->nextFloat())));
+
+			/* The selection probabilities must form a distribution */
+			std::vector<Float> pdfs(emitters.size());
+			Float pdfSum = 0;
+			for (size_t j=0; j<emitters.size(); ++j) {
+				pdfs[j] = bvh->pdf(emitters[j], p, n);
+				pdfSum += pdfs[j];
+			}
+			if (pdfSum == 0) {
+				/* None of the emitters illuminate this point */
+				Float sample = random->nextFloat(), pdf;
+				assertTrue(bvh->sample(p, n, sample, pdf) == NULL);
+				continue;
+			}
+			assertEqualsEpsilon(pdfSum, (Float) 1, ERROR_REQ);
+
+			/* Sampled emitters must be reported with the density of pdf() */
+			std::vector<size_t> histogram(emitters.size(), 0);
+			bool mismatch = false;
+			for (int j=0; j<sampleCount; ++j) {
+				Float sample = random->nextFloat(), pdf;
+				const Emitter *emitter = bvh->sample(p, n, sample, pdf);
+				size_t index = std::find(emitters.begin(), emitters.end(),
+					emitter) - emitters.begin();
+				if (index == emitters.size()) {
+					mismatch = true;
+					break;
+				}
+				if (std::abs(pdf - pdfs[index]) > ERROR_REQ * pdfs[index])
+					mismatch = true;
+				histogram[index]++;
+			}
+			if (mismatch) {
+				failAndContinue("The emitter hierarchy sampled an emitter with "
+					"a density that does not match pdf()");
+				++failureCount; ++testCount;
+				continue;
+			}
+
+			/* Pearson's chi-square test of the histogram, pooling cells
+			   with low expected frequencies */
+			Float chsq = 0, pooledObs = 0, pooledExp = 0;
+			int df = 0;
+			for (size_t j=0; j<emitters.size(); ++j) {
+				Float expected = pdfs[j] * sampleCount;
+				if (expected < CHISQR_MIN_EXP_FREQUENCY) {
+					pooledObs += (Float) histogram[j];
+					pooledExp += expected;
+				} else {
+					Float diff = (Float) histogram[j] - expected;
+					chsq += diff * diff / expected;
+					++df;
+				}
+			}
+			if (pooledExp > 0) {
+				Float diff = pooledObs - pooledExp;
+				chsq += diff * diff / std::max(pooledExp, (Float) CHISQR_MIN_EXP_FREQUENCY);
+				++df;
+			}
+			df -= 1;
+
+			if (df > 0) {
+				boost::math::chi_squared chSqDist(df);
+				Float pval = 1 - (Float) boost::math::cdf(chSqDist, chsq);
+				if (pval < alpha) {
+					failAndContinue(formatString("Uh oh, the chi-square test indicates that "
+						"the emitter hierarchy does not sample according to pdf() "
+						"(p-value = %e, significance level = %e)", pval, alpha));
+					++failureCount;
+				} else {
+					succeed();
+				}
+				++testCount;
+			}
+		}
+		Log(EInfo, "%i/%i emitter hierarchy checks succeeded", testCount-failureCount, testCount);
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestChiSquare, "Chi-square test for various sampling functions")
@@ -20,6 +20,7 @@
 #include <mitsuba/core/kdtree.h>
 #include <mitsuba/render/testcase.h>
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/scene.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -29,6 +30,8 @@ public:
 	MTS_DECLARE_TEST(test01_sutherlandHodgman)
 	MTS_DECLARE_TEST(test02_bunnyBenchmark)
 	MTS_DECLARE_TEST(test03_pointKDTree)
+	MTS_DECLARE_TEST(test04_compactKDTree)
+	MTS_DECLARE_TEST(test05_refitInstances)
 	MTS_END_TESTCASE()
 
 	void test01_sutherlandHodgman() {
@@ -214,6 +217,246 @@ public:
 		Log(EInfo, "Normal node size = " SIZE_T_FMT " bytes", sizeof(KDTree2::NodeType));
 		Log(EInfo, "Left-balanced node size = " SIZE_T_FMT " bytes", sizeof(KDTree2Left::NodeType));
 	}
+
+	/// Accumulates the data of all points returned by a range query
+	template <typename Tree> struct DataSum {
+		const Tree &tree;
+		Float sum;
+
+		inline DataSum(const Tree &tree) : tree(tree), sum(0) { }
+
+		inline void operator()(typename Tree::IndexType index) {
+			sum += tree.getData(index);
+		}
+	};
+
+	struct NodeDataSum {
+		Float sum;
+
+		inline NodeDataSum() : sum(0) { }
+
+		inline void operator()(const SimpleKDNode<Point, Float> &node) {
+			sum += node.getData();
+		}
+	};
+
+	void test04_compactKDTree() {
+		typedef CompactPointKDTree<Point, Float> CompactTree;
+		typedef PointKDTree< SimpleKDNode<Point, Float> > KDTree3;
+
+		ref<Random> random = new Random();
+
+		/* Validate k-nn and range queries against a brute force search */
+		size_t nPoints = 50000, nTries = 20;
+		CompactTree tree;
+		tree.reserve(nPoints);
+		for (size_t i=0; i<nPoints; ++i)
+			tree.push_back(Point(random->nextFloat(), random->nextFloat(),
+				random->nextFloat()), random->nextFloat());
+
+		ref<Timer> timer = new Timer();
+		tree.build(true);
+		Log(EInfo, "Construction time = %i ms, depth = %i", timer->getMilliseconds(), tree.getDepth());
+
+		CompactTree::SearchResult results[11];
+		std::vector<CompactTree::SearchResult> resultsBF;
+		for (int k=1; k<=10; ++k) {
+			for (size_t it = 0; it < nTries; ++it) {
+				Point p(random->nextFloat(), random->nextFloat(), random->nextFloat());
+				size_t found = tree.nnSearch(p, k, results);
+				assertEquals((int) found, k);
+				resultsBF.clear();
+				for (size_t j=0; j<nPoints; ++j)
+					resultsBF.push_back(CompactTree::SearchResult((tree.getPosition(j)-p).lengthSquared(), (uint32_t) j));
+				std::sort(results, results + k, CompactTree::SearchResultComparator());
+				std::sort(resultsBF.begin(), resultsBF.end(), CompactTree::SearchResultComparator());
+				for (int j=0; j<k; ++j) {
+					assertTrue(results[j].index == resultsBF[j].index);
+					assertEqualsEpsilon(results[j].distSquared, resultsBF[j].distSquared, Epsilon);
+				}
+			}
+		}
+
+		for (size_t it = 0; it < nTries; ++it) {
+			Point p(random->nextFloat(), random->nextFloat(), random->nextFloat());
+			Float radius = 0.05f + 0.1f * random->nextFloat();
+			DataSum<CompactTree> functor(tree);
+			size_t found = tree.executeQuery(p, radius, functor);
+			size_t foundBF = 0;
+			Float sumBF = 0;
+			for (size_t j=0; j<nPoints; ++j) {
+				if ((tree.getPosition(j)-p).lengthSquared() < radius*radius) {
+					foundBF++;
+					sumBF += tree.getData(j);
+				}
+			}
+			assertEquals((int) found, (int) foundBF);
+			assertEqualsEpsilon(functor.sum, sumBF, 1e-3f);
+		}
+
+		/* Points on two parallel planes: the leaves must still be split down
+		   to the bucket size, even though most cells are flat along y */
+		tree.clear();
+		tree.reserve(nPoints);
+		for (size_t i=0; i<nPoints; ++i)
+			tree.push_back(Point(random->nextFloat(), (Float) (i & 1),
+				random->nextFloat()), random->nextFloat());
+		tree.build(true);
+		uint32_t maxLeafSize = 0;
+		for (size_t i=0; i<tree.getNodeCount(); ++i) {
+			const CompactTree::Node &node = tree.getNode((uint32_t) i);
+			if (node.isLeaf())
+				maxLeafSize = std::max(maxLeafSize, node.getCount());
+		}
+		assertTrue(maxLeafSize <= CompactTree::KLeafSize);
+		for (size_t it = 0; it < nTries; ++it) {
+			Point p(random->nextFloat(), (Float) (it & 1), random->nextFloat());
+			size_t found = tree.nnSearch(p, 4, results);
+			assertEquals((int) found, 4);
+			Float maxDistSquared = 0;
+			for (int j=0; j<4; ++j)
+				maxDistSquared = std::max(maxDistSquared, results[j].distSquared);
+			size_t closerBF = 0;
+			for (size_t j=0; j<nPoints; ++j)
+				if ((tree.getPosition(j)-p).lengthSquared() < maxDistSquared)
+					++closerBF;
+			assertTrue(closerBF < 4);
+		}
+
+		/* Compare query throughput and memory usage with the node-based tree */
+		nPoints = 1000000;
+		size_t nQueries = 1000000;
+		Float radius = 0.01f;
+		tree.clear();
+		tree.reserve(nPoints);
+		KDTree3 kdtree(nPoints, KDTree3::ESlidingMidpoint);
+		for (size_t i=0; i<nPoints; ++i) {
+			Point p(random->nextFloat(), random->nextFloat(), random->nextFloat());
+			Float value = random->nextFloat();
+			tree.push_back(p, value);
+			kdtree[i].setPosition(p);
+			kdtree[i].setData(value);
+		}
+
+		timer->reset();
+		kdtree.build(true);
+		Log(EInfo, "PointKDTree: built in %i ms, %s", timer->getMilliseconds(),
+			memString(nPoints * sizeof(KDTree3::NodeType)).c_str());
+		timer->reset();
+		tree.build(true);
+		Log(EInfo, "CompactPointKDTree: built in %i ms, %s", timer->getMilliseconds(),
+			memString(tree.getMemoryUsage()).c_str());
+
+		std::vector<Point> queries(nQueries);
+		for (size_t i=0; i<nQueries; ++i)
+			queries[i] = Point(random->nextFloat(), random->nextFloat(), random->nextFloat());
+
+		size_t found = 0, foundCompact = 0;
+		NodeDataSum nodeSum;
+		timer->reset();
+		for (size_t i=0; i<nQueries; ++i)
+			found += kdtree.executeQuery(queries[i], radius, nodeSum);
+		unsigned int timeNode = timer->getMilliseconds();
+
+		DataSum<CompactTree> compactSum(tree);
+		timer->reset();
+		for (size_t i=0; i<nQueries; ++i)
+			foundCompact += tree.executeQuery(queries[i], radius, compactSum);
+		unsigned int timeCompact = timer->getMilliseconds();
+
+		assertTrue(found == foundCompact);
+		Log(EInfo, "Range queries (avg. " SIZE_T_FMT " points): PointKDTree = %i ms, "
+			"CompactPointKDTree = %i ms", found / nQueries, timeNode, timeCompact);
+
+		/* Results need room for k+1 entries */
+		KDTree3::SearchResult nodeResults[33];
+		CompactTree::SearchResult compactResults[33];
+		nQueries /= 10;
+		timer->reset();
+		for (size_t i=0; i<nQueries; ++i)
+			kdtree.nnSearch(queries[i], 32, nodeResults);
+		timeNode = timer->getMilliseconds();
+		timer->reset();
+		for (size_t i=0; i<nQueries; ++i)
+			tree.nnSearch(queries[i], 32, compactResults);
+		timeCompact = timer->getMilliseconds();
+		Log(EInfo, SIZE_T_FMT " 32-nn queries: PointKDTree = %i ms, CompactPointKDTree = %i ms",
+			nQueries, timeNode, timeCompact);
+	}
+
+	/// Trace a ray straight down from above the given position
+	Float traceDown(const Scene *scene, Float x, const Shape *&instance) {
+		Intersection its;
+		instance = NULL;
+		if (!scene->rayIntersect(Ray(Point(x, 0, 20), Vector(0, 0, -1), 0.0f), its))
+			return -1;
+		instance = its.instance;
+		return its.t;
+	}
+
+	void test05_refitInstances() {
+		/* Two instances of a unit rectangle stacked above each other,
+		   next to a sphere that is not instanced */
+		ref<Scene> scene = loadSceneFromString(
+			"<scene version=\"0.5.0\">"
+			"	<shapegroup id=\"group\">"
+			"		<shape type=\"rectangle\"/>"
+			"	</shapegroup>"
+			"	<shape type=\"instance\">"
+			"		<ref id=\"group\"/>"
+			"		<transform name=\"toWorld\">"
+			"			<translate z=\"5\"/>"
+			"		</transform>"
+			"	</shape>"
+			"	<shape type=\"instance\">"
+			"		<ref id=\"group\"/>"
+			"		<transform name=\"toWorld\">"
+			"			<translate z=\"-5\"/>"
+			"		</transform>"
+			"	</shape>"
+			"	<shape type=\"sphere\">"
+			"		<point name=\"center\" x=\"10\" y=\"0\" z=\"0\"/>"
+			"	</shape>"
+			"</scene>");
+		scene->initialize();
+
+		std::vector<Shape *> instances;
+		for (size_t i=0; i<scene->getShapes().size(); ++i) {
+			Shape *shape = scene->getShapes()[i];
+			if (shape->getClass()->getName() == "Instance")
+				instances.push_back(shape);
+		}
+		assertEquals((int) instances.size(), 2);
+		Shape *upper = instances[0]->getWorldTransform()->eval(0)(Point(0.0f)).z > 0
+			? instances[0] : instances[1];
+		Shape *lower = upper == instances[0] ? instances[1] : instances[0];
+
+		const Shape *hit;
+		assertEqualsEpsilon(traceDown(scene, 0, hit), (Float) 15, Epsilon);
+		assertTrue(hit == upper);
+		assertEqualsEpsilon(traceDown(scene, 10, hit), (Float) 19, Epsilon);
+
+		/* Move within the bounds of the instances: the scene's kd-tree is kept */
+		const ShapeKDTree *kdtree = scene->getKDTree();
+		upper->setWorldTransform(new AnimatedTransform(
+			Transform::translate(Vector(0, 0, 2)) * Transform::scale(Vector(0.5f))));
+		scene->refitKDTree();
+		assertTrue(scene->getKDTree() == kdtree);
+		assertEqualsEpsilon(traceDown(scene, 0, hit), (Float) 18, Epsilon);
+		assertTrue(hit == upper);
+		assertEqualsEpsilon(traceDown(scene, -0.9f, hit), (Float) 25, Epsilon);
+		assertTrue(hit == lower);
+
+		/* Move outside of them: the scene's kd-tree has to be rebuilt */
+		upper->setWorldTransform(new AnimatedTransform(Transform::translate(Vector(4, 0, 0))));
+		scene->refitKDTree();
+		assertTrue(scene->getKDTree() != kdtree);
+		assertEqualsEpsilon(traceDown(scene, 4, hit), (Float) 20, Epsilon);
+		assertTrue(hit == upper);
+		assertEqualsEpsilon(traceDown(scene, 0, hit), (Float) 25, Epsilon);
+		assertTrue(hit == lower);
+		assertEqualsEpsilon(traceDown(scene, 10, hit), (Float) 19, Epsilon);
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestKDTree, "Testcase for kd-tree related code")
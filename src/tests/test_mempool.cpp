@@ -0,0 +1,149 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/mempool.h>
+#include <mitsuba/bidir/vertex.h>
+#include <mitsuba/bidir/edge.h>
+#include <mitsuba/bidir/mempool.h>
+#include <mitsuba/render/testcase.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestMemoryPool : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_arenaRelease)
+	MTS_DECLARE_TEST(test02_arenaReset)
+	MTS_DECLARE_TEST(test03_arenaMode)
+	MTS_END_TESTCASE()
+
+	typedef BasicMemoryArena<uint64_t> Arena;
+
+	void test01_arenaRelease() {
+		Arena arena(4);
+		assertTrue(arena.unused());
+
+		/* Six entries span two blocks */
+		uint64_t *entries[6];
+		for (int i=0; i<6; ++i)
+			entries[i] = arena.alloc();
+		assertEquals((int) arena.size(), 8);
+		assertTrue(!arena.unused());
+
+		/* Entries other than the most recent one stay allocated */
+		arena.release(entries[2]);
+		uint64_t *next = arena.alloc();
+		assertTrue(next == entries[5] + 1);
+		arena.release(next);
+
+		/* Releasing in reverse order crosses the block boundary */
+		for (int i=5; i>=0; --i) {
+			assertTrue(!arena.unused());
+			arena.release(entries[i]);
+		}
+		assertTrue(arena.unused());
+
+		/* Both blocks are reused in the original order */
+		for (int i=0; i<6; ++i)
+			assertTrue(arena.alloc() == entries[i]);
+		assertEquals((int) arena.size(), 8);
+
+		/* Partial release across the boundary, then allocate again */
+		arena.release(entries[5]);
+		arena.release(entries[4]);
+		arena.release(entries[3]);
+		assertTrue(arena.alloc() == entries[3]);
+		assertTrue(arena.alloc() == entries[4]);
+		assertEquals((int) arena.size(), 8);
+	}
+
+	void test02_arenaReset() {
+		Arena arena(4);
+		arena.reset();
+		assertTrue(arena.unused());
+
+		uint64_t *entries[10];
+		for (int i=0; i<10; ++i)
+			entries[i] = arena.alloc();
+		assertEquals((int) arena.size(), 12);
+
+		arena.reset();
+		assertTrue(arena.unused());
+
+		/* No new blocks are needed after a reset */
+		for (int i=0; i<10; ++i)
+			assertTrue(arena.alloc() == entries[i]);
+		assertEquals((int) arena.size(), 12);
+		assertTrue(!arena.unused());
+
+		/* Growing past the previous high-water mark adds a block */
+		for (int i=0; i<3; ++i)
+			arena.alloc();
+		assertEquals((int) arena.size(), 16);
+		arena.reset();
+		assertTrue(arena.unused());
+	}
+
+	bool trySetArenaMode(MemoryPool &pool, bool arena) {
+		try {
+			pool.setArenaMode(arena);
+			return true;
+		} catch (const std::exception &) {
+			return false;
+		}
+	}
+
+	void test03_arenaMode() {
+		MemoryPool pool(16);
+		assertTrue(!pool.isArenaMode());
+
+		/* Switching is refused while free list entries are in use */
+		PathVertex *vertex = pool.allocVertex();
+		assertTrue(!trySetArenaMode(pool, true));
+		assertTrue(!pool.isArenaMode());
+		pool.release(vertex);
+		assertTrue(trySetArenaMode(pool, true));
+		assertTrue(pool.isArenaMode());
+
+		/* .. and while arena entries are in use */
+		PathEdge *edge = pool.allocEdge();
+		vertex = pool.allocVertex();
+		assertTrue(!trySetArenaMode(pool, false));
+		assertTrue(pool.isArenaMode());
+
+		/* LIFO release returns the arena to its unused state */
+		pool.release(vertex);
+		pool.release(edge);
+		assertTrue(pool.unused());
+
+		for (int i=0; i<40; ++i)
+			pool.allocVertex();
+		assertTrue(!trySetArenaMode(pool, false));
+		pool.reset();
+		assertTrue(pool.unused());
+		assertTrue(trySetArenaMode(pool, false));
+		assertTrue(!pool.isArenaMode());
+
+		vertex = pool.allocVertex();
+		pool.release(vertex);
+		assertTrue(pool.unused());
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestMemoryPool, "Testcase for memory pools and arenas")
+MTS_NAMESPACE_END
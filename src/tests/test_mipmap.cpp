@@ -0,0 +1,173 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/random.h>
+#include <mitsuba/render/mipmap.h>
+#include <mitsuba/render/testcase.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestMIPMap : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_blockCompression)
+	MTS_DECLARE_TEST(test02_ewaBenchmark)
+	MTS_END_TESTCASE()
+
+	typedef TSpectrum<Float, 3> Color3;
+	typedef TSpectrum<half, 3>  Color3h;
+	typedef TMIPMap<Color3, Color3h> MIPMap3;
+
+	static Color3 rgb(Float r, Float g, Float b) {
+		Color3 result;
+		result[0] = r; result[1] = g; result[2] = b;
+		return result;
+	}
+
+	/**
+	 * Tinted luminance pattern with fine detail and a slow change in hue
+	 * (like most natural textures, the color channels are correlated)
+	 */
+	ref<Bitmap> createBitmap(const Vector2i &size) {
+		ref<Bitmap> bitmap = new Bitmap(Bitmap::ERGB, Bitmap::EFloat32, size);
+		float *data = bitmap->getFloat32Data();
+		for (int y=0; y<size.y; ++y) {
+			for (int x=0; x<size.x; ++x) {
+				float detail = ((x / 3 + y / 5) % 2) * 0.05f,
+				      lum = 0.5f + 0.3f * std::sin(x * 0.02f) * std::cos(y * 0.03f) + detail,
+				      hue = 0.05f * std::sin((x + y) * 0.005f);
+				*data++ = lum * 0.9f + hue;
+				*data++ = lum * 0.7f;
+				*data++ = lum * 0.4f - hue;
+			}
+		}
+		return bitmap;
+	}
+
+	ref<ReconstructionFilter> createFilter() {
+		Properties rfilterProps("lanczos");
+		rfilterProps.setInteger("lobes", 2);
+		ref<ReconstructionFilter> rfilter = static_cast<ReconstructionFilter *> (
+			PluginManager::getInstance()->createObject(
+			MTS_CLASS(ReconstructionFilter), rfilterProps));
+		rfilter->configure();
+		return rfilter;
+	}
+
+	void test01_blockCompression() {
+		typedef CompressedBlockedArray<Color3> CompressedArray;
+
+		/* Blocks on a line segment are reproduced up to the index resolution */
+		Color3 values[16];
+		for (int i=0; i<16; ++i)
+			values[i] = Color3(0.1f) + rgb(0.5f, 0.2f, 0.8f) * (i / 15.0f);
+		CompressedArray::Block block;
+		CompressedArray::encode(values, block);
+		for (int i=0; i<16; ++i)
+			for (int c=0; c<3; ++c)
+				assertEqualsEpsilon(block.eval(i)[c], values[i][c], 2e-3f);
+
+		/* Constant blocks are reproduced at half precision */
+		for (int i=0; i<16; ++i)
+			values[i] = rgb(2.5f, 100.0f, 0.0f);
+		CompressedArray::encode(values, block);
+		for (int i=0; i<16; ++i)
+			for (int c=0; c<3; ++c)
+				assertEqualsEpsilon(block.eval(i)[c], values[i][c], 1e-6f);
+
+		/* Compare a compressed MIP map against an uncompressed one */
+		ref<Bitmap> bitmap = createBitmap(Vector2i(509, 253));
+		ref<ReconstructionFilter> rfilter = createFilter();
+		ref<MIPMap3> mipmap = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+			rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat);
+		ref<MIPMap3> compressed = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+			rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+			EEWA, 20.0f, fs::pathstr(), 0, 1.0f, Spectrum::EReflectance, true);
+
+		assertTrue(compressed->isCompressed());
+		assertEquals(compressed->getLevels(), mipmap->getLevels());
+		Log(EInfo, "Uncompressed: %s, compressed: %s",
+			memString(mipmap->getBufferSize()).c_str(),
+			memString(compressed->getBufferSize()).c_str());
+		assertTrue(compressed->getBufferSize() * 4 < mipmap->getBufferSize());
+
+		for (int level=0; level<mipmap->getLevels(); ++level) {
+			const Vector2i &size = mipmap->getArray(level).getSize();
+			Float error = 0, maxError = 0;
+			for (int y=0; y<size.y; ++y) {
+				for (int x=0; x<size.x; ++x) {
+					Color3 diff = compressed->evalTexel(level, x, y)
+						- mipmap->evalTexel(level, x, y);
+					for (int c=0; c<3; ++c) {
+						error += diff[c] * diff[c];
+						maxError = std::max(maxError, std::abs(diff[c]));
+					}
+				}
+			}
+			error = std::sqrt(error / (3 * size.x * size.y));
+			Log(EInfo, "Level %i: RMS error = %f, max. error = %f", level, error, maxError);
+			assertTrue(error < (level == 0 ? 0.005f : 0.05f));
+		}
+	}
+
+	void test02_ewaBenchmark() {
+		ref<Bitmap> bitmap = createBitmap(Vector2i(2048, 2048));
+		ref<ReconstructionFilter> rfilter = createFilter();
+		ref<MIPMap3> mipmaps[2];
+		mipmaps[0] = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+			rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat);
+		mipmaps[1] = new MIPMap3(bitmap, Bitmap::ERGB, Bitmap::EFloat,
+			rfilter, ReconstructionFilter::ERepeat, ReconstructionFilter::ERepeat,
+			EEWA, 20.0f, fs::pathstr(), 0, 1.0f, Spectrum::EReflectance, true);
+
+		/* Anisotropic lookups with footprints between 1/2 and 16 texels */
+		const size_t nLookups = 2000000;
+		std::vector<Point2> uv(nLookups);
+		std::vector<Vector2> d0(nLookups), d1(nLookups);
+		ref<Random> random = new Random();
+		for (size_t i=0; i<nLookups; ++i) {
+			Float scale = std::pow((Float) 2, random->nextFloat() * 5 - 1) / 2048,
+			      angle = random->nextFloat() * 2 * M_PI,
+			      aspect = 1 + random->nextFloat() * 7;
+			uv[i] = Point2(random->nextFloat(), random->nextFloat());
+			d0[i] = Vector2(std::cos(angle), std::sin(angle)) * scale * aspect;
+			d1[i] = Vector2(-std::sin(angle), std::cos(angle)) * scale;
+		}
+
+		Color3 sums[2];
+		ref<Timer> timer = new Timer();
+		for (int j=0; j<2; ++j) {
+			sums[j] = Color3(0.0f);
+			timer->reset();
+			for (size_t i=0; i<nLookups; ++i)
+				sums[j] += mipmaps[j]->eval(uv[i], d0[i], d1[i]);
+			Float time = timer->getMilliseconds() / (Float) 1000;
+			Log(EInfo, "%s: %s, " SIZE_T_FMT " EWA lookups in %.2f s -> %.2f MLookups/s",
+				j == 0 ? "Uncompressed" : "Compressed",
+				memString(mipmaps[j]->getBufferSize()).c_str(),
+				nLookups, time, nLookups / (time * 1e6f));
+		}
+
+		for (int c=0; c<3; ++c)
+			assertEqualsEpsilon(sums[1][c] / nLookups, sums[0][c] / nLookups, 1e-2f);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestMIPMap, "Testcase for MIP map storage and lookups")
+MTS_NAMESPACE_END
@@ -0,0 +1,152 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/filesystem.h>
+#include <mitsuba/render/trimesh.h>
+#include <mitsuba/render/testcase.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestMMap : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_copyOnWrite)
+	MTS_DECLARE_TEST(test02_uncompressedRoundTrip)
+	MTS_END_TESTCASE()
+
+	std::vector<uint8_t> readFile(const fs::path &path) {
+		ref<FileStream> stream = new FileStream(fs::encode_pathstr(path));
+		std::vector<uint8_t> result(stream->getSize());
+		if (!result.empty())
+			stream->read(&result[0], result.size());
+		return result;
+	}
+
+	void test01_copyOnWrite() {
+		fs::path path = fs::temp_directory_path() / "mts_test_cow.bin";
+		std::vector<uint8_t> contents(3 * 4096 + 123);
+		for (size_t i=0; i<contents.size(); ++i)
+			contents[i] = (uint8_t) (i * 7);
+		{
+			ref<FileStream> stream = new FileStream(fs::encode_pathstr(path),
+				FileStream::ETruncReadWrite);
+			stream->write(&contents[0], contents.size());
+		}
+
+		ref<MemoryMappedFile> mapping = MemoryMappedFile::createCopyOnWrite(
+			fs::encode_pathstr(path));
+		assertTrue(mapping->isCopyOnWrite());
+		assertTrue(!mapping->isReadOnly());
+		assertEquals((int) mapping->getSize(), (int) contents.size());
+		uint8_t *data = static_cast<uint8_t *>(mapping->getData());
+		assertTrue(memcmp(data, &contents[0], contents.size()) == 0);
+
+		/* Writes are private to the mapping */
+		data[0] ^= 0xFF;
+		data[contents.size() - 1] ^= 0xFF;
+		assertTrue(readFile(path) == contents);
+
+		ref<MemoryMappedFile> other = MemoryMappedFile::createCopyOnWrite(
+			fs::encode_pathstr(path));
+		assertTrue(memcmp(other->getData(), &contents[0], contents.size()) == 0);
+
+		other = NULL;
+		mapping = NULL;
+		assertTrue(readFile(path) == contents);
+		fs::remove(path);
+	}
+
+	void test02_uncompressedRoundTrip() {
+		const size_t vertexCount = 1000, triangleCount = 2000;
+		ref<TriMesh> mesh = new TriMesh("roundTrip", triangleCount,
+			vertexCount, true, true);
+		ref<Random> random = new Random();
+		Point *positions = mesh->getVertexPositions();
+		Normal *normals = mesh->getVertexNormals();
+		Point2 *texcoords = mesh->getVertexTexcoords();
+		Triangle *triangles = mesh->getTriangles();
+		for (size_t i=0; i<vertexCount; ++i) {
+			positions[i] = Point(random->nextFloat(), random->nextFloat(), random->nextFloat());
+			normals[i] = Normal(0, 0, 1);
+			texcoords[i] = Point2(random->nextFloat(), random->nextFloat());
+		}
+		for (size_t i=0; i<triangleCount; ++i)
+			for (int j=0; j<3; ++j)
+				triangles[i].idx[j] = (uint32_t) random->nextUInt(vertexCount);
+
+		/* Write two meshes and the end-of-file dictionary, like 'serialized2mmap' */
+		fs::path path = fs::temp_directory_path() / "mts_test_mmap.serialized";
+		{
+			ref<FileStream> stream = new FileStream(fs::encode_pathstr(path),
+				FileStream::ETruncReadWrite);
+			stream->setByteOrder(Stream::ELittleEndian);
+			uint64_t offsets[2];
+			offsets[0] = (uint64_t) mesh->serializeUncompressed(stream);
+			offsets[1] = (uint64_t) mesh->serializeUncompressed(stream);
+			assertTrue(offsets[1] > offsets[0] && offsets[1] % 4096 == 0);
+			stream->writeULongArray(offsets, 2);
+			stream->writeUInt(2);
+		}
+		std::vector<uint8_t> contents = readFile(path);
+
+		/* The first shape is loaded twice: the second copy must not
+		   see the modifications made to the first one */
+		const int shapeIndices[] = { 0, 1, 0 };
+		ref_vector<TriMesh> meshes;
+		for (int i=0; i<3; ++i) {
+			Properties props("serialized");
+			props.setString("filename", path.string());
+			props.setInteger("shapeIndex", shapeIndices[i]);
+			ref<TriMesh> mapped = static_cast<TriMesh *>(PluginManager::getInstance()->
+				createObject(MTS_CLASS(Shape), props));
+			mapped->configure();
+			meshes.push_back(mapped);
+
+			assertTrue(mapped->isMapped());
+			assertEquals((int) mapped->getVertexCount(), (int) vertexCount);
+			assertEquals((int) mapped->getTriangleCount(), (int) triangleCount);
+			assertTrue(mapped->getVertexColors() == NULL);
+			assertTrue(memcmp(mapped->getVertexPositions(), positions, vertexCount * sizeof(Point)) == 0);
+			assertTrue(memcmp(mapped->getVertexNormals(), normals, vertexCount * sizeof(Normal)) == 0);
+			assertTrue(memcmp(mapped->getVertexTexcoords(), texcoords, vertexCount * sizeof(Point2)) == 0);
+			assertTrue(memcmp(mapped->getTriangles(), triangles, triangleCount * sizeof(Triangle)) == 0);
+
+			/* Modifying the mesh must not reach the file */
+			mapped->getVertexPositions()[0] += Vector(1, 2, 3);
+			assertTrue(readFile(path) == contents);
+		}
+
+		/* Reading through a stream copies the data */
+		{
+			ref<FileStream> stream = new FileStream(fs::encode_pathstr(path));
+			stream->setByteOrder(Stream::ELittleEndian);
+			ref<TriMesh> copied = new TriMesh(stream, 1);
+			assertTrue(!copied->isMapped());
+			assertTrue(memcmp(copied->getVertexPositions(), positions, vertexCount * sizeof(Point)) == 0);
+			assertTrue(memcmp(copied->getTriangles(), triangles, triangleCount * sizeof(Triangle)) == 0);
+		}
+
+		fs::remove(path);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestMMap, "Testcase for memory-mapped serialized meshes")
+MTS_NAMESPACE_END
@@ -28,6 +28,7 @@ public:
 	MTS_DECLARE_TEST(test01_Halton)
 	MTS_DECLARE_TEST(test02_Hammersley)
 	MTS_DECLARE_TEST(test03_radicalInverseIncr)
+	MTS_DECLARE_TEST(test04_owenSobol)
 	MTS_END_TESTCASE()
 
 	void test01_Halton() {
@@ -84,6 +85,69 @@ public:
 			x = radicalInverseIncremental(2, x);
 		}
 	}
+
+	/// Check that 'n' values hit every one of 'n' strata exactly once
+	void assertStratified(const std::vector<Float> &values) {
+		std::vector<int> counts(values.size(), 0);
+		for (size_t i=0; i<values.size(); ++i)
+			counts[std::min((size_t) (values[i] * values.size()), values.size() - 1)]++;
+		for (size_t i=0; i<counts.size(); ++i)
+			assertEquals(counts[i], 1);
+	}
+
+	void test04_owenSobol() {
+		const int sampleCount = 64, dimensions = 8, arraySize = 4;
+		Properties props("owensobol");
+		props.setInteger("sampleCount", sampleCount);
+
+		ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), props));
+		sampler->request1DArray(arraySize);
+
+		std::vector<Float> values1D(sampleCount * dimensions);
+		std::vector<Point2> values2D(sampleCount * dimensions);
+		std::vector<Float> array(sampleCount * arraySize);
+
+		sampler->generate(Point2i(13, 7));
+		for (int i=0; i<sampleCount; ++i) {
+			for (int j=0; j<dimensions; ++j) {
+				values1D[j*sampleCount + i] = sampler->next1D();
+				values2D[j*sampleCount + i] = sampler->next2D();
+			}
+			Float *a = sampler->next1DArray(arraySize);
+			for (int j=0; j<arraySize; ++j)
+				array[i*arraySize + j] = a[j];
+			sampler->advance();
+		}
+
+		/* Every dimension is stratified in 1D and 2D (8x8 strata) */
+		for (int j=0; j<dimensions; ++j) {
+			std::vector<Float> x(values1D.begin() + j*sampleCount,
+				values1D.begin() + (j+1)*sampleCount);
+			assertStratified(x);
+			for (int i=0; i<sampleCount; ++i) {
+				const Point2 &p = values2D[j*sampleCount + i];
+				x[i] = (std::floor(p.x * 8) + p.y) / 8;
+			}
+			assertStratified(x);
+		}
+
+		/* The arrays of all samples are stratified as a whole */
+		assertStratified(array);
+
+		/* Random access to a sample reproduces the sequential values */
+		sampler->generate(Point2i(13, 7), 42);
+		for (int j=0; j<dimensions; ++j) {
+			assertEquals(sampler->next1D(), values1D[j*sampleCount + 42]);
+			Point2 p = sampler->next2D();
+			assertEquals(p.x, values2D[j*sampleCount + 42].x);
+			assertEquals(p.y, values2D[j*sampleCount + 42].y);
+		}
+
+		/* Other pixels use a different scramble */
+		sampler->generate(Point2i(14, 7));
+		assertTrue(sampler->next1D() != values1D[0]);
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestSamplers, "Testcase for sampling-related code")
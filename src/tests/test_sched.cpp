@@ -0,0 +1,349 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/sched.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/render/testcase.h>
+#include <atomic>
+#include <chrono>
+
+MTS_NAMESPACE_BEGIN
+
+/// Work unit consisting of a single index
+class IndexWorkUnit : public WorkUnit {
+public:
+	void set(const WorkUnit *wu) { m_index = static_cast<const IndexWorkUnit *>(wu)->m_index; }
+	void load(Stream *stream) { m_index = stream->readUInt(); }
+	void save(Stream *stream) const { stream->writeUInt(m_index); }
+	std::string toString() const { return formatString("IndexWorkUnit[%u]", m_index); }
+
+	inline uint32_t getIndex() const { return m_index; }
+	inline void setIndex(uint32_t index) { m_index = index; }
+
+	MTS_DECLARE_CLASS()
+private:
+	uint32_t m_index;
+};
+
+/// Work result consisting of a single hash value
+class HashWorkResult : public WorkResult {
+public:
+	void load(Stream *stream) { m_hash = stream->readUInt(); }
+	void save(Stream *stream) const { stream->writeUInt(m_hash); }
+	std::string toString() const { return formatString("HashWorkResult[%u]", m_hash); }
+
+	inline uint32_t getHash() const { return m_hash; }
+	inline void setHash(uint32_t hash) { m_hash = hash; }
+
+	MTS_DECLARE_CLASS()
+private:
+	uint32_t m_hash;
+};
+
+/// Performs a few hundred nanoseconds worth of computation per work unit
+class HashWorkProcessor : public WorkProcessor {
+public:
+	ref<WorkUnit> createWorkUnit() const { return new IndexWorkUnit(); }
+	ref<WorkResult> createWorkResult() const { return new HashWorkResult(); }
+	ref<WorkProcessor> clone() const { return new HashWorkProcessor(); }
+	void prepare() { }
+	void serialize(Stream *stream, InstanceManager *manager) const { }
+
+	void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
+		uint32_t value = static_cast<const IndexWorkUnit *>(workUnit)->getIndex();
+		for (int i=0; i<64; ++i)
+			value = (value ^ (value >> 15)) * 0x2c1b3c6dU;
+		static_cast<HashWorkResult *>(workResult)->setHash(value);
+	}
+
+	MTS_DECLARE_CLASS()
+};
+
+/// Parallel process consisting of many tiny work units
+class HashProcess : public ParallelProcess {
+public:
+	HashProcess(uint32_t workUnits) : m_workUnits(workUnits),
+		m_generated(0), m_processed(0), m_checksum(0) { }
+
+	EStatus generateWork(WorkUnit *unit, int worker) {
+		if (m_generated == m_workUnits)
+			return EFailure;
+		static_cast<IndexWorkUnit *>(unit)->setIndex(m_generated++);
+		return ESuccess;
+	}
+
+	void processResult(const WorkResult *result, bool cancelled) {
+		if (cancelled)
+			return;
+		m_checksum += static_cast<const HashWorkResult *>(result)->getHash();
+		m_processed++;
+	}
+
+	ref<WorkProcessor> createWorkProcessor() const { return new HashWorkProcessor(); }
+	bool isLocal() const { return true; }
+
+	inline uint32_t getProcessed() const { return m_processed; }
+	inline uint32_t getChecksum() const { return m_checksum; }
+
+	MTS_DECLARE_CLASS()
+private:
+	uint32_t m_workUnits, m_generated;
+	std::atomic<uint32_t> m_processed, m_checksum;
+};
+
+/// Work unit that remembers the thread which generated it
+class OwnedWorkUnit : public WorkUnit {
+public:
+	void set(const WorkUnit *wu) { m_owner = static_cast<const OwnedWorkUnit *>(wu)->m_owner; }
+	void load(Stream *stream) { Log(EError, "OwnedWorkUnit is local only"); }
+	void save(Stream *stream) const { Log(EError, "OwnedWorkUnit is local only"); }
+	std::string toString() const { return "OwnedWorkUnit[]"; }
+
+	inline const Thread *getOwner() const { return m_owner; }
+	inline void setOwner(const Thread *owner) { m_owner = owner; }
+
+	MTS_DECLARE_CLASS()
+private:
+	const Thread *m_owner;
+};
+
+/// Work result recording how the work unit was executed
+class SpinWorkResult : public WorkResult {
+public:
+	void load(Stream *stream) { Log(EError, "SpinWorkResult is local only"); }
+	void save(Stream *stream) const { Log(EError, "SpinWorkResult is local only"); }
+	std::string toString() const { return "SpinWorkResult[]"; }
+
+	bool stolen, stopped;
+
+	MTS_DECLARE_CLASS()
+};
+
+/// Spins for a few microseconds, or until the work unit is stopped
+class SpinWorkProcessor : public WorkProcessor {
+public:
+	ref<WorkUnit> createWorkUnit() const { return new OwnedWorkUnit(); }
+	ref<WorkResult> createWorkResult() const { return new SpinWorkResult(); }
+	ref<WorkProcessor> clone() const { return new SpinWorkProcessor(); }
+	void prepare() { }
+	void serialize(Stream *stream, InstanceManager *manager) const { }
+
+	void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
+		SpinWorkResult *result = static_cast<SpinWorkResult *>(workResult);
+		result->stolen = static_cast<const OwnedWorkUnit *>(workUnit)->getOwner() != Thread::getThread();
+		std::chrono::steady_clock::time_point end =
+			std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+		while (!stop && std::chrono::steady_clock::now() < end)
+			;
+		result->stopped = stop;
+	}
+
+	MTS_DECLARE_CLASS()
+};
+
+/// Parallel process that keeps generating work until it is cancelled
+class SpinProcess : public ParallelProcess {
+public:
+	SpinProcess() : m_generated(0), m_results(0), m_stolen(0), m_cancelled(0) { }
+
+	EStatus generateWork(WorkUnit *unit, int worker) {
+		static_cast<OwnedWorkUnit *>(unit)->setOwner(Thread::getThread());
+		m_generated++;
+		return ESuccess;
+	}
+
+	void processResult(const WorkResult *result, bool cancelled) {
+		const SpinWorkResult *spinResult = static_cast<const SpinWorkResult *>(result);
+		if (spinResult->stolen)
+			m_stolen++;
+		if (cancelled)
+			m_cancelled++;
+		m_results++;
+	}
+
+	ref<WorkProcessor> createWorkProcessor() const { return new SpinWorkProcessor(); }
+	bool isLocal() const { return true; }
+
+	inline uint32_t getGenerated() const { return m_generated; }
+	inline uint32_t getResults() const { return m_results; }
+	inline uint32_t getStolen() const { return m_stolen; }
+	inline uint32_t getCancelled() const { return m_cancelled; }
+
+	MTS_DECLARE_CLASS()
+private:
+	std::atomic<uint32_t> m_generated, m_results, m_stolen, m_cancelled;
+};
+
+/// Waits for a parallel process on a separate thread
+class WaitThread : public Thread {
+public:
+	WaitThread(ParallelProcess *proc) : Thread("wait"), m_proc(proc),
+		m_waiting(false), m_result(false) { }
+
+	void run() {
+		m_waiting = true;
+		m_result = Scheduler::getInstance()->wait(m_proc);
+	}
+
+	inline bool isWaiting() const { return m_waiting; }
+	inline bool getResult() const { return m_result; }
+private:
+	ref<ParallelProcess> m_proc;
+	std::atomic<bool> m_waiting;
+	bool m_result;
+};
+
+class TestScheduler : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_workUnitThroughput)
+	MTS_DECLARE_TEST(test02_cancelQueuedWork)
+	MTS_END_TESTCASE()
+
+	void test01_workUnitThroughput() {
+		const uint32_t nWorkUnits = 200000;
+		ref<Scheduler> scheduler = Scheduler::getInstance();
+
+		/* Reference checksum */
+		ref<HashProcess> reference = new HashProcess(nWorkUnits);
+		ref<WorkProcessor> wp = reference->createWorkProcessor();
+		ref<WorkUnit> workUnit = wp->createWorkUnit();
+		ref<WorkResult> workResult = wp->createWorkResult();
+		bool stop = false;
+		while (reference->generateWork(workUnit, 0) == ParallelProcess::ESuccess) {
+			wp->process(workUnit, workResult, stop);
+			reference->processResult(workResult, false);
+		}
+
+		/* Temporarily replace the workers of the scheduler */
+		scheduler->pause();
+		std::vector<ref<Worker> > workers;
+		while (scheduler->getWorkerCount() > 0) {
+			workers.push_back(scheduler->getWorker(0));
+			scheduler->unregisterWorker(workers.back());
+		}
+
+		int maxCores = getCoreCount();
+		for (int cores = 1; ; cores = std::min(cores * 2, maxCores)) {
+			for (int i=0; i<cores; ++i)
+				scheduler->registerWorker(new LocalWorker(i, formatString("tst%i", i)));
+			scheduler->start();
+
+			ref<HashProcess> proc = new HashProcess(nWorkUnits);
+			ref<Timer> timer = new Timer();
+			scheduler->schedule(proc);
+			scheduler->wait(proc);
+			Float time = timer->getMilliseconds() / (Float) 1000;
+
+			Log(EInfo, "%i core(s): %u work units in %.3f s -> %.1f K work units/s",
+				cores, nWorkUnits, time, nWorkUnits / (time * 1000));
+
+			assertTrue(proc->getReturnStatus() == ParallelProcess::ESuccess);
+			assertEquals((int) proc->getProcessed(), (int) nWorkUnits);
+			assertTrue(proc->getChecksum() == reference->getChecksum());
+
+			scheduler->pause();
+			while (scheduler->getWorkerCount() > 0)
+				scheduler->unregisterWorker(scheduler->getWorker(0));
+
+			if (cores == maxCores)
+				break;
+		}
+
+		for (size_t i=0; i<workers.size(); ++i)
+			scheduler->registerWorker(workers[i]);
+		scheduler->start();
+	}
+
+	/// Wait for a condition with a timeout of ten seconds
+	template <typename Predicate> bool waitFor(Predicate pred) {
+		ref<Timer> timer = new Timer();
+		while (!pred()) {
+			if (timer->getMilliseconds() > 10000)
+				return false;
+			Thread::sleep(1);
+		}
+		return true;
+	}
+
+	void test02_cancelQueuedWork() {
+		ref<Scheduler> scheduler = Scheduler::getInstance();
+
+		/* Temporarily replace the workers of the scheduler. Work stealing
+		   needs at least two local workers, even on a single core */
+		scheduler->pause();
+		std::vector<ref<Worker> > workers;
+		while (scheduler->getWorkerCount() > 0) {
+			workers.push_back(scheduler->getWorker(0));
+			scheduler->unregisterWorker(workers.back());
+		}
+		int cores = std::max(4, std::min(getCoreCount(), 8));
+		for (int i=0; i<cores; ++i)
+			scheduler->registerWorker(new LocalWorker(-1, formatString("tst%i", i)));
+		scheduler->start();
+
+		ref<SpinProcess> proc = new SpinProcess();
+		scheduler->schedule(proc);
+		ref<WaitThread> waitThread = new WaitThread(proc);
+		waitThread->start();
+
+		/* Cancel once batches are being queued and stolen */
+		assertTrue(waitFor([&] { return waitThread->isWaiting() &&
+			proc->getStolen() > 0 && proc->getResults() > 1000; }));
+		assertTrue(scheduler->cancel(proc));
+
+		/* All in-flight work units, including queued ones that were never
+		   started, were returned before cancel() finished */
+		uint32_t generated = proc->getGenerated(), results = proc->getResults();
+		Log(EInfo, "Cancelled after %u work units (%u stolen, %u cancelled)",
+			generated, proc->getStolen(), proc->getCancelled());
+		assertEquals((int) results, (int) generated);
+		assertTrue(proc->getCancelled() > 0);
+		assertTrue(proc->getReturnStatus() == ParallelProcess::EFailure);
+		assertTrue(!scheduler->isBusy());
+
+		/* The waiting thread is woken up, and later calls return immediately */
+		assertTrue(waitFor([&] { return !waitThread->isRunning(); }));
+		waitThread->join();
+		assertTrue(waitThread->getResult());
+		assertTrue(!scheduler->wait(proc));
+
+		/* Nothing of the cancelled process circulates anymore */
+		Thread::sleep(50);
+		assertEquals((int) proc->getGenerated(), (int) generated);
+		assertEquals((int) proc->getResults(), (int) results);
+
+		scheduler->pause();
+		while (scheduler->getWorkerCount() > 0)
+			scheduler->unregisterWorker(scheduler->getWorker(0));
+		for (size_t i=0; i<workers.size(); ++i)
+			scheduler->registerWorker(workers[i]);
+		scheduler->start();
+	}
+};
+
+MTS_IMPLEMENT_CLASS(IndexWorkUnit, false, WorkUnit)
+MTS_IMPLEMENT_CLASS(HashWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS(HashWorkProcessor, false, WorkProcessor)
+MTS_IMPLEMENT_CLASS(HashProcess, false, ParallelProcess)
+MTS_IMPLEMENT_CLASS(OwnedWorkUnit, false, WorkUnit)
+MTS_IMPLEMENT_CLASS(SpinWorkResult, false, WorkResult)
+MTS_IMPLEMENT_CLASS(SpinWorkProcessor, false, WorkProcessor)
+MTS_IMPLEMENT_CLASS(SpinProcess, false, ParallelProcess)
+MTS_EXPORT_TESTCASE(TestScheduler, "Testcase for the scheduler")
+MTS_NAMESPACE_END
@@ -19,6 +19,7 @@
 #include <mitsuba/render/testcase.h>
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/random.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -28,6 +29,8 @@ public:
 	MTS_DECLARE_TEST(test01_spectrum)
 	MTS_DECLARE_TEST(test02_interpolatedSpectrum)
 	MTS_DECLARE_TEST(test03_blackBody)
+	MTS_DECLARE_TEST(test04_kernels)
+	MTS_DECLARE_TEST(test05_misalignedKernels)
 	MTS_END_TESTCASE()
 
 	void test01_spectrum() {
@@ -140,6 +143,107 @@ public:
 		assertEqualsEpsilon(spec.eval(2000)/10, 115.8f, .5f);
 		assertEqualsEpsilon(spec.average(100, 1000) * .09f, 715.f, 1);
 	}
+
+	/// Compare the (possibly vectorized) spectrum arithmetic against scalar loops
+	template <int N> void checkKernels(Random *random) {
+		typedef TSpectrum<Float, N> Spec;
+		typedef TSpectrumKernels<Float, N, false> Scalar;
+
+		Spec a, b;
+		Float w = random->nextFloat() * 4 - 2;
+		for (int i=0; i<N; ++i) {
+			a[i] = random->nextFloat() * 4 - 2;
+			b[i] = random->nextFloat() + 0.5f;
+		}
+
+		Float ref[N];
+		Scalar::add(ref, &a[0], &b[0]); checkEquals(a + b, ref);
+		Scalar::sub(ref, &a[0], &b[0]); checkEquals(a - b, ref);
+		Scalar::mul(ref, &a[0], &b[0]); checkEquals(a * b, ref);
+		Scalar::div(ref, &a[0], &b[0]); checkEquals(a / b, ref);
+		Scalar::scale(ref, &a[0], w); checkEquals(a * w, ref);
+		Scalar::negate(ref, &a[0]); checkEquals(-a, ref);
+		Scalar::abs(ref, &a[0]); checkEquals(a.abs(), ref);
+		Scalar::sqrt(ref, &b[0]); checkEquals(b.sqrt(), ref);
+		Scalar::safe_sqrt(ref, &a[0]); checkEquals(a.safe_sqrt(), ref);
+
+		Spec c = b;
+		c.addWeighted(w, a);
+		memcpy(ref, &b[0], sizeof(Float) * N);
+		Scalar::addWeighted(ref, w, &a[0]);
+		checkEquals(c, ref);
+
+		c = a;
+		c.clampNegative();
+		memcpy(ref, &a[0], sizeof(Float) * N);
+		Scalar::clampNegative(ref);
+		checkEquals(c, ref);
+
+		assertEqualsEpsilon(a.average(), Scalar::sum(&a[0]) / N, 1e-5f);
+		assertEquals(a.max(), Scalar::max(&a[0]));
+		assertEquals(a.min(), Scalar::min(&a[0]));
+
+		assertTrue(a == a && a != b);
+		c = a; c[N-1] += 1;
+		assertTrue(c != a);
+		assertTrue(Spec(0.0f).isZero() && !c.isZero());
+	}
+
+	template <typename Spec> void checkEquals(const Spec &value, const Float *ref) {
+		for (int i=0; i<Spec::dim; ++i)
+			assertEqualsEpsilon(value[i], ref[i], 1e-6f * std::max((Float) 1, std::abs(ref[i])));
+	}
+
+	void test04_kernels() {
+		ref<Random> random = new Random();
+		for (int i=0; i<100; ++i) {
+			checkKernels<3>(random);
+			checkKernels<4>(random);
+			checkKernels<8>(random);
+			checkKernels<16>(random);
+			checkKernels<SPECTRUM_SAMPLES>(random);
+		}
+	}
+
+	/// Spectra reinterpreted from float buffers need not be 16-byte aligned
+	template <int N> void checkMisaligned(Random *random) {
+		typedef TSpectrum<Float, N> Spec;
+		typedef TSpectrumKernels<Float, N, false> Scalar;
+
+		Float buffer[3*N + 4], ref[N];
+		for (int offset=1; offset<=2; ++offset) {
+			for (int i=0; i<3*N + 4; ++i)
+				buffer[i] = random->nextFloat() + 0.5f;
+			Float *a = buffer + offset, *b = a + N, *r = b + N;
+			Spec *sa = (Spec *) a, *sb = (Spec *) b, *sr = (Spec *) r;
+
+			*sr = *sa + *sb; Scalar::add(ref, a, b); checkEquals(*sr, ref);
+			*sr = *sa * *sb; Scalar::mul(ref, a, b); checkEquals(*sr, ref);
+			*sr = *sa / *sb; Scalar::div(ref, a, b); checkEquals(*sr, ref);
+			*sr = sa->sqrt(); Scalar::sqrt(ref, a); checkEquals(*sr, ref);
+
+			memcpy(ref, a, sizeof(Float) * N);
+			Scalar::sub(ref, ref, b);
+			*sa -= *sb;
+			checkEquals(*sa, ref);
+
+			assertEqualsEpsilon(sb->average(), Scalar::sum(b) / N, 1e-5f);
+			assertEquals(sb->max(), Scalar::max(b));
+			assertEquals(sb->min(), Scalar::min(b));
+			assertTrue(*sb == *sb && *sa != *sb && !sb->isZero());
+
+			*sr = Spec(0.0f);
+			assertTrue(sr->isZero());
+		}
+	}
+
+	void test05_misalignedKernels() {
+		ref<Random> random = new Random();
+		for (int i=0; i<100; ++i) {
+			checkMisaligned<8>(random);
+			checkMisaligned<16>(random);
+		}
+	}
 };
 
 MTS_EXPORT_TESTCASE(TestSpectrum, "Testcase for manipulating spectral data")
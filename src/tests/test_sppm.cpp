@@ -0,0 +1,125 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/integrator2.h>
+#include <mitsuba/render/scene.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestSPPM : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_responsiveDirect)
+	MTS_END_TESTCASE()
+
+	void test01_responsiveDirect() {
+		/* A diffuse plane lit by a point light at unit distance, viewed from
+		   above through a small orthographic window. The irradiance is almost
+		   constant across the window, hence the photon density estimate has
+		   to converge to the radiance of the plane without noticeable bias. */
+		const Float reflectance = 0.5f, intensity = 10.0f;
+		ref<Scene> scene = loadSceneFromString(formatString(
+			"<scene version=\"0.5.0\">"
+			"	<integrator type=\"sppm\">"
+			"		<float name=\"initialRadius\" value=\"0.02\"/>"
+			"		<integer name=\"photonCount\" value=\"100000\"/>"
+			"		<integer name=\"maxPasses\" value=\"16\"/>"
+			"	</integrator>"
+			"	<sensor type=\"orthographic\">"
+			"		<transform name=\"toWorld\">"
+			"			<scale x=\"0.1\" y=\"0.1\"/>"
+			"			<lookat origin=\"0, 0, 2\" target=\"0, 0, 0\" up=\"0, 1, 0\"/>"
+			"		</transform>"
+			"		<sampler type=\"independent\"/>"
+			"		<film type=\"hdrfilm\">"
+			"			<integer name=\"width\" value=\"16\"/>"
+			"			<integer name=\"height\" value=\"16\"/>"
+			"			<rfilter type=\"box\"/>"
+			"		</film>"
+			"	</sensor>"
+			"	<shape type=\"rectangle\">"
+			"		<transform name=\"toWorld\">"
+			"			<scale x=\"10\" y=\"10\"/>"
+			"		</transform>"
+			"		<bsdf type=\"diffuse\">"
+			"			<spectrum name=\"reflectance\" value=\"%f\"/>"
+			"		</bsdf>"
+			"	</shape>"
+			"	<emitter type=\"point\">"
+			"		<point name=\"position\" x=\"0\" y=\"0\" z=\"1\"/>"
+			"		<spectrum name=\"intensity\" value=\"%f\"/>"
+			"	</emitter>"
+			"</scene>", reflectance, intensity));
+		scene->initialize();
+
+		Sensor *sensor = scene->getSensor();
+		Sampler *sampler = scene->getSampler();
+		Film *film = sensor->getFilm();
+		ref<ResponsiveIntegrator> integrator = scene->getIntegrator()->makeResponsiveIntegrator();
+		assertTrue(integrator.get() != NULL);
+
+		ref<ImageBlock> target = new ImageBlock(Bitmap::ESpectrumAlpha,
+			film->getSize(), film->getReconstructionFilter());
+		target->clear();
+
+		ImageBlock *targets[] = { target.get() };
+		Sampler *samplers[] = { sampler };
+		assertTrue(integrator->preprocess(scene, sensor, sampler));
+		assertTrue(integrator->allocate(*scene, samplers, targets, 1));
+		integrator->prepareFrame(1);
+
+		ResponsiveIntegrator::Controls controls = { NULL, NULL, NULL };
+		int result = integrator->render(*scene, *sensor, *sampler, *target, controls, 0, 1);
+		assertEquals(result, 1); /* Stopped after 'maxPasses' */
+
+		/* Every gather point overlaps at most eight grid cells */
+		float refsPerPoint = 0;
+		sscanf(integrator->getRealtimeStatistics(),
+			"%*f passes/s, %*fM photons/s, %f grid refs/point", &refsPerPoint);
+		assertTrue(refsPerPoint > 0 && refsPerPoint <= 8);
+
+		const Bitmap *bitmap = target->getBitmap();
+		const int channels = bitmap->getChannelCount(),
+		          border = target->getBorderSize();
+		const Vector2i size = film->getSize();
+		Float mean = 0;
+		bool valid = true;
+		for (int y=0; y<size.y; ++y) {
+			const Float *data = bitmap->getFloatData() + ((size_t) (y + border)
+				* bitmap->getWidth() + border) * channels;
+			for (int x=0; x<size.x; ++x, data += channels) {
+				Spectrum value;
+				for (int i=0; i<SPECTRUM_SAMPLES; ++i)
+					value[i] = data[i];
+				valid &= value.isValid();
+				mean += value.getLuminance();
+			}
+		}
+		mean /= size.x * size.y;
+		assertTrue(valid);
+
+		/* Diffuse reflection of the irradiance I/r^2 at r = 1 */
+		Float expected = reflectance * INV_PI * intensity;
+		Log(EInfo, "Mean radiance: %f (expected %f)", mean, expected);
+		assertEqualsEpsilon(mean, expected, 0.1f * expected);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestSPPM, "Testcase for the responsive SPPM integrator")
+MTS_NAMESPACE_END
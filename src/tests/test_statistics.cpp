@@ -0,0 +1,162 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/statistics.h>
+#include <mitsuba/render/testcase.h>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+MTS_NAMESPACE_BEGIN
+
+/* Counters stay registered with the statistics collector, hence
+   they must outlive the test case */
+static StatsCounter shardReuse("Test statistics", "Shard reuse", EPercentage);
+static StatsCounter sharedShard("Test statistics", "Shared shard");
+static StatsCounter escaping("Test \"statistics\"", "comma, \"quote\"\n\ttab\x01");
+
+class TestStatistics : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_shardReuse)
+	MTS_DECLARE_TEST(test02_sharedShardFallback)
+	MTS_DECLARE_TEST(test03_snapshotEscaping)
+	MTS_END_TESTCASE()
+
+	/// Simple barrier for a fixed number of threads
+	struct Barrier {
+		std::mutex mutex;
+		std::condition_variable cv;
+		int remaining;
+
+		Barrier(int count) : remaining(count) { }
+
+		void wait() {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (--remaining == 0)
+				cv.notify_all();
+			else
+				cv.wait(lock, [this] { return remaining == 0; });
+		}
+	};
+
+	/// Increments a counter and records the shard that was used
+	class CountingThread : public Thread {
+	public:
+		CountingThread(StatsCounter &counter, int count, Barrier *barrier = NULL)
+			: Thread("count"), m_counter(counter), m_count(count),
+			  m_barrier(barrier), m_shard(-1) { }
+
+		void run() {
+			++m_counter;
+			m_shard = StatsCounter::getShard();
+			if (m_barrier)
+				m_barrier->wait();
+			for (int i=1; i<m_count; ++i) {
+				++m_counter;
+				m_counter.incrementBase(2);
+			}
+			m_counter.incrementBase(2);
+		}
+
+		int getShard() const { return m_shard; }
+	private:
+		StatsCounter &m_counter;
+		int m_count;
+		Barrier *m_barrier;
+		int m_shard;
+	};
+
+	void test01_shardReuse() {
+		shardReuse.reset();
+
+		/* Consecutive generations of short-lived threads reuse the shards
+		   of their predecessors, which must keep the earlier counts */
+		const int rounds = 4, threadCount = 8, count = 10000;
+		std::set<int> shards;
+		for (int i=0; i<rounds; ++i) {
+			ref_vector<CountingThread> threads;
+			for (int j=0; j<threadCount; ++j) {
+				threads.push_back(new CountingThread(shardReuse, count));
+				threads[j]->start();
+			}
+			for (int j=0; j<threadCount; ++j) {
+				threads[j]->join();
+				shards.insert(threads[j]->getShard());
+			}
+			assertEquals((int) shardReuse.getValue(), (i+1) * threadCount * count);
+			assertEquals((int) shardReuse.getBase(), 2 * (i+1) * threadCount * count);
+		}
+		Log(EInfo, "%i threads used %i distinct shards",
+			rounds * threadCount, (int) shards.size());
+		assertTrue((int) shards.size() < rounds * threadCount);
+
+		std::string snapshot = Statistics::getInstance()->getSnapshot(
+			Statistics::EJSON, "Test statistics");
+		assertTrue(snapshot.find(formatString("\"name\":\"Shard reuse\",\"type\":"
+			"\"percentage\",\"value\":%i,\"base\":%i", rounds * threadCount * count,
+			2 * rounds * threadCount * count)) != std::string::npos);
+	}
+
+	void test02_sharedShardFallback() {
+		sharedShard.reset();
+
+		/* More concurrently running threads than shards: the surplus
+		   threads share the first shard, which is updated atomically */
+		const int threadCount = NUM_COUNTERS + 8, count = 10000;
+		Barrier barrier(threadCount);
+		ref_vector<CountingThread> threads;
+		for (int i=0; i<threadCount; ++i) {
+			threads.push_back(new CountingThread(sharedShard, count, &barrier));
+			threads[i]->start();
+		}
+
+		std::set<int> shards;
+		int sharing = 0;
+		for (int i=0; i<threadCount; ++i) {
+			threads[i]->join();
+			int shard = threads[i]->getShard();
+			assertTrue(shard >= 0 && shard < NUM_COUNTERS);
+			if (shard == 0)
+				++sharing;
+			else
+				shards.insert(shard);
+		}
+		assertTrue(sharing >= threadCount - (NUM_COUNTERS - 1));
+		assertEquals((int) shards.size(), threadCount - sharing);
+		assertEquals((int) sharedShard.getValue(), threadCount * count);
+	}
+
+	void test03_snapshotEscaping() {
+		escaping.reset();
+		escaping += 3;
+
+		const std::string category = "Test \"statistics\"";
+		std::string json = Statistics::getInstance()->getSnapshot(Statistics::EJSON, category);
+		assertTrue(json == "{\"counters\":[{\"category\":\"Test \\\"statistics\\\"\","
+			"\"name\":\"comma, \\\"quote\\\"\\u000a\\u0009tab\\u0001\","
+			"\"type\":\"number\",\"value\":3,\"base\":0}]}");
+
+		std::string csv = Statistics::getInstance()->getSnapshot(Statistics::ECSV, category);
+		assertTrue(csv == "category,name,type,value,base\n"
+			"\"Test \"\"statistics\"\"\",\"comma, \"\"quote\"\"\n\ttab\x01\",number,3,0\n");
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestStatistics, "Testcase for statistics counters")
+MTS_NAMESPACE_END
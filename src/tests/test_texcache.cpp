@@ -0,0 +1,102 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/texcache.h>
+#include <mitsuba/render/testcase.h>
+#include <atomic>
+
+MTS_NAMESPACE_BEGIN
+
+class TestTextureCache : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_evictionUnderBudget)
+	MTS_END_TESTCASE()
+
+	/// Fills every tile with a byte pattern derived from its index
+	class PatternProvider : public TextureCache::TileProvider {
+	public:
+		PatternProvider(size_t tileSize) : m_tileSize(tileSize), m_loads(0) { }
+
+		size_t getTileSize() const { return m_tileSize; }
+
+		void loadTile(uint32_t tileIndex, uint8_t *target) const {
+			for (size_t i=0; i<m_tileSize; ++i)
+				target[i] = (uint8_t) (tileIndex * 31 + i);
+			m_loads++;
+		}
+
+		size_t getLoads() const { return m_loads; }
+	private:
+		size_t m_tileSize;
+		mutable std::atomic<size_t> m_loads;
+	};
+
+	bool checkTile(const uint8_t *data, uint32_t tileIndex, size_t tileSize) {
+		for (size_t i=0; i<tileSize; ++i) {
+			if (data[i] != (uint8_t) (tileIndex * 31 + i))
+				return false;
+		}
+		return true;
+	}
+
+	void test01_evictionUnderBudget() {
+		const size_t tileSize = 4096, tileCount = 2048;
+		TextureCache *cache = TextureCache::getInstance();
+		size_t oldBudget = cache->getBudget();
+
+		/* Room for two tiles in each of the cache shards */
+		const size_t budget = 128 * tileSize;
+		cache->setBudget(budget);
+
+		PatternProvider provider(tileSize);
+		uint32_t id = cache->registerProvider(&provider);
+
+		bool valid = true, withinBudget = true;
+		for (uint32_t i=0; i<tileCount; ++i) {
+			valid &= checkTile(cache->lookup(id, i), i, tileSize);
+			withinBudget &= cache->getMemoryUsage() <= budget;
+		}
+		assertTrue(valid);
+		assertTrue(withinBudget);
+		assertEquals((int) provider.getLoads(), (int) tileCount);
+
+		/* Repeated lookups of the most recent tile never reach the provider */
+		for (int i=0; i<100; ++i)
+			valid &= checkTile(cache->lookup(id, tileCount-1), tileCount-1, tileSize);
+		assertTrue(valid);
+		assertEquals((int) provider.getLoads(), (int) tileCount);
+
+		/* Almost all of the early tiles were evicted and must be reloaded */
+		for (uint32_t i=0; i<tileCount; ++i)
+			valid &= checkTile(cache->lookup(id, i), i, tileSize);
+		assertTrue(valid);
+		assertTrue(provider.getLoads() > tileCount + tileCount / 2);
+
+		/* Shrinking the budget releases tiles right away */
+		cache->setBudget(budget / 4);
+		assertTrue(cache->getMemoryUsage() <= budget / 4);
+
+		cache->unregisterProvider(id);
+		assertEquals((int) cache->getMemoryUsage(), 0);
+		cache->setBudget(oldBudget);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestTextureCache, "Testcase for the texture cache")
+MTS_NAMESPACE_END
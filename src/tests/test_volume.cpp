@@ -0,0 +1,225 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/filesystem.h>
+#include <mitsuba/render/volume.h>
+#include <mitsuba/render/medium.h>
+#include <mitsuba/render/sampler.h>
+#include <mitsuba/render/testcase.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestVolume : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_floatRange)
+	MTS_DECLARE_TEST(test02_majorantGridTransmittance)
+	MTS_END_TESTCASE()
+
+	/// Write a single-channel float32 grid in the 'gridvolume' file format
+	void writeGrid(const fs::path &path, const Vector3i &res, const AABB &aabb,
+			Random *random, Float emptyFraction) {
+		ref<FileStream> stream = new FileStream(fs::encode_pathstr(path),
+			FileStream::ETruncReadWrite);
+		stream->setByteOrder(Stream::ELittleEndian);
+		stream->write("VOL", 3);
+		stream->writeChar(3);
+		stream->writeInt(1); /* float32 */
+		stream->writeInt(res.x);
+		stream->writeInt(res.y);
+		stream->writeInt(res.z);
+		stream->writeInt(1);
+		for (int i=0; i<3; ++i)
+			stream->writeSingle((float) aabb.min[i]);
+		for (int i=0; i<3; ++i)
+			stream->writeSingle((float) aabb.max[i]);
+		for (int i=0; i<res.x*res.y*res.z; ++i)
+			stream->writeSingle(random->nextFloat() < emptyFraction
+				? 0.0f : 3.0f * random->nextFloat());
+	}
+
+	ref<VolumeDataSource> createVolume(const Properties &props,
+			VolumeDataSource *nested = NULL) {
+		ref<VolumeDataSource> volume = static_cast<VolumeDataSource *>(
+			PluginManager::getInstance()->createObject(MTS_CLASS(VolumeDataSource), props));
+		if (nested)
+			volume->addChild("", nested);
+		volume->configure();
+		return volume;
+	}
+
+	ref<VolumeDataSource> createGrid(const fs::path &path) {
+		Properties props("gridvolume");
+		props.setString("filename", path.string());
+		return createVolume(props);
+	}
+
+	/// Check that lookups within random regions never leave the range reported for them
+	int checkFloatRange(const VolumeDataSource *volume, Random *random) {
+		const AABB &aabb = volume->getAABB();
+		Vector extents = aabb.getExtents();
+		int violations = 0;
+
+		for (int i=0; i<200; ++i) {
+			/* Random regions that may also stick out of the volume */
+			Point p0, p1;
+			for (int j=0; j<3; ++j) {
+				p0[j] = aabb.min[j] + extents[j] * (1.2f * random->nextFloat() - 0.1f);
+				p1[j] = p0[j] + extents[j] * 0.4f * random->nextFloat();
+			}
+			AABB region(p0, p1);
+
+			Float min, max;
+			volume->getFloatRange(region, min, max);
+			const Float eps = 1e-4f * std::max((Float) 1, std::abs(max));
+
+			for (int j=0; j<50; ++j) {
+				Point p;
+				for (int k=0; k<3; ++k)
+					p[k] = region.min[k] + (region.max[k] - region.min[k]) * random->nextFloat();
+				Float value = volume->lookupFloat(p);
+				if (value < min - eps || value > max + eps) {
+					if (violations++ == 0)
+						Log(EWarn, "%s: lookup %f at %s is outside of the range "
+							"[%f, %f] of %s", volume->getClass()->getName().c_str(),
+							value, p.toString().c_str(), min, max, region.toString().c_str());
+				}
+			}
+		}
+		return violations;
+	}
+
+	void test01_floatRange() {
+		ref<Random> random = new Random();
+		fs::path dir = fs::temp_directory_path();
+		AABB unitCube(Point(0.0f), Point(1.0f));
+
+		fs::path gridPath = dir / "mts_test_grid.vol";
+		writeGrid(gridPath, Vector3i(8, 6, 5), unitCube, random, 0.3f);
+		ref<VolumeDataSource> grid = createGrid(gridPath);
+		assertEquals(checkFloatRange(grid, random), 0);
+
+		/* Hierarchical grid of 2x2x2 blocks, one of which is missing */
+		std::string prefix = (dir / "mts_test_hgrid_").string();
+		fs::path dictPath = dir / "mts_test_hgrid.vol";
+		std::vector<fs::path> paths;
+		{
+			ref<FileStream> stream = new FileStream(fs::encode_pathstr(dictPath),
+				FileStream::ETruncReadWrite);
+			stream->setByteOrder(Stream::ELittleEndian);
+			for (int i=0; i<3; ++i)
+				stream->writeSingle((float) unitCube.min[i]);
+			for (int i=0; i<3; ++i)
+				stream->writeSingle((float) unitCube.max[i]);
+			Vector3i(2).serialize(stream);
+			for (int i=0; i<7; ++i) {
+				Vector3i block(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+				block.serialize(stream);
+				Point min(block.x * 0.5f, block.y * 0.5f, block.z * 0.5f);
+				paths.push_back(fs::path(formatString("%s%03i_%03i_%03i.vol",
+					prefix.c_str(), block.x, block.y, block.z)));
+				writeGrid(paths.back(), Vector3i(4), AABB(min, min + Vector(0.5f)),
+					random, 0.3f);
+			}
+		}
+		Properties hgridProps("hgridvolume");
+		hgridProps.setString("filename", dictPath.string());
+		hgridProps.setString("prefix", prefix);
+		hgridProps.setString("postfix", ".vol");
+		ref<VolumeDataSource> hgrid = createVolume(hgridProps);
+		assertEquals(checkFloatRange(hgrid, random), 0);
+
+		/* Cache with a voxel width that does not match the nested grid */
+		Properties cacheProps("volcache");
+		cacheProps.setFloat("voxelWidth", 0.07f);
+		ref<VolumeDataSource> cache = createVolume(cacheProps, grid);
+		assertEquals(checkFloatRange(cache, random), 0);
+
+		cache = NULL;
+		hgrid = NULL;
+		grid = NULL;
+		fs::remove(gridPath);
+		fs::remove(dictPath);
+		for (size_t i=0; i<paths.size(); ++i)
+			fs::remove(paths[i]);
+	}
+
+	ref<Medium> createMedium(VolumeDataSource *density, const std::string &method,
+			int majorantResolution) {
+		Properties props("heterogeneous");
+		props.setString("method", method);
+		props.setInteger("majorantResolution", majorantResolution);
+		ref<Medium> medium = static_cast<Medium *>(PluginManager::getInstance()->
+			createObject(MTS_CLASS(Medium), props));
+
+		Properties albedoProps("constvolume");
+		albedoProps.setSpectrum("value", Spectrum(0.5f));
+		ref<VolumeDataSource> albedo = createVolume(albedoProps);
+
+		medium->addChild("density", density);
+		medium->addChild("albedo", albedo);
+		medium->configure();
+		return medium;
+	}
+
+	void test02_majorantGridTransmittance() {
+		ref<Random> random = new Random();
+		fs::path gridPath = fs::temp_directory_path() / "mts_test_density.vol";
+		writeGrid(gridPath, Vector3i(8), AABB(Point(0.0f), Point(1.0f)), random, 0.5f);
+		ref<VolumeDataSource> density = createGrid(gridPath);
+
+		/* Deterministic reference, a single global majorant (the former
+		   Woodcock tracking estimator), and the majorant grid */
+		ref<Medium> simpson = createMedium(density, "simpson", 1);
+		ref<Medium> global = createMedium(density, "woodcock", 1);
+		ref<Medium> grid = createMedium(density, "woodcock", 16);
+
+		ref<Sampler> sampler = static_cast<Sampler *>(PluginManager::getInstance()->
+			createObject(MTS_CLASS(Sampler), Properties("independent")));
+		sampler->configure();
+
+		const int nRays = 20, nSamples = 40000;
+		for (int i=0; i<nRays; ++i) {
+			Point o(random->nextFloat() * 3 - 1, random->nextFloat() * 3 - 1, -1);
+			Point target(random->nextFloat(), random->nextFloat(), random->nextFloat());
+			Ray ray(o, normalize(target - o), 0.0f);
+
+			Float reference = simpson->evalTransmittance(ray, NULL)[0];
+			Float globalEstimate = 0, gridEstimate = 0;
+			for (int j=0; j<nSamples; ++j) {
+				globalEstimate += global->evalTransmittance(ray, sampler)[0];
+				gridEstimate += grid->evalTransmittance(ray, sampler)[0];
+			}
+			globalEstimate /= nSamples;
+			gridEstimate /= nSamples;
+
+			assertEqualsEpsilon(globalEstimate, reference, 0.01f);
+			assertEqualsEpsilon(gridEstimate, reference, 0.01f);
+			assertEqualsEpsilon(gridEstimate, globalEstimate, 0.015f);
+		}
+
+		density = NULL;
+		simpson = global = grid = NULL;
+		fs::remove(gridPath);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestVolume, "Testcase for volume data sources and heterogeneous media")
+MTS_NAMESPACE_END
@@ -77,6 +77,20 @@ MTS_NAMESPACE_BEGIN
  *        \emph{filename}\code{.mip} to be created.
  *        \default{automatic---use caching for textures larger than 1M pixels.}
  *     }
+ *     \parameter{outOfCore}{\Boolean}{
+ *        Access the MIP map cache file out-of-core? Instead of mapping the
+ *        entire file into memory, tiles are then paged in on demand through
+ *        a texture cache that is shared by all textures and limited to a global
+ *        memory budget (see the \code{-m} option of \code{mitsuba}). Implies
+ *        \code{cache=true}. \default{\code{false}}
+ *     }
+ *     \parameter{compress}{\Boolean}{
+ *        Store the MIP map using a lossy block-compressed format that requires
+ *        about 5 times less memory for RGB data (and about 2.7 times less
+ *        for monochromatic data), at the cost of a slightly higher lookup
+ *        cost. Applies to the MIP map cache file as well.
+ *        \default{\code{false}}
+ *     }
  *     \parameter{uoffset, voffset}{\Float}{
  *       Numerical offset that should be applied to UV lookups
  *     }
@@ -143,7 +157,8 @@ MTS_NAMESPACE_BEGIN
  * size of the occupied memory region might be orders of magnitude greater than that of the
  * original input file).
  *
- * For instance, a basic 10 megapixel image requires as much as 76 MiB of memory! Loading,
+ * For instance, a basic 10 megapixel image requires as much as 76 MiB of memory (16 MiB
+ * when the \code{compress} parameter is set)! Loading,
  * color space transformation, and MIP map construction require up to several seconds in this case.
  * To reduce these overheads, Mitsuba 0.4.0 introduced MIP map caches. When a large
  * texture is loaded for the first time, a MIP map cache file with the name \emph{filename}\code{.mip}
@@ -236,15 +251,24 @@ public:
 		if (m_filterType != EEWA)
 			m_maxAnisotropy = 1.0f;
 
+		m_compress = props.getBoolean("compress", false);
+
+		bool outOfCore = props.getBoolean("outOfCore", false);
+		if (outOfCore && cacheFile.empty()) {
+			Log(EWarn, "Out-of-core access requires a texture file on disk -- "
+				"keeping the texture in memory.");
+			outOfCore = false;
+		}
+
 		fs::pathstr scacheFile = fs::encode_pathstr(cacheFile);
 		if (tryReuseCache && MIPMap3::validateCacheFile(scacheFile, timestamp,
-				Bitmap::ERGB, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma)) {
+				Bitmap::ERGB, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma, m_compress)) {
 			/* Reuse an existing MIP map cache file */
-			m_mipmap3 = new MIPMap3(scacheFile, m_maxAnisotropy);
+			m_mipmap3 = new MIPMap3(scacheFile, m_maxAnisotropy, outOfCore);
 		} else if (tryReuseCache && MIPMap1::validateCacheFile(scacheFile, timestamp,
-				Bitmap::ELuminance, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma)) {
+				Bitmap::ELuminance, m_wrapModeU, m_wrapModeV, m_filterType, m_gamma, m_compress)) {
 			/* Reuse an existing MIP map cache file */
-			m_mipmap1 = new MIPMap1(scacheFile, m_maxAnisotropy);
+			m_mipmap1 = new MIPMap1(scacheFile, m_maxAnisotropy, outOfCore);
 		} else {
 			if (bitmap == NULL) {
 				/* Load the input image if necessary */
@@ -290,17 +314,36 @@ public:
 			rfilter->configure();
 
 			/* Potentially create a new MIP map cache file */
-			bool createCache = !cacheFile.empty() && props.getBoolean("cache",
-				bitmap->getSize().x * bitmap->getSize().y > 1024*1024);
+			bool createCache = !cacheFile.empty() && (outOfCore || props.getBoolean("cache",
+				bitmap->getSize().x * bitmap->getSize().y > 1024*1024));
 
 			if (pixelFormat == Bitmap::ELuminance)
 				m_mipmap1 = new MIPMap1(bitmap, pixelFormat, Bitmap::EFloat,
 					rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-					createCache ? scacheFile : fs::pathstr(), timestamp);
+					createCache ? scacheFile : fs::pathstr(), timestamp, 1.0f,
+					Spectrum::EReflectance, m_compress);
 			else
 				m_mipmap3 = new MIPMap3(bitmap, pixelFormat, Bitmap::EFloat,
 					rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-					createCache ? scacheFile : fs::pathstr(), timestamp);
+					createCache ? scacheFile : fs::pathstr(), timestamp, 1.0f,
+					Spectrum::EReflectance, m_compress);
+
+			/* Release the generated pyramid and page it back in from the cache
+			   file (unless the latter could not be created) */
+			if (outOfCore && (pixelFormat == Bitmap::ELuminance
+					? MIPMap1::validateCacheFile(scacheFile, timestamp, pixelFormat,
+						m_wrapModeU, m_wrapModeV, m_filterType, 0, m_compress)
+					: MIPMap3::validateCacheFile(scacheFile, timestamp, pixelFormat,
+						m_wrapModeU, m_wrapModeV, m_filterType, 0, m_compress))) {
+				bitmap = NULL;
+				if (m_mipmap1.get()) {
+					m_mipmap1 = NULL;
+					m_mipmap1 = new MIPMap1(scacheFile, m_maxAnisotropy, true);
+				} else {
+					m_mipmap3 = NULL;
+					m_mipmap3 = new MIPMap3(scacheFile, m_maxAnisotropy, true);
+				}
+			}
 		}
 	}
 
@@ -350,6 +393,7 @@ public:
 		m_wrapModeV = (ReconstructionFilter::EBoundaryCondition) stream->readUInt();
 		m_gamma = stream->readFloat();
 		m_maxAnisotropy = stream->readFloat();
+		m_compress = stream->readBool();
 		m_channel = stream->readString();
 
 		size_t size = stream->readSize();
@@ -394,11 +438,11 @@ public:
 		if (pixelFormat == Bitmap::ELuminance)
 			m_mipmap1 = new MIPMap1(bitmap, pixelFormat, Bitmap::EFloat,
 				rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-				fs::pathstr(), 0);
+				fs::pathstr(), 0, 1.0f, Spectrum::EReflectance, m_compress);
 		else
 			m_mipmap3 = new MIPMap3(bitmap, pixelFormat, Bitmap::EFloat,
 				rfilter, m_wrapModeU, m_wrapModeV, m_filterType, m_maxAnisotropy,
-				fs::pathstr(), 0);
+				fs::pathstr(), 0, 1.0f, Spectrum::EReflectance, m_compress);
 	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
@@ -409,6 +453,7 @@ public:
 		stream->writeUInt(m_wrapModeV);
 		stream->writeFloat(m_gamma);
 		stream->writeFloat(m_maxAnisotropy);
+		stream->writeBool(m_compress);
 
 		if (!m_filename.empty() && fs::exists(m_filename)) {
 			/* We still have access to the original image -- use that, since
@@ -591,6 +636,7 @@ protected:
 	ReconstructionFilter::EBoundaryCondition m_wrapModeU;
 	ReconstructionFilter::EBoundaryCondition m_wrapModeV;
 	Float m_gamma, m_maxAnisotropy;
+	bool m_compress;
 	std::string m_channel;
 	fs::path m_filename;
 };
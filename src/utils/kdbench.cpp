@@ -51,6 +51,9 @@ public:
 		cout << "   -l value       Specify the primitive count, below which a leaf node" << endl;
 		cout << "                  will always be created" << endl << endl;
 		cout << "   -d depth       Specify the maximum tree depth" << endl << endl;
+		cout << "   -a kd/bvh/both Select the acceleration data structure. With 'both', a" << endl;
+		cout << "                  4-wide BVH is built over the same shapes after the" << endl;
+		cout << "                  kd-tree and both are benchmarked (default: kd)" << endl << endl;
 	 	cout << "   -x value       Specify the number of primitives, at which the " << endl;
 		cout << "                  builder will switch from (approximate) Min-Max " << endl;
 		cout << "                  binning to the more accurate O(n log n) SAH-based " << endl;
@@ -66,6 +69,43 @@ public:
 		cout << "  this on a huge model." << endl << endl;
 	}
 
+	/// Shoot incoherent rays through the bounding sphere, returns the best MRays/s of three runs
+	Float benchmark(const ShapeKDTree *kdtree) {
+		BSphere bsphere(kdtree->getAABB().getBSphere());
+		const size_t nRays = 5000000;
+
+		Log(EInfo, "Bounding sphere: %s", bsphere.toString().c_str());
+		Float best = 0;
+		for (int j=0; j<3; ++j) {
+			ref<Random> random = new Random();
+			ref<Timer> timer = new Timer();
+			size_t nIntersections = 0;
+
+			Log(EInfo, "Shooting " SIZE_T_FMT " rays (1 thread, incoherent) ..", nRays);
+
+			for (size_t i=0; i<nRays; ++i) {
+				Point2 sample1(random->nextFloat(), random->nextFloat()),
+					sample2(random->nextFloat(), random->nextFloat());
+				Point p1 = bsphere.center + warp::squareToUniformSphere(sample1) * bsphere.radius;
+				Point p2 = bsphere.center + warp::squareToUniformSphere(sample2) * bsphere.radius;
+				Ray r(p1, normalize(p2-p1), 0.0f);
+
+				Intersection its;
+				if (kdtree->rayIntersect(r, its))
+					nIntersections++;
+			}
+
+			Log(EInfo, "Found " SIZE_T_FMT " intersections in %i ms",
+				nIntersections, timer->getMilliseconds());
+			Float mrays = nRays / (timer->getMilliseconds() * (Float) 1000);
+			Log(EInfo, "-> %.3f MRays/s", mrays);
+			Log(EInfo, "");
+			best = std::max(best, mrays);
+		}
+		Log(EInfo, "Best of three: %.3f MRays/s", best);
+		return best;
+	}
+
 	int run(int argc, char **argv) {
 		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
 		int optchar;
@@ -73,10 +113,11 @@ public:
 		Float intersectionCost = -1, traversalCost = -1, emptySpaceBonus = -1;
 		int stopPrims = -1, maxDepth = -1, exactPrims = -1, minMaxBins = -1;
 		bool clip = true, parallel = true, retract = true, fitParameters = false;
+		bool benchKD = true, benchBVH = false;
 		optind = 1;
 
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "i:t:e:c:p:r:l:x:b:d:hf")) != -1) {
+		while ((optchar = getopt(argc, argv, "i:t:e:c:p:r:l:x:b:d:a:hf")) != -1) {
 			switch (optchar) {
 				case 'h': {
 						help();
@@ -121,6 +162,17 @@ public:
 					if (*end_ptr != '\0')
 						SLog(EError, "Could not parse the min-max bins parameter!");
 					break;
+				case 'a':
+					if (strcmp(optarg, "kd") == 0) {
+						benchKD = true; benchBVH = false;
+					} else if (strcmp(optarg, "bvh") == 0) {
+						benchKD = false; benchBVH = true;
+					} else if (strcmp(optarg, "both") == 0) {
+						benchKD = benchBVH = true;
+					} else {
+						SLog(EError, "Could not parse the acceleration data structure!");
+					}
+					break;
 				case 'c':
 					if (strcmp(optarg, "true") == 0)
 						clip = true;
@@ -197,6 +249,7 @@ public:
 		kdtree->setClip(clip);
 		kdtree->setRetract(retract);
 		kdtree->setParallelBuild(parallel);
+		kdtree->setAccelerator(benchKD ? ShapeKDTree::EKDTree : ShapeKDTree::EBVH);
 
 		/* Show some statistics, and make sure it roughly fits in 80cols */
 		Logger *logger = Thread::getThread()->getLogger();
@@ -204,47 +257,38 @@ public:
 		logger->setLogLevel(EDebug);
 		formatter->setHaveDate(false);
 
+		ref<Timer> buildTimer = new Timer();
 		if (scene)
 			scene->initialize();
 		else
 			kdtree->build();
+		int buildTime = buildTimer->getMilliseconds();
 
-		BSphere bsphere(kdtree->getAABB().getBSphere());
-		const size_t nRays = 5000000;
-
-		if (!fitParameters) {
-			Log(EInfo, "Bounding sphere: %s", bsphere.toString().c_str());
-			Float best = 0;
-			for (int j=0; j<3; ++j) {
-				ref<Random> random = new Random();
-				ref<Timer> timer = new Timer();
-				size_t nIntersections = 0;
-
-				Log(EInfo, "Shooting " SIZE_T_FMT " rays (1 thread, incoherent) ..", nRays);
-
-				for (size_t i=0; i<nRays; ++i) {
-					Point2 sample1(random->nextFloat(), random->nextFloat()),
-						sample2(random->nextFloat(), random->nextFloat());
-					Point p1 = bsphere.center + warp::squareToUniformSphere(sample1) * bsphere.radius;
-					Point p2 = bsphere.center + warp::squareToUniformSphere(sample2) * bsphere.radius;
-					Ray r(p1, normalize(p2-p1), 0.0f);
-
-					Intersection its;
-					if (kdtree->rayIntersect(r, its))
-						nIntersections++;
-				}
-
-				Log(EInfo, "Found " SIZE_T_FMT " intersections in %i ms",
-					nIntersections, timer->getMilliseconds());
-				Float mrays = nRays / (timer->getMilliseconds() * (Float) 1000);
-				Log(EInfo, "-> %.3f MRays/s", mrays);
-				Log(EInfo, "");
-				best = std::max(best, mrays);
-			}
-			Log(EInfo, "Best of three: %.3f MRays/s", best);
-		} else {
+		if (fitParameters && benchKD) {
 			Float intersectionCost, traversalCost;
 			kdtree->findCosts(intersectionCost, traversalCost);
+		} else {
+			Float best = benchmark(kdtree);
+			if (benchKD && benchBVH) {
+				/* Build a BVH over the same (already expanded) shapes */
+				ref<ShapeKDTree> bvh = new ShapeKDTree();
+				const std::vector<const Shape *> &shapes = kdtree->getShapes();
+				for (size_t i=0; i<shapes.size(); ++i)
+					bvh->addShape(shapes[i]);
+				bvh->setParallelBuild(parallel);
+				bvh->setAccelerator(ShapeKDTree::EBVH);
+				buildTimer->reset();
+				bvh->build();
+				int bvhBuildTime = buildTimer->getMilliseconds();
+				Float bvhBest = benchmark(bvh);
+
+				Log(EInfo, "Comparison      kd-tree       BVH");
+				Log(EInfo, "  Build time:   %7i ms    %7i ms", buildTime, bvhBuildTime);
+				Log(EInfo, "  Throughput:   %7.3f MR/s  %7.3f MR/s", best, bvhBest);
+				Log(EInfo, "  BVH storage:  %s", memString(bvh->getBVH().getMemoryUsage()).c_str());
+			} else {
+				Log(EInfo, "Build time: %i ms", buildTime);
+			}
 		}
 
 		Thread::getThread()->getLogger()->setLogLevel(EInfo);
@@ -0,0 +1,79 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/render/trimesh.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+class Serialized2MMap : public Utility {
+public:
+	void help() {
+		cout << endl;
+		cout << "Synopsis: Converts a .serialized geometry file into the uncompressed," << endl;
+		cout << "page-aligned variant of the format. Such files are memory-mapped by the" << endl;
+		cout << "'serialized' shape plugin and referenced without copying, which makes" << endl;
+		cout << "loading I/O-bound and lets concurrent render processes on the same machine" << endl;
+		cout << "share the geometry through the file cache. The data is stored in the" << endl;
+		cout << "floating point precision of this build." << endl;
+		cout << endl;
+		cout << "Usage: mtsutil serialized2mmap <input.serialized> <output.serialized>" << endl;
+		cout << endl;
+	}
+
+	int run(int argc, char **argv) {
+		if (argc != 3) {
+			help();
+			return -1;
+		}
+
+		ref<Timer> timer = new Timer();
+		ref<FileStream> in = new FileStream(fs::pathstr(argv[1]), FileStream::EReadOnly);
+		in->setByteOrder(Stream::ELittleEndian);
+		ref<FileStream> out = new FileStream(fs::pathstr(argv[2]), FileStream::ETruncReadWrite);
+		out->setByteOrder(Stream::ELittleEndian);
+
+		int count = TriMesh::getSerializedMeshCount(in);
+		std::vector<uint64_t> offsets(count);
+		size_t triangleCount = 0;
+		for (int i=0; i<count; ++i) {
+			in->seek(0);
+			ref<TriMesh> mesh = new TriMesh(in, i);
+			offsets[i] = (uint64_t) mesh->serializeUncompressed(out);
+			triangleCount += mesh->getTriangleCount();
+		}
+
+		/* End-of-file dictionary */
+		if (count > 0)
+			out->writeULongArray(&offsets[0], count);
+		out->writeUInt((uint32_t) count);
+
+		Log(EInfo, "Converted %i meshes (" SIZE_T_FMT " triangles, %s) in %i ms",
+			count, triangleCount, memString(out->getSize()).c_str(),
+			timer->getMilliseconds());
+		out->close();
+		return 0;
+	}
+
+	MTS_DECLARE_UTILITY()
+};
+
+MTS_EXPORT_UTILITY(Serialized2MMap, "Convert serialized meshes into the memory-mappable format");
+MTS_NAMESPACE_END
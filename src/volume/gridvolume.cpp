@@ -584,6 +584,53 @@ public:
 		return 1.0f;
 	}
 
+	void getFloatRange(const AABB &aabb, Float &min, Float &max) const {
+		if (m_channels != 1 || (m_volumeType != EFloat32 && m_volumeType != EUInt8)) {
+			VolumeDataSource::getFloatRange(aabb, min, max);
+			return;
+		}
+
+		/* Find the voxels that contribute to lookups within the region */
+		AABB gridAABB;
+		for (int i=0; i<8; ++i)
+			gridAABB.expandBy(m_worldToGrid.transformAffine(aabb.getCorner(i)));
+
+		int start[3], end[3];
+		bool outside = false;
+		for (int i=0; i<3; ++i) {
+			start[i] = math::floorToInt(gridAABB.min[i]);
+			end[i] = math::floorToInt(gridAABB.max[i]) + 1;
+			/* Lookups return zero outside of the grid */
+			if (start[i] < 0 || end[i] >= m_res[i])
+				outside = true;
+			start[i] = std::max(start[i], 0);
+			end[i] = std::min(end[i], m_res[i] - 1);
+			if (start[i] > end[i]) {
+				min = max = 0.0f;
+				return;
+			}
+		}
+
+		min = std::numeric_limits<Float>::infinity();
+		max = -std::numeric_limits<Float>::infinity();
+		for (int z=start[2]; z<=end[2]; ++z) {
+			for (int y=start[1]; y<=end[1]; ++y) {
+				size_t idx = ((size_t) z * m_res.y + y) * m_res.x + start[0];
+				for (int x=start[0]; x<=end[0]; ++x, ++idx) {
+					Float value = m_volumeType == EFloat32
+						? (Float) ((float *) m_data)[idx] : m_densityMap[m_data[idx]];
+					min = std::min(min, value);
+					max = std::max(max, value);
+				}
+			}
+		}
+
+		if (outside) {
+			min = std::min(min, (Float) 0);
+			max = std::max(max, (Float) 0);
+		}
+	}
+
 	std::string toString() const {
 		std::ostringstream oss;
 		oss << "GridVolume[" << endl
@@ -92,6 +92,7 @@ public:
 		m_supportsVectorLookups = true;
 		m_supportsSpectrumLookups = true;
 		m_stepSize = std::numeric_limits<Float>::infinity();
+		m_maxFloatValue = 0.0f;
 
 		int numBlocks = 0;
 		while (!stream->isEOF()) {
@@ -108,7 +109,7 @@ public:
 					createObject(MTS_CLASS(VolumeDataSource), props));
 			content->configure();
 
-			m_maxFloatValue = content->getMaximumFloatValue();
+			m_maxFloatValue = std::max(m_maxFloatValue, content->getMaximumFloatValue());
 			m_blocks[(m_res.y * block.z + block.y) * m_res.x + block.x] = content;
 			m_stepSize = std::min(m_stepSize, content->getStepSize());
 			m_supportsVectorLookups = m_supportsVectorLookups && content->supportsVectorLookups();
@@ -196,6 +197,51 @@ public:
 		return m_maxFloatValue;
 	}
 
+	void getFloatRange(const AABB &aabb, Float &min, Float &max) const {
+		AABB gridAABB;
+		for (int i=0; i<8; ++i)
+			gridAABB.expandBy(m_worldToGrid.transformAffine(aabb.getCorner(i)));
+
+		int start[3], end[3];
+		bool empty = false;
+		for (int i=0; i<3; ++i) {
+			start[i] = math::floorToInt(gridAABB.min[i]);
+			end[i] = math::floorToInt(gridAABB.max[i]);
+			if (start[i] < 0 || end[i] >= m_res[i])
+				empty = true;
+			start[i] = std::max(start[i], 0);
+			end[i] = std::min(end[i], m_res[i] - 1);
+			if (start[i] > end[i]) {
+				min = max = 0.0f;
+				return;
+			}
+		}
+
+		/* Combine the ranges of all blocks overlapping the region */
+		min = std::numeric_limits<Float>::infinity();
+		max = -std::numeric_limits<Float>::infinity();
+		for (int z=start[2]; z<=end[2]; ++z) {
+			for (int y=start[1]; y<=end[1]; ++y) {
+				for (int x=start[0]; x<=end[0]; ++x) {
+					const VolumeDataSource *block = m_blocks[((z * m_res.y) + y) * m_res.x + x];
+					if (block == NULL) {
+						empty = true;
+						continue;
+					}
+					Float blockMin, blockMax;
+					block->getFloatRange(aabb, blockMin, blockMax);
+					min = std::min(min, blockMin);
+					max = std::max(max, blockMax);
+				}
+			}
+		}
+
+		if (empty) {
+			min = std::min(min, (Float) 0);
+			max = std::max(max, (Float) 0);
+		}
+	}
+
 	MTS_DECLARE_CLASS()
 protected:
 	fs::pathstr m_filename;
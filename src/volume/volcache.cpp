@@ -322,6 +322,23 @@ public:
 		return m_nested->getMaximumFloatValue();
 	}
 
+	void getFloatRange(const AABB &aabb, Float &min, Float &max) const {
+		/* Cached values interpolate lookups of the nested volume
+		   at the vertices of the surrounding voxels */
+		AABB nestedAABB;
+		for (int i=0; i<8; ++i)
+			nestedAABB.expandBy(m_worldToVolume.transformAffine(aabb.getCorner(i)));
+		nestedAABB.min -= Vector(m_voxelWidth);
+		nestedAABB.max += Vector(m_voxelWidth);
+		m_nested->getFloatRange(nestedAABB, min, max);
+
+		/* Lookups return zero outside of the cached region */
+		if (!m_aabb.contains(nestedAABB)) {
+			min = std::min(min, (Float) 0);
+			max = std::max(max, (Float) 0);
+		}
+	}
+
 	MTS_DECLARE_CLASS()
 protected:
 	ref<VolumeDataSource> m_nested;